@@ -1,5 +1,9 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+	#define _GNU_SOURCE /* recvmmsg, sendmmsg */
+#endif
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
@@ -571,6 +575,31 @@ void thread_sleep(int milliseconds)
 #endif
 }
 
+void thread_usleep(int microseconds)
+{
+#if defined(CONF_FAMILY_UNIX)
+	struct timespec ts;
+	ts.tv_sec = microseconds/1000000;
+	ts.tv_nsec = (microseconds%1000000)*1000;
+	while(nanosleep(&ts, &ts) == -1 && errno == EINTR);
+#elif defined(CONF_FAMILY_WINDOWS)
+	/* waitable timers take the due time in 100ns units, negative means relative */
+	LARGE_INTEGER DueTime;
+	HANDLE Timer = CreateWaitableTimer(NULL, TRUE, NULL);
+	if(!Timer)
+	{
+		Sleep(microseconds/1000);
+		return;
+	}
+	DueTime.QuadPart = -(LONGLONG)microseconds*10;
+	if(SetWaitableTimer(Timer, &DueTime, 0, NULL, NULL, FALSE))
+		WaitForSingleObject(Timer, INFINITE);
+	CloseHandle(Timer);
+#else
+	#error not implemented
+#endif
+}
+
 void thread_detach(void *thread)
 {
 #if defined(CONF_FAMILY_UNIX)
@@ -1136,6 +1165,34 @@ NETSOCKET net_udp_create(NETADDR bindaddr, int use_random_port)
 	return sock;
 }
 
+static void priv_net_udp_sockaddr_in(const NETADDR *addr, struct sockaddr_in *sa)
+{
+	if(addr->type&NETTYPE_LINK_BROADCAST)
+	{
+		mem_zero(sa, sizeof(*sa));
+		sa->sin_port = htons(addr->port);
+		sa->sin_family = AF_INET;
+		sa->sin_addr.s_addr = INADDR_BROADCAST;
+	}
+	else
+		netaddr_to_sockaddr_in(addr, sa);
+}
+
+static void priv_net_udp_sockaddr_in6(const NETADDR *addr, struct sockaddr_in6 *sa)
+{
+	if(addr->type&NETTYPE_LINK_BROADCAST)
+	{
+		mem_zero(sa, sizeof(*sa));
+		sa->sin6_port = htons(addr->port);
+		sa->sin6_family = AF_INET6;
+		sa->sin6_addr.s6_addr[0] = 0xff; /* multicast */
+		sa->sin6_addr.s6_addr[1] = 0x02; /* link local scope */
+		sa->sin6_addr.s6_addr[15] = 1; /* all nodes */
+	}
+	else
+		netaddr_to_sockaddr_in6(addr, sa);
+}
+
 int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size)
 {
 	int d = -1;
@@ -1145,16 +1202,7 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 		if(sock.ipv4sock >= 0)
 		{
 			struct sockaddr_in sa;
-			if(addr->type&NETTYPE_LINK_BROADCAST)
-			{
-				mem_zero(&sa, sizeof(sa));
-				sa.sin_port = htons(addr->port);
-				sa.sin_family = AF_INET;
-				sa.sin_addr.s_addr = INADDR_BROADCAST;
-			}
-			else
-				netaddr_to_sockaddr_in(addr, &sa);
-
+			priv_net_udp_sockaddr_in(addr, &sa);
 			d = sendto((int)sock.ipv4sock, (const char*)data, size, 0, (struct sockaddr *)&sa, sizeof(sa));
 		}
 		else
@@ -1166,18 +1214,7 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 		if(sock.ipv6sock >= 0)
 		{
 			struct sockaddr_in6 sa;
-			if(addr->type&NETTYPE_LINK_BROADCAST)
-			{
-				mem_zero(&sa, sizeof(sa));
-				sa.sin6_port = htons(addr->port);
-				sa.sin6_family = AF_INET6;
-				sa.sin6_addr.s6_addr[0] = 0xff; /* multicast */
-				sa.sin6_addr.s6_addr[1] = 0x02; /* link local scope */
-				sa.sin6_addr.s6_addr[15] = 1; /* all nodes */
-			}
-			else
-				netaddr_to_sockaddr_in6(addr, &sa);
-
+			priv_net_udp_sockaddr_in6(addr, &sa);
 			d = sendto((int)sock.ipv6sock, (const char*)data, size, 0, (struct sockaddr *)&sa, sizeof(sa));
 		}
 		else
@@ -1234,6 +1271,184 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, void *data, int maxsize)
 	return -1; /* error */
 }
 
+#if defined(CONF_PLATFORM_LINUX)
+enum
+{
+	/* packets per recvmmsg/sendmmsg call */
+	NET_UDP_MMSG_BATCH = 64
+};
+
+typedef union
+{
+	struct sockaddr_in ipv4;
+	struct sockaddr_in6 ipv6;
+} NET_UDP_SOCKADDR;
+
+static int priv_net_udp_send_mmsg(int sock, struct mmsghdr *msgs, int num)
+{
+	int sent = 0;
+	int i = 0;
+	while(i < num)
+	{
+		int n = sendmmsg(sock, msgs+i, num-i, 0);
+		if(n > 0)
+		{
+			sent += n;
+			i += n;
+		}
+		else if(n < 0 && errno == EINTR)
+			continue;
+		else
+			i++; /* drop the packet that failed, like net_udp_send does */
+	}
+	return sent;
+}
+
+int net_udp_send_batch(NETSOCKET sock, const NETPACKET *packets, int num)
+{
+	struct mmsghdr msgs4[NET_UDP_MMSG_BATCH];
+	struct mmsghdr msgs6[NET_UDP_MMSG_BATCH];
+	struct iovec iovs[NET_UDP_MMSG_BATCH];
+	struct sockaddr_in addrs4[NET_UDP_MMSG_BATCH];
+	struct sockaddr_in6 addrs6[NET_UDP_MMSG_BATCH];
+	int sent = 0;
+	int start, i;
+
+	for(start = 0; start < num; start += NET_UDP_MMSG_BATCH)
+	{
+		int count = num-start < NET_UDP_MMSG_BATCH ? num-start : NET_UDP_MMSG_BATCH;
+		int num4 = 0;
+		int num6 = 0;
+		mem_zero(msgs4, sizeof(struct mmsghdr)*count);
+		mem_zero(msgs6, sizeof(struct mmsghdr)*count);
+
+		for(i = 0; i < count; i++)
+		{
+			const NETPACKET *packet = &packets[start+i];
+			iovs[i].iov_base = packet->data;
+			iovs[i].iov_len = packet->size;
+
+			if(packet->addr.type&NETTYPE_IPV4)
+			{
+				if(sock.ipv4sock >= 0)
+				{
+					priv_net_udp_sockaddr_in(&packet->addr, &addrs4[num4]);
+					msgs4[num4].msg_hdr.msg_name = &addrs4[num4];
+					msgs4[num4].msg_hdr.msg_namelen = sizeof(addrs4[num4]);
+					msgs4[num4].msg_hdr.msg_iov = &iovs[i];
+					msgs4[num4].msg_hdr.msg_iovlen = 1;
+					num4++;
+				}
+				else
+					dbg_msg("net", "can't sent ipv4 traffic to this socket");
+			}
+
+			if(packet->addr.type&NETTYPE_IPV6)
+			{
+				if(sock.ipv6sock >= 0)
+				{
+					priv_net_udp_sockaddr_in6(&packet->addr, &addrs6[num6]);
+					msgs6[num6].msg_hdr.msg_name = &addrs6[num6];
+					msgs6[num6].msg_hdr.msg_namelen = sizeof(addrs6[num6]);
+					msgs6[num6].msg_hdr.msg_iov = &iovs[i];
+					msgs6[num6].msg_hdr.msg_iovlen = 1;
+					num6++;
+				}
+				else
+					dbg_msg("net", "can't sent ipv6 traffic to this socket");
+			}
+
+			network_stats.sent_bytes += packet->size;
+			network_stats.sent_packets++;
+		}
+
+		if(num4)
+			sent += priv_net_udp_send_mmsg(sock.ipv4sock, msgs4, num4);
+		if(num6)
+			sent += priv_net_udp_send_mmsg(sock.ipv6sock, msgs6, num6);
+	}
+	return sent;
+}
+
+static int priv_net_udp_recv_mmsg(int sock, NETPACKET *packets, int num, int maxsize)
+{
+	struct mmsghdr msgs[NET_UDP_MMSG_BATCH];
+	struct iovec iovs[NET_UDP_MMSG_BATCH];
+	NET_UDP_SOCKADDR addrs[NET_UDP_MMSG_BATCH];
+	int received = 0;
+	int i;
+
+	while(received < num)
+	{
+		int count = num-received < NET_UDP_MMSG_BATCH ? num-received : NET_UDP_MMSG_BATCH;
+		int n;
+		mem_zero(msgs, sizeof(struct mmsghdr)*count);
+		for(i = 0; i < count; i++)
+		{
+			iovs[i].iov_base = packets[received+i].data;
+			iovs[i].iov_len = maxsize;
+			msgs[i].msg_hdr.msg_name = &addrs[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		n = recvmmsg(sock, msgs, count, MSG_DONTWAIT, 0);
+		if(n <= 0)
+			break;
+
+		for(i = 0; i < n; i++)
+		{
+			sockaddr_to_netaddr((struct sockaddr *)&addrs[i], &packets[received+i].addr);
+			packets[received+i].size = msgs[i].msg_len;
+			network_stats.recv_bytes += msgs[i].msg_len;
+			network_stats.recv_packets++;
+		}
+		received += n;
+
+		/* the socket is drained */
+		if(n < count)
+			break;
+	}
+	return received;
+}
+
+int net_udp_recv_batch(NETSOCKET sock, NETPACKET *packets, int num, int maxsize)
+{
+	int received = 0;
+	if(sock.ipv4sock >= 0)
+		received += priv_net_udp_recv_mmsg(sock.ipv4sock, packets, num, maxsize);
+	if(received < num && sock.ipv6sock >= 0)
+		received += priv_net_udp_recv_mmsg(sock.ipv6sock, packets+received, num-received, maxsize);
+	return received;
+}
+#else
+int net_udp_send_batch(NETSOCKET sock, const NETPACKET *packets, int num)
+{
+	int sent = 0;
+	int i;
+	for(i = 0; i < num; i++)
+	{
+		if(net_udp_send(sock, &packets[i].addr, packets[i].data, packets[i].size) >= 0)
+			sent++;
+	}
+	return sent;
+}
+
+int net_udp_recv_batch(NETSOCKET sock, NETPACKET *packets, int num, int maxsize)
+{
+	int received = 0;
+	while(received < num)
+	{
+		int bytes = net_udp_recv(sock, &packets[received].addr, packets[received].data, maxsize);
+		if(bytes <= 0)
+			break;
+		packets[received++].size = bytes;
+	}
+	return received;
+}
+#endif
+
 int net_udp_close(NETSOCKET sock)
 {
 	return priv_net_close_all_sockets(sock);
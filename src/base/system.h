@@ -417,6 +417,20 @@ IOHANDLE io_stderr();
 */
 void thread_sleep(int milliseconds);
 
+/*
+	Function: thread_usleep
+		Suspends the current thread for a given period using the most
+		precise timer the platform offers.
+
+	Parameters:
+		microseconds - Number of microseconds to sleep.
+
+	Remarks:
+		- The thread may wake up later than requested, the overshoot
+		  depends on the scheduler and the timer resolution.
+*/
+void thread_usleep(int microseconds);
+
 /*
 	Function: thread_init
 		Creates a new thread.
@@ -737,6 +751,52 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 */
 int net_udp_recv(NETSOCKET sock, NETADDR *addr, void *data, int maxsize);
 
+/*
+	Struct: NETPACKET
+		A packet for the batched UDP functions.
+*/
+typedef struct
+{
+	NETADDR addr;
+	void *data;
+	int size;
+} NETPACKET;
+
+/*
+	Function: net_udp_send_batch
+		Sends several packets over an UDP socket. Uses one system call
+		for many packets where the platform supports it and falls back
+		to net_udp_send otherwise.
+
+	Parameters:
+		sock - Socket to use.
+		packets - Packets to send, addr, data and size have to be set.
+		num - Number of packets.
+
+	Returns:
+		The number of packets that were sent.
+*/
+int net_udp_send_batch(NETSOCKET sock, const NETPACKET *packets, int num);
+
+/*
+	Function: net_udp_recv_batch
+		Receives the packets that are waiting on an UDP socket. Uses one
+		system call for many packets where the platform supports it and
+		falls back to net_udp_recv otherwise.
+
+	Parameters:
+		sock - Socket to use.
+		packets - Packets to fill in, data has to point to a buffer of
+			maxsize bytes for each of them.
+		num - Maximum number of packets to receive.
+		maxsize - Maximum size of a single packet.
+
+	Returns:
+		The number of packets received, their addr and size are set.
+		Returns 0 if no packets are waiting.
+*/
+int net_udp_recv_batch(NETSOCKET sock, NETPACKET *packets, int num, int maxsize);
+
 /*
 	Function: net_udp_close
 		Closes an UDP socket.
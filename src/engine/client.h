@@ -211,6 +211,10 @@ public:
 	virtual void OnDummyDisconnect() = 0;
 	virtual void SendStartInfo(int Dummy) = 0;
 
+	// per component cpu time of the last rendered frame
+	virtual void SetRenderProfiling(bool Enable) = 0;
+	virtual int GetRenderProfile(const char **ppNames, int64 *pTimes, int MaxComponents) const = 0;
+
 	virtual const char *GetItemName(int Type) const = 0;
 	virtual const char *Version() const = 0;
 	virtual const char *NetVersion() const = 0;
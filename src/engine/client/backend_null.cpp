@@ -0,0 +1,108 @@
+#include <base/detect.h>
+#include "SDL.h"
+#include "SDL_opengl.h"
+
+#include <base/system.h>
+#include <base/tl/threading.h>
+
+#include "graphics_threaded.h"
+#include "backend_null.h"
+
+CGraphicsBackend_Null::CGraphicsBackend_Null()
+{
+	mem_zero(m_aTextureMemSize, sizeof(m_aTextureMemSize));
+	m_TextureMemoryUsage = 0;
+	m_ScreenWidth = 0;
+	m_ScreenHeight = 0;
+}
+
+int CGraphicsBackend_Null::Init(const char *pName, int *pScreen, int *pWindowWidth, int *pWindowHeight, int *pScreenWidth, int *pScreenHeight, int FsaaSamples, int Flags, int *pDesktopWidth, int *pDesktopHeight)
+{
+	// there is no window, take the configured size as it is
+	*pScreen = 0;
+	*pScreenWidth = *pWindowWidth;
+	*pScreenHeight = *pWindowHeight;
+	*pDesktopWidth = *pWindowWidth;
+	*pDesktopHeight = *pWindowHeight;
+	m_ScreenWidth = *pScreenWidth;
+	m_ScreenHeight = *pScreenHeight;
+
+	dbg_msg("gfx", "using null backend %dx%d", m_ScreenWidth, m_ScreenHeight);
+	return 0;
+}
+
+int CGraphicsBackend_Null::GetVideoModes(CVideoMode *pModes, int MaxModes, int Screen)
+{
+	if(MaxModes < 1)
+		return 0;
+	pModes[0].m_Width = m_ScreenWidth;
+	pModes[0].m_Height = m_ScreenHeight;
+	pModes[0].m_Red = 8;
+	pModes[0].m_Green = 8;
+	pModes[0].m_Blue = 8;
+	return 1;
+}
+
+bool CGraphicsBackend_Null::GetDesktopResolution(int Index, int *pDesktopWidth, int* pDesktopHeight)
+{
+	*pDesktopWidth = m_ScreenWidth;
+	*pDesktopHeight = m_ScreenHeight;
+	return true;
+}
+
+void CGraphicsBackend_Null::Cmd_Texture_Create(const CCommandBuffer::CTextureCreateCommand *pCommand)
+{
+	m_TextureMemoryUsage -= m_aTextureMemSize[pCommand->m_Slot];
+	m_aTextureMemSize[pCommand->m_Slot] = pCommand->m_Width*pCommand->m_Height*pCommand->m_PixelSize;
+	m_TextureMemoryUsage += m_aTextureMemSize[pCommand->m_Slot];
+	mem_free(pCommand->m_pData);
+}
+
+void CGraphicsBackend_Null::Cmd_Texture_Destroy(const CCommandBuffer::CTextureDestroyCommand *pCommand)
+{
+	m_TextureMemoryUsage -= m_aTextureMemSize[pCommand->m_Slot];
+	m_aTextureMemSize[pCommand->m_Slot] = 0;
+}
+
+void CGraphicsBackend_Null::Cmd_Texture_Update(const CCommandBuffer::CTextureUpdateCommand *pCommand)
+{
+	mem_free(pCommand->m_pData);
+}
+
+void CGraphicsBackend_Null::Cmd_Screenshot(const CCommandBuffer::CScreenshotCommand *pCommand)
+{
+	// hand out a black image so screenshots still produce a file
+	int w = pCommand->m_W == -1 ? m_ScreenWidth : pCommand->m_W;
+	int h = pCommand->m_H == -1 ? m_ScreenHeight : pCommand->m_H;
+	pCommand->m_pImage->m_Width = w;
+	pCommand->m_pImage->m_Height = h;
+	pCommand->m_pImage->m_Format = CImageInfo::FORMAT_RGB;
+	pCommand->m_pImage->m_pData = mem_alloc(w*h*3, 1);
+	mem_zero(pCommand->m_pImage->m_pData, w*h*3);
+}
+
+void CGraphicsBackend_Null::RunBuffer(CCommandBuffer *pBuffer)
+{
+	unsigned CmdIndex = 0;
+	while(1)
+	{
+		const CCommandBuffer::CCommand *pBaseCommand = pBuffer->GetCommand(&CmdIndex);
+		if(pBaseCommand == 0x0)
+			break;
+
+		switch(pBaseCommand->m_Cmd)
+		{
+		case CCommandBuffer::CMD_TEXTURE_CREATE: Cmd_Texture_Create(static_cast<const CCommandBuffer::CTextureCreateCommand *>(pBaseCommand)); break;
+		case CCommandBuffer::CMD_TEXTURE_DESTROY: Cmd_Texture_Destroy(static_cast<const CCommandBuffer::CTextureDestroyCommand *>(pBaseCommand)); break;
+		case CCommandBuffer::CMD_TEXTURE_UPDATE: Cmd_Texture_Update(static_cast<const CCommandBuffer::CTextureUpdateCommand *>(pBaseCommand)); break;
+		case CCommandBuffer::CMD_BUFFER_CREATE: mem_free(static_cast<const CCommandBuffer::CBufferCreateCommand *>(pBaseCommand)->m_pData); break;
+		case CCommandBuffer::CMD_SCREENSHOT: Cmd_Screenshot(static_cast<const CCommandBuffer::CScreenshotCommand *>(pBaseCommand)); break;
+		case CCommandBuffer::CMD_VSYNC: *static_cast<const CCommandBuffer::CVSyncCommand *>(pBaseCommand)->m_pRetOk = true; break;
+		default:
+			// signals and nops, everything else only draws
+			m_General.RunCommand(pBaseCommand);
+		}
+	}
+}
+
+IGraphicsBackend *CreateGraphicsBackendNull() { return new CGraphicsBackend_Null; }
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "graphics_threaded.h"
+#include "backend_sdl.h"
+
+// graphics backend that consumes the command buffers without rendering anything,
+// used to run the client headless (benchmarks, machines without a gpu)
+class CGraphicsBackend_Null : public IGraphicsBackend
+{
+	CCommandProcessorFragment_General m_General;
+	int m_aTextureMemSize[CCommandBuffer::MAX_TEXTURES];
+	int m_TextureMemoryUsage;
+	int m_ScreenWidth;
+	int m_ScreenHeight;
+
+	void Cmd_Texture_Create(const CCommandBuffer::CTextureCreateCommand *pCommand);
+	void Cmd_Texture_Destroy(const CCommandBuffer::CTextureDestroyCommand *pCommand);
+	void Cmd_Texture_Update(const CCommandBuffer::CTextureUpdateCommand *pCommand);
+	void Cmd_Screenshot(const CCommandBuffer::CScreenshotCommand *pCommand);
+
+public:
+	CGraphicsBackend_Null();
+
+	virtual int Init(const char *pName, int *pScreen, int *pWindowWidth, int *pWindowHeight, int *pScreenWidth, int *pScreenHeight, int FsaaSamples, int Flags, int *pDesktopWidth, int *pDesktopHeight);
+	virtual int Shutdown() { return 0; }
+
+	virtual int MemoryUsage() const { return m_TextureMemoryUsage; }
+	virtual int GetTextureArraySize() const { return 1; }
+
+	virtual int GetNumScreens() const { return 1; }
+
+	virtual void Minimize() {}
+	virtual void Maximize() {}
+	virtual bool Fullscreen(bool State) { return false; }
+	virtual void SetWindowBordered(bool State) {}
+	virtual bool SetWindowScreen(int Index) { return Index == 0; }
+	virtual int GetVideoModes(CVideoMode *pModes, int MaxModes, int Screen);
+	virtual bool GetDesktopResolution(int Index, int *pDesktopWidth, int* pDesktopHeight);
+	virtual int GetWindowScreen() { return 0; }
+	virtual int WindowActive() { return 1; }
+	virtual int WindowOpen() { return 1; }
+
+	// commands are handled right away on the calling thread
+	virtual void RunBuffer(CCommandBuffer *pBuffer);
+	virtual bool IsIdle() const { return true; }
+	virtual void WaitForIdle() {}
+};
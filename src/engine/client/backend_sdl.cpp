@@ -260,6 +260,87 @@ void CCommandProcessorFragment_OpenGL::Cmd_Init(const CInitCommand *pCommand)
 	*pCommand->m_pTextureArraySize = m_TextureArraySize;
 
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	m_UseVertexBuffers = false;
+	if(pCommand->m_UseVertexBuffers)
+		InitVertexBuffers();
+}
+
+void CCommandProcessorFragment_OpenGL::InitVertexBuffers()
+{
+	if(!SDL_GL_ExtensionSupported("GL_ARB_vertex_buffer_object"))
+	{
+		dbg_msg("render", "vertex buffer objects not supported");
+		return;
+	}
+
+	m_pfnGenBuffers = (PFNGLGENBUFFERSPROC)SDL_GL_GetProcAddress("glGenBuffers");
+	m_pfnDeleteBuffers = (PFNGLDELETEBUFFERSPROC)SDL_GL_GetProcAddress("glDeleteBuffers");
+	m_pfnBindBuffer = (PFNGLBINDBUFFERPROC)SDL_GL_GetProcAddress("glBindBuffer");
+	m_pfnBufferData = (PFNGLBUFFERDATAPROC)SDL_GL_GetProcAddress("glBufferData");
+	m_pfnBufferSubData = (PFNGLBUFFERSUBDATAPROC)SDL_GL_GetProcAddress("glBufferSubData");
+	if(!m_pfnGenBuffers || !m_pfnDeleteBuffers || !m_pfnBindBuffer || !m_pfnBufferData || !m_pfnBufferSubData)
+	{
+		dbg_msg("render", "vertex buffer objects not supported");
+		return;
+	}
+
+	// the vertices of the command buffers are streamed into one buffer that is orphaned when full
+	m_pfnGenBuffers(1, &m_StreamBuffer);
+	m_pfnBindBuffer(GL_ARRAY_BUFFER, m_StreamBuffer);
+	m_pfnBufferData(GL_ARRAY_BUFFER, STREAM_BUFFER_SIZE, 0, GL_STREAM_DRAW);
+	m_StreamBufferOffset = 0;
+
+	// quads are drawn as two indexed triangles each
+	GLushort *pIndices = (GLushort *)mem_alloc(sizeof(GLushort)*6*MAX_INDEXED_QUADS, sizeof(void*));
+	for(int i = 0; i < MAX_INDEXED_QUADS; i++)
+	{
+		pIndices[i*6+0] = i*4+0;
+		pIndices[i*6+1] = i*4+1;
+		pIndices[i*6+2] = i*4+2;
+		pIndices[i*6+3] = i*4+0;
+		pIndices[i*6+4] = i*4+2;
+		pIndices[i*6+5] = i*4+3;
+	}
+	m_pfnGenBuffers(1, &m_QuadIndexBuffer);
+	m_pfnBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_QuadIndexBuffer);
+	m_pfnBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort)*6*MAX_INDEXED_QUADS, pIndices, GL_STATIC_DRAW);
+	mem_free(pIndices);
+
+	m_UseVertexBuffers = true;
+	dbg_msg("render", "using vertex buffer objects");
+}
+
+void CCommandProcessorFragment_OpenGL::SetVertexPointers(const char *pVertices, int Stride, bool Color)
+{
+	glVertexPointer(2, GL_FLOAT, Stride, pVertices);
+	glTexCoordPointer(3, GL_FLOAT, Stride, pVertices + sizeof(float)*2);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	if(Color)
+	{
+		glColorPointer(4, GL_FLOAT, Stride, pVertices + sizeof(float)*5);
+		glEnableClientState(GL_COLOR_ARRAY);
+	}
+	else
+		glDisableClientState(GL_COLOR_ARRAY);
+}
+
+void CCommandProcessorFragment_OpenGL::DrawQuads(const char *pVertices, int Stride, bool Color, unsigned NumQuads)
+{
+	if(!m_UseVertexBuffers)
+	{
+		SetVertexPointers(pVertices, Stride, Color);
+		glDrawArrays(GL_QUADS, 0, NumQuads*4);
+		return;
+	}
+
+	// the index buffer only reaches MAX_INDEXED_QUADS, so larger batches are split
+	for(unsigned Offset = 0; Offset < NumQuads; Offset += MAX_INDEXED_QUADS)
+	{
+		SetVertexPointers(pVertices + Offset*4*Stride, Stride, Color);
+		glDrawElements(GL_TRIANGLES, min(NumQuads-Offset, (unsigned)MAX_INDEXED_QUADS)*6, GL_UNSIGNED_SHORT, 0);
+	}
 }
 
 void CCommandProcessorFragment_OpenGL::Cmd_Texture_Update(const CCommandBuffer::CTextureUpdateCommand *pCommand)
@@ -450,19 +531,30 @@ void CCommandProcessorFragment_OpenGL::Cmd_Render(const CCommandBuffer::CRenderC
 {
 	SetState(pCommand->m_State);
 
-	glVertexPointer(2, GL_FLOAT, sizeof(CCommandBuffer::CVertex), (char*)pCommand->m_pVertices);
-	glTexCoordPointer(3, GL_FLOAT, sizeof(CCommandBuffer::CVertex), (char*)pCommand->m_pVertices + sizeof(float)*2);
-	glColorPointer(4, GL_FLOAT, sizeof(CCommandBuffer::CVertex), (char*)pCommand->m_pVertices + sizeof(float)*5);
-	glEnableClientState(GL_VERTEX_ARRAY);
-	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-	glEnableClientState(GL_COLOR_ARRAY);
+	const char *pVertices = (const char *)pCommand->m_pVertices;
+	if(m_UseVertexBuffers)
+	{
+		// append the vertices to the stream buffer, orphan it when it is full
+		unsigned NumVertices = pCommand->m_PrimCount * (pCommand->m_PrimType == CCommandBuffer::PRIMTYPE_QUADS ? 4 : 2);
+		unsigned Size = NumVertices*sizeof(CCommandBuffer::CVertex);
+		m_pfnBindBuffer(GL_ARRAY_BUFFER, m_StreamBuffer);
+		if(m_StreamBufferOffset+Size > STREAM_BUFFER_SIZE)
+		{
+			m_pfnBufferData(GL_ARRAY_BUFFER, STREAM_BUFFER_SIZE, 0, GL_STREAM_DRAW);
+			m_StreamBufferOffset = 0;
+		}
+		m_pfnBufferSubData(GL_ARRAY_BUFFER, m_StreamBufferOffset, Size, pCommand->m_pVertices);
+		pVertices = (const char *)0 + m_StreamBufferOffset;
+		m_StreamBufferOffset += Size;
+	}
 
 	switch(pCommand->m_PrimType)
 	{
 	case CCommandBuffer::PRIMTYPE_QUADS:
-		glDrawArrays(GL_QUADS, 0, pCommand->m_PrimCount*4);
+		DrawQuads(pVertices, sizeof(CCommandBuffer::CVertex), true, pCommand->m_PrimCount);
 		break;
 	case CCommandBuffer::PRIMTYPE_LINES:
+		SetVertexPointers(pVertices, sizeof(CCommandBuffer::CVertex), true);
 		glDrawArrays(GL_LINES, 0, pCommand->m_PrimCount*2);
 		break;
 	default:
@@ -470,6 +562,52 @@ void CCommandProcessorFragment_OpenGL::Cmd_Render(const CCommandBuffer::CRenderC
 	};
 }
 
+void CCommandProcessorFragment_OpenGL::Cmd_RenderBuffer(const CCommandBuffer::CRenderBufferCommand *pCommand)
+{
+	const CBuffer *pBuffer = &m_aBuffers[pCommand->m_Slot];
+	if(pCommand->m_PrimOffset*4 >= (unsigned)pBuffer->m_NumVertices)
+		return;
+	unsigned NumQuads = min(pCommand->m_PrimCount, pBuffer->m_NumVertices/4 - pCommand->m_PrimOffset);
+
+	SetState(pCommand->m_State);
+	glColor4f(pCommand->m_Color.r, pCommand->m_Color.g, pCommand->m_Color.b, pCommand->m_Color.a);
+
+	const char *pVertices = (const char *)pBuffer->m_pVertices;
+	if(m_UseVertexBuffers)
+	{
+		m_pfnBindBuffer(GL_ARRAY_BUFFER, pBuffer->m_Vbo);
+		pVertices = 0;
+	}
+	DrawQuads(pVertices + pCommand->m_PrimOffset*4*sizeof(CCommandBuffer::CBufferVertex), sizeof(CCommandBuffer::CBufferVertex), false, NumQuads);
+}
+
+void CCommandProcessorFragment_OpenGL::Cmd_Buffer_Create(const CCommandBuffer::CBufferCreateCommand *pCommand)
+{
+	CBuffer *pBuffer = &m_aBuffers[pCommand->m_Slot];
+	pBuffer->m_NumVertices = pCommand->m_NumVertices;
+	if(m_UseVertexBuffers)
+	{
+		m_pfnGenBuffers(1, &pBuffer->m_Vbo);
+		m_pfnBindBuffer(GL_ARRAY_BUFFER, pBuffer->m_Vbo);
+		m_pfnBufferData(GL_ARRAY_BUFFER, sizeof(CCommandBuffer::CBufferVertex)*pCommand->m_NumVertices, pCommand->m_pData, GL_STATIC_DRAW);
+		mem_free(pCommand->m_pData);
+		pBuffer->m_pVertices = 0;
+	}
+	else
+		pBuffer->m_pVertices = pCommand->m_pData;
+}
+
+void CCommandProcessorFragment_OpenGL::Cmd_Buffer_Destroy(const CCommandBuffer::CBufferDestroyCommand *pCommand)
+{
+	CBuffer *pBuffer = &m_aBuffers[pCommand->m_Slot];
+	if(pBuffer->m_Vbo)
+		m_pfnDeleteBuffers(1, &pBuffer->m_Vbo);
+	mem_free(pBuffer->m_pVertices);
+	pBuffer->m_Vbo = 0;
+	pBuffer->m_pVertices = 0;
+	pBuffer->m_NumVertices = 0;
+}
+
 void CCommandProcessorFragment_OpenGL::Cmd_Screenshot(const CCommandBuffer::CScreenshotCommand *pCommand)
 {
 	// fetch image data
@@ -510,7 +648,16 @@ void CCommandProcessorFragment_OpenGL::Cmd_Screenshot(const CCommandBuffer::CScr
 CCommandProcessorFragment_OpenGL::CCommandProcessorFragment_OpenGL()
 {
 	mem_zero(m_aTextures, sizeof(m_aTextures));
+	mem_zero(m_aBuffers, sizeof(m_aBuffers));
 	m_pTextureMemoryUsage = 0;
+	m_UseVertexBuffers = false;
+}
+
+CCommandProcessorFragment_OpenGL::~CCommandProcessorFragment_OpenGL()
+{
+	// the gl objects go away with the context
+	for(int i = 0; i < CCommandBuffer::MAX_BUFFERS; i++)
+		mem_free(m_aBuffers[i].m_pVertices);
 }
 
 bool CCommandProcessorFragment_OpenGL::RunCommand(const CCommandBuffer::CCommand * pBaseCommand)
@@ -522,7 +669,10 @@ bool CCommandProcessorFragment_OpenGL::RunCommand(const CCommandBuffer::CCommand
 	case CCommandBuffer::CMD_TEXTURE_DESTROY: Cmd_Texture_Destroy(static_cast<const CCommandBuffer::CTextureDestroyCommand *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_TEXTURE_UPDATE: Cmd_Texture_Update(static_cast<const CCommandBuffer::CTextureUpdateCommand *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_CLEAR: Cmd_Clear(static_cast<const CCommandBuffer::CClearCommand *>(pBaseCommand)); break;
+	case CCommandBuffer::CMD_BUFFER_CREATE: Cmd_Buffer_Create(static_cast<const CCommandBuffer::CBufferCreateCommand *>(pBaseCommand)); break;
+	case CCommandBuffer::CMD_BUFFER_DESTROY: Cmd_Buffer_Destroy(static_cast<const CCommandBuffer::CBufferDestroyCommand *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_RENDER: Cmd_Render(static_cast<const CCommandBuffer::CRenderCommand *>(pBaseCommand)); break;
+	case CCommandBuffer::CMD_RENDER_BUFFER: Cmd_RenderBuffer(static_cast<const CCommandBuffer::CRenderBufferCommand *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_SCREENSHOT: Cmd_Screenshot(static_cast<const CCommandBuffer::CScreenshotCommand *>(pBaseCommand)); break;
 	default: return false;
 	}
@@ -743,6 +893,7 @@ int CGraphicsBackend_SDL_OpenGL::Init(const char *pName, int *pScreen, int *pWin
 	CCommandProcessorFragment_OpenGL::CInitCommand CmdOpenGL;
 	CmdOpenGL.m_pTextureMemoryUsage = &m_TextureMemoryUsage;
 	CmdOpenGL.m_pTextureArraySize = &m_TextureArraySize;
+	CmdOpenGL.m_UseVertexBuffers = Flags&IGraphicsBackend::INITFLAG_VERTEXBUFFERS;
 	CmdBuffer.AddCommand(CmdOpenGL);
 	RunBuffer(&CmdBuffer);
 	WaitForIdle();
@@ -107,6 +107,32 @@ class CCommandProcessorFragment_OpenGL
 	int m_Max3DTexSize;
 	int m_TextureArraySize;
 
+	class CBuffer
+	{
+	public:
+		GLuint m_Vbo;
+		CCommandBuffer::CBufferVertex *m_pVertices; // only kept when vertex buffer objects are not used
+		int m_NumVertices;
+	};
+	CBuffer m_aBuffers[CCommandBuffer::MAX_BUFFERS];
+
+	enum
+	{
+		STREAM_BUFFER_SIZE = 8*1024*1024,
+		MAX_INDEXED_QUADS = 16*1024, // 16 bit indices
+	};
+
+	// vertex buffer objects, used when they are enabled and supported
+	bool m_UseVertexBuffers;
+	PFNGLGENBUFFERSPROC m_pfnGenBuffers;
+	PFNGLDELETEBUFFERSPROC m_pfnDeleteBuffers;
+	PFNGLBINDBUFFERPROC m_pfnBindBuffer;
+	PFNGLBUFFERDATAPROC m_pfnBufferData;
+	PFNGLBUFFERSUBDATAPROC m_pfnBufferSubData;
+	GLuint m_StreamBuffer;
+	unsigned m_StreamBufferOffset;
+	GLuint m_QuadIndexBuffer;
+
 public:
 	enum
 	{
@@ -118,6 +144,7 @@ public:
 		CInitCommand() : CCommand(CMD_INIT) {}
 		volatile int *m_pTextureMemoryUsage;
 		int *m_pTextureArraySize;
+		bool m_UseVertexBuffers;
 	};
 
 private:
@@ -126,17 +153,24 @@ private:
 	static void *Rescale(int Width, int Height, int NewWidth, int NewHeight, int Format, const unsigned char *pData);
 
 	void SetState(const CCommandBuffer::CState &State);
+	void InitVertexBuffers();
+	void SetVertexPointers(const char *pVertices, int Stride, bool Color);
+	void DrawQuads(const char *pVertices, int Stride, bool Color, unsigned NumQuads);
 
 	void Cmd_Init(const CInitCommand *pCommand);
 	void Cmd_Texture_Update(const CCommandBuffer::CTextureUpdateCommand *pCommand);
 	void Cmd_Texture_Destroy(const CCommandBuffer::CTextureDestroyCommand *pCommand);
 	void Cmd_Texture_Create(const CCommandBuffer::CTextureCreateCommand *pCommand);
+	void Cmd_Buffer_Create(const CCommandBuffer::CBufferCreateCommand *pCommand);
+	void Cmd_Buffer_Destroy(const CCommandBuffer::CBufferDestroyCommand *pCommand);
 	void Cmd_Clear(const CCommandBuffer::CClearCommand *pCommand);
 	void Cmd_Render(const CCommandBuffer::CRenderCommand *pCommand);
+	void Cmd_RenderBuffer(const CCommandBuffer::CRenderBufferCommand *pCommand);
 	void Cmd_Screenshot(const CCommandBuffer::CScreenshotCommand *pCommand);
 
 public:
 	CCommandProcessorFragment_OpenGL();
+	~CCommandProcessorFragment_OpenGL();
 
 	bool RunCommand(const CCommandBuffer::CCommand * pBaseCommand);
 };
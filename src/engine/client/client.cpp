@@ -260,19 +260,39 @@ CClient::CClient() : m_DemoPlayer(&m_SnapshotDelta), m_DemoRecorder(&m_SnapshotD
 	m_LastRenderTime = time_get();
 	m_LastCpuTime = time_get();
 	m_LastAvgCpuFrameTime = 0;
+	m_pNetThread = 0;
+	m_NetThreadShutdown = false;
+	mem_zero(m_aNetGeneration, sizeof(m_aNetGeneration));
+	m_PacketRecvTime = 0;
+	mem_zero(m_aNetState, sizeof(m_aNetState));
+	mem_zero(m_aNetGotProblems, sizeof(m_aNetGotProblems));
+	mem_zero(m_aaNetErrorString, sizeof(m_aaNetErrorString));
+	for(int i = 0; i < NUM_CLIENTS; i++)
+	{
+		m_aSnapshotReceivers[i].m_DeltaStorage.Init();
+		m_aSnapshotReceivers[i].m_Generation = 0;
+		ResetSnapshotReceiver(i);
+		ResetNetInput(i);
+	}
+	m_SleepOvershoot = 0.001;
+	m_PacerStatsStart = time_get();
+	m_PacerFrames = 0;
+	m_PacerJitterSum = 0.0;
+	m_PacerJitterMax = 0.0;
+	m_PacerSleepTime = 0.0;
+	m_PacerSpinTime = 0.0;
+	m_PacerJitterAvg = 0.0f;
+	m_PacerJitterPeak = 0.0f;
+	m_PacerSleepShare = 0.0f;
+	m_PacerSpinShare = 0.0f;
 
 	m_GameTickSpeed = SERVER_TICK_SPEED;
 
 	m_WindowMustRefocus = 0;
-	m_SnapCrcErrors = 0;
 	m_AutoScreenshotRecycle = false;
 	m_AutoStatScreenshotRecycle = false;
 	m_EditorActive = false;
 
-	m_AckGameTick[CLIENT_MAIN] = -1;
-	m_AckGameTick[CLIENT_DUMMY] = -1;
-	m_CurrentRecvTick[CLIENT_MAIN] = 0;
-	m_CurrentRecvTick[CLIENT_DUMMY] = 0;
 	m_RconAuthed[CLIENT_MAIN] = 0;
 	m_RconAuthed[CLIENT_DUMMY] = 0;
 	m_RconPassword[0] = 0;
@@ -354,7 +374,10 @@ int CClient::SendMsg(CMsgPacker *pMsg, int Flags, int NetClient)
 	}
 
 	if(!(Flags&MSGFLAG_NOSEND))
+	{
+		scope_lock Lock(&m_NetLock);
 		m_NetClient[NetClient].Send(&Packet);
+	}
 	return 0;
 }
 
@@ -414,7 +437,7 @@ void CClient::Rcon(const char *pCmd)
 
 bool CClient::ConnectionProblems()
 {
-	return m_NetClient[Config()->m_ClDummy].GotProblems() != 0;
+	return m_aNetGotProblems[Config()->m_ClDummy];
 }
 
 int CClient::GetInputtimeMarginStabilityScore()
@@ -449,30 +472,22 @@ void CClient::SendInput()
 		if (!Size)
 			continue;
 
-		// pack input
-		CMsgPacker Msg(NETMSG_INPUT, true);
-		Msg.AddInt(m_AckGameTick[i]);
-		Msg.AddInt(m_PredTick[i]);
-		Msg.AddInt(Size);
-
 		m_aInputs[i][m_CurrentInput[i]].m_Tick = m_PredTick[i];
-		m_aInputs[i][m_CurrentInput[i]].m_PredictedTime = m_PredictedTime.Get(Now);
-		m_aInputs[i][m_CurrentInput[i]].m_Time = Now;
-
-		// pack it
-		for (int k = 0; k < Size / 4; k++)
-			Msg.AddInt(m_aInputs[i][m_CurrentInput[i]].m_aData[k]);
 
-		int PingCorrection = 0;
-		int64 TagTime;
-		if (m_SnapshotStorage[i].Get(m_AckGameTick[i], &TagTime, 0, 0) >= 0)
-			PingCorrection = (int)(((Now - TagTime) * 1000) / time_freq());
-		Msg.AddInt(PingCorrection);
+		// publish it for the network thread and send it
+		{
+			scope_lock Lock(&m_NetLock);
+			CNetInput *pInput = &m_aNetInputs[i];
+			mem_copy(pInput->m_aData, m_aInputs[i][m_CurrentInput[i]].m_aData, Size);
+			pInput->m_Size = Size;
+			pInput->m_PredictedTime = m_PredictedTime.Get(Now);
+			pInput->m_Time = Now;
+			SendNetInput(i, m_PredTick[i], Now);
+		}
 
 		m_CurrentInput[i]++;
 		m_CurrentInput[i] %= 200;
 
-		SendMsg(&Msg, MSGFLAG_FLUSH, i);
 		// ugly workaround for dummy. we need to send input with dummy to prevent
 		// prediction time resets. but if we do it too often, then it's
 		// impossible to use grenade with frozen dummy that gets hammered...
@@ -481,6 +496,74 @@ void CClient::SendInput()
 	}
 }
 
+// called with m_NetLock held
+void CClient::ResetNetInput(int NetClient)
+{
+	CNetInput *pInput = &m_aNetInputs[NetClient];
+	pInput->m_Size = 0;
+	pInput->m_LastSentTick = 0;
+	for(int i = 0; i < 200; i++)
+		pInput->m_aSent[i].m_Tick = -1;
+	pInput->m_NextSent = 0;
+}
+
+// sends the published input of a connection for the given tick, called with m_NetLock held
+void CClient::SendNetInput(int NetClient, int Tick, int64 Now)
+{
+	CNetInput *pInput = &m_aNetInputs[NetClient];
+	CSnapshotReceiver *pReceiver = &m_aSnapshotReceivers[NetClient];
+	if(!pInput->m_Size || m_NetClient[NetClient].State() != NETSTATE_ONLINE)
+		return;
+
+	// pack input
+	CMsgPacker Msg(NETMSG_INPUT, true);
+	Msg.AddInt(pReceiver->m_AckGameTick);
+	Msg.AddInt(Tick);
+	Msg.AddInt(pInput->m_Size);
+
+	// pack it
+	for(int k = 0; k < pInput->m_Size / 4; k++)
+		Msg.AddInt(pInput->m_aData[k]);
+
+	int PingCorrection = 0;
+	int64 TagTime;
+	if(pReceiver->m_DeltaStorage.Get(pReceiver->m_AckGameTick, &TagTime, 0, 0) >= 0)
+		PingCorrection = (int)(((Now - TagTime) * 1000) / time_freq());
+	Msg.AddInt(PingCorrection);
+
+	// remember when it was sent to adjust the prediction time on NETMSG_INPUTTIMING
+	pInput->m_aSent[pInput->m_NextSent].m_Tick = Tick;
+	pInput->m_aSent[pInput->m_NextSent].m_PredictedTime = pInput->m_PredictedTime + (Now - pInput->m_Time);
+	pInput->m_aSent[pInput->m_NextSent].m_Time = Now;
+	pInput->m_NextSent = (pInput->m_NextSent + 1) % 200;
+	pInput->m_LastSentTick = max(pInput->m_LastSentTick, Tick);
+
+	CNetChunk Packet;
+	mem_zero(&Packet, sizeof(CNetChunk));
+	Packet.m_pData = Msg.Data();
+	Packet.m_DataSize = Msg.Size();
+	Packet.m_Flags = NETSENDFLAG_FLUSH;
+	m_NetClient[NetClient].Send(&Packet);
+}
+
+// keeps the input cadence while the game thread is late: once the predicted
+// time passed the middle of a tick nobody sent an input for, the network
+// thread sends the newest input for it. called with m_NetLock held
+void CClient::SendNetInputs(int64 Now)
+{
+	for(int i = 0; i < NUM_CLIENTS; i++)
+	{
+		const CNetInput *pInput = &m_aNetInputs[i];
+		if(!pInput->m_Size)
+			continue;
+
+		int64 PredictedTime = pInput->m_PredictedTime + (Now - pInput->m_Time) - time_freq()/(2*SERVER_TICK_SPEED);
+		int Tick = (int)(PredictedTime*SERVER_TICK_SPEED/time_freq()) + 1;
+		if(Tick > pInput->m_LastSentTick)
+			SendNetInput(i, Tick, Now);
+	}
+}
+
 const char *CClient::LatestVersion() const
 {
 	return m_aVersionStr;
@@ -537,15 +620,21 @@ void CClient::OnEnterGame()
 	m_CurrentInput[CLIENT_DUMMY] = 0;
 
 	// reset snapshots
+	{
+		scope_lock Lock(&m_NetLock);
+		for(int i = 0; i < NUM_CLIENTS; i++)
+		{
+			ResetSnapshotReceiver(i);
+			ResetNetInput(i);
+		}
+	}
 	for (int i = 0; i < NUM_CLIENTS; i++)
 	{
 		m_aSnapshots[i][SNAP_CURRENT] = 0;
 		m_aSnapshots[i][SNAP_PREV] = 0;
 		m_SnapshotStorage[i].PurgeAll();
 		m_ReceivedSnapshots[i] = 0;
-		m_SnapshotParts[i] = 0;
 		m_PredTick[i] = 0;
-		m_CurrentRecvTick[i] = 0;
 		m_CurGameTick[i] = 0;
 		m_PrevGameTick[i] = 0;
 	}
@@ -656,7 +745,12 @@ void CClient::Connect(const char *pAddress)
 	m_UseTempRconCommands = 0;
 	if(m_ServerAddress.port == 0)
 		m_ServerAddress.port = Port;
-	m_NetClient[CLIENT_MAIN].Connect(&m_ServerAddress);
+	{
+		scope_lock Lock(&m_NetLock);
+		m_NetClient[CLIENT_MAIN].Connect(&m_ServerAddress);
+		m_aNetGeneration[CLIENT_MAIN]++;
+		ResetNetInput(CLIENT_MAIN);
+	}
 	SetState(IClient::STATE_CONNECTING);
 
 	if(m_DemoRecorder.IsRecording())
@@ -692,7 +786,12 @@ void CClient::DisconnectWithReason(const char *pReason)
 	m_ServerSentCapabilities = false;
 	m_UseTempRconCommands = 0;
 	m_pConsole->DeregisterTempAll();
-	m_NetClient[CLIENT_MAIN].Disconnect(pReason);
+	{
+		scope_lock Lock(&m_NetLock);
+		m_NetClient[CLIENT_MAIN].Disconnect(pReason);
+		m_aNetGeneration[CLIENT_MAIN]++;
+		ResetNetInput(CLIENT_MAIN);
+	}
 	SetState(IClient::STATE_OFFLINE);
 	m_pMap->Unload();
 
@@ -744,7 +843,7 @@ void CClient::DummyConnect()
 	if(m_LastDummyConnectTime > 0 && m_LastDummyConnectTime + GameTickSpeed() * 5 > GameTick())
 		return;
 
-	if(m_NetClient[CLIENT_MAIN].State() != NET_CONNSTATE_CONNECT)
+	if(NetClientState(CLIENT_MAIN) != NET_CONNSTATE_CONNECT)
 		return;
 
 	if(m_DummyConnected)
@@ -760,7 +859,11 @@ void CClient::DummyConnect()
 	Config()->m_ClDummyHammer = 0;
 
 	//connecting to the server
+	scope_lock Lock(&m_NetLock);
 	m_NetClient[CLIENT_DUMMY].Connect(&m_ServerAddress);
+	m_aNetGeneration[CLIENT_DUMMY]++;
+	ResetSnapshotReceiver(CLIENT_DUMMY);
+	ResetNetInput(CLIENT_DUMMY);
 }
 
 void CClient::DummyDisconnect(const char *pReason)
@@ -775,7 +878,12 @@ void CClient::DummyDisconnect(const char *pReason)
 		GameClient()->OnDummySwap();
 	}
 
-	m_NetClient[CLIENT_DUMMY].Disconnect(pReason);
+	{
+		scope_lock Lock(&m_NetLock);
+		m_NetClient[CLIENT_DUMMY].Disconnect(pReason);
+		m_aNetGeneration[CLIENT_DUMMY]++;
+		ResetNetInput(CLIENT_DUMMY);
+	}
 	m_RconAuthed[CLIENT_DUMMY] = 0;
 	m_aSnapshots[CLIENT_DUMMY][SNAP_CURRENT] = 0;
 	m_aSnapshots[CLIENT_DUMMY][SNAP_PREV] = 0;
@@ -853,6 +961,9 @@ void *CClient::SnapNewItem(int Type, int ID, int Size)
 void CClient::SnapSetStaticsize(int ItemType, int Size)
 {
 	m_SnapshotDelta.SetStaticsize(ItemType, Size);
+
+	scope_lock Lock(&m_NetLock);
+	m_NetSnapshotDelta = m_SnapshotDelta;
 }
 
 
@@ -887,9 +998,11 @@ void CClient::DebugRender()
 		total = 42
 	*/
 	FrameTimeAvg = FrameTimeAvg*0.9f + m_RenderFrameTime*0.1f;
-	str_format(aBuffer, sizeof(aBuffer), "ticks: %8d %8d gfxmem: %dk fps: %3d",
+	str_format(aBuffer, sizeof(aBuffer), "ticks: %8d %8d gfxmem: %dk snapmem: %dk/%dk fps: %3d",
 		m_CurGameTick[Config()->m_ClDummy], m_PredTick[Config()->m_ClDummy],
 		Graphics()->MemoryUsage()/1024,
+		(m_SnapshotStorage[CLIENT_MAIN].UsedSize()+m_SnapshotStorage[CLIENT_DUMMY].UsedSize())/1024,
+		(m_SnapshotStorage[CLIENT_MAIN].AllocatedSize()+m_SnapshotStorage[CLIENT_DUMMY].AllocatedSize())/1024,
 		(int)(1.0f/FrameTimeAvg + 0.5f));
 	Graphics()->QuadsText(2, 2, 16, aBuffer);
 
@@ -928,6 +1041,14 @@ void CClient::DebugRender()
 	str_format(aBuffer, sizeof(aBuffer), "pred: %d ms",
 		(int)((m_PredictedTime.Get(Now)-m_GameTime[Config()->m_ClDummy].Get(Now))*1000/(float)time_freq()));
 	Graphics()->QuadsText(2, 70, 16, aBuffer);
+
+	if(!Config()->m_GfxVsync && Config()->m_GfxLimitFps)
+	{
+		str_format(aBuffer, sizeof(aBuffer), "pacing: jitter avg %.2f ms max %.2f ms  overshoot %.2f ms  sleep %d%%  spin %d%%",
+			m_PacerJitterAvg*1000.0f, m_PacerJitterPeak*1000.0f, m_SleepOvershoot*1000.0,
+			round_to_int(m_PacerSleepShare*100.0f), round_to_int(m_PacerSpinShare*100.0f));
+		Graphics()->QuadsText(2, 82, 16, aBuffer);
+	}
 	Graphics()->QuadsEnd();
 
 	// render graphs
@@ -954,7 +1075,7 @@ void CClient::Quit()
 
 const char *CClient::ErrorString() const
 {
-	return m_NetClient[CLIENT_MAIN].ErrorString();
+	return m_aaNetErrorString[CLIENT_MAIN];
 }
 
 void CClient::Render()
@@ -1586,7 +1707,7 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 		else if(Msg == NETMSG_PING_REPLY)
 		{
 			char aBuf[256];
-			str_format(aBuf, sizeof(aBuf), "latency %.2f", (time_get() - m_PingStartTime)*1000 / (float)time_freq());
+			str_format(aBuf, sizeof(aBuf), "latency %.2f", (m_PacketRecvTime - m_PingStartTime)*1000 / (float)time_freq());
 			m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "client/network", aBuf);
 		}
 		else if(Msg == NETMSG_INPUTTIMING)
@@ -1596,13 +1717,17 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 
 			// adjust our prediction time
 			int64 Target = 0;
-			for(int k = 0; k < 200; k++)
 			{
-				if(m_aInputs[Config()->m_ClDummy][k].m_Tick == InputPredTick)
+				scope_lock Lock(&m_NetLock);
+				const CNetInput *pInput = &m_aNetInputs[Config()->m_ClDummy];
+				for(int k = 0; k < 200; k++)
 				{
-					Target = m_aInputs[Config()->m_ClDummy][k].m_PredictedTime + (time_get() - m_aInputs[Config()->m_ClDummy][k].m_Time);
-					Target = Target - (int64)(((TimeLeft-PREDICTION_MARGIN)/1000.0f)*time_freq());
-					break;
+					if(pInput->m_aSent[k].m_Tick == InputPredTick)
+					{
+						Target = pInput->m_aSent[k].m_PredictedTime + (m_PacketRecvTime - pInput->m_aSent[k].m_Time);
+						Target = Target - (int64)(((TimeLeft-PREDICTION_MARGIN)/1000.0f)*time_freq());
+						break;
+					}
 				}
 			}
 
@@ -1611,209 +1736,7 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 		}
 		else if(Msg == NETMSG_SNAP || Msg == NETMSG_SNAPSINGLE || Msg == NETMSG_SNAPEMPTY)
 		{
-			int NumParts = 1;
-			int Part = 0;
-			int GameTick = Unpacker.GetInt();
-			int DeltaTick = GameTick-Unpacker.GetInt();
-			int PartSize = 0;
-			int Crc = 0;
-			int CompleteSize = 0;
-			const char *pData = 0;
-
-			// we are not allowed to process snapshot yet
-			if(State() < IClient::STATE_LOADING)
-				return;
-
-			if(Msg == NETMSG_SNAP)
-			{
-				NumParts = Unpacker.GetInt();
-				Part = Unpacker.GetInt();
-			}
-
-			if(Msg != NETMSG_SNAPEMPTY)
-			{
-				Crc = Unpacker.GetInt();
-				PartSize = Unpacker.GetInt();
-			}
-
-			pData = (const char *)Unpacker.GetRaw(PartSize);
-
-			if(Unpacker.Error() || NumParts < 1 || NumParts > CSnapshot::MAX_PARTS || Part < 0 || Part >= NumParts || PartSize < 0 || PartSize > MAX_SNAPSHOT_PACKSIZE)
-				return;
-
-			if(GameTick >= m_CurrentRecvTick[Config()->m_ClDummy])
-			{
-				if(GameTick != m_CurrentRecvTick[Config()->m_ClDummy])
-				{
-					m_SnapshotParts[Config()->m_ClDummy] = 0;
-					m_CurrentRecvTick[Config()->m_ClDummy] = GameTick;
-				}
-
-				// TODO: clean this up abit
-				mem_copy((char*)m_aSnapshotIncomingData + Part*MAX_SNAPSHOT_PACKSIZE, pData, PartSize);
-				m_SnapshotParts[Config()->m_ClDummy] |= 1<<Part;
-
-				if(m_SnapshotParts[Config()->m_ClDummy] == (unsigned)((1<<NumParts)-1))
-				{
-					static CSnapshot Emptysnap;
-					CSnapshot *pDeltaShot = &Emptysnap;
-					int PurgeTick;
-					void *pDeltaData;
-					int DeltaSize;
-					unsigned char aTmpBuffer2[CSnapshot::MAX_SIZE];
-					unsigned char aTmpBuffer3[CSnapshot::MAX_SIZE];
-					CSnapshot *pTmpBuffer3 = (CSnapshot*)aTmpBuffer3;	// Fix compiler warning for strict-aliasing
-					int SnapSize;
-
-					CompleteSize = (NumParts-1) * MAX_SNAPSHOT_PACKSIZE + PartSize;
-
-					// reset snapshoting
-					m_SnapshotParts[Config()->m_ClDummy] = 0;
-
-					// find snapshot that we should use as delta
-					Emptysnap.Clear();
-
-					// find delta
-					if(DeltaTick >= 0)
-					{
-						int DeltashotSize = m_SnapshotStorage[Config()->m_ClDummy].Get(DeltaTick, 0, &pDeltaShot, 0);
-
-						if(DeltashotSize < 0)
-						{
-							// couldn't find the delta snapshots that the server used
-							// to compress this snapshot. force the server to resync
-							if(Config()->m_Debug)
-							{
-								char aBuf[256];
-								str_format(aBuf, sizeof(aBuf), "error, couldn't find the delta snapshot");
-								m_pConsole->Print(IConsole::OUTPUT_LEVEL_DEBUG, "client", aBuf);
-							}
-
-							// ack snapshot
-							// TODO: combine this with the input message
-							m_AckGameTick[Config()->m_ClDummy] = -1;
-							return;
-						}
-					}
-
-					// decompress snapshot
-					pDeltaData = m_SnapshotDelta.EmptyDelta();
-					DeltaSize = sizeof(int)*3;
-
-					if(CompleteSize)
-					{
-						int IntSize = CVariableInt::Decompress(m_aSnapshotIncomingData, CompleteSize, aTmpBuffer2, sizeof(aTmpBuffer2));
-
-						if(IntSize < 0) // failure during decompression, bail
-							return;
-
-						pDeltaData = aTmpBuffer2;
-						DeltaSize = IntSize;
-					}
-
-					// unpack delta
-					SnapSize = m_SnapshotDelta.UnpackDelta(pDeltaShot, pTmpBuffer3, pDeltaData, DeltaSize);
-					if(SnapSize < 0)
-					{
-						m_pConsole->Print(IConsole::OUTPUT_LEVEL_DEBUG, "client", "delta unpack failed!");
-						return;
-					}
-
-					if(Msg != NETMSG_SNAPEMPTY && pTmpBuffer3->Crc() != Crc)
-					{
-						if(Config()->m_Debug)
-						{
-							char aBuf[256];
-							str_format(aBuf, sizeof(aBuf), "snapshot crc error #%d - tick=%d wantedcrc=%d gotcrc=%d compressed_size=%d delta_tick=%d",
-								m_SnapCrcErrors, GameTick, Crc, pTmpBuffer3->Crc(), CompleteSize, DeltaTick);
-							m_pConsole->Print(IConsole::OUTPUT_LEVEL_DEBUG, "client", aBuf);
-						}
-
-						m_SnapCrcErrors++;
-						if(m_SnapCrcErrors > 10)
-						{
-							// to many errors, send reset
-							m_AckGameTick[Config()->m_ClDummy] = -1;
-							SendInput();
-							m_SnapCrcErrors = 0;
-						}
-						return;
-					}
-					else
-					{
-						if(m_SnapCrcErrors)
-							m_SnapCrcErrors--;
-					}
-
-					// purge old snapshots
-					PurgeTick = DeltaTick;
-					if(m_aSnapshots[Config()->m_ClDummy][SNAP_PREV] && m_aSnapshots[Config()->m_ClDummy][SNAP_PREV]->m_Tick < PurgeTick)
-						PurgeTick = m_aSnapshots[Config()->m_ClDummy][SNAP_PREV]->m_Tick;
-					if(m_aSnapshots[Config()->m_ClDummy][SNAP_CURRENT] && m_aSnapshots[Config()->m_ClDummy][SNAP_CURRENT]->m_Tick < PurgeTick)
-						PurgeTick = m_aSnapshots[Config()->m_ClDummy][SNAP_CURRENT]->m_Tick;
-					m_SnapshotStorage[Config()->m_ClDummy].PurgeUntil(PurgeTick);
-
-					// add new
-					m_SnapshotStorage[Config()->m_ClDummy].Add(GameTick, time_get(), SnapSize, pTmpBuffer3, 1);
-
-					// add snapshot to demo
-					if(m_DemoRecorder.IsRecording())
-					{
-						// build up snapshot and add local messages
-						m_DemoRecSnapshotBuilder.Init(pTmpBuffer3);
-						GameClient()->OnDemoRecSnap();
-						SnapSize = m_DemoRecSnapshotBuilder.Finish(pTmpBuffer3);
-
-						// write snapshot
-						m_DemoRecorder.RecordSnapshot(GameTick, pTmpBuffer3, SnapSize);
-					}
-
-					// apply snapshot, cycle pointers
-					m_ReceivedSnapshots[Config()->m_ClDummy]++;
-
-					m_CurrentRecvTick[Config()->m_ClDummy] = GameTick;
-
-					// we got two snapshots until we see us self as connected
-					if(m_ReceivedSnapshots[Config()->m_ClDummy] == 2)
-					{
-						// start at 200ms and work from there
-						m_PredictedTime.Init(GameTick*time_freq()/50);
-						m_PredictedTime.SetAdjustSpeed(1, 1000.0f);
-						m_GameTime[Config()->m_ClDummy].Init((GameTick-1)*time_freq()/50);
-						m_aSnapshots[Config()->m_ClDummy][SNAP_PREV] = m_SnapshotStorage[Config()->m_ClDummy].m_pFirst;
-						m_aSnapshots[Config()->m_ClDummy][SNAP_CURRENT] = m_SnapshotStorage[Config()->m_ClDummy].m_pLast;
-						SetState(IClient::STATE_ONLINE);
-					}
-
-					// adjust game time
-					if(m_ReceivedSnapshots[Config()->m_ClDummy] > 2)
-					{
-						int64 Now = m_GameTime[Config()->m_ClDummy].Get(time_get());
-						int64 TickStart = GameTick*time_freq()/50;
-						int64 TimeLeft = (TickStart-Now)*1000 / time_freq();
-						m_GameTime[Config()->m_ClDummy].Update(&m_GametimeMarginGraph, (GameTick-1)*time_freq()/50, TimeLeft, 0);
-					}
-
-					// ack snapshot
-					m_AckGameTick[Config()->m_ClDummy] = GameTick;
-
-					// send timeout codes
-					if(m_ReceivedSnapshots[Config()->m_ClDummy] > 50 && !m_aTimeoutCodeSent[Config()->m_ClDummy])
-					{
-						if(m_ServerCapabilities.m_ChatTimeoutCode || ShouldSendChatTimeoutCodeHeuristic())
-						{
-							m_aTimeoutCodeSent[Config()->m_ClDummy] = true;
-							CNetMsg_Cl_Say Msg;
-							Msg.m_Mode = CHAT_ALL;
-							Msg.m_Target = -1;
-							char aBuf[256];
-							str_format(aBuf, sizeof(aBuf), "/timeout %s", m_aTimeoutCodes[Config()->m_ClDummy]);
-							Msg.m_pMessage = aBuf;
-							SendPackMsg(&Msg, MSGFLAG_VITAL, Config()->m_ClDummy);
-						}
-					}
-				}
-			}
+			ReceiveSnapshot(Config()->m_ClDummy, Msg, &Unpacker);
 		}
 	}
 	else
@@ -1877,218 +1800,416 @@ void CClient::ProcessServerPacketDummy(CNetChunk *pPacket)
 		}
 		else if(Msg == NETMSG_SNAP || Msg == NETMSG_SNAPSINGLE || Msg == NETMSG_SNAPEMPTY)
 		{
-			int NumParts = 1;
-			int Part = 0;
-			int GameTick = Unpacker.GetInt();
-			int DeltaTick = GameTick-Unpacker.GetInt();
-			int PartSize = 0;
-			int Crc = 0;
-			int CompleteSize = 0;
-			const char *pData = 0;
-
-			// we are not allowed to process snapshot yet
-			if(State() < IClient::STATE_LOADING)
-				return;
+			ReceiveSnapshot(!Config()->m_ClDummy, Msg, &Unpacker);
+		}
+	}
+	else
+	{
+		GameClient()->OnMessage(Msg, &Unpacker, true);
+	}
+}
 
-			if(Msg == NETMSG_SNAP)
-			{
-				NumParts = Unpacker.GetInt();
-				Part = Unpacker.GetInt();
-			}
+// called with m_NetLock held
+void CClient::ResetSnapshotReceiver(int NetClient)
+{
+	CSnapshotReceiver *pReceiver = &m_aSnapshotReceivers[NetClient];
+	pReceiver->m_DeltaStorage.PurgeAll();
+	pReceiver->m_Generation++;
+	pReceiver->m_Parts = 0;
+	pReceiver->m_RecvTick = 0;
+	pReceiver->m_AckGameTick = -1;
+	pReceiver->m_CrcErrors = 0;
+}
 
-			if(Msg != NETMSG_SNAPEMPTY)
-			{
-				Crc = Unpacker.GetInt();
-				PartSize = Unpacker.GetInt();
-			}
+// reassembles and delta decodes a snapshot message into pSnap. returns the size of the
+// snapshot once all parts arrived, 0 while parts are missing and -1 on errors, which
+// are described in pError if they are worth printing. called with m_NetLock held
+int CClient::DecodeSnapshot(CSnapshotDelta *pSnapshotDelta, int NetClient, int Msg, CUnpacker *pUnpacker, CSnapshot *pSnap, int *pGameTick, int *pDeltaTick, int64 RecvTime, char *pError, int ErrorSize)
+{
+	CSnapshotReceiver *pReceiver = &m_aSnapshotReceivers[NetClient];
+	int NumParts = 1;
+	int Part = 0;
+	int GameTick = pUnpacker->GetInt();
+	int DeltaTick = GameTick-pUnpacker->GetInt();
+	int PartSize = 0;
+	int Crc = 0;
+	int CompleteSize = 0;
+	const char *pData = 0;
 
-			pData = (const char *)Unpacker.GetRaw(PartSize);
+	pError[0] = 0;
+	*pGameTick = GameTick;
+	*pDeltaTick = DeltaTick;
 
-			if(Unpacker.Error() || NumParts < 1 || NumParts > CSnapshot::MAX_PARTS || Part < 0 || Part >= NumParts || PartSize < 0 || PartSize > MAX_SNAPSHOT_PACKSIZE)
-				return;
+	if(Msg == NETMSG_SNAP)
+	{
+		NumParts = pUnpacker->GetInt();
+		Part = pUnpacker->GetInt();
+	}
 
-			if(GameTick >= m_CurrentRecvTick[!Config()->m_ClDummy])
-			{
-				if(GameTick != m_CurrentRecvTick[!Config()->m_ClDummy])
-				{
-					m_SnapshotParts[!Config()->m_ClDummy] = 0;
-					m_CurrentRecvTick[!Config()->m_ClDummy] = GameTick;
-				}
+	if(Msg != NETMSG_SNAPEMPTY)
+	{
+		Crc = pUnpacker->GetInt();
+		PartSize = pUnpacker->GetInt();
+	}
 
-				// TODO: clean this up abit
-				mem_copy((char*)m_aSnapshotIncomingData + Part*MAX_SNAPSHOT_PACKSIZE, pData, PartSize);
-				m_SnapshotParts[!Config()->m_ClDummy] |= 1<<Part;
+	pData = (const char *)pUnpacker->GetRaw(PartSize);
 
-				if(m_SnapshotParts[!Config()->m_ClDummy] == (unsigned)((1<<NumParts)-1))
-				{
-					static CSnapshot Emptysnap;
-					CSnapshot *pDeltaShot = &Emptysnap;
-					int PurgeTick;
-					void *pDeltaData;
-					int DeltaSize;
-					unsigned char aTmpBuffer2[CSnapshot::MAX_SIZE];
-					unsigned char aTmpBuffer3[CSnapshot::MAX_SIZE];
-					CSnapshot *pTmpBuffer3 = (CSnapshot*)aTmpBuffer3;	// Fix compiler warning for strict-aliasing
-					int SnapSize;
-
-					CompleteSize = (NumParts-1) * MAX_SNAPSHOT_PACKSIZE + PartSize;
-
-					// reset snapshoting
-					m_SnapshotParts[!Config()->m_ClDummy] = 0;
-
-					// find snapshot that we should use as delta
-					Emptysnap.Clear();
-
-					// find delta
-					if(DeltaTick >= 0)
-					{
-						int DeltashotSize = m_SnapshotStorage[!Config()->m_ClDummy].Get(DeltaTick, 0, &pDeltaShot, 0);
-
-						if(DeltashotSize < 0)
-						{
-							// couldn't find the delta snapshots that the server used
-							// to compress this snapshot. force the server to resync
-							if(Config()->m_Debug)
-							{
-								char aBuf[256];
-								str_format(aBuf, sizeof(aBuf), "error, couldn't find the delta snapshot");
-								m_pConsole->Print(IConsole::OUTPUT_LEVEL_DEBUG, "client", aBuf);
-							}
-
-							// ack snapshot
-							// TODO: combine this with the input message
-							m_AckGameTick[!Config()->m_ClDummy] = -1;
-							return;
-						}
-					}
+	if(pUnpacker->Error() || NumParts < 1 || NumParts > CSnapshot::MAX_PARTS || Part < 0 || Part >= NumParts || PartSize < 0 || PartSize > MAX_SNAPSHOT_PACKSIZE)
+		return -1;
 
-					// decompress snapshot
-					pDeltaData = m_SnapshotDelta.EmptyDelta();
-					DeltaSize = sizeof(int)*3;
+	if(GameTick < pReceiver->m_RecvTick)
+		return 0;
 
-					if(CompleteSize)
-					{
-						int IntSize = CVariableInt::Decompress(m_aSnapshotIncomingData, CompleteSize, aTmpBuffer2, sizeof(aTmpBuffer2));
+	if(GameTick != pReceiver->m_RecvTick)
+	{
+		pReceiver->m_Parts = 0;
+		pReceiver->m_RecvTick = GameTick;
+	}
 
-						if(IntSize < 0) // failure during decompression, bail
-							return;
+	// TODO: clean this up abit
+	mem_copy(pReceiver->m_aIncomingData + Part*MAX_SNAPSHOT_PACKSIZE, pData, PartSize);
+	pReceiver->m_Parts |= 1<<Part;
 
-						pDeltaData = aTmpBuffer2;
-						DeltaSize = IntSize;
-					}
+	if(pReceiver->m_Parts != (unsigned)((1<<NumParts)-1))
+		return 0;
 
-					// unpack delta
-					SnapSize = m_SnapshotDelta.UnpackDelta(pDeltaShot, pTmpBuffer3, pDeltaData, DeltaSize);
-					if(SnapSize < 0)
-					{
-						m_pConsole->Print(IConsole::OUTPUT_LEVEL_DEBUG, "client", "delta unpack failed!");
-						return;
-					}
+	CSnapshot EmptySnap;
+	CSnapshot *pDeltaShot = &EmptySnap;
+	const void *pDeltaData;
+	int DeltaSize;
+	unsigned char aDeltaData[CSnapshot::MAX_SIZE];
 
-					if(Msg != NETMSG_SNAPEMPTY && pTmpBuffer3->Crc() != Crc)
-					{
-						if(Config()->m_Debug)
-						{
-							char aBuf[256];
-							str_format(aBuf, sizeof(aBuf), "snapshot crc error #%d - tick=%d wantedcrc=%d gotcrc=%d compressed_size=%d delta_tick=%d",
-								m_SnapCrcErrors, GameTick, Crc, pTmpBuffer3->Crc(), CompleteSize, DeltaTick);
-							m_pConsole->Print(IConsole::OUTPUT_LEVEL_DEBUG, "client", aBuf);
-						}
-
-						m_SnapCrcErrors++;
-						if(m_SnapCrcErrors > 10)
-						{
-							// to many errors, send reset
-							m_AckGameTick[!Config()->m_ClDummy] = -1;
-							SendInput();
-							m_SnapCrcErrors = 0;
-						}
-						return;
-					}
-					else
-					{
-						if(m_SnapCrcErrors)
-							m_SnapCrcErrors--;
-					}
+	CompleteSize = (NumParts-1) * MAX_SNAPSHOT_PACKSIZE + PartSize;
 
-					// purge old snapshots
-					PurgeTick = DeltaTick;
-					if(m_aSnapshots[!Config()->m_ClDummy][SNAP_PREV] && m_aSnapshots[!Config()->m_ClDummy][SNAP_PREV]->m_Tick < PurgeTick)
-						PurgeTick = m_aSnapshots[!Config()->m_ClDummy][SNAP_PREV]->m_Tick;
-					if(m_aSnapshots[!Config()->m_ClDummy][SNAP_CURRENT] && m_aSnapshots[!Config()->m_ClDummy][SNAP_CURRENT]->m_Tick < PurgeTick)
-						PurgeTick = m_aSnapshots[!Config()->m_ClDummy][SNAP_CURRENT]->m_Tick;
-					m_SnapshotStorage[!Config()->m_ClDummy].PurgeUntil(PurgeTick);
+	// reset snapshoting
+	pReceiver->m_Parts = 0;
 
-					// add new
-					m_SnapshotStorage[!Config()->m_ClDummy].Add(GameTick, time_get(), SnapSize, pTmpBuffer3, 1);
+	// find snapshot that we should use as delta
+	EmptySnap.Clear();
 
-					// apply snapshot, cycle pointers
-					m_ReceivedSnapshots[!Config()->m_ClDummy]++;
+	// find delta
+	if(DeltaTick >= 0)
+	{
+		int DeltashotSize = pReceiver->m_DeltaStorage.Get(DeltaTick, 0, &pDeltaShot, 0);
 
-					m_CurrentRecvTick[!Config()->m_ClDummy] = GameTick;
+		if(DeltashotSize < 0)
+		{
+			// couldn't find the delta snapshots that the server used
+			// to compress this snapshot. force the server to resync
+			str_copy(pError, "error, couldn't find the delta snapshot", ErrorSize);
 
-					// we got two snapshots until we see us self as connected
-					if(m_ReceivedSnapshots[!Config()->m_ClDummy] == 2)
-					{
-						// start at 200ms and work from there
-						//m_PredictedTime.Init(GameTick*time_freq()/50);
-						//m_PredictedTime.SetAdjustSpeed(1, 1000.0f);
-						m_GameTime[!Config()->m_ClDummy].Init((GameTick-1)*time_freq()/50);
-						m_aSnapshots[!Config()->m_ClDummy][SNAP_PREV] = m_SnapshotStorage[!Config()->m_ClDummy].m_pFirst;
-						m_aSnapshots[!Config()->m_ClDummy][SNAP_CURRENT] = m_SnapshotStorage[!Config()->m_ClDummy].m_pLast;
-						SetState(IClient::STATE_ONLINE);
-					}
+			// ack snapshot
+			// TODO: combine this with the input message
+			pReceiver->m_AckGameTick = -1;
+			return -1;
+		}
+	}
 
-					// adjust game time
-					if(m_ReceivedSnapshots[!Config()->m_ClDummy] > 2)
-					{
-						int64 Now = m_GameTime[!Config()->m_ClDummy].Get(time_get());
-						int64 TickStart = GameTick*time_freq()/50;
-						int64 TimeLeft = (TickStart-Now)*1000 / time_freq();
-						m_GameTime[!Config()->m_ClDummy].Update(&m_GametimeMarginGraph, (GameTick-1)*time_freq()/50, TimeLeft, 0);
-					}
+	// decompress snapshot
+	pDeltaData = pSnapshotDelta->EmptyDelta();
+	DeltaSize = sizeof(int)*3;
 
-					// ack snapshot
-					m_AckGameTick[!Config()->m_ClDummy] = GameTick;
-				}
-			}
+	if(CompleteSize)
+	{
+		int IntSize = CVariableInt::Decompress(pReceiver->m_aIncomingData, CompleteSize, aDeltaData, sizeof(aDeltaData));
+
+		if(IntSize < 0) // failure during decompression, bail
+			return -1;
+
+		pDeltaData = aDeltaData;
+		DeltaSize = IntSize;
+	}
+
+	// unpack delta
+	int SnapSize = pSnapshotDelta->UnpackDelta(pDeltaShot, pSnap, pDeltaData, DeltaSize);
+	if(SnapSize < 0)
+	{
+		str_copy(pError, "delta unpack failed!", ErrorSize);
+		return -1;
+	}
+
+	if(Msg != NETMSG_SNAPEMPTY && pSnap->Crc() != Crc)
+	{
+		str_format(pError, ErrorSize, "snapshot crc error #%d - tick=%d wantedcrc=%d gotcrc=%d compressed_size=%d delta_tick=%d",
+			pReceiver->m_CrcErrors, GameTick, Crc, pSnap->Crc(), CompleteSize, DeltaTick);
+
+		pReceiver->m_CrcErrors++;
+		if(pReceiver->m_CrcErrors > 10)
+		{
+			// to many errors, send reset
+			pReceiver->m_AckGameTick = -1;
+			SendNetInput(NetClient, m_aNetInputs[NetClient].m_LastSentTick, time_get());
+			pReceiver->m_CrcErrors = 0;
 		}
+		return -1;
 	}
 	else
 	{
-		GameClient()->OnMessage(Msg, &Unpacker, true);
+		if(pReceiver->m_CrcErrors)
+			pReceiver->m_CrcErrors--;
+	}
+
+	// keep it as delta for the following snapshots, the server
+	// doesn't use anything older than DeltaTick anymore
+	pReceiver->m_DeltaStorage.PurgeUntil(DeltaTick);
+	pReceiver->m_DeltaStorage.Add(GameTick, RecvTime, SnapSize, pSnap, 0);
+
+	// ack snapshot
+	pReceiver->m_AckGameTick = GameTick;
+	return SnapSize;
+}
+
+// decodes a snapshot message on the network thread and queues it for the
+// game thread. returns false for other messages. called with m_NetLock held
+bool CClient::QueueSnapshot(int NetClient, CNetChunk *pPacket, int64 RecvTime)
+{
+	CUnpacker Unpacker;
+	Unpacker.Reset(pPacket->m_pData, pPacket->m_DataSize);
+
+	// unpack msgid and system flag
+	int Msg = Unpacker.GetInt();
+	int Sys = Msg&1;
+	Msg >>= 1;
+
+	if(Unpacker.Error() || !Sys || (Msg != NETMSG_SNAP && Msg != NETMSG_SNAPSINGLE && Msg != NETMSG_SNAPEMPTY))
+		return false;
+
+	// the game thread is behind, drop it. it isn't acked, so the
+	// server keeps sending deltas against the last acked snapshot
+	CQueuedSnapshot *pQueued = m_SnapshotQueue.Reserve();
+	if(!pQueued)
+		return true;
+
+	pQueued->m_Size = DecodeSnapshot(&m_NetSnapshotDelta, NetClient, Msg, &Unpacker, (CSnapshot *)pQueued->m_aData, &pQueued->m_GameTick, &pQueued->m_DeltaTick, RecvTime, pQueued->m_aError, sizeof(pQueued->m_aError));
+	if(pQueued->m_Size > 0 || pQueued->m_aError[0])
+	{
+		pQueued->m_NetClient = NetClient;
+		pQueued->m_Generation = m_aNetGeneration[NetClient];
+		pQueued->m_ReceiverGeneration = m_aSnapshotReceivers[NetClient].m_Generation;
+		pQueued->m_RecvTime = RecvTime;
+		m_SnapshotQueue.Commit();
 	}
+	return true;
+}
+
+// decodes a snapshot message on the game thread, if there is no network thread
+void CClient::ReceiveSnapshot(int NetClient, int Msg, CUnpacker *pUnpacker)
+{
+	// we are not allowed to process snapshot yet
+	if(State() < IClient::STATE_LOADING)
+		return;
+
+	unsigned char aSnap[CSnapshot::MAX_SIZE];
+	CSnapshot *pSnap = (CSnapshot *)aSnap;
+	char aError[256];
+	int GameTick;
+	int DeltaTick;
+	int SnapSize;
+	{
+		scope_lock Lock(&m_NetLock);
+		SnapSize = DecodeSnapshot(&m_SnapshotDelta, NetClient, Msg, pUnpacker, pSnap, &GameTick, &DeltaTick, m_PacketRecvTime, aError, sizeof(aError));
+	}
+
+	if(aError[0] && Config()->m_Debug)
+		m_pConsole->Print(IConsole::OUTPUT_LEVEL_DEBUG, "client", aError);
+	if(SnapSize > 0)
+		ApplySnapshot(NetClient, GameTick, DeltaTick, m_PacketRecvTime, pSnap, SnapSize);
+}
+
+// hands a decoded snapshot to the game
+void CClient::ApplySnapshot(int NetClient, int GameTick, int DeltaTick, int64 RecvTime, CSnapshot *pSnap, int SnapSize)
+{
+	// we are not allowed to process snapshot yet
+	if(State() < IClient::STATE_LOADING)
+		return;
+
+	// the dummy only feeds its own snapshots, the rest follows the played connection
+	const bool Main = NetClient == Config()->m_ClDummy;
+
+	// purge old snapshots
+	int PurgeTick = DeltaTick;
+	if(m_aSnapshots[NetClient][SNAP_PREV] && m_aSnapshots[NetClient][SNAP_PREV]->m_Tick < PurgeTick)
+		PurgeTick = m_aSnapshots[NetClient][SNAP_PREV]->m_Tick;
+	if(m_aSnapshots[NetClient][SNAP_CURRENT] && m_aSnapshots[NetClient][SNAP_CURRENT]->m_Tick < PurgeTick)
+		PurgeTick = m_aSnapshots[NetClient][SNAP_CURRENT]->m_Tick;
+	m_SnapshotStorage[NetClient].PurgeUntil(PurgeTick);
+
+	// add new
+	m_SnapshotStorage[NetClient].Add(GameTick, RecvTime, SnapSize, pSnap, 1);
+
+	// add snapshot to demo
+	if(Main && m_DemoRecorder.IsRecording())
+	{
+		// build up snapshot and add local messages
+		m_DemoRecSnapshotBuilder.Init(pSnap);
+		GameClient()->OnDemoRecSnap();
+		SnapSize = m_DemoRecSnapshotBuilder.Finish(pSnap);
+
+		// write snapshot
+		m_DemoRecorder.RecordSnapshot(GameTick, pSnap, SnapSize);
+	}
+
+	// apply snapshot, cycle pointers
+	m_ReceivedSnapshots[NetClient]++;
+
+	// we got two snapshots until we see us self as connected
+	if(m_ReceivedSnapshots[NetClient] == 2)
+	{
+		// start at 200ms and work from there
+		if(Main)
+		{
+			m_PredictedTime.Init(GameTick*time_freq()/50);
+			m_PredictedTime.SetAdjustSpeed(1, 1000.0f);
+		}
+		m_GameTime[NetClient].Init((GameTick-1)*time_freq()/50);
+		m_aSnapshots[NetClient][SNAP_PREV] = m_SnapshotStorage[NetClient].m_pFirst;
+		m_aSnapshots[NetClient][SNAP_CURRENT] = m_SnapshotStorage[NetClient].m_pLast;
+		SetState(IClient::STATE_ONLINE);
+	}
+
+	// adjust game time
+	if(m_ReceivedSnapshots[NetClient] > 2)
+	{
+		int64 Now = m_GameTime[NetClient].Get(RecvTime);
+		int64 TickStart = GameTick*time_freq()/50;
+		int64 TimeLeft = (TickStart-Now)*1000 / time_freq();
+		m_GameTime[NetClient].Update(&m_GametimeMarginGraph, (GameTick-1)*time_freq()/50, TimeLeft, 0);
+	}
+
+	// send timeout codes
+	if(Main && m_ReceivedSnapshots[NetClient] > 50 && !m_aTimeoutCodeSent[NetClient])
+	{
+		if(m_ServerCapabilities.m_ChatTimeoutCode || ShouldSendChatTimeoutCodeHeuristic())
+		{
+			m_aTimeoutCodeSent[NetClient] = true;
+			CNetMsg_Cl_Say Msg;
+			Msg.m_Mode = CHAT_ALL;
+			Msg.m_Target = -1;
+			char aBuf[256];
+			str_format(aBuf, sizeof(aBuf), "/timeout %s", m_aTimeoutCodes[NetClient]);
+			Msg.m_pMessage = aBuf;
+			SendPackMsg(&Msg, MSGFLAG_VITAL, NetClient);
+		}
+	}
+}
+
+void CClient::NetworkThread(void *pUser)
+{
+	CClient *pSelf = (CClient *)pUser;
+
+	while(!pSelf->m_NetThreadShutdown)
+	{
+		bool QueueFull = false;
+		{
+			scope_lock Lock(&pSelf->m_NetLock);
+			const int64 Now = time_get();
+			for(int i = 0; i < NUM_CLIENTS; i++)
+			{
+				pSelf->m_NetClient[i].Update();
+
+				// queue the game packets, connless ones are dropped like in PumpNetwork
+				// and snapshots are decoded right away
+				CNetChunk Packet;
+				CQueuedPacket *pQueued;
+				while((pQueued = pSelf->m_PacketQueue.Reserve()) && pSelf->m_NetClient[i].Recv(&Packet))
+				{
+					if(Packet.m_Flags&NETSENDFLAG_CONNLESS)
+						continue;
+					if(pSelf->QueueSnapshot(i, &Packet, Now))
+						continue;
+					pQueued->m_NetClient = i;
+					pQueued->m_Generation = pSelf->m_aNetGeneration[i];
+					pQueued->m_Flags = Packet.m_Flags;
+					pQueued->m_DataSize = Packet.m_DataSize;
+					pQueued->m_RecvTime = Now;
+					mem_copy(pQueued->m_aData, Packet.m_pData, Packet.m_DataSize);
+					pSelf->m_PacketQueue.Commit();
+				}
+				QueueFull = QueueFull || !pQueued;
+			}
+
+			pSelf->SendNetInputs(Now);
+		}
+
+		// wait for the next packet, the timeout keeps resends and timeouts ticking
+		if(QueueFull)
+			thread_sleep(1);
+		else
+			net_socket_read_wait(pSelf->m_NetClient[CLIENT_MAIN].Socket(), 1);
+	}
+}
+
+void CClient::StartNetworkThread()
+{
+	if(m_pNetThread)
+		return;
+	m_NetThreadShutdown = false;
+	m_pNetThread = thread_init(NetworkThread, this);
+}
+
+void CClient::StopNetworkThread()
+{
+	if(!m_pNetThread)
+		return;
+	m_NetThreadShutdown = true;
+	thread_wait(m_pNetThread);
+	thread_destroy(m_pNetThread);
+	m_pNetThread = 0;
+}
+
+int CClient::NetClientState(int NetClient)
+{
+	scope_lock Lock(&m_NetLock);
+	return m_NetClient[NetClient].State();
+}
+
+void CClient::ProcessPacket(CNetChunk *pPacket, int NetClient)
+{
+	// the dummy packets are processed as main packets while playing the dummy
+	if((NetClient == CLIENT_DUMMY) == (Config()->m_ClDummy != 0))
+		ProcessServerPacket(pPacket);
+	else
+		ProcessServerPacketDummy(pPacket);
 }
 
 void CClient::PumpNetwork()
 {
-	for(int i = 0; i < NUM_CLIENTS; i++)
+	// the network thread updates the connections itself, copy
+	// their status as it might change them meanwhile
 	{
-		m_NetClient[i].Update();
+		scope_lock Lock(&m_NetLock);
+		for(int i = 0; i < NUM_CLIENTS; i++)
+		{
+			if(!m_pNetThread)
+				m_NetClient[i].Update();
+			m_aNetState[i] = m_NetClient[i].State();
+			m_aNetGotProblems[i] = m_NetClient[i].GotProblems() != 0;
+			str_copy(m_aaNetErrorString[i], m_NetClient[i].ErrorString(), sizeof(m_aaNetErrorString[i]));
+		}
 	}
 
 	if(State() != IClient::STATE_DEMOPLAYBACK)
 	{
 		// check for errors
-		if(State() != IClient::STATE_OFFLINE && State() != IClient::STATE_QUITING && m_NetClient[CLIENT_MAIN].State() == NETSTATE_OFFLINE)
+		if(State() != IClient::STATE_OFFLINE && State() != IClient::STATE_QUITING && m_aNetState[CLIENT_MAIN] == NETSTATE_OFFLINE)
 		{
 			SetState(IClient::STATE_OFFLINE);
-			DisconnectWithReason(m_NetClient[CLIENT_MAIN].ErrorString());
+			DisconnectWithReason(m_aaNetErrorString[CLIENT_MAIN]);
 			char aBuf[256];
-			str_format(aBuf, sizeof(aBuf), "offline error='%s'", m_NetClient[CLIENT_MAIN].ErrorString());
+			str_format(aBuf, sizeof(aBuf), "offline error='%s'", m_aaNetErrorString[CLIENT_MAIN]);
 			m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "client", aBuf);
 		}
 
-		if(m_DummyConnected && State() != IClient::STATE_OFFLINE && State() != IClient::STATE_QUITING && m_NetClient[CLIENT_DUMMY].State() == NETSTATE_OFFLINE)
+		if(m_DummyConnected && State() != IClient::STATE_OFFLINE && State() != IClient::STATE_QUITING && m_aNetState[CLIENT_DUMMY] == NETSTATE_OFFLINE)
 		{
 			DummyDisconnect(0);
 			char aBuf[256];
-			str_format(aBuf, sizeof(aBuf), "offline dummy error='%s'", m_NetClient[CLIENT_DUMMY].ErrorString());
+			str_format(aBuf, sizeof(aBuf), "offline dummy error='%s'", m_aaNetErrorString[CLIENT_DUMMY]);
 			m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "client", aBuf);
 		}
 
 		//
-		if(State() == IClient::STATE_CONNECTING && m_NetClient[CLIENT_MAIN].State() == NETSTATE_ONLINE)
+		if(State() == IClient::STATE_CONNECTING && m_aNetState[CLIENT_MAIN] == NETSTATE_ONLINE)
 		{
 			// we switched to online
 			m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "client", "connected, sending info");
@@ -2097,28 +2218,51 @@ void CClient::PumpNetwork()
 		}
 	}
 
-	// process non-connless packets
+	// process packets queued by the network thread, also after it was stopped
 	CNetChunk Packet;
-	while(m_NetClient[CLIENT_MAIN].Recv(&Packet))
+	CQueuedPacket *pQueued;
+	while((pQueued = m_PacketQueue.Front()))
 	{
-		if(!(Packet.m_Flags&NETSENDFLAG_CONNLESS))
+		if(pQueued->m_Generation == m_aNetGeneration[pQueued->m_NetClient])
 		{
-			if (Config()->m_ClDummy)
-				ProcessServerPacketDummy(&Packet);
-			else
-				ProcessServerPacket(&Packet);
+			mem_zero(&Packet, sizeof(Packet));
+			Packet.m_Flags = pQueued->m_Flags;
+			Packet.m_DataSize = pQueued->m_DataSize;
+			Packet.m_pData = pQueued->m_aData;
+			m_PacketRecvTime = pQueued->m_RecvTime;
+			ProcessPacket(&Packet, pQueued->m_NetClient);
 		}
+		m_PacketQueue.Pop();
 	}
 
-	// process dummy packets
-	while (m_NetClient[CLIENT_DUMMY].Recv(&Packet))
+	// and the snapshots it decoded, unless the connection or the receiver was reset since
+	CQueuedSnapshot *pSnapshot;
+	while((pSnapshot = m_SnapshotQueue.Front()))
 	{
-		if(!(Packet.m_Flags&NETSENDFLAG_CONNLESS))
+		int NetClient = pSnapshot->m_NetClient;
+		if(pSnapshot->m_Generation == m_aNetGeneration[NetClient] && pSnapshot->m_ReceiverGeneration == m_aSnapshotReceivers[NetClient].m_Generation)
 		{
-			if (Config()->m_ClDummy)
-				ProcessServerPacket(&Packet);
-			else
-				ProcessServerPacketDummy(&Packet);
+			if(pSnapshot->m_aError[0] && Config()->m_Debug)
+				m_pConsole->Print(IConsole::OUTPUT_LEVEL_DEBUG, "client", pSnapshot->m_aError);
+			if(pSnapshot->m_Size > 0)
+				ApplySnapshot(NetClient, pSnapshot->m_GameTick, pSnapshot->m_DeltaTick, pSnapshot->m_RecvTime, (CSnapshot *)pSnapshot->m_aData, pSnapshot->m_Size);
+		}
+		m_SnapshotQueue.Pop();
+	}
+
+	// process non-connless packets
+	if(!m_pNetThread)
+	{
+		for(int i = 0; i < NUM_CLIENTS; i++)
+		{
+			while(m_NetClient[i].Recv(&Packet))
+			{
+				if(!(Packet.m_Flags&NETSENDFLAG_CONNLESS))
+				{
+					m_PacketRecvTime = time_get();
+					ProcessPacket(&Packet, i);
+				}
+			}
 		}
 	}
 
@@ -2402,6 +2546,56 @@ void CClient::InitInterfaces()
 	m_Blacklist.Init();
 }
 
+void CClient::PacerSleep(double Seconds)
+{
+	// leave the estimated overshoot to the spin loop, sleeps shorter
+	// than half a millisecond are not worth the wake up latency
+	const double Request = Seconds - m_SleepOvershoot;
+	if(Request < 0.0005)
+		return;
+
+	int64 Start = time_get();
+	thread_usleep((int)(Request*1000000.0));
+	const double Slept = (time_get() - Start) / (double)time_freq();
+	m_PacerSleepTime += Slept;
+
+	// calibrate the margin: grow at once when the scheduler woke us
+	// up too late, shrink slowly when it was punctual
+	const double Overshoot = clamp(Slept - Request, 0.0, 0.02);
+	if(Overshoot > m_SleepOvershoot)
+		m_SleepOvershoot = Overshoot;
+	else
+		m_SleepOvershoot = m_SleepOvershoot*0.95 + Overshoot*0.05;
+}
+
+void CClient::PacerUpdateStats(double FrameTime)
+{
+	// deviation of the rendered frame time from the desired one
+	if(!Config()->m_GfxVsync && Config()->m_GfxLimitFps)
+	{
+		const double Jitter = absolute(FrameTime - 1.0/Config()->m_GfxMaxFps);
+		m_PacerJitterSum += Jitter;
+		m_PacerJitterMax = max(m_PacerJitterMax, Jitter);
+		m_PacerFrames++;
+	}
+
+	int64 Now = time_get();
+	const double Elapsed = (Now - m_PacerStatsStart) / (double)time_freq();
+	if(Elapsed < 1.0)
+		return;
+
+	m_PacerJitterAvg = m_PacerFrames ? m_PacerJitterSum/m_PacerFrames : 0.0f;
+	m_PacerJitterPeak = m_PacerJitterMax;
+	m_PacerSleepShare = m_PacerSleepTime/Elapsed;
+	m_PacerSpinShare = m_PacerSpinTime/Elapsed;
+	m_PacerStatsStart = Now;
+	m_PacerFrames = 0;
+	m_PacerJitterSum = 0.0;
+	m_PacerJitterMax = 0.0;
+	m_PacerSleepTime = 0.0;
+	m_PacerSpinTime = 0.0;
+}
+
 bool CClient::LimitFps()
 {
 	if(Config()->m_GfxVsync || !Config()->m_GfxLimitFps) return false;
@@ -2414,6 +2608,10 @@ bool CClient::LimitFps()
 		If we don't have the time to do another game loop:
 			Wait until desired frametime
 
+		With gfx_limitfps_sleep the waiting is done by sleeping for
+		most of the remaining time and spinning only for the last
+		part, the spin margin follows the measured sleep overshoot.
+
 		Returns true if frame should be skipped
 	**/
 
@@ -2442,6 +2640,10 @@ bool CClient::LimitFps()
 		const double Freq = (double)time_freq();
 		const int64 LastT = m_LastRenderTime;
 		double d = DesiredTime - RenderDeltaTime;
+		if(Config()->m_GfxLimitFpsSleep)
+			PacerSleep(d);
+
+		const int64 SpinStart = time_get();
 		while(d > 0.00001)
 		{
 			Now = time_get();
@@ -2449,10 +2651,19 @@ bool CClient::LimitFps()
 			d = DesiredTime - RenderDeltaTime;
 			cpu_relax();
 		}
+		// the loop doesn't run at all if the sleep already reached the deadline
+		Now = time_get();
+		m_PacerSpinTime += (Now - SpinStart) / Freq;
 
 		SkipFrame = false;
 		m_LastCpuTime = Now;
 	}
+	else if(SkipFrame && RenderDeltaTime < DesiredTime && Config()->m_GfxLimitFpsSleep)
+	{
+		// far from the deadline, sleep until only one more game loop fits
+		PacerSleep(DesiredTime - RenderDeltaTime - m_LastAvgCpuFrameTime * 1.20);
+		m_LastCpuTime = time_get();
+	}
 
 	// RenderDeltaTime exceeds DesiredTime, render
 	if(SkipFrame && RenderDeltaTime > DesiredTime)
@@ -2485,8 +2696,6 @@ bool CClient::LimitFps()
 void CClient::Run()
 {
 	m_LocalStartTime = time_get();
-	m_SnapshotParts[CLIENT_MAIN] = 0;
-	m_SnapshotParts[CLIENT_DUMMY] = 0;
 
 	if (m_GenerateTimeoutSeed)
 	{
@@ -2590,6 +2799,12 @@ void CClient::Run()
 		//
 		VersionUpdate();
 
+		// follow cl_network_thread
+		if(Config()->m_ClNetworkThread && !m_pNetThread)
+			StartNetworkThread();
+		else if(!Config()->m_ClNetworkThread && m_pNetThread)
+			StopNetworkThread();
+
 		// handle pending connects
 		if(m_aCmdConnect[0])
 		{
@@ -2597,7 +2812,7 @@ void CClient::Run()
 			m_aCmdConnect[0] = 0;
 		}
 
-		if (m_DummySendConnInfo && m_NetClient[CLIENT_DUMMY].State() == STATE_CONNECTING)
+		if (m_DummySendConnInfo && NetClientState(CLIENT_DUMMY) == STATE_CONNECTING)
 		{
 			m_DummySendConnInfo = false;
 
@@ -2615,7 +2830,10 @@ void CClient::Run()
 			SendMsg(&MsgInfo, MSGFLAG_VITAL|MSGFLAG_FLUSH, CLIENT_DUMMY);
 
 			// update netclient
-			m_NetClient[CLIENT_DUMMY].Update();
+			{
+				scope_lock Lock(&m_NetLock);
+				m_NetClient[CLIENT_DUMMY].Update();
+			}
 
 			// send ready
 			CMsgPacker MsgReady(NETMSG_READY, true);
@@ -2707,11 +2925,14 @@ void CClient::Run()
 			
 			m_pTextRender->Update();
 
+			int64 UpdateStart = time_get();
 			Update();
+			int64 UpdateTime = time_get()-UpdateStart;
 
-			const bool SkipFrame = LimitFps();
+			// the benchmark renders every frame as fast as it can
+			const bool SkipFrame = !m_Benchmark && LimitFps();
 
-			if(!SkipFrame && (!Config()->m_GfxAsyncRender || m_pGraphics->IsIdle()))
+			if(!SkipFrame && (!Config()->m_GfxAsyncRender || m_Benchmark || m_pGraphics->IsIdle()))
 			{
 				m_RenderFrames++;
 
@@ -2724,20 +2945,32 @@ void CClient::Run()
 				if(m_RenderFrameTime > m_RenderFrameTimeHigh)
 					m_RenderFrameTimeHigh = m_RenderFrameTime;
 				m_FpsGraph.Add(1.0f/m_RenderFrameTime, 1,1,1);
+				PacerUpdateStats(m_RenderFrameTime);
 
 				m_LastRenderTime = Now;
 
 				// when we are stress testing only render every 10th frame
 				if(!Config()->m_DbgStress || (m_RenderFrames%10) == 0 )
 				{
+					int64 RenderStart = time_get();
 					Render();
+					int64 SwapStart = time_get();
 					m_pGraphics->Swap();
+					if(m_Benchmark && State() == IClient::STATE_DEMOPLAYBACK && !m_DemoPlayer.BaseInfo()->m_Paused)
+						BenchmarkAddFrame(UpdateTime, SwapStart-RenderStart, time_get()-SwapStart);
 				}
 			}
 		}
 
 		AutoScreenshot_Cleanup();
 
+		// the benchmark is over once the demo reached its end
+		if(m_Benchmark && (State() != IClient::STATE_DEMOPLAYBACK || m_DemoPlayer.BaseInfo()->m_Paused))
+		{
+			BenchmarkFinish();
+			Quit();
+		}
+
 		// check conditions
 		if(State() == IClient::STATE_QUITING)
 			break;
@@ -2750,11 +2983,14 @@ void CClient::Run()
 				m_CurMenuTick++;
 		}
 
-		// beNice
-		if(Config()->m_ClCpuThrottle)
-			thread_sleep(Config()->m_ClCpuThrottle);
-		else if(Config()->m_DbgStress || !m_pGraphics->WindowActive())
-			thread_sleep(5);
+		// beNice, the benchmark runs flat out
+		if(!m_Benchmark)
+		{
+			if(Config()->m_ClCpuThrottle)
+				thread_sleep(Config()->m_ClCpuThrottle);
+			else if(Config()->m_DbgStress || !m_pGraphics->WindowActive())
+				thread_sleep(5);
+		}
 
 		if(Config()->m_DbgHitch)
 		{
@@ -2783,6 +3019,7 @@ void CClient::Run()
 		m_LocalTime = (time_get()-m_LocalStartTime)/(float)time_freq();
 	}
 
+	StopNetworkThread();
 	GameClient()->OnShutdown();
 	Disconnect();
 
@@ -2911,10 +3148,15 @@ void CClient::Con_RconAuth(IConsole::IResult *pResult, void *pUserData)
 const char *CClient::DemoPlayer_Play(const char *pFilename, int StorageType)
 {
 	Disconnect();
-	m_NetClient[CLIENT_MAIN].ResetErrorString();
+	{
+		scope_lock Lock(&m_NetLock);
+		m_NetClient[CLIENT_MAIN].ResetErrorString();
+	}
+	m_aaNetErrorString[CLIENT_MAIN][0] = 0;
 
 	// try to start playback
 	m_DemoPlayer.SetListener(this);
+	m_DemoPlayer.SetCheckpoints(Config()->m_ClDemoCheckpointInterval, Config()->m_ClDemoCheckpointCache);
 
 	const char *pError = m_DemoPlayer.Load(Storage(), m_pConsole, pFilename, StorageType, GameClient()->NetVersion());
 	if(pError)
@@ -3021,6 +3263,126 @@ void CClient::Con_AddDemoMarker(IConsole::IResult *pResult, void *pUserData)
 	pSelf->DemoRecorder_AddDemoMarker();
 }
 
+void CClient::BenchmarkStart(const char *pDemo, int Fps, const char *pOutput)
+{
+	const char *pError = DemoPlayer_Play(pDemo, IStorage::TYPE_ALL);
+	if(pError)
+	{
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "could not play '%s': %s", pDemo, pError);
+		m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "benchmark", aBuf);
+		return;
+	}
+
+	// every frame moves the demo forward by the same amount of time, no matter how long it took
+	m_DemoPlayer.SetFixedStep(time_freq()/Fps);
+	GameClient()->SetRenderProfiling(true);
+
+	m_Benchmark = true;
+	str_copy(m_aBenchmarkOutput, pOutput, sizeof(m_aBenchmarkOutput));
+	m_BenchmarkNumColumns = 0;
+	m_BenchmarkSamples.clear();
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "playing '%s' at %d fps", pDemo, Fps);
+	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "benchmark", aBuf);
+}
+
+void CClient::BenchmarkAddFrame(int64 UpdateTime, int64 RenderTime, int64 SwapTime)
+{
+	const char *apNames[BENCHMARK_MAX_COLUMNS-NUM_BENCHMARK_ENGINE_COLUMNS];
+	int64 aTimes[BENCHMARK_MAX_COLUMNS-NUM_BENCHMARK_ENGINE_COLUMNS];
+	int NumComponents = GameClient()->GetRenderProfile(apNames, aTimes, BENCHMARK_MAX_COLUMNS-NUM_BENCHMARK_ENGINE_COLUMNS);
+
+	if(m_BenchmarkNumColumns == 0)
+	{
+		m_apBenchmarkColumns[BENCHMARK_COLUMN_FRAME] = "frame";
+		m_apBenchmarkColumns[BENCHMARK_COLUMN_UPDATE] = "update";
+		m_apBenchmarkColumns[BENCHMARK_COLUMN_RENDER] = "render";
+		m_apBenchmarkColumns[BENCHMARK_COLUMN_SWAP] = "swap";
+		for(int i = 0; i < NumComponents; i++)
+			m_apBenchmarkColumns[NUM_BENCHMARK_ENGINE_COLUMNS+i] = apNames[i];
+		m_BenchmarkNumColumns = NUM_BENCHMARK_ENGINE_COLUMNS+NumComponents;
+	}
+
+	const float Scale = 1000.0f/time_freq();
+	m_BenchmarkSamples.add((UpdateTime+RenderTime+SwapTime)*Scale);
+	m_BenchmarkSamples.add(UpdateTime*Scale);
+	m_BenchmarkSamples.add(RenderTime*Scale);
+	m_BenchmarkSamples.add(SwapTime*Scale);
+	for(int i = NUM_BENCHMARK_ENGINE_COLUMNS; i < m_BenchmarkNumColumns; i++)
+		m_BenchmarkSamples.add(i-NUM_BENCHMARK_ENGINE_COLUMNS < NumComponents ? aTimes[i-NUM_BENCHMARK_ENGINE_COLUMNS]*Scale : 0.0f);
+}
+
+void CClient::BenchmarkFinish()
+{
+	m_Benchmark = false;
+	m_DemoPlayer.SetFixedStep(0);
+	GameClient()->SetRenderProfiling(false);
+
+	const int NumFrames = m_BenchmarkNumColumns ? m_BenchmarkSamples.size()/m_BenchmarkNumColumns : 0;
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "%d frames, cpu time in ms", NumFrames);
+	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "benchmark", aBuf);
+	if(NumFrames == 0)
+		return;
+
+	IOHANDLE File = 0;
+	if(m_aBenchmarkOutput[0])
+	{
+		File = Storage()->OpenFile(m_aBenchmarkOutput, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+		if(File)
+		{
+			str_copy(aBuf, "name,mean,p50,p95,p99,max", sizeof(aBuf));
+			io_write(File, aBuf, str_length(aBuf));
+			io_write_newline(File);
+		}
+		else
+			m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "benchmark", "could not open the output file");
+	}
+
+	float *pColumn = (float *)mem_alloc(NumFrames*sizeof(float), 1);
+	for(int c = 0; c < m_BenchmarkNumColumns; c++)
+	{
+		float Sum = 0.0f;
+		for(int f = 0; f < NumFrames; f++)
+		{
+			pColumn[f] = m_BenchmarkSamples[f*m_BenchmarkNumColumns+c];
+			Sum += pColumn[f];
+		}
+		std::sort(pColumn, pColumn+NumFrames);
+
+		const float Mean = Sum/NumFrames;
+		const float P50 = pColumn[min(NumFrames-1, NumFrames*50/100)];
+		const float P95 = pColumn[min(NumFrames-1, NumFrames*95/100)];
+		const float P99 = pColumn[min(NumFrames-1, NumFrames*99/100)];
+		const float Max = pColumn[NumFrames-1];
+
+		str_format(aBuf, sizeof(aBuf), "%-20s mean %7.3f  p50 %7.3f  p95 %7.3f  p99 %7.3f  max %7.3f",
+			m_apBenchmarkColumns[c], Mean, P50, P95, P99, Max);
+		m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "benchmark", aBuf);
+
+		if(File)
+		{
+			str_format(aBuf, sizeof(aBuf), "%s,%.4f,%.4f,%.4f,%.4f,%.4f", m_apBenchmarkColumns[c], Mean, P50, P95, P99, Max);
+			io_write(File, aBuf, str_length(aBuf));
+			io_write_newline(File);
+		}
+	}
+	mem_free(pColumn);
+
+	if(File)
+		io_close(File);
+	m_BenchmarkSamples.clear();
+}
+
+void CClient::Con_Benchmark(IConsole::IResult *pResult, void *pUserData)
+{
+	CClient *pSelf = (CClient *)pUserData;
+	int Fps = pResult->NumArguments() > 1 ? clamp(pResult->GetInteger(1), 1, 1000) : 60;
+	pSelf->BenchmarkStart(pResult->GetString(0), Fps, pResult->NumArguments() > 2 ? pResult->GetString(2) : "");
+}
+
 void CClient::ServerBrowserUpdate()
 {
 	m_ResortServerBrowser = true;
@@ -3150,6 +3512,7 @@ void CClient::RegisterCommands()
 	m_pConsole->Register("record", "?s[file]", CFGFLAG_CLIENT, Con_Record, this, "Record to the file");
 	m_pConsole->Register("stoprecord", "", CFGFLAG_CLIENT, Con_StopRecord, this, "Stop recording");
 	m_pConsole->Register("add_demomarker", "", CFGFLAG_CLIENT, Con_AddDemoMarker, this, "Add demo timeline marker");
+	m_pConsole->Register("benchmark", "s[demo] ?i[fps] ?s[output]", CFGFLAG_CLIENT|CFGFLAG_STORE, Con_Benchmark, this, "Play a demo at a fixed frame rate, print the cpu frame time percentiles per component and quit");
 
 	// used for server browser update
 	m_pConsole->Chain("br_filter_string", ConchainServerBrowserUpdate, this);
@@ -4,6 +4,8 @@
 #define ENGINE_CLIENT_CLIENT_H
 
 #include <base/hash.h>
+#include <base/tl/array.h>
+#include <base/tl/threading.h>
 
 class CGraph
 {
@@ -50,6 +52,52 @@ public:
 	void Update(CGraph *pGraph, int64 Target, int TimeLeft, int AdjustDirection);
 };
 
+// hands items from the network thread to the game thread, one producer
+// and one consumer so the indices need no lock
+template<class T, unsigned MAX_ITEMS> // MAX_ITEMS is a power of two, the indices wrap around
+class CNetThreadQueue
+{
+	T m_aItems[MAX_ITEMS];
+	volatile unsigned m_ReadIndex;
+	volatile unsigned m_WriteIndex;
+
+public:
+	CNetThreadQueue() : m_ReadIndex(0), m_WriteIndex(0) {}
+
+	// producer side
+	T *Reserve() { return m_WriteIndex-m_ReadIndex < MAX_ITEMS ? &m_aItems[m_WriteIndex%MAX_ITEMS] : 0; }
+	void Commit() { sync_barrier(); m_WriteIndex++; }
+
+	// consumer side
+	T *Front() { if(m_ReadIndex == m_WriteIndex) return 0; sync_barrier(); return &m_aItems[m_ReadIndex%MAX_ITEMS]; }
+	void Pop() { sync_barrier(); m_ReadIndex++; }
+};
+
+// a packet as received by the network thread
+struct CQueuedPacket
+{
+	int m_NetClient;
+	unsigned m_Generation;
+	int m_Flags;
+	int m_DataSize;
+	int64 m_RecvTime;
+	unsigned char m_aData[NET_MAX_PAYLOAD];
+};
+
+// a snapshot decoded by the network thread
+struct CQueuedSnapshot
+{
+	int m_NetClient;
+	unsigned m_Generation;
+	unsigned m_ReceiverGeneration;
+	int m_GameTick;
+	int m_DeltaTick;
+	int m_Size; // -1 if there is only an error to print
+	int64 m_RecvTime;
+	char m_aData[CSnapshot::MAX_SIZE];
+	char m_aError[256];
+};
+
 class CServerCapabilities
 {
 public:
@@ -82,6 +130,59 @@ class CClient : public IClient, public CDemoPlayer::IListener
 
 	class CNetClient m_NetClient[NUM_CLIENTS];
 	class CNetClient m_ContactClient;
+
+	// network thread, see cl_network_thread. it pumps m_NetClient, decodes
+	// the snapshots and keeps sending inputs while holding m_NetLock, the
+	// game thread takes the lock to touch the connections
+	void *m_pNetThread;
+	volatile bool m_NetThreadShutdown;
+	lock m_NetLock;
+	unsigned m_aNetGeneration[NUM_CLIENTS]; // bumped on (dis)connect to drop stale packets
+	CNetThreadQueue<CQueuedPacket, 256> m_PacketQueue;
+	CNetThreadQueue<CQueuedSnapshot, 8> m_SnapshotQueue;
+	int64 m_PacketRecvTime; // arrival time of the packet being processed
+
+	// connection status, copied under m_NetLock in PumpNetwork
+	int m_aNetState[NUM_CLIENTS];
+	bool m_aNetGotProblems[NUM_CLIENTS];
+	char m_aaNetErrorString[NUM_CLIENTS][256];
+
+	// reassembles and decodes the snapshots of one connection, guarded by m_NetLock
+	struct CSnapshotReceiver
+	{
+		CSnapshotStorage m_DeltaStorage; // decoded snapshots the server can delta against
+		unsigned m_Generation; // bumped on reset to drop queued snapshots
+		unsigned m_Parts;
+		int m_RecvTick;
+		int m_AckGameTick;
+		int m_CrcErrors;
+		char m_aIncomingData[CSnapshot::MAX_SIZE];
+	} m_aSnapshotReceivers[NUM_CLIENTS];
+
+	// delta decoder of the network thread, so its data rate counters don't
+	// race with m_SnapshotDelta of the game thread and the demo player
+	class CSnapshotDelta m_NetSnapshotDelta;
+
+	// the newest input of each connection, guarded by m_NetLock. the network
+	// thread repeats it for every predicted tick the game thread is late for
+	struct CNetInput
+	{
+		int m_aData[MAX_INPUT_SIZE];
+		int m_Size; // 0 if there is nothing to send
+		int64 m_PredictedTime; // m_PredictedTime at m_Time
+		int64 m_Time;
+		int m_LastSentTick;
+
+		// the sent inputs, for NETMSG_INPUTTIMING
+		struct
+		{
+			int m_Tick;
+			int64 m_PredictedTime; // prediction latency when we sent this input
+			int64 m_Time;
+		} m_aSent[200];
+		int m_NextSent;
+	} m_aNetInputs[NUM_CLIENTS];
+
 	class CDemoPlayer m_DemoPlayer;
 	class CDemoRecorder m_DemoRecorder;
 	class CServerBrowser m_ServerBrowser;
@@ -94,7 +195,6 @@ class CClient : public IClient, public CDemoPlayer::IListener
 
 	CUuid m_ConnectionID;
 
-	unsigned m_SnapshotParts[NUM_CLIENTS];
 	int64 m_LocalStartTime;
 
 	int64 m_LastRenderTime;
@@ -104,9 +204,21 @@ class CClient : public IClient, public CDemoPlayer::IListener
 	float m_RenderFrameTimeHigh;
 	int m_RenderFrames;
 
+	// frame pacing, see LimitFps
+	double m_SleepOvershoot;
+	int64 m_PacerStatsStart;
+	int m_PacerFrames;
+	double m_PacerJitterSum;
+	double m_PacerJitterMax;
+	double m_PacerSleepTime;
+	double m_PacerSpinTime;
+	float m_PacerJitterAvg;
+	float m_PacerJitterPeak;
+	float m_PacerSleepShare;
+	float m_PacerSpinShare;
+
 	NETADDR m_ServerAddress;
 	int m_WindowMustRefocus;
-	int m_SnapCrcErrors;
 	bool m_AutoScreenshotRecycle;
 	bool m_AutoStatScreenshotRecycle;
 	bool m_EditorActive;
@@ -114,8 +226,6 @@ class CClient : public IClient, public CDemoPlayer::IListener
 	bool m_ResortServerBrowser;
 	bool m_RecordGameMessage;
 
-	int m_AckGameTick[NUM_CLIENTS];
-	int m_CurrentRecvTick[NUM_CLIENTS];
 	int m_RconAuthed[NUM_CLIENTS];
 	char m_RconPassword[32];
 	int m_UseTempRconCommands;
@@ -163,8 +273,6 @@ class CClient : public IClient, public CDemoPlayer::IListener
 	{
 		int m_aData[MAX_INPUT_SIZE]; // the input data
 		int m_Tick; // the tick that the input is for
-		int64 m_PredictedTime; // prediction latency when we sent this input
-		int64 m_Time;
 	} m_aInputs[NUM_CLIENTS][200];
 
 	int m_CurrentInput[NUM_CLIENTS];
@@ -182,7 +290,6 @@ class CClient : public IClient, public CDemoPlayer::IListener
 	CSnapshotStorage::CHolder *m_aSnapshots[NUM_CLIENTS][NUM_SNAPSHOT_TYPES];
 
 	int m_ReceivedSnapshots[NUM_CLIENTS];
-	char m_aSnapshotIncomingData[CSnapshot::MAX_SIZE];
 
 	class CSnapshotStorage::CHolder m_aDemorecSnapshotHolders[NUM_SNAPSHOT_TYPES];
 	char *m_aDemorecSnapshotData[NUM_SNAPSHOT_TYPES][2][CSnapshot::MAX_SIZE];
@@ -190,6 +297,27 @@ class CClient : public IClient, public CDemoPlayer::IListener
 
 	class CSnapshotDelta m_SnapshotDelta;
 
+	// benchmark, plays a demo at a fixed frame rate and records the cpu time of every frame
+	enum
+	{
+		BENCHMARK_COLUMN_FRAME=0,
+		BENCHMARK_COLUMN_UPDATE,
+		BENCHMARK_COLUMN_RENDER,
+		BENCHMARK_COLUMN_SWAP,
+		NUM_BENCHMARK_ENGINE_COLUMNS,
+		BENCHMARK_MAX_COLUMNS=NUM_BENCHMARK_ENGINE_COLUMNS+64,
+	};
+
+	bool m_Benchmark;
+	char m_aBenchmarkOutput[IO_MAX_PATH_LENGTH];
+	int m_BenchmarkNumColumns;
+	const char *m_apBenchmarkColumns[BENCHMARK_MAX_COLUMNS];
+	array<float> m_BenchmarkSamples; // milliseconds, one row of columns per frame
+
+	void BenchmarkStart(const char *pDemo, int Fps, const char *pOutput);
+	void BenchmarkAddFrame(int64 UpdateTime, int64 RenderTime, int64 SwapTime);
+	void BenchmarkFinish();
+
 	// server capabilities
 	bool m_CanReceiveServerCapabilities;
 	bool m_ServerSentCapabilities;
@@ -314,6 +442,19 @@ public:
 	virtual int MapDownloadAmount() const { return m_MapdownloadAmount; }
 	virtual int MapDownloadTotalsize() const { return m_MapdownloadTotalsize; }
 
+	static void NetworkThread(void *pUser);
+	void StartNetworkThread();
+	void StopNetworkThread();
+	int NetClientState(int NetClient);
+	void ResetSnapshotReceiver(int NetClient);
+	void ResetNetInput(int NetClient);
+	void SendNetInput(int NetClient, int Tick, int64 Now);
+	void SendNetInputs(int64 Now);
+	int DecodeSnapshot(CSnapshotDelta *pSnapshotDelta, int NetClient, int Msg, CUnpacker *pUnpacker, CSnapshot *pSnap, int *pGameTick, int *pDeltaTick, int64 RecvTime, char *pError, int ErrorSize);
+	bool QueueSnapshot(int NetClient, CNetChunk *pPacket, int64 RecvTime);
+	void ReceiveSnapshot(int NetClient, int Msg, CUnpacker *pUnpacker);
+	void ApplySnapshot(int NetClient, int GameTick, int DeltaTick, int64 RecvTime, CSnapshot *pSnap, int SnapSize);
+	void ProcessPacket(CNetChunk *pPacket, int NetClient);
 	void PumpNetwork();
 
 	virtual void OnDemoPlayerSnapshot(void *pData, int Size);
@@ -324,6 +465,8 @@ public:
 	void RegisterInterfaces();
 	void InitInterfaces();
 
+	void PacerSleep(double Seconds);
+	void PacerUpdateStats(double FrameTime);
 	bool LimitFps();
 	void Run();
 
@@ -347,6 +490,7 @@ public:
 	static void Con_Record(IConsole::IResult *pResult, void *pUserData);
 	static void Con_StopRecord(IConsole::IResult *pResult, void *pUserData);
 	static void Con_AddDemoMarker(IConsole::IResult *pResult, void *pUserData);
+	static void Con_Benchmark(IConsole::IResult *pResult, void *pUserData);
 	static void ConchainServerBrowserUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainFullscreen(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainWindowBordered(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
@@ -710,6 +710,153 @@ void CGraphics_Threaded::QuadsDrawFreeform(const CFreeformItem *pArray, int Num)
 	AddVertices(4*Num);
 }
 
+void CGraphics_Threaded::QuadsDrawTiles(const CTileQuadItem *pArray, int Num)
+{
+	dbg_assert(m_Drawing == DRAWING_QUADS, "called Graphics()->QuadsDrawTiles without begin");
+
+	const int TextureArraySize = m_pBackend->GetTextureArraySize();
+	for(int i = 0; i < Num; ++i)
+	{
+		const CTileQuadItem *pItem = &pArray[i];
+
+		// tileset fallback system, may flush the vertices drawn so far
+		if(TextureArraySize > 1 && pItem->m_TextureIndex >= 0)
+			TilesetFallbackSystem(pItem->m_TextureIndex);
+		m_State.m_TextureArrayIndex = m_TextureArrayIndex;
+		m_State.m_Dimension = (pItem->m_TextureIndex < 0) ? 2 : 3;
+
+		const float TexIndex = (0.5f + pItem->m_TextureIndex) / (256.0f/TextureArraySize);
+		const float x0 = pItem->m_Quad.m_X;
+		const float y0 = pItem->m_Quad.m_Y;
+		const float x1 = x0 + pItem->m_Quad.m_Width;
+		const float y1 = y0 + pItem->m_Quad.m_Height;
+		CCommandBuffer::CVertex *pVertices = &m_aVertices[m_NumVertices];
+
+		pVertices[0].m_Pos.x = x0;
+		pVertices[0].m_Pos.y = y0;
+		pVertices[1].m_Pos.x = x1;
+		pVertices[1].m_Pos.y = y0;
+		pVertices[2].m_Pos.x = x1;
+		pVertices[2].m_Pos.y = y1;
+		pVertices[3].m_Pos.x = x0;
+		pVertices[3].m_Pos.y = y1;
+
+		for(int v = 0; v < 4; v++)
+		{
+			pVertices[v].m_Tex.u = pItem->m_aU[v];
+			pVertices[v].m_Tex.v = pItem->m_aV[v];
+			pVertices[v].m_Tex.i = TexIndex;
+			pVertices[v].m_Color = m_aColor[v];
+		}
+
+		AddVertices(4);
+	}
+}
+
+IGraphics::CBufferHandle CGraphics_Threaded::CreateQuadBuffer(const CTileQuadItem *pArray, int Num)
+{
+	if(Num <= 0 || m_FirstFreeBuffer < 0)
+		return CBufferHandle();
+
+	// the texture dimension and the tileset fallback texture are part of the render state,
+	// so they have to be the same for all quads of a buffer
+	const int TextureArraySize = m_pBackend->GetTextureArraySize();
+	const int Dimension = (pArray[0].m_TextureIndex < 0) ? 2 : 3;
+	for(int i = 0; i < Num; ++i)
+	{
+		if(((pArray[i].m_TextureIndex < 0) ? 2 : 3) != Dimension || (pArray[i].m_TextureIndex >= 0 && TextureArraySize > 1))
+			return CBufferHandle();
+	}
+
+	CCommandBuffer::CBufferVertex *pVertices = (CCommandBuffer::CBufferVertex *)mem_alloc(sizeof(CCommandBuffer::CBufferVertex)*4*Num, sizeof(void*));
+	for(int i = 0; i < Num; ++i)
+	{
+		const CTileQuadItem *pItem = &pArray[i];
+		const float TexIndex = (0.5f + pItem->m_TextureIndex) / (256.0f/TextureArraySize);
+		CCommandBuffer::CBufferVertex *pQuad = &pVertices[4*i];
+
+		pQuad[0].m_Pos.x = pItem->m_Quad.m_X;
+		pQuad[0].m_Pos.y = pItem->m_Quad.m_Y;
+		pQuad[1].m_Pos.x = pItem->m_Quad.m_X + pItem->m_Quad.m_Width;
+		pQuad[1].m_Pos.y = pItem->m_Quad.m_Y;
+		pQuad[2].m_Pos.x = pItem->m_Quad.m_X + pItem->m_Quad.m_Width;
+		pQuad[2].m_Pos.y = pItem->m_Quad.m_Y + pItem->m_Quad.m_Height;
+		pQuad[3].m_Pos.x = pItem->m_Quad.m_X;
+		pQuad[3].m_Pos.y = pItem->m_Quad.m_Y + pItem->m_Quad.m_Height;
+
+		for(int v = 0; v < 4; v++)
+		{
+			pQuad[v].m_Tex.u = pItem->m_aU[v];
+			pQuad[v].m_Tex.v = pItem->m_aV[v];
+			pQuad[v].m_Tex.i = TexIndex;
+		}
+	}
+
+	// grab buffer
+	int Buffer = m_FirstFreeBuffer;
+	m_FirstFreeBuffer = m_aBufferIndices[Buffer];
+	m_aBufferIndices[Buffer] = -1;
+	m_aBufferDimensions[Buffer] = Dimension;
+
+	CCommandBuffer::CBufferCreateCommand Cmd;
+	Cmd.m_Slot = Buffer;
+	Cmd.m_NumVertices = 4*Num;
+	Cmd.m_pData = pVertices;
+	if(!m_pCommandBuffer->AddCommand(Cmd))
+	{
+		// kick command buffer and try again
+		KickCommandBuffer();
+		m_pCommandBuffer->AddCommand(Cmd);
+	}
+
+	return CreateBufferHandle(Buffer);
+}
+
+void CGraphics_Threaded::DestroyQuadBuffer(CBufferHandle *pBuffer)
+{
+	if(!pBuffer->IsValid())
+		return;
+
+	CCommandBuffer::CBufferDestroyCommand Cmd;
+	Cmd.m_Slot = pBuffer->Id();
+	if(!m_pCommandBuffer->AddCommand(Cmd))
+	{
+		KickCommandBuffer();
+		m_pCommandBuffer->AddCommand(Cmd);
+	}
+
+	m_aBufferIndices[pBuffer->Id()] = m_FirstFreeBuffer;
+	m_FirstFreeBuffer = pBuffer->Id();
+
+	pBuffer->Invalidate();
+}
+
+void CGraphics_Threaded::QuadsDrawBuffer(CBufferHandle Buffer, int Offset, int Num)
+{
+	dbg_assert(m_Drawing == DRAWING_QUADS, "called Graphics()->QuadsDrawBuffer without begin");
+	if(!Buffer.IsValid() || Num <= 0)
+		return;
+
+	// keep the order with the quads drawn before
+	FlushVertices();
+
+	CCommandBuffer::CRenderBufferCommand Cmd;
+	Cmd.m_State = m_State;
+	Cmd.m_State.m_Dimension = m_aBufferDimensions[Buffer.Id()];
+	Cmd.m_State.m_TextureArrayIndex = 0;
+	Cmd.m_Color = m_aColor[0];
+	Cmd.m_Slot = Buffer.Id();
+	Cmd.m_PrimOffset = Offset;
+	Cmd.m_PrimCount = Num;
+	if(!m_pCommandBuffer->AddCommand(Cmd))
+	{
+		// kick command buffer and try again
+		KickCommandBuffer();
+		if(!m_pCommandBuffer->AddCommand(Cmd))
+			dbg_msg("graphics", "failed to allocate memory for render command");
+	}
+}
+
 void CGraphics_Threaded::QuadsText(float x, float y, float Size, const char *pText)
 {
 	float StartX = x;
@@ -748,6 +895,7 @@ int CGraphics_Threaded::IssueInit()
 	if(m_pConfig->m_GfxHighdpi) Flags |= IGraphicsBackend::INITFLAG_HIGHDPI;
 	if(m_pConfig->m_DbgResizable) Flags |= IGraphicsBackend::INITFLAG_RESIZABLE;
 	if(m_pConfig->m_GfxUseX11XRandRWM) Flags |= IGraphicsBackend::INITFLAG_X11XRANDR;
+	if(m_pConfig->m_GfxVertexBuffers) Flags |= IGraphicsBackend::INITFLAG_VERTEXBUFFERS;
 
 	return m_pBackend->Init("F-Client", &m_pConfig->m_GfxScreen, &m_pConfig->m_GfxScreenWidth,
 			&m_pConfig->m_GfxScreenHeight, &m_ScreenWidth, &m_ScreenHeight, m_pConfig->m_GfxFsaaSamples,
@@ -802,7 +950,13 @@ int CGraphics_Threaded::Init()
 		m_aTextureIndices[i] = i+1;
 	m_aTextureIndices[MAX_TEXTURES-1] = -1;
 
-	m_pBackend = CreateGraphicsBackend();
+	// init buffers
+	m_FirstFreeBuffer = 0;
+	for(int i = 0; i < MAX_BUFFERS-1; i++)
+		m_aBufferIndices[i] = i+1;
+	m_aBufferIndices[MAX_BUFFERS-1] = -1;
+
+	m_pBackend = m_pConfig->m_GfxNullBackend ? CreateGraphicsBackendNull() : CreateGraphicsBackend();
 	if(InitWindow() != 0)
 		return -1;
 
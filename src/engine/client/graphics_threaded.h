@@ -51,6 +51,7 @@ public:
 	enum
 	{
 		MAX_TEXTURES=1024*4,
+		MAX_BUFFERS=1024*4,
 	};
 
 	enum
@@ -74,9 +75,14 @@ public:
 		CMD_TEXTURE_DESTROY,
 		CMD_TEXTURE_UPDATE,
 
+		// retained vertex buffer commands
+		CMD_BUFFER_CREATE,
+		CMD_BUFFER_DESTROY,
+
 		// rendering
 		CMD_CLEAR,
 		CMD_RENDER,
+		CMD_RENDER_BUFFER,
 
 		// swap
 		CMD_SWAP,
@@ -128,6 +134,13 @@ public:
 		CColor m_Color;
 	};
 
+	// vertex of a retained buffer, the color is given when it is drawn
+	struct CBufferVertex
+	{
+		CPoint m_Pos;
+		CTexCoord m_Tex;
+	};
+
 	struct CCommand
 	{
 	public:
@@ -182,6 +195,16 @@ public:
 		CVertex *m_pVertices; // you should use the command buffer data to allocate vertices for this command
 	};
 
+	struct CRenderBufferCommand : public CCommand
+	{
+		CRenderBufferCommand() : CCommand(CMD_RENDER_BUFFER) {}
+		CState m_State;
+		CColor m_Color;
+		int m_Slot;
+		unsigned m_PrimOffset; // quads
+		unsigned m_PrimCount;
+	};
+
 	struct CScreenshotCommand : public CCommand
 	{
 		CScreenshotCommand() : CCommand(CMD_SCREENSHOT) {}
@@ -244,6 +267,22 @@ public:
 		int m_Slot;
 	};
 
+	struct CBufferCreateCommand : public CCommand
+	{
+		CBufferCreateCommand() : CCommand(CMD_BUFFER_CREATE) {}
+
+		int m_Slot;
+		int m_NumVertices;
+		CBufferVertex *m_pData; // will be freed by the command processor
+	};
+
+	struct CBufferDestroyCommand : public CCommand
+	{
+		CBufferDestroyCommand() : CCommand(CMD_BUFFER_DESTROY) {}
+
+		int m_Slot;
+	};
+
 	//
 	CCommandBuffer(unsigned CmdBufferSize, unsigned DataBufferSize)
 	: m_CmdBuffer(CmdBufferSize), m_DataBuffer(DataBufferSize)
@@ -300,6 +339,7 @@ public:
 		INITFLAG_BORDERLESS = 8,
 		INITFLAG_X11XRANDR = 16,
 		INITFLAG_HIGHDPI = 32,
+		INITFLAG_VERTEXBUFFERS = 64,
 	};
 
 	virtual ~IGraphicsBackend() {}
@@ -336,6 +376,7 @@ class CGraphics_Threaded : public IEngineGraphics
 
 		MAX_VERTICES = 32*1024,
 		MAX_TEXTURES = 1024*4,
+		MAX_BUFFERS = 1024*4,
 
 		DRAWING_QUADS=1,
 		DRAWING_LINES=2
@@ -373,6 +414,10 @@ class CGraphics_Threaded : public IEngineGraphics
 	int m_FirstFreeTexture;
 	int m_TextureMemoryUsage;
 
+	int m_aBufferIndices[MAX_BUFFERS];
+	int m_aBufferDimensions[MAX_BUFFERS];
+	int m_FirstFreeBuffer;
+
 	void FlushVertices();
 	void AddVertices(int Count);
 	void Rotate4(const CCommandBuffer::CPoint &rCenter, CCommandBuffer::CVertex *pPoints);
@@ -435,6 +480,11 @@ public:
 	virtual void QuadsDraw(CQuadItem *pArray, int Num);
 	virtual void QuadsDrawTL(const CQuadItem *pArray, int Num);
 	virtual void QuadsDrawFreeform(const CFreeformItem *pArray, int Num);
+	virtual void QuadsDrawTiles(const CTileQuadItem *pArray, int Num);
+
+	virtual CBufferHandle CreateQuadBuffer(const CTileQuadItem *pArray, int Num);
+	virtual void DestroyQuadBuffer(CBufferHandle *pBuffer);
+	virtual void QuadsDrawBuffer(CBufferHandle Buffer, int Offset, int Num);
 	virtual void QuadsText(float x, float y, float Size, const char *pText);
 
 	virtual int GetNumScreens() const;
@@ -465,3 +515,4 @@ public:
 };
 
 extern IGraphicsBackend *CreateGraphicsBackend();
+extern IGraphicsBackend *CreateGraphicsBackendNull();
@@ -18,6 +18,14 @@ extern "C"
 }
 #include <math.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define SOUND_MIX_SSE2 1
+	#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#define SOUND_MIX_NEON 1
+	#include <arm_neon.h>
+#endif
+
 enum
 {
 	NUM_SAMPLES = 512,
@@ -71,7 +79,19 @@ static unsigned m_MaxFrames = 0;
 
 static IOHANDLE s_File;
 
-// TODO: there should be a faster way todo this
+// state of a voice for one mix call, taken under the lock so the mixing itself can run without it
+struct CMixVoice
+{
+	const short *m_pData;
+	int m_Step;
+	unsigned m_Frames;
+	int m_Flags;
+	int m_Vol;
+	int m_X, m_Y;
+};
+
+static CMixVoice m_aMixVoices[NUM_VOICES];	// only used by the thread callback function
+
 static short Int2Short(int i)
 {
 	if(i > 0x7fff)
@@ -81,114 +101,192 @@ static short Int2Short(int i)
 	return i;
 }
 
+// adds Frames frames of the input scaled by the channel volumes to the interleaved stereo output
+static void MixVoice(int *pOut, const short *pIn, int Step, unsigned Frames, int Lvol, int Rvol)
+{
+	unsigned s = 0;
+
+#if defined(SOUND_MIX_SSE2)
+	// 4 frames at a time, the 16 bit products are put together from their low and high halves
+	__m128i Vol = _mm_set_epi16(Rvol, Lvol, Rvol, Lvol, Rvol, Lvol, Rvol, Lvol);
+	for(; s+4 <= Frames; s += 4, pOut += 8)
+	{
+		__m128i In;
+		if(Step == 2)
+			In = _mm_loadu_si128((const __m128i *)(pIn+s*2));
+		else
+		{
+			In = _mm_loadl_epi64((const __m128i *)(pIn+s));
+			In = _mm_unpacklo_epi16(In, In);
+		}
+		__m128i Lo = _mm_mullo_epi16(In, Vol);
+		__m128i Hi = _mm_mulhi_epi16(In, Vol);
+		__m128i *pDst = (__m128i *)pOut;
+		_mm_storeu_si128(pDst, _mm_add_epi32(_mm_loadu_si128(pDst), _mm_unpacklo_epi16(Lo, Hi)));
+		_mm_storeu_si128(pDst+1, _mm_add_epi32(_mm_loadu_si128(pDst+1), _mm_unpackhi_epi16(Lo, Hi)));
+	}
+#elif defined(SOUND_MIX_NEON)
+	const short aVol[4] = {(short)Lvol, (short)Rvol, (short)Lvol, (short)Rvol};
+	int16x4_t Vol = vld1_s16(aVol);
+	for(; s+4 <= Frames; s += 4, pOut += 8)
+	{
+		int16x4_t In0, In1;
+		if(Step == 2)
+		{
+			int16x8_t In = vld1q_s16(pIn+s*2);
+			In0 = vget_low_s16(In);
+			In1 = vget_high_s16(In);
+		}
+		else
+		{
+			int16x4_t In = vld1_s16(pIn+s);
+			int16x4x2_t Zip = vzip_s16(In, In);
+			In0 = Zip.val[0];
+			In1 = Zip.val[1];
+		}
+		vst1q_s32(pOut, vmlal_s16(vld1q_s32(pOut), In0, Vol));
+		vst1q_s32(pOut+4, vmlal_s16(vld1q_s32(pOut+4), In1, Vol));
+	}
+#endif
+
+	// the remaining frames
+	const short *pInL = pIn+s*Step;
+	const short *pInR = pInL+Step-1;
+	for(; s < Frames; s++)
+	{
+		*pOut++ += (*pInL)*Lvol;
+		*pOut++ += (*pInR)*Rvol;
+		pInL += Step;
+		pInR += Step;
+	}
+}
+
+// applies the master volume and clamps the accumulated samples
+static void ConvertMix(short *pFinalOut, const int *pIn, unsigned Frames, int MasterVol)
+{
+	unsigned Samples = Frames*2;
+	unsigned i = 0;
+	const float Scale = MasterVol/(101.0f*256.0f);
+
+#if defined(SOUND_MIX_SSE2)
+	__m128 Scale4 = _mm_set1_ps(Scale);
+	__m128i Min = _mm_set1_epi16(-0x7fff);
+	for(; i+8 <= Samples; i += 8)
+	{
+		__m128i Lo = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(pIn+i))), Scale4));
+		__m128i Hi = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(pIn+i+4))), Scale4));
+		_mm_storeu_si128((__m128i *)(pFinalOut+i), _mm_max_epi16(_mm_packs_epi32(Lo, Hi), Min));
+	}
+#elif defined(SOUND_MIX_NEON)
+	float32x4_t Scale4 = vdupq_n_f32(Scale);
+	int16x8_t Min = vdupq_n_s16(-0x7fff);
+	for(; i+8 <= Samples; i += 8)
+	{
+		int32x4_t Lo = vcvtq_s32_f32(vmulq_f32(vcvtq_f32_s32(vld1q_s32(pIn+i)), Scale4));
+		int32x4_t Hi = vcvtq_s32_f32(vmulq_f32(vcvtq_f32_s32(vld1q_s32(pIn+i+4)), Scale4));
+		vst1q_s16(pFinalOut+i, vmaxq_s16(vcombine_s16(vqmovn_s32(Lo), vqmovn_s32(Hi)), Min));
+	}
+#endif
+
+	for(; i < Samples; i++)
+		pFinalOut[i] = Int2Short((int)(pIn[i]*Scale));
+}
+
 static void Mix(short *pFinalOut, unsigned Frames)
 {
 	int MasterVol;
+	int NumMixVoices = 0;
 	mem_zero(m_pMixBuffer, m_MaxFrames*2*sizeof(int));
 	Frames = min(Frames, m_MaxFrames);
 
-	// aquire lock while we are mixing
+	// take what is needed from the voices and advance them, the lock is only held for that
 	lock_wait(m_SoundLock);
 
 	MasterVol = m_SoundVolume;
+	int CenterX = m_CenterX;
+	int CenterY = m_CenterY;
+	float MaxDistance = m_MaxDistance;
 
 	for(unsigned i = 0; i < NUM_VOICES; i++)
 	{
-		if(m_aVoices[i].m_pSample)
+		CVoice *v = &m_aVoices[i];
+		if(!v->m_pSample)
+			continue;
+
+		// make sure that we don't go outside the sound data
+		unsigned End = v->m_pSample->m_NumFrames-v->m_Tick;
+		if(Frames < End)
+			End = Frames;
+
+		CMixVoice *pMix = &m_aMixVoices[NumMixVoices++];
+		pMix->m_Step = v->m_pSample->m_Channels; // setup input sources
+		pMix->m_pData = &v->m_pSample->m_pData[v->m_Tick*pMix->m_Step];
+		pMix->m_Frames = End;
+		pMix->m_Flags = v->m_Flags;
+		pMix->m_Vol = v->m_pChannel->m_Vol;
+		pMix->m_X = v->m_X;
+		pMix->m_Y = v->m_Y;
+
+		// free voice if not used any more
+		v->m_Tick += End;
+		if(v->m_Tick == v->m_pSample->m_NumFrames)
 		{
-			// mix voice
-			CVoice *v = &m_aVoices[i];
-			int *pOut = m_pMixBuffer;
+			if(v->m_Flags&ISound::FLAG_LOOP)
+				v->m_Tick = 0;
+			else
+				v->m_pSample = 0;
+		}
+	}
 
-			int Step = v->m_pSample->m_Channels; // setup input sources
-			short *pInL = &v->m_pSample->m_pData[v->m_Tick*Step];
-			short *pInR = &v->m_pSample->m_pData[v->m_Tick*Step+1];
+	// release the lock
+	lock_unlock(m_SoundLock);
 
-			unsigned End = v->m_pSample->m_NumFrames-v->m_Tick;
+	for(int i = 0; i < NumMixVoices; i++)
+	{
+		// mix voice
+		const CMixVoice *v = &m_aMixVoices[i];
+		int Rvol = v->m_Vol;
+		int Lvol = v->m_Vol;
 
-			int Rvol = v->m_pChannel->m_Vol;
-			int Lvol = v->m_pChannel->m_Vol;
+		// volume calculation
+		if(v->m_Flags&ISound::FLAG_POS)
+		{
+			int dx = v->m_X - CenterX;
+			int dy = v->m_Y - CenterY;
+			float Dist = sqrtf((float)dx*dx+dy*dy);
+			if(Dist >= 0.0f && Dist < MaxDistance)
+			{
+				// linear falloff
+				float Falloff = 1.0f - Dist/MaxDistance;
 
-			// make sure that we don't go outside the sound data
-			if(Frames < End)
-				End = Frames;
+				// amplitude after falloff
+				float FalloffAmp = v->m_Vol * Falloff;
 
-			// check if we have a mono sound
-			if(v->m_pSample->m_Channels == 1)
-				pInR = pInL;
+				// distribute volume to the channels depending on x difference
+				float Lpan = 0.5f - dx/MaxDistance/2.0f;
+				float Rpan = 1.0f - Lpan;
 
-			// volume calculation
-			if(v->m_Flags&ISound::FLAG_POS)
-			{
-				int dx = v->m_X - m_CenterX;
-				int dy = v->m_Y - m_CenterY;
-				float Dist = sqrtf((float)dx*dx+dy*dy);
-				if(Dist >= 0.0f && Dist < m_MaxDistance)
-				{
-					// linear falloff
-					float Falloff = 1.0f - Dist/m_MaxDistance;
-
-					// amplitude after falloff
-					float FalloffAmp = v->m_pChannel->m_Vol * Falloff;
-
-					// distribute volume to the channels depending on x difference
-					float Lpan = 0.5f - dx/m_MaxDistance/2.0f;
-					float Rpan = 1.0f - Lpan;
-
-					// apply square root to preserve sound power after panning
-					float LampFactor = sqrt(Lpan);
-					float RampFactor = sqrt(Rpan);
-
-					// volume of the channels
-					Lvol = FalloffAmp*LampFactor;
-					Rvol = FalloffAmp*RampFactor;
-				}
-				else
-				{
-					Lvol = 0;
-					Rvol = 0;
-				}
-			}
+				// apply square root to preserve sound power after panning
+				float LampFactor = sqrtf(Lpan);
+				float RampFactor = sqrtf(Rpan);
 
-			// process all frames
-			for(unsigned s = 0; s < End; s++)
-			{
-				*pOut++ += (*pInL)*Lvol;
-				*pOut++ += (*pInR)*Rvol;
-				pInL += Step;
-				pInR += Step;
-				v->m_Tick++;
+				// volume of the channels
+				Lvol = FalloffAmp*LampFactor;
+				Rvol = FalloffAmp*RampFactor;
 			}
-
-			// free voice if not used any more
-			if(v->m_Tick == v->m_pSample->m_NumFrames)
+			else
 			{
-				if(v->m_Flags&ISound::FLAG_LOOP)
-					v->m_Tick = 0;
-				else
-					v->m_pSample = 0;
+				Lvol = 0;
+				Rvol = 0;
 			}
 		}
-	}
 
-
-	// release the lock
-	lock_unlock(m_SoundLock);
-
-	{
-		// clamp accumulated values
-		// TODO: this seams slow
-		for(unsigned i = 0; i < Frames; i++)
-		{
-			int j = i<<1;
-			int vl = ((m_pMixBuffer[j]*MasterVol)/101)>>8;
-			int vr = ((m_pMixBuffer[j+1]*MasterVol)/101)>>8;
-
-			pFinalOut[j] = Int2Short(vl);
-			pFinalOut[j+1] = Int2Short(vr);
-		}
+		if(Lvol || Rvol)
+			MixVoice(m_pMixBuffer, v->m_pData, v->m_Step, v->m_Frames, Lvol, Rvol);
 	}
 
+	ConvertMix(pFinalOut, m_pMixBuffer, Frames, MasterVol);
+
 #if defined(CONF_ARCH_ENDIAN_BIG)
 	swap_endian(pFinalOut, sizeof(short), Frames * 2);
 #endif
@@ -149,8 +149,9 @@ void CGlyphMap::InitTexture(int Width, int Height)
 	m_ActiveAtlasIndex = 0;
 
 	// invalidate all glyphs
-	for(int i = 0; i < m_Glyphs.size(); ++i)
-		m_Glyphs[i].m_pGlyph->m_Rendered = false;
+	for(int i = 0; i < m_NumGlyphSlots; ++i)
+		if(m_pGlyphSlots[i].m_pGlyph)
+			m_pGlyphSlots[i].m_pGlyph->m_Rendered = false;
 
 	int TextureSize = Width*Height;
 
@@ -276,13 +277,21 @@ CGlyphMap::CGlyphMap(IGraphics *pGraphics, FT_Library FtLibrary)
 	m_NumFallbackFaces = 0;
 	m_NumTotalPages = 0;
 
+	mem_zero(m_aapAsciiGlyphs, sizeof(m_aapAsciiGlyphs));
+	m_NumGlyphSlots = MIN_GLYPH_SLOTS;
+	m_NumGlyphs = 0;
+	m_pGlyphSlots = (CGlyphSlot *)mem_alloc(m_NumGlyphSlots*sizeof(CGlyphSlot), 1);
+	mem_zero(m_pGlyphSlots, m_NumGlyphSlots*sizeof(CGlyphSlot));
+	mem_zero(m_aKerningCache, sizeof(m_aKerningCache));
+
 	InitTexture(TEXTURE_SIZE, TEXTURE_SIZE);
 }
 
 CGlyphMap::~CGlyphMap()
 {
-	for(int i = 0; i < m_Glyphs.size(); ++i)
-		delete m_Glyphs[i].m_pGlyph;
+	for(int i = 0; i < m_NumGlyphSlots; ++i)
+		delete m_pGlyphSlots[i].m_pGlyph;
+	mem_free(m_pGlyphSlots);
 
 	for(int i = 0; i < m_NumFtFaces; ++i)
 		FT_Done_Face(m_aFtFaces[i]);
@@ -463,30 +472,71 @@ bool CGlyphMap::RenderGlyph(CGlyph *pGlyph, bool Render)
 	return true;
 }
 
-CGlyph *CGlyphMap::GetGlyph(int Chr, int FontSizeIndex, bool Render)
+void CGlyphMap::InsertGlyph(CGlyph *pGlyph)
 {
-	CGlyphIndex Index;
-	Index.m_FontSizeIndex = FontSizeIndex;
-	Index.m_ID = Chr;
+	// keep the table at most half full
+	if((m_NumGlyphs+1)*2 > m_NumGlyphSlots)
+	{
+		CGlyphSlot *pOldSlots = m_pGlyphSlots;
+		int NumOldSlots = m_NumGlyphSlots;
+		m_NumGlyphSlots *= 2;
+		m_NumGlyphs = 0;
+		m_pGlyphSlots = (CGlyphSlot *)mem_alloc(m_NumGlyphSlots*sizeof(CGlyphSlot), 1);
+		mem_zero(m_pGlyphSlots, m_NumGlyphSlots*sizeof(CGlyphSlot));
+		for(int i = 0; i < NumOldSlots; ++i)
+			if(pOldSlots[i].m_pGlyph)
+				InsertGlyph(pOldSlots[i].m_pGlyph);
+		mem_free(pOldSlots);
+	}
 
-	sorted_array<CGlyphIndex>::range r = ::find_binary(m_Glyphs.all(), Index);
+	unsigned Key = GlyphKey(pGlyph->m_ID, pGlyph->m_FontSizeIndex);
+	unsigned Mask = m_NumGlyphSlots-1;
+	unsigned Slot = HashKey(Key)&Mask;
+	while(m_pGlyphSlots[Slot].m_Key)
+		Slot = (Slot+1)&Mask;
+	m_pGlyphSlots[Slot].m_Key = Key;
+	m_pGlyphSlots[Slot].m_pGlyph = pGlyph;
+	m_NumGlyphs++;
+
+	if(pGlyph->m_ID >= 0 && pGlyph->m_ID < NUM_ASCII_GLYPHS)
+		m_aapAsciiGlyphs[pGlyph->m_FontSizeIndex][pGlyph->m_ID] = pGlyph;
+}
+
+CGlyph *CGlyphMap::GetGlyph(int Chr, int FontSizeIndex, bool Render)
+{
+	CGlyph *pMatch = 0;
+	if(Chr >= 0 && Chr < NUM_ASCII_GLYPHS)
+		pMatch = m_aapAsciiGlyphs[FontSizeIndex][Chr];
+	else
+	{
+		unsigned Key = GlyphKey(Chr, FontSizeIndex);
+		unsigned Mask = m_NumGlyphSlots-1;
+		for(unsigned Slot = HashKey(Key)&Mask; m_pGlyphSlots[Slot].m_Key; Slot = (Slot+1)&Mask)
+		{
+			if(m_pGlyphSlots[Slot].m_Key == Key)
+			{
+				pMatch = m_pGlyphSlots[Slot].m_pGlyph;
+				break;
+			}
+		}
+	}
 
 	// couldn't find glyph, render a new one
-	if(r.empty())
+	if(!pMatch)
 	{
-		Index.m_pGlyph = new CGlyph();
-		Index.m_pGlyph->m_Rendered = false;
-		Index.m_pGlyph->m_ID = Chr;
-		Index.m_pGlyph->m_FontSizeIndex = FontSizeIndex;
-		if(RenderGlyph(Index.m_pGlyph, Render))
+		CGlyph *pGlyph = new CGlyph();
+		pGlyph->m_Rendered = false;
+		pGlyph->m_ID = Chr;
+		pGlyph->m_FontSizeIndex = FontSizeIndex;
+		if(RenderGlyph(pGlyph, Render))
 		{
-			m_Glyphs.add(Index);
-			return Index.m_pGlyph;
+			InsertGlyph(pGlyph);
+			return pGlyph;
 		}
+		delete pGlyph;
 		return NULL;
 	}
 
-	CGlyph *pMatch = r.front().m_pGlyph;
 	if(Render)
 		RenderGlyph(pMatch, true);
 	return pMatch;
@@ -494,18 +544,25 @@ CGlyph *CGlyphMap::GetGlyph(int Chr, int FontSizeIndex, bool Render)
 
 vec2 CGlyphMap::Kerning(CGlyph *pLeft, CGlyph *pRight, int PixelSize)
 {
-	FT_Vector Kerning = {0,0};
+	if(!pLeft || !pRight || !pLeft->m_Face || pLeft->m_Face != pRight->m_Face || !FT_HAS_KERNING(pLeft->m_Face))
+		return vec2(0.0f, 0.0f);
 
-	if(pLeft && pRight && pLeft->m_Face == pRight->m_Face)
-	{
-		FT_Set_Pixel_Sizes(pLeft->m_Face, 0, PixelSize);
-		FT_Get_Kerning(pLeft->m_Face, pLeft->m_ID, pRight->m_ID, FT_KERNING_DEFAULT, &Kerning);
-	}
+	FT_Face Face = pLeft->m_Face;
+	unsigned Hash = HashKey((unsigned)pLeft->m_ID*31 + (unsigned)pRight->m_ID*7 + (unsigned)PixelSize) >> 16;
+	CKerningEntry *pEntry = &m_aKerningCache[Hash&(KERNING_CACHE_SIZE-1)];
+	if(pEntry->m_Face == Face && pEntry->m_Left == pLeft->m_ID && pEntry->m_Right == pRight->m_ID && pEntry->m_PixelSize == PixelSize)
+		return pEntry->m_Kerning;
 
-	vec2 Vec;
-	Vec.x = (float)(Kerning.x>>6);
-	Vec.y = (float)(Kerning.y>>6);
-	return Vec;
+	FT_Vector Kerning = {0,0};
+	FT_Set_Pixel_Sizes(Face, 0, PixelSize);
+	FT_Get_Kerning(Face, pLeft->m_ID, pRight->m_ID, FT_KERNING_DEFAULT, &Kerning);
+
+	pEntry->m_Face = Face;
+	pEntry->m_Left = pLeft->m_ID;
+	pEntry->m_Right = pRight->m_ID;
+	pEntry->m_PixelSize = PixelSize;
+	pEntry->m_Kerning = vec2((float)(Kerning.x>>6), (float)(Kerning.y>>6));
+	return pEntry->m_Kerning;
 }
 
 int CGlyphMap::GetFontSizeIndex(int PixelSize) const
@@ -1055,6 +1112,7 @@ void CTextRender::TextDeferred(CTextCursor *pCursor, const char *pText, int Leng
 		}
 	}
 
+	pCursor->m_QuadsPageCount = -1;
 	TextRefreshGlyphs(pCursor);
 }
 
@@ -1120,8 +1178,55 @@ void CTextRender::TextAdvance(CTextCursor *pCursor, float AdvanceX)
 	pCursor->m_Advance.x = (int)(pCursor->m_Advance.x * ScreenScale.x) / ScreenScale.x;
 }
 
+void CTextRender::TextBuildQuads(CTextCursor *pCursor)
+{
+	int NumQuads = pCursor->m_Glyphs.size();
+	pCursor->m_Quads.set_size(NumQuads);
+
+	int HorizontalAlign = pCursor->m_Align & TEXTALIGN_MASK_HORI;
+	int Line = -1;
+	float LineOffsetX = 0;
+
+	// lines are aligned by their last glyph
+	for(int i = NumQuads - 1; i >= 0; --i)
+	{
+		const CScaledGlyph& rScaled = pCursor->m_Glyphs[i];
+		const CGlyph *pGlyph = rScaled.m_pGlyph;
+		CGlyphQuad *pQuad = &pCursor->m_Quads[i];
+
+		if(Line != rScaled.m_Line)
+		{
+			Line = rScaled.m_Line;
+			if(HorizontalAlign == TEXTALIGN_RIGHT)
+				LineOffsetX = pCursor->m_Width - (rScaled.m_Advance.x + pGlyph->m_AdvanceX * rScaled.m_Size);
+			else if(HorizontalAlign == TEXTALIGN_CENTER)
+				LineOffsetX = (pCursor->m_Width - (rScaled.m_Advance.x + pGlyph->m_AdvanceX * rScaled.m_Size)) / 2.0f;
+			else
+				LineOffsetX = 0;
+		}
+
+		vec2 Position = rScaled.m_Advance + vec2(pGlyph->m_BearingX, pGlyph->m_BearingY) * rScaled.m_Size;
+		pQuad->m_Item.m_Quad = IGraphics::CQuadItem(Position.x, Position.y, pGlyph->m_Width * rScaled.m_Size, pGlyph->m_Height * rScaled.m_Size);
+		pQuad->m_Item.m_aU[0] = pQuad->m_Item.m_aU[3] = pGlyph->m_aUvCoords[0];
+		pQuad->m_Item.m_aU[1] = pQuad->m_Item.m_aU[2] = pGlyph->m_aUvCoords[2];
+		pQuad->m_Item.m_aV[0] = pQuad->m_Item.m_aV[1] = pGlyph->m_aUvCoords[1];
+		pQuad->m_Item.m_aV[2] = pQuad->m_Item.m_aV[3] = pGlyph->m_aUvCoords[3];
+		pQuad->m_Item.m_TextureIndex = -1;
+		pQuad->m_LineOffsetX = LineOffsetX;
+		pQuad->m_AtlasIndex = pGlyph->m_AtlasIndex;
+	}
+
+	pCursor->m_QuadsPageCount = m_pGlyphMap->NumTotalPages();
+	pCursor->m_QuadsAlign = pCursor->m_Align;
+}
+
 void CTextRender::DrawText(CTextCursor *pCursor, vec2 Offset, int Texture, bool IsSecondary, float Alpha, int StartGlyph = 0, int NumGlyphs = -1)
 {
+	enum
+	{
+		MAX_BATCH_QUADS = 128,
+	};
+
 	int NumQuads = pCursor->m_Glyphs.size();
 	if(NumQuads <= 0)
 		return;
@@ -1131,6 +1236,9 @@ void CTextRender::DrawText(CTextCursor *pCursor, vec2 Offset, int Texture, bool
 	
 	int EndGlyphs = StartGlyph + NumGlyphs;
 
+	if(pCursor->m_QuadsPageCount != m_pGlyphMap->NumTotalPages() || pCursor->m_QuadsAlign != pCursor->m_Align || pCursor->m_Quads.size() != NumQuads)
+		TextBuildQuads(pCursor);
+
 	float ScreenX0, ScreenY0, ScreenX1, ScreenY1;
 	int ScreenWidth = Graphics()->ScreenWidth();
 	int ScreenHeight = Graphics()->ScreenHeight();
@@ -1138,39 +1246,28 @@ void CTextRender::DrawText(CTextCursor *pCursor, vec2 Offset, int Texture, bool
 
 	vec2 ScreenScale = vec2(ScreenWidth/(ScreenX1-ScreenX0), ScreenHeight/(ScreenY1-ScreenY0));
 
-	int HorizontalAlign = pCursor->m_Align & TEXTALIGN_MASK_HORI;
 	CTextBoundingBox AlignBox = pCursor->AlignedBoundingBox();
-	vec2 AlignOffset = vec2(AlignBox.x, AlignBox.y);
+	vec2 Anchor = pCursor->m_CursorPos + vec2(AlignBox.x, AlignBox.y);
+	vec2 ScaledOffset = Offset / ScreenScale;
+	float AnchorY = (int)(Anchor.y * ScreenScale.y) / ScreenScale.y + ScaledOffset.y;
 
 	vec4 LastColor = vec4(-1, -1, -1, -1);
 	Graphics()->TextureSet(m_pGlyphMap->GetTexture(Texture));
 	Graphics()->QuadsBegin();
 
-	int Line = -1;
-	vec2 LineOffset = vec2(0, 0);
-	vec2 Anchor = pCursor->m_CursorPos + AlignOffset;
+	// the quads are moved to the anchor and submitted in batches of the same color
+	IGraphics::CTileQuadItem aBatch[MAX_BATCH_QUADS];
+	int NumBatch = 0;
 
-	for(int i = NumQuads - 1; i >= 0; --i)
+	for(int i = min(EndGlyphs, NumQuads) - 1; i >= StartGlyph && i >= 0; --i)
 	{
-		const CScaledGlyph& rScaled = pCursor->m_Glyphs[i];
-		const CGlyph *pGlyph = rScaled.m_pGlyph;
-
-		if(Line != rScaled.m_Line)
-		{
-			Line = rScaled.m_Line;
-			if(HorizontalAlign == TEXTALIGN_RIGHT)
-				LineOffset.x = pCursor->m_Width - (rScaled.m_Advance.x + pGlyph->m_AdvanceX * rScaled.m_Size);
-			else if(HorizontalAlign == TEXTALIGN_CENTER)
-				LineOffset.x = (pCursor->m_Width - (rScaled.m_Advance.x + pGlyph->m_AdvanceX * rScaled.m_Size)) / 2.0f;
-			else
-				LineOffset.x = 0;
-		}
-
-		if(pGlyph->m_AtlasIndex < 0 || i < StartGlyph || i >= EndGlyphs)
+		const CGlyphQuad *pQuad = &pCursor->m_Quads[i];
+		if(pQuad->m_AtlasIndex < 0)
 			continue;
 
-		m_pGlyphMap->TouchPage(pGlyph->m_AtlasIndex);
+		m_pGlyphMap->TouchPage(pQuad->m_AtlasIndex);
 
+		const CScaledGlyph& rScaled = pCursor->m_Glyphs[i];
 		vec4 Color;
 		if(IsSecondary)
 		{
@@ -1183,20 +1280,24 @@ void CTextRender::DrawText(CTextCursor *pCursor, vec2 Offset, int Texture, bool
 			Color = rScaled.m_TextColor;
 		}
 
-		if(Color != LastColor)
+		if(Color != LastColor || NumBatch == MAX_BATCH_QUADS)
 		{
+			if(NumBatch)
+				Graphics()->QuadsDrawTiles(aBatch, NumBatch);
+			NumBatch = 0;
 			Graphics()->SetColor(Color.r, Color.g, Color.b, Color.a * Alpha);
 			LastColor = Color;
 		}
 
-		Graphics()->QuadsSetSubset(pGlyph->m_aUvCoords[0], pGlyph->m_aUvCoords[1], pGlyph->m_aUvCoords[2], pGlyph->m_aUvCoords[3]);
-		
-		float AnchorX = (int)((Anchor.x + LineOffset.x) * ScreenScale.x) / ScreenScale.x; 
-		float AnchorY = (int)((Anchor.y + LineOffset.y) * ScreenScale.y) / ScreenScale.y; 
-		vec2 QuadPosition = vec2(AnchorX, AnchorY) + rScaled.m_Advance + vec2(pGlyph->m_BearingX, pGlyph->m_BearingY) * rScaled.m_Size + Offset / ScreenScale;
-		IGraphics::CQuadItem QuadItem = IGraphics::CQuadItem(QuadPosition.x, QuadPosition.y, pGlyph->m_Width * rScaled.m_Size, pGlyph->m_Height * rScaled.m_Size);
-		Graphics()->QuadsDrawTL(&QuadItem, 1);
+		float AnchorX = (int)((Anchor.x + pQuad->m_LineOffsetX) * ScreenScale.x) / ScreenScale.x;
+		IGraphics::CTileQuadItem *pItem = &aBatch[NumBatch++];
+		*pItem = pQuad->m_Item;
+		pItem->m_Quad.m_X += AnchorX + ScaledOffset.x;
+		pItem->m_Quad.m_Y += AnchorY;
 	}
+
+	if(NumBatch)
+		Graphics()->QuadsDrawTiles(aBatch, NumBatch);
 	Graphics()->QuadsEnd();
 }
 
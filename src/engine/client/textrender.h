@@ -3,7 +3,6 @@
 #ifndef ENGINE_CLIENT_TEXTRENDER_H
 #define ENGINE_CLIENT_TEXTRENDER_H
 
-#include <base/tl/sorted_array.h>
 #include <base/vmath.h>
 #include <engine/textrender.h>
 
@@ -20,6 +19,10 @@ enum
 	NUM_PAGES_PER_DIM = 4, // 16 pages total
 
 	FONT_NAME_SIZE = 128,
+
+	NUM_ASCII_GLYPHS = 128,
+	MIN_GLYPH_SLOTS = 1024, // power of two, grows when half full
+	KERNING_CACHE_SIZE = 4096, // power of two
 };
 
 // TODO: use SDF or MSDF font instead of multiple font sizes
@@ -44,24 +47,19 @@ struct CGlyph
 	float m_aUvCoords[4];
 };
 
-struct CGlyphIndex
+struct CGlyphSlot
 {
-	int m_FontSizeIndex;
-	int m_ID;
+	unsigned m_Key; // codepoint and font size index, 0 if the slot is free
 	CGlyph *m_pGlyph;
+};
 
-	friend bool operator ==(const CGlyphIndex& l, const CGlyphIndex& r)
-	{
-		return l.m_ID == r.m_ID && l.m_FontSizeIndex == r.m_FontSizeIndex;
-	};
-	friend bool operator < (const CGlyphIndex& l, const CGlyphIndex& r)
-	{
-		if (l.m_FontSizeIndex == r.m_FontSizeIndex) return l.m_ID < r.m_ID;
-		return l.m_FontSizeIndex < r.m_FontSizeIndex;
-	};
-	friend bool operator > (const CGlyphIndex& l, const CGlyphIndex& r) { return r < l; };
-	friend bool operator <=(const CGlyphIndex& l, const CGlyphIndex& r) { return !(l > r); };
-	friend bool operator >=(const CGlyphIndex& l, const CGlyphIndex& r) { return !(l < r); };
+struct CKerningEntry
+{
+	FT_Face m_Face;
+	int m_Left;
+	int m_Right;
+	int m_PixelSize;
+	vec2 m_Kerning;
 };
 
 class CGlyphMap
@@ -92,7 +90,16 @@ class CGlyphMap
 	IGraphics::CTextureHandle m_aTextures[2];
 	CAtlas m_aAtlasPages[NUM_PAGES_PER_DIM*NUM_PAGES_PER_DIM];
 	int m_ActiveAtlasIndex;
-	sorted_array<CGlyphIndex> m_Glyphs;
+
+	// glyphs are looked up by codepoint and font size in an open-addressed table,
+	// ascii glyphs additionally go into a flat table per font size
+	CGlyph *m_aapAsciiGlyphs[NUM_FONT_SIZES][NUM_ASCII_GLYPHS];
+	CGlyphSlot *m_pGlyphSlots;
+	int m_NumGlyphSlots;
+	int m_NumGlyphs;
+
+	// kerning only depends on the face, the glyph pair and the pixel size
+	CKerningEntry m_aKerningCache[KERNING_CACHE_SIZE];
 
 	int m_NumTotalPages;
 
@@ -111,6 +118,10 @@ class CGlyphMap
 	void UploadGlyph(int TextureIndex, int PosX, int PosY, int Width, int Height, const unsigned char *pData);
 	bool SetFaceByName(FT_Face *pFace, const char *pFamilyName);
 	int GetCharGlyph(int Chr, FT_Face *pFace);
+
+	static unsigned GlyphKey(int Chr, int FontSizeIndex) { return (unsigned)(Chr*NUM_FONT_SIZES + FontSizeIndex + 1); }
+	static unsigned HashKey(unsigned Key) { return Key * 2654435761u; }
+	void InsertGlyph(CGlyph *pGlyph);
 public:
 	CGlyphMap(IGraphics *pGraphics, FT_Library FtLibrary);
 	~CGlyphMap();
@@ -182,6 +193,7 @@ class CTextRender : public IEngineTextRender
 	CWordWidthHint MakeWord(CTextCursor *pCursor, const char *pText, const char *pEnd, 
 						int FontSizeIndex, float Size, int PixelSize, vec2 ScreenScale);
 	void TextRefreshGlyphs(CTextCursor *pCursor);
+	void TextBuildQuads(CTextCursor *pCursor);
 
 	void DrawText(CTextCursor *pCursor, vec2 Offset, int Texture, bool IsSecondary, float Alpha, int StartGlyph, int NumGlyphs);
 
@@ -95,6 +95,20 @@ public:
 		void Invalidate() { m_Id = -1; }
 	};
 
+	class CBufferHandle
+	{
+		friend class IGraphics;
+		int m_Id;
+	public:
+		CBufferHandle()
+		: m_Id(-1)
+		{}
+
+		bool IsValid() const { return Id() >= 0; }
+		int Id() const { return m_Id; }
+		void Invalidate() { m_Id = -1; }
+	};
+
 	int ScreenWidth() const { return m_ScreenWidth; }
 	int ScreenHeight() const { return m_ScreenHeight; }
 	float ScreenAspect() const { return (float)ScreenWidth()/(float)ScreenHeight(); }
@@ -161,6 +175,20 @@ public:
 			: m_X0(x0), m_Y0(y0), m_X1(x1), m_Y1(y1), m_X2(x2), m_Y2(y2), m_X3(x3), m_Y3(y3) {}
 	};
 	virtual void QuadsDrawFreeform(const CFreeformItem *pArray, int Num) = 0;
+
+	struct CTileQuadItem
+	{
+		CQuadItem m_Quad; // top left corner and size
+		float m_aU[4], m_aV[4]; // texture coordinates of the corners, clockwise from the top left
+		int m_TextureIndex;
+	};
+	virtual void QuadsDrawTiles(const CTileQuadItem *pArray, int Num) = 0;
+
+	// retained quads that stay on the gpu, drawn with the current color
+	// creation fails if the quads need more than one tileset texture
+	virtual CBufferHandle CreateQuadBuffer(const CTileQuadItem *pArray, int Num) = 0;
+	virtual void DestroyQuadBuffer(CBufferHandle *pBuffer) = 0;
+	virtual void QuadsDrawBuffer(CBufferHandle Buffer, int Offset, int Num) = 0;
 	virtual void QuadsText(float x, float y, float Size, const char *pText) = 0;
 
 	struct CColorVertex
@@ -195,6 +223,13 @@ protected:
 		Tex.m_Id = Index;
 		return Tex;
 	}
+
+	inline CBufferHandle CreateBufferHandle(int Index)
+	{
+		CBufferHandle Buffer;
+		Buffer.m_Id = Index;
+		return Buffer;
+	}
 };
 
 class IEngineGraphics : public IGraphics
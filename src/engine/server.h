@@ -81,6 +81,7 @@ public:
 
 	virtual void OnTick() = 0;
 	virtual void OnPreSnap() = 0;
+	virtual void OnSnapShared() = 0; // items every client gets, added once per tick before OnSnap
 	virtual void OnSnap(int ClientID) = 0;
 	virtual void OnPostSnap() = 0;
 
@@ -294,6 +294,9 @@ CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 	m_RconPasswordSet = 0;
 	m_GeneratedRconPassword = 0;
 
+	m_NumEncodedClients = 0;
+	mem_zero(m_apClientSnapshotEncodings, sizeof(m_apClientSnapshotEncodings));
+
 	Init();
 }
 
@@ -534,10 +537,123 @@ int CServer::SendMsg(CMsgPacker *pMsg, int Flags, int ClientID)
 	return 0;
 }
 
+void CServer::CSnapshotEncoding::Encode()
+{
+	// create delta
+	m_DeltaSize = m_pSnapshotDelta->CreateDelta(m_pDeltashot, m_pSnap, m_aDeltaData);
+
+	// compress it
+	m_CompSize = 0;
+	if(m_DeltaSize)
+		m_CompSize = CVariableInt::Compress(m_aDeltaData, m_DeltaSize, m_aCompData, sizeof(m_aCompData));
+}
+
+int CServer::CSnapshotEncoding::EncodeJob(void *pUser)
+{
+	((CSnapshotEncoding *)pUser)->Encode();
+	return 0;
+}
+
+const CServer::CSnapshotEncoding *CServer::FindSnapshotEncoding(const CSnapshotEncoding *pWanted) const
+{
+	for(int e = 0; e < m_NumEncodedClients; e++)
+	{
+		const CSnapshotEncoding *pEncoding = &m_aSnapshotEncodings[m_aEncodedClients[e]];
+		if(pEncoding->m_Crc != pWanted->m_Crc || pEncoding->m_SnapSize != pWanted->m_SnapSize || pEncoding->m_DeltaTick != pWanted->m_DeltaTick)
+			continue;
+
+		// compare the snapshots themselves, the crc is only a sum
+		if(mem_comp(pEncoding->m_pSnap, pWanted->m_pSnap, pWanted->m_SnapSize) != 0)
+			continue;
+
+		// the delta base has to match as well
+		if(pWanted->m_DeltaTick != -1 && (pEncoding->m_DeltashotSize != pWanted->m_DeltashotSize ||
+			mem_comp(pEncoding->m_pDeltashot, pWanted->m_pDeltashot, pWanted->m_DeltashotSize) != 0))
+			continue;
+
+		return pEncoding;
+	}
+
+	return 0;
+}
+
+void CServer::EncodeSnapshots()
+{
+	if(m_SnapshotJobPool.NumThreads() == 0 || m_NumEncodedClients < 2)
+	{
+		for(int e = 0; e < m_NumEncodedClients; e++)
+			m_aSnapshotEncodings[m_aEncodedClients[e]].Encode();
+		return;
+	}
+
+	// delta creation and compression only read the snapshots, fan them out and join before sending
+	CJob *apJobs[MAX_CLIENTS];
+	for(int e = 0; e < m_NumEncodedClients; e++)
+	{
+		CSnapshotEncoding *pEncoding = &m_aSnapshotEncodings[m_aEncodedClients[e]];
+		m_SnapshotJobPool.Add(&pEncoding->m_Job, CSnapshotEncoding::EncodeJob, pEncoding);
+		apJobs[e] = &pEncoding->m_Job;
+	}
+	m_SnapshotJobPool.WaitAll(apJobs, m_NumEncodedClients);
+}
+
+void CServer::SendSnapshotEncoding(int ClientID, const CSnapshotEncoding *pEncoding)
+{
+	if(pEncoding->m_DeltaSize)
+	{
+		const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+		const int NumPackets = (pEncoding->m_CompSize+MaxSize-1)/MaxSize;
+
+		for(int n = 0, Left = pEncoding->m_CompSize; Left > 0; n++)
+		{
+			int Chunk = Left < MaxSize ? Left : MaxSize;
+			Left -= Chunk;
+
+			if(NumPackets == 1)
+			{
+				CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
+				Msg.AddInt(m_CurrentGameTick);
+				Msg.AddInt(m_CurrentGameTick-pEncoding->m_DeltaTick);
+				Msg.AddInt(pEncoding->m_Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pEncoding->m_aCompData[n*MaxSize], Chunk);
+				SendMsg(&Msg, MSGFLAG_FLUSH, ClientID);
+			}
+			else
+			{
+				CMsgPacker Msg(NETMSG_SNAP, true);
+				Msg.AddInt(m_CurrentGameTick);
+				Msg.AddInt(m_CurrentGameTick-pEncoding->m_DeltaTick);
+				Msg.AddInt(NumPackets);
+				Msg.AddInt(n);
+				Msg.AddInt(pEncoding->m_Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pEncoding->m_aCompData[n*MaxSize], Chunk);
+				SendMsg(&Msg, MSGFLAG_FLUSH, ClientID);
+			}
+		}
+	}
+	else
+	{
+		CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
+		Msg.AddInt(m_CurrentGameTick);
+		Msg.AddInt(m_CurrentGameTick-pEncoding->m_DeltaTick);
+		SendMsg(&Msg, MSGFLAG_FLUSH, ClientID);
+	}
+}
+
 void CServer::DoSnapshot()
 {
 	GameServer()->OnPreSnap();
 
+	// build the items that are the same for everybody once,
+	// the snapshots below only add their own items to them
+	char aSharedData[CSnapshot::MAX_SIZE];
+	CSnapshot *pSharedSnap = (CSnapshot*)aSharedData;
+	m_SnapshotBuilder.Init();
+	GameServer()->OnSnapShared();
+	m_SnapshotBuilder.Finish(pSharedSnap);
+
 	// create snapshot for demo recording
 	if(m_DemoRecorder.IsRecording())
 	{
@@ -545,7 +661,7 @@ void CServer::DoSnapshot()
 		int SnapshotSize;
 
 		// build snap and possibly add some messages
-		m_SnapshotBuilder.Init();
+		m_SnapshotBuilder.Init(pSharedSnap);
 		GameServer()->OnSnap(-1);
 		SnapshotSize = m_SnapshotBuilder.Finish(aData);
 
@@ -554,8 +670,13 @@ void CServer::DoSnapshot()
 	}
 
 	// create snapshots for all clients
+	static CSnapshot EmptySnap;
+	EmptySnap.Clear();
+	m_NumEncodedClients = 0;
 	for(int i = 0; i < MAX_CLIENTS; i++)
 	{
+		m_apClientSnapshotEncodings[i] = 0;
+
 		// client must be ingame to receive snapshots
 		if(m_aClients[i].m_State != CClient::STATE_INGAME)
 			continue;
@@ -571,98 +692,72 @@ void CServer::DoSnapshot()
 		{
 			char aData[CSnapshot::MAX_SIZE];
 			CSnapshot *pData = (CSnapshot*)aData;	// Fix compiler warning for strict-aliasing
-			char aDeltaData[CSnapshot::MAX_SIZE];
-			char aCompData[CSnapshot::MAX_SIZE];
-			int SnapshotSize;
-			int Crc;
-			static CSnapshot EmptySnap;
-			CSnapshot *pDeltashot = &EmptySnap;
-			int DeltashotSize;
-			int DeltaTick = -1;
-			int DeltaSize;
-
-			m_SnapshotBuilder.Init();
+			CSnapshotEncoding *pEncoding = &m_aSnapshotEncodings[i];
+
+			m_SnapshotBuilder.Init(pSharedSnap);
 
 			GameServer()->OnSnap(i);
 
 			// finish snapshot
-			SnapshotSize = m_SnapshotBuilder.Finish(pData);
-			Crc = pData->Crc();
+			pEncoding->m_SnapSize = m_SnapshotBuilder.Finish(pData);
+			pEncoding->m_Crc = pData->Crc();
 
 			// remove old snapshos
 			// keep 3 seconds worth of snapshots
 			m_aClients[i].m_Snapshots.PurgeUntil(m_CurrentGameTick-SERVER_TICK_SPEED*3);
 
 			// save it the snapshot
-			m_aClients[i].m_Snapshots.Add(m_CurrentGameTick, time_get(), SnapshotSize, pData, 0);
+			m_aClients[i].m_Snapshots.Add(m_CurrentGameTick, time_get(), pEncoding->m_SnapSize, pData, 0);
+			m_aClients[i].m_Snapshots.Get(m_CurrentGameTick, 0, &pEncoding->m_pSnap, 0);
 
 			// find snapshot that we can perform delta against
-			EmptySnap.Clear();
-
 			{
-				DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, 0, &pDeltashot, 0);
-				if(DeltashotSize >= 0)
-					DeltaTick = m_aClients[i].m_LastAckedSnapshot;
+				CSnapshot *pDeltashot;
+				pEncoding->m_DeltaTick = -1;
+				pEncoding->m_DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, 0, &pDeltashot, 0);
+				if(pEncoding->m_DeltashotSize >= 0)
+				{
+					pEncoding->m_DeltaTick = m_aClients[i].m_LastAckedSnapshot;
+					pEncoding->m_pDeltashot = pDeltashot;
+				}
 				else
 				{
+					pEncoding->m_pDeltashot = &EmptySnap;
+
 					// no acked package found, force client to recover rate
 					if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_FULL)
 						m_aClients[i].m_SnapRate = CClient::SNAPRATE_RECOVER;
 				}
 			}
 
-			// create delta
-			DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
-
-			if(DeltaSize)
-			{
-				// compress it
-				int SnapshotSize;
-				const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
-				int NumPackets;
-
-				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData, sizeof(aCompData));
-				NumPackets = (SnapshotSize+MaxSize-1)/MaxSize;
-
-				for(int n = 0, Left = SnapshotSize; Left > 0; n++)
-				{
-					int Chunk = Left < MaxSize ? Left : MaxSize;
-					Left -= Chunk;
+			// reuse the encoding of a client that got the same snapshot against the same base
+			const CSnapshotEncoding *pShared = 0;
+			if(Config()->m_SvSnapshotCache)
+				pShared = FindSnapshotEncoding(pEncoding);
 
-					if(NumPackets == 1)
-					{
-						CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick-DeltaTick);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n*MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-					else
-					{
-						CMsgPacker Msg(NETMSG_SNAP, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick-DeltaTick);
-						Msg.AddInt(NumPackets);
-						Msg.AddInt(n);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n*MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-				}
-			}
+			if(pShared)
+				m_apClientSnapshotEncodings[i] = pShared;
 			else
 			{
-				CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
-				Msg.AddInt(m_CurrentGameTick);
-				Msg.AddInt(m_CurrentGameTick-DeltaTick);
-				SendMsg(&Msg, MSGFLAG_FLUSH, i);
+				pEncoding->m_pSnapshotDelta = &m_SnapshotDelta;
+				m_aEncodedClients[m_NumEncodedClients++] = i;
+				m_apClientSnapshotEncodings[i] = pEncoding;
 			}
 		}
 	}
 
+	// create deltas and compress them
+	EncodeSnapshots();
+
+	// send them out
+	m_NetServer.BeginSendBatch();
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(m_apClientSnapshotEncodings[i])
+			SendSnapshotEncoding(i, m_apClientSnapshotEncodings[i]);
+	}
+	m_NetServer.EndSendBatch();
+
 	GameServer()->OnPostSnap();
 }
 
@@ -1208,7 +1303,8 @@ void CServer::PumpNetwork()
 
 	m_NetServer.Update();
 
-	// process packets
+	// process packets, replies go out together afterwards
+	m_NetServer.BeginSendBatch();
 	while(m_NetServer.Recv(&Packet, &ResponseToken))
 	{
 		if(Packet.m_Flags&NETSENDFLAG_CONNLESS)
@@ -1240,6 +1336,7 @@ void CServer::PumpNetwork()
 		else
 			ProcessClientPacket(&Packet);
 	}
+	m_NetServer.EndSendBatch();
 
 	m_ServerBan.Update();
 	m_Econ.Update();
@@ -1349,6 +1446,9 @@ int CServer::Run()
 	}
 	m_MapChunksPerRequest = Config()->m_SvMapDownloadSpeed;
 
+	// start snapshot encoding workers
+	m_SnapshotJobPool.Init(Config()->m_SvSnapshotThreads);
+
 	// start server
 	NETADDR BindAddr;
 	if(Config()->m_Bindaddr[0] && net_host_lookup(Config()->m_Bindaddr, &BindAddr, NETTYPE_ALL) == 0)
@@ -1588,6 +1688,29 @@ void CServer::ConStatus(IConsole::IResult *pResult, void *pUser)
 	}
 }
 
+void CServer::ConSnapshotMemory(IConsole::IResult *pResult, void *pUser)
+{
+	char aBuf[256];
+	CServer* pThis = static_cast<CServer *>(pUser);
+	int TotalUsed = 0;
+	int TotalAllocated = 0;
+
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		const CSnapshotStorage *pSnapshots = &pThis->m_aClients[i].m_Snapshots;
+		if(pThis->m_aClients[i].m_State == CClient::STATE_EMPTY && !pSnapshots->AllocatedSize())
+			continue;
+
+		str_format(aBuf, sizeof(aBuf), "id=%d used=%dk allocated=%dk", i, pSnapshots->UsedSize()/1024, pSnapshots->AllocatedSize()/1024);
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+		TotalUsed += pSnapshots->UsedSize();
+		TotalAllocated += pSnapshots->AllocatedSize();
+	}
+
+	str_format(aBuf, sizeof(aBuf), "snapshot storage total: used=%dk allocated=%dk", TotalUsed/1024, TotalAllocated/1024);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+}
+
 void CServer::ConShutdown(IConsole::IResult *pResult, void *pUser)
 {
 	((CServer *)pUser)->m_RunServer = false;
@@ -1767,6 +1890,7 @@ void CServer::RegisterCommands()
 	// register console commands
 	Console()->Register("kick", "i[id] ?r[reason]", CFGFLAG_SERVER, ConKick, this, "Kick player with specified id for any reason");
 	Console()->Register("status", "", CFGFLAG_SERVER, ConStatus, this, "List players");
+	Console()->Register("snapshot_memory", "", CFGFLAG_SERVER, ConSnapshotMemory, this, "Show the memory used to store snapshots per player");
 	Console()->Register("shutdown", "", CFGFLAG_SERVER, ConShutdown, this, "Shut down");
 	Console()->Register("logout", "", CFGFLAG_SERVER|CFGFLAG_BASICACCESS, ConLogout, this, "Logout of rcon");
 
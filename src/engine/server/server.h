@@ -4,6 +4,7 @@
 #define ENGINE_SERVER_SERVER_H
 
 #include <engine/server.h>
+#include <engine/shared/jobs.h>
 #include <engine/shared/memheap.h>
 
 class CSnapIDPool
@@ -144,6 +145,36 @@ public:
 
 	CSnapshotDelta m_SnapshotDelta;
 	CSnapshotBuilder m_SnapshotBuilder;
+
+	// encoded snapshot of each client for the current tick,
+	// clients with identical snapshots and delta bases share one encoding
+	class CSnapshotEncoding
+	{
+	public:
+		CJob m_Job;
+		CSnapshotDelta *m_pSnapshotDelta;
+		CSnapshot *m_pSnap;
+		const CSnapshot *m_pDeltashot;
+
+		int m_Crc;
+		int m_SnapSize;
+		int m_DeltashotSize;
+		int m_DeltaTick;
+		int m_DeltaSize;
+		int m_CompSize;
+		char m_aDeltaData[CSnapshot::MAX_SIZE];
+		char m_aCompData[CSnapshot::MAX_SIZE];
+
+		void Encode();
+		static int EncodeJob(void *pUser);
+	};
+
+	CSnapshotEncoding m_aSnapshotEncodings[MAX_CLIENTS];
+	const CSnapshotEncoding *m_apClientSnapshotEncodings[MAX_CLIENTS];
+	int m_aEncodedClients[MAX_CLIENTS];
+	int m_NumEncodedClients;
+	CJobPool m_SnapshotJobPool;
+
 	CSnapIDPool m_IDPool;
 	CNetServer m_NetServer;
 	CEcon m_Econ;
@@ -227,6 +258,9 @@ public:
 
 	virtual int SendMsg(CMsgPacker *pMsg, int Flags, int ClientID);
 
+	const CSnapshotEncoding *FindSnapshotEncoding(const CSnapshotEncoding *pWanted) const;
+	void EncodeSnapshots();
+	void SendSnapshotEncoding(int ClientID, const CSnapshotEncoding *pEncoding);
 	void DoSnapshot();
 
 	static int NewClientCallback(int ClientID, void *pUser);
@@ -263,6 +297,7 @@ public:
 
 	static void ConKick(IConsole::IResult *pResult, void *pUser);
 	static void ConStatus(IConsole::IResult *pResult, void *pUser);
+	static void ConSnapshotMemory(IConsole::IResult *pResult, void *pUser);
 	static void ConShutdown(IConsole::IResult *pResult, void *pUser);
 	static void ConRecord(IConsole::IResult *pResult, void *pUser);
 	static void ConStopRecord(IConsole::IResult *pResult, void *pUser);
@@ -30,6 +30,20 @@ unsigned char *CVariableInt::Pack(unsigned char *pDst, int i)
 	return pDst;
 }
 
+int CVariableInt::PackedSize(int i)
+{
+	// same as the length of Pack's output
+	i = i^(i>>31); // if(i<0) i = ~i
+	i >>= 6;
+	int Size = 1;
+	while(i)
+	{
+		Size++;
+		i >>= 7;
+	}
+	return Size;
+}
+
 const unsigned char *CVariableInt::Unpack(const unsigned char *pSrc, int *pInOut)
 {
 	int Sign = (*pSrc>>6)&1;
@@ -7,6 +7,7 @@ class CVariableInt
 {
 public:
 	static unsigned char *Pack(unsigned char *pDst, int i);
+	static int PackedSize(int i);
 	static const unsigned char *Unpack(const unsigned char *pSrc, int *pInOut);
 	static long Compress(const void *pSrc, int SrcSize, void *pDst, int DstSize);
 	static long Decompress(const void *pSrc, int SrcSize, void *pDst, int DstSize);
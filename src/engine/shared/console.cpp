@@ -58,6 +58,38 @@ const IConsole::CCommandInfo *CConsole::FirstCommandInfo(int AccessLevel, int Fl
 	return 0;
 }
 
+// returns the end of the command pStr starts with and where the next one starts, if there is one
+static const char *FindPartEnd(const char *pStr, const char **ppNextPart)
+{
+	const char *pEnd = pStr;
+	int InString = 0;
+	*ppNextPart = 0;
+
+	while(*pEnd)
+	{
+		if(*pEnd == '"')
+			InString ^= 1;
+		else if(*pEnd == '\\') // escape sequences
+		{
+			if(pEnd[1] == '"')
+				pEnd++;
+		}
+		else if(!InString)
+		{
+			if(*pEnd == ';') // command separator
+			{
+				*ppNextPart = pEnd+1;
+				break;
+			}
+			else if(*pEnd == '#') // comment, no need to do anything more
+				break;
+		}
+
+		pEnd++;
+	}
+	return pEnd;
+}
+
 // the maximum number of tokens occurs in a string of length CONSOLE_MAX_STR_LENGTH with tokens size 1 separated by single spaces
 
 
@@ -300,32 +332,8 @@ bool CConsole::LineIsValid(const char *pStr)
 	do
 	{
 		CResult Result;
-		const char *pEnd = pStr;
-		const char *pNextPart = 0;
-		int InString = 0;
-
-		while(*pEnd)
-		{
-			if(*pEnd == '"')
-				InString ^= 1;
-			else if(*pEnd == '\\') // escape sequences
-			{
-				if(pEnd[1] == '"')
-					pEnd++;
-			}
-			else if(!InString)
-			{
-				if(*pEnd == ';') // command separator
-				{
-					pNextPart = pEnd+1;
-					break;
-				}
-				else if(*pEnd == '#') // comment, no need to do anything more
-					break;
-			}
-
-			pEnd++;
-		}
+		const char *pNextPart;
+		const char *pEnd = FindPartEnd(pStr, &pNextPart);
 
 		if(ParseStart(&Result, pStr, (pEnd-pStr) + 1) != 0)
 			return false;
@@ -341,38 +349,159 @@ bool CConsole::LineIsValid(const char *pStr)
 	return true;
 }
 
-void CConsole::ExecuteLineStroked(int Stroke, const char *pStr)
+void CConsole::ExecuteCommand(CCommand *pCommand, CResult *pResult)
 {
-	while(pStr && *pStr)
+	if(m_StoreCommands && pCommand->m_Flags&CFGFLAG_STORE)
+	{
+		m_ExecutionQueue.AddEntry();
+		m_ExecutionQueue.m_pLast->m_pCommand = pCommand;
+		m_ExecutionQueue.m_pLast->m_Result = *pResult;
+	}
+	else
+		pCommand->m_pfnCallback(pResult, pCommand->m_pUserData);
+}
+
+bool CConsole::CacheLinePart(CCachedPart *pPart, CCommand *pCommand, const CResult *pResult)
+{
+	if(pResult->NumArguments() > LINE_CACHE_ARGS)
+		return false;
+
+	// the line is shorter than the cache storage, so are all tokens taken from it
+	pPart->m_pCommand = pCommand;
+	pPart->m_Command = pResult->m_pCommand - pResult->m_aStringStorage;
+	pPart->m_NumArgs = pResult->NumArguments();
+	for(int i = 0; i < pPart->m_NumArgs; i++)
+	{
+		int Offset = pResult->m_apArgs[i] - pResult->m_aStringStorage;
+		if(Offset >= 0 && Offset < LINE_CACHE_LENGTH)
+			pPart->m_aArgs[i] = Offset;
+		else
+			pPart->m_aArgs[i] = LINE_CACHE_STROKE_ARG;
+	}
+	mem_copy(pPart->m_aStorage, pResult->m_aStringStorage, sizeof(pPart->m_aStorage));
+	return true;
+}
+
+CConsole::CCachedLine *CConsole::CacheLine(int Stroke, const char *pStr)
+{
+	if(str_length(pStr) >= LINE_CACHE_LENGTH)
+		return 0;
+
+	if(!m_pLineCache)
+	{
+		m_pLineCache = static_cast<CCachedLine *>(mem_alloc(LINE_CACHE_SIZE*sizeof(CCachedLine), sizeof(void*)));
+		mem_zero(m_pLineCache, LINE_CACHE_SIZE*sizeof(CCachedLine));
+	}
+
+	unsigned Hash = str_quickhash(pStr) ^ (Stroke ? 0x9e3779b9u : 0u) ^ (unsigned)m_FlagMask*0x85ebca6bu;
+	CCachedLine *pLine = &m_pLineCache[Hash%LINE_CACHE_SIZE];
+	if(LineCacheValid(pLine, pLine->m_ID) && pLine->m_Hash == Hash && pLine->m_Stroke == Stroke &&
+		pLine->m_FlagMask == m_FlagMask && str_comp(pLine->m_aLine, pStr) == 0)
+		return pLine;
+
+	// split and parse the line like ExecuteLineUncached does, but without running anything.
+	// anything that prints an error is left to the uncached path
+	pLine->m_ID = ++m_LineCacheCounter;
+	pLine->m_Hash = Hash;
+	pLine->m_Stroke = Stroke;
+	pLine->m_FlagMask = m_FlagMask;
+	pLine->m_NumParts = 0;
+	str_copy(pLine->m_aLine, pStr, sizeof(pLine->m_aLine));
+
+	const char *pPart = pStr;
+	while(pPart && *pPart)
 	{
 		CResult Result;
-		const char *pEnd = pStr;
-		const char *pNextPart = 0;
-		int InString = 0;
+		const char *pNextPart;
+		const char *pEnd = FindPartEnd(pPart, &pNextPart);
 
-		while(*pEnd)
+		if(ParseStart(&Result, pPart, (pEnd-pPart) + 1) != 0)
 		{
-			if(*pEnd == '"')
-				InString ^= 1;
-			else if(*pEnd == '\\') // escape sequences
-			{
-				if(pEnd[1] == '"')
-					pEnd++;
-			}
-			else if(!InString)
+			pLine->m_NumParts = -1;
+			break;
+		}
+		if(!*Result.m_pCommand)
+			break;
+
+		CCommand *pCommand = FindCommand(Result.m_pCommand, m_FlagMask);
+		int IsStrokeCommand = Result.m_pCommand[0] == '+';
+		if(pCommand && (Stroke || IsStrokeCommand))
+		{
+			if(IsStrokeCommand)
+				Result.AddArgument(m_paStrokeStr[Stroke]);
+
+			CCachedPart *pCachedPart = &pLine->m_aParts[pLine->m_NumParts];
+			if(pLine->m_NumParts == LINE_CACHE_PARTS || ParseArgs(&Result, pCommand->m_pParams) || !CacheLinePart(pCachedPart, pCommand, &Result))
 			{
-				if(*pEnd == ';') // command separator
-				{
-					pNextPart = pEnd+1;
-					break;
-				}
-				else if(*pEnd == '#') // comment, no need to do anything more
-					break;
+				pLine->m_NumParts = -1;
+				break;
 			}
+			pCachedPart->m_NextPart = pNextPart ? pNextPart-pStr : -1;
+			pLine->m_NumParts++;
+		}
+		else if(!pCommand && Stroke)
+		{
+			pLine->m_NumParts = -1;
+			break;
+		}
+
+		pPart = pNextPart;
+	}
+
+	return pLine;
+}
+
+void CConsole::ExecuteLineStroked(int Stroke, const char *pStr)
+{
+	CCachedLine *pLine = CacheLine(Stroke, pStr);
+	if(!pLine || pLine->m_NumParts < 0)
+	{
+		ExecuteLineUncached(Stroke, pStr);
+		return;
+	}
 
-			pEnd++;
+	// a nested line can take over the cache entry while a command runs, so don't read its part count again
+	unsigned ID = pLine->m_ID;
+	int NumParts = pLine->m_NumParts;
+	for(int i = 0; i < NumParts; i++)
+	{
+		const CCachedPart *pPart = &pLine->m_aParts[i];
+		int NextPart = pPart->m_NextPart;
+
+		CResult Result;
+		mem_copy(Result.m_aStringStorage, pPart->m_aStorage, sizeof(pPart->m_aStorage));
+		Result.m_pCommand = Result.m_aStringStorage + pPart->m_Command;
+		for(int a = 0; a < pPart->m_NumArgs; a++)
+			Result.AddArgument(pPart->m_aArgs[a] == LINE_CACHE_STROKE_ARG ? m_paStrokeStr[Stroke] : Result.m_aStringStorage + pPart->m_aArgs[a]);
+		Result.m_pArgsStart = Result.m_aStringStorage + pPart->m_Command;
+
+		if(pPart->m_pCommand->GetAccessLevel() >= m_AccessLevel)
+			ExecuteCommand(pPart->m_pCommand, &Result);
+		else if(Stroke)
+		{
+			char aBuf[256];
+			str_format(aBuf, sizeof(aBuf), "Access for command %s denied.", Result.m_pCommand);
+			Print(OUTPUT_LEVEL_STANDARD, "console", aBuf);
 		}
 
+		// the command might have changed the commands or reused the cache entry, parse the rest then
+		if(i+1 < NumParts && !LineCacheValid(pLine, ID))
+		{
+			if(NextPart >= 0)
+				ExecuteLineUncached(Stroke, pStr+NextPart);
+			return;
+		}
+	}
+}
+
+void CConsole::ExecuteLineUncached(int Stroke, const char *pStr)
+{
+	while(pStr && *pStr)
+	{
+		CResult Result;
+		const char *pNextPart;
+		const char *pEnd = FindPartEnd(pStr, &pNextPart);
+
 		if(ParseStart(&Result, pStr, (pEnd-pStr) + 1) != 0)
 			return;
 
@@ -401,14 +530,8 @@ void CConsole::ExecuteLineStroked(int Stroke, const char *pStr)
 						str_format(aBuf, sizeof(aBuf), "Invalid arguments... Usage: %s %s", pCommand->m_pName, pCommand->m_pParams);
 						Print(OUTPUT_LEVEL_STANDARD, "console", aBuf);
 					}
-					else if(m_StoreCommands && pCommand->m_Flags&CFGFLAG_STORE)
-					{
-						m_ExecutionQueue.AddEntry();
-						m_ExecutionQueue.m_pLast->m_pCommand = pCommand;
-						m_ExecutionQueue.m_pLast->m_Result = Result;
-					}
 					else
-						pCommand->m_pfnCallback(&Result, pCommand->m_pUserData);
+						ExecuteCommand(pCommand, &Result);
 				}
 			}
 			else if(Stroke)
@@ -457,9 +580,41 @@ int CConsole::PossibleMaps(const char *pStr, FPossibleCallback pfnCallback, void
 	return Index;
 }
 
+unsigned CConsole::CommandHash(const char *pName)
+{
+	unsigned Hash = 5381;
+	for(; *pName; pName++)
+	{
+		unsigned char c = *pName;
+		if(c >= 'A' && c <= 'Z')
+			c += 'a'-'A';
+		Hash = Hash*33 + c;
+	}
+	return Hash%COMMAND_HASH_SIZE;
+}
+
+void CConsole::AddCommandHash(CCommand *pCommand)
+{
+	unsigned Hash = CommandHash(pCommand->m_pName);
+	pCommand->m_pNextHash = m_apCommandHash[Hash];
+	m_apCommandHash[Hash] = pCommand;
+}
+
+void CConsole::RemoveCommandHash(CCommand *pCommand)
+{
+	for(CCommand **ppCommand = &m_apCommandHash[CommandHash(pCommand->m_pName)]; *ppCommand; ppCommand = &(*ppCommand)->m_pNextHash)
+	{
+		if(*ppCommand == pCommand)
+		{
+			*ppCommand = pCommand->m_pNextHash;
+			return;
+		}
+	}
+}
+
 CConsole::CCommand *CConsole::FindCommand(const char *pName, int FlagMask)
 {
-	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	for(CCommand *pCommand = m_apCommandHash[CommandHash(pName)]; pCommand; pCommand = pCommand->m_pNextHash)
 	{
 		if(pCommand->m_Flags&FlagMask && str_comp_nocase(pCommand->m_pName, pName) == 0)
 		{
@@ -808,6 +963,10 @@ CConsole::CConsole(int FlagMask)
 	m_pLastMapEntry = 0;
 	m_ExecutionQueue.Reset();
 	m_pFirstCommand = 0;
+	mem_zero(m_apCommandHash, sizeof(m_apCommandHash));
+	m_pLineCache = 0;
+	m_LineCacheCounter = 0;
+	m_LineCacheValidFrom = 1;
 	m_pFirstExec = 0;
 	mem_zero(m_aPrintCB, sizeof(m_aPrintCB));
 	m_NumPrintCB = 0;
@@ -845,6 +1004,7 @@ CConsole::~CConsole()
 		delete m_pTempMapListHeap;
 		m_pTempMapListHeap = 0;
 	}
+	mem_free(m_pLineCache);
 }
 
 void CConsole::Init()
@@ -905,6 +1065,9 @@ void CConsole::ParseArguments(int NumArgs, const char **ppArguments)
 
 void CConsole::AddCommandSorted(CCommand *pCommand)
 {
+	AddCommandHash(pCommand);
+	InvalidateLineCache();
+
 	if(!m_pFirstCommand || str_comp(pCommand->m_pName, m_pFirstCommand->m_pName) <= 0)
 	{
 		if(m_pFirstCommand && m_pFirstCommand->m_pNext)
@@ -949,6 +1112,8 @@ void CConsole::Register(const char *pName, const char *pParams,
 
 	if(DoAdd)
 		AddCommandSorted(pCommand);
+	else
+		InvalidateLineCache();
 }
 
 void CConsole::RegisterTemp(const char *pName, const char *pParams,	int Flags, const char *pHelp)
@@ -1012,6 +1177,8 @@ void CConsole::DeregisterTemp(const char *pName)
 	// add to recycle list
 	if(pRemoved)
 	{
+		RemoveCommandHash(pRemoved);
+		InvalidateLineCache();
 		pRemoved->m_pNext = m_pRecycleList;
 		m_pRecycleList = pRemoved;
 	}
@@ -1019,6 +1186,19 @@ void CConsole::DeregisterTemp(const char *pName)
 
 void CConsole::DeregisterTempAll()
 {
+	// drop temp entries from the index
+	for(int i = 0; i < COMMAND_HASH_SIZE; i++)
+	{
+		for(CCommand **ppCommand = &m_apCommandHash[i]; *ppCommand;)
+		{
+			if((*ppCommand)->m_Temp)
+				*ppCommand = (*ppCommand)->m_pNextHash;
+			else
+				ppCommand = &(*ppCommand)->m_pNextHash;
+		}
+	}
+	InvalidateLineCache();
+
 	// set non temp as first one
 	for(; m_pFirstCommand && m_pFirstCommand->m_Temp; m_pFirstCommand = m_pFirstCommand->m_pNext);
 
@@ -1137,7 +1317,7 @@ void CConsole::StoreCommands(bool Store)
 
 const IConsole::CCommandInfo *CConsole::GetCommandInfo(const char *pName, int FlagMask, bool Temp)
 {
-	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	for(CCommand *pCommand = m_apCommandHash[CommandHash(pName)]; pCommand; pCommand = pCommand->m_pNextHash)
 	{
 		if(pCommand->m_Flags&FlagMask && pCommand->m_Temp == Temp)
 		{
@@ -14,6 +14,7 @@ class CConsole : public IConsole
 	public:
 		CCommand(bool BasicAccess) : CCommandInfo(BasicAccess) {};
 		CCommand *m_pNext;
+		CCommand *m_pNextHash;
 		int m_Flags;
 		bool m_Temp;
 		FCommandCallback m_pfnCallback;
@@ -65,6 +66,7 @@ class CConsole : public IConsole
 
 	void ExecuteFileRecurse(const char *pFilename);
 	void ExecuteLineStroked(int Stroke, const char *pStr);
+	void ExecuteLineUncached(int Stroke, const char *pStr);
 
 	struct
 	{
@@ -163,9 +165,62 @@ class CConsole : public IConsole
 		}
 	} m_ExecutionQueue;
 
+	void ExecuteCommand(CCommand *pCommand, CResult *pResult);
+
 	void AddCommandSorted(CCommand *pCommand);
 	CCommand *FindCommand(const char *pName, int FlagMask);
 
+	// case insensitive index of all commands in the list, same names are chained newest first like in the list
+	enum
+	{
+		COMMAND_HASH_SIZE = 512,
+	};
+	CCommand *m_apCommandHash[COMMAND_HASH_SIZE];
+
+	static unsigned CommandHash(const char *pName);
+	void AddCommandHash(CCommand *pCommand);
+	void RemoveCommandHash(CCommand *pCommand);
+
+	// lines split into commands with tokenised arguments, so binds and repeated lines skip parsing
+	enum
+	{
+		LINE_CACHE_SIZE = 64,
+		LINE_CACHE_LENGTH = 256,
+		LINE_CACHE_PARTS = 4,
+		LINE_CACHE_ARGS = 16,
+		LINE_CACHE_STROKE_ARG = -1,
+	};
+
+	struct CCachedPart
+	{
+		CCommand *m_pCommand;
+		int m_NextPart; // offset of the rest of the line, -1 if there is none
+		int m_Command;
+		int m_NumArgs;
+		short m_aArgs[LINE_CACHE_ARGS]; // offsets into m_aStorage or LINE_CACHE_STROKE_ARG
+		char m_aStorage[LINE_CACHE_LENGTH];
+	};
+
+	struct CCachedLine
+	{
+		unsigned m_ID;
+		unsigned m_Hash;
+		int m_Stroke;
+		int m_FlagMask;
+		int m_NumParts; // -1 if the line can't be cached
+		char m_aLine[LINE_CACHE_LENGTH];
+		CCachedPart m_aParts[LINE_CACHE_PARTS];
+	};
+
+	CCachedLine *m_pLineCache;
+	unsigned m_LineCacheCounter;
+	unsigned m_LineCacheValidFrom;
+
+	void InvalidateLineCache() { m_LineCacheValidFrom = m_LineCacheCounter+1; }
+	bool LineCacheValid(const CCachedLine *pLine, unsigned ID) const { return pLine->m_ID == ID && ID >= m_LineCacheValidFrom; }
+	CCachedLine *CacheLine(int Stroke, const char *pStr);
+	bool CacheLinePart(CCachedPart *pPart, CCommand *pCommand, const CResult *pResult);
+
 	struct CMapListEntryTemp {
 		CMapListEntryTemp *m_pPrev;
 		CMapListEntryTemp *m_pNext;
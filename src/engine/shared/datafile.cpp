@@ -8,6 +8,8 @@
 #include <engine/storage.h>
 #include <zlib.h>
 
+#include "jobs.h"
+
 static const int DEBUG=0;
 
 struct CDatafileItemType
@@ -67,9 +69,55 @@ struct CDatafile
 	int m_DataStartOffset;
 	char **m_ppDataPtrs;
 	int *m_pDataSizes;
+	bool *m_pDataOwned; // false for views into the file data or the arena
 	char *m_pData;
+
+	// whole file when it could be read at once, m_File is closed then
+	char *m_pFileData;
+	long m_FileSize;
+
+	// v4 data of a file read at once is decompressed into one allocation
+	char *m_pArena;
+	int *m_pArenaOffsets;
+	int m_ArenaSize;
+};
+
+enum
+{
+	ARENA_ALIGNMENT = 8,
 };
 
+struct CDataPrefetch
+{
+	CJob m_Job;
+	class CDataFileReader *m_pReader;
+	int m_Index;
+};
+
+static void AllocArena(CDatafile *pDataFile)
+{
+	if(!pDataFile->m_pArena && pDataFile->m_ArenaSize >= 0)
+		pDataFile->m_pArena = (char *)mem_alloc(max(pDataFile->m_ArenaSize, 1), ARENA_ALIGNMENT);
+}
+
+static void CloseSource(IOHANDLE File, char *pFileData)
+{
+	if(File)
+		io_close(File);
+	mem_free(pFileData);
+}
+
+static bool UncompressData(char *pDst, unsigned long DstSize, const char *pSrc, int SrcSize)
+{
+	unsigned long Size = DstSize;
+	if(uncompress((Bytef*)pDst, &Size, (const Bytef*)pSrc, SrcSize) == Z_OK && Size == DstSize) // ignore_convention
+		return true;
+
+	// hand out zeroes rather than a partially inflated block
+	mem_zero(pDst, DstSize);
+	return false;
+}
+
 bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType)
 {
 	dbg_msg("datafile", "loading. filename='%s'", pFilename);
@@ -81,11 +129,36 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		return false;
 	}
 
+	// read the whole file so it can be hashed and parsed without reading it twice.
+	// it's not mapped, the reader must not fault when the file is truncated while in use
+	long FileSize = io_length(File);
+	char *pFileData = 0;
+	if(FileSize > 0)
+	{
+		pFileData = (char *)mem_alloc(FileSize, 1);
+		if(io_read(File, pFileData, FileSize) == (unsigned)FileSize)
+		{
+			io_close(File);
+			File = 0;
+		}
+		else
+		{
+			mem_free(pFileData);
+			pFileData = 0;
+			io_seek(File, 0, IOSEEK_START);
+		}
+	}
 
 	// take the hashes of the file and store them
 	SHA256_CTX Sha256Ctx;
 	sha256_init(&Sha256Ctx);
 	unsigned Crc = crc32(0L, 0x0, 0);
+	if(pFileData)
+	{
+		sha256_update(&Sha256Ctx, pFileData, FileSize);
+		Crc = crc32(Crc, (const Bytef *)pFileData, FileSize); // ignore_convention
+	}
+	else
 	{
 		enum
 		{
@@ -108,13 +181,21 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 
 	// TODO: change this header
 	CDatafileHeader Header;
-	io_read(File, &Header, sizeof(Header));
+	if(pFileData)
+	{
+		if(FileSize >= (long)sizeof(Header))
+			mem_copy(&Header, pFileData, sizeof(Header));
+		else
+			mem_zero(&Header, sizeof(Header));
+	}
+	else
+		io_read(File, &Header, sizeof(Header));
 	if(Header.m_aID[0] != 'A' || Header.m_aID[1] != 'T' || Header.m_aID[2] != 'A' || Header.m_aID[3] != 'D')
 	{
 		if(Header.m_aID[0] != 'D' || Header.m_aID[1] != 'A' || Header.m_aID[2] != 'T' || Header.m_aID[3] != 'A')
 		{
 			dbg_msg("datafile", "wrong signature. %x %x %x %x", Header.m_aID[0], Header.m_aID[1], Header.m_aID[2], Header.m_aID[3]);
-			io_close(File);
+			CloseSource(File, pFileData);
 			return 0;
 		}
 	}
@@ -125,7 +206,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	if(Header.m_Version != 3 && Header.m_Version != 4)
 	{
 		dbg_msg("datafile", "wrong version. version=%x", Header.m_Version);
-		io_close(File);
+		CloseSource(File, pFileData);
 		return 0;
 	}
 
@@ -137,13 +218,15 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		Size += Header.m_NumRawData*sizeof(int); // v4 has uncompressed data sizes aswell
 	Size += Header.m_ItemSize;
 
-	int64 AllocSize = Size;
+	int64 AllocSize = pFileData ? 0 : Size; // a file read at once is parsed in place
 	AllocSize += sizeof(CDatafile); // add space for info structure
 	AllocSize += Header.m_NumRawData*sizeof(void*); // add space for data pointers
 	AllocSize += Header.m_NumRawData*sizeof(int); // add space for data sizes
+	AllocSize += Header.m_NumRawData*sizeof(int); // add space for arena offsets
+	AllocSize += Header.m_NumRawData*sizeof(bool); // add space for data ownership
 	if(Size > (int64(1)<<31) || Header.m_NumItemTypes < 0 || Header.m_NumItems < 0 || Header.m_NumRawData < 0 || Header.m_ItemSize < 0)
 	{
-		io_close(File);
+		CloseSource(File, pFileData);
 		dbg_msg("datafile", "unable to load file, invalid file information");
 		return false;
 	}
@@ -153,20 +236,39 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	pTmpDataFile->m_DataStartOffset = sizeof(CDatafileHeader) + Size;
 	pTmpDataFile->m_ppDataPtrs = (char **)(pTmpDataFile+1);
 	pTmpDataFile->m_pDataSizes = (int *)(pTmpDataFile->m_ppDataPtrs + Header.m_NumRawData);
-	pTmpDataFile->m_pData = (char *)(pTmpDataFile->m_pDataSizes + Header.m_NumRawData);
+	pTmpDataFile->m_pArenaOffsets = pTmpDataFile->m_pDataSizes + Header.m_NumRawData;
+	if(pFileData)
+	{
+		pTmpDataFile->m_pData = pFileData + sizeof(CDatafileHeader);
+		pTmpDataFile->m_pDataOwned = (bool *)(pTmpDataFile->m_pArenaOffsets + Header.m_NumRawData);
+	}
+	else
+	{
+		pTmpDataFile->m_pData = (char *)(pTmpDataFile->m_pArenaOffsets + Header.m_NumRawData);
+		pTmpDataFile->m_pDataOwned = (bool *)(pTmpDataFile->m_pData + Size);
+	}
 	pTmpDataFile->m_File = File;
 	pTmpDataFile->m_Sha256 = sha256_finish(&Sha256Ctx);
 	pTmpDataFile->m_Crc = Crc;
+	pTmpDataFile->m_pFileData = pFileData;
+	pTmpDataFile->m_FileSize = FileSize;
+	pTmpDataFile->m_pArena = 0;
+	pTmpDataFile->m_ArenaSize = -1;
 
 	// clear the data pointers and sizes
 	mem_zero(pTmpDataFile->m_ppDataPtrs, Header.m_NumRawData*sizeof(void*));
 	mem_zero(pTmpDataFile->m_pDataSizes, Header.m_NumRawData*sizeof(int));
+	mem_zero(pTmpDataFile->m_pDataOwned, Header.m_NumRawData*sizeof(bool));
 
 	// read types, offsets, sizes and item data
-	unsigned ReadSize = io_read(File, pTmpDataFile->m_pData, Size);
+	unsigned ReadSize;
+	if(pFileData)
+		ReadSize = (unsigned)clamp(int64(FileSize) - int64(sizeof(CDatafileHeader)), int64(0), Size);
+	else
+		ReadSize = io_read(File, pTmpDataFile->m_pData, Size);
 	if(ReadSize != Size)
 	{
-		io_close(pTmpDataFile->m_File);
+		CloseSource(File, pFileData);
 		mem_free(pTmpDataFile);
 		pTmpDataFile = 0;
 		dbg_msg("datafile", "couldn't load the whole thing, wanted=%d got=%d", unsigned(Size), ReadSize);
@@ -199,6 +301,21 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		m_pDataFile->m_Info.m_pItemStart = (char *)&m_pDataFile->m_Info.m_pDataOffsets[m_pDataFile->m_Header.m_NumRawData];
 	m_pDataFile->m_Info.m_pDataStart = m_pDataFile->m_Info.m_pItemStart + m_pDataFile->m_Header.m_ItemSize;
 
+	// lay out the arena for the decompressed data, it's only allocated once data is requested
+	if(pFileData && Header.m_Version == 4)
+	{
+		int64 ArenaSize = 0;
+		for(int i = 0; i < Header.m_NumRawData && ArenaSize >= 0; i++)
+		{
+			int DataSize = m_pDataFile->m_Info.m_pDataSizes[i];
+			m_pDataFile->m_pArenaOffsets[i] = (int)ArenaSize;
+			ArenaSize += (int64(DataSize) + ARENA_ALIGNMENT-1) & ~int64(ARENA_ALIGNMENT-1);
+			if(DataSize < 0 || ArenaSize > (int64(1)<<31)-1)
+				ArenaSize = -1;
+		}
+		m_pDataFile->m_ArenaSize = (int)ArenaSize;
+	}
+
 	dbg_msg("datafile", "loading done. datafile='%s'", pFilename);
 
 	if(DEBUG)
@@ -292,26 +409,75 @@ void *CDataFileReader::GetDataImpl(int Index, int Swap)
 		int SwapSize = DataSize;
 #endif
 
-		if(m_pDataFile->m_Header.m_Version == 4)
+		if(m_pDataFile->m_pFileData)
+		{
+			// don't trust the offsets to stay inside the file
+			int64 Start = int64(m_pDataFile->m_DataStartOffset) + m_pDataFile->m_Info.m_pDataOffsets[Index];
+			Start = clamp(Start, int64(0), int64(m_pDataFile->m_FileSize));
+			DataSize = (int)clamp(int64(DataSize), int64(0), m_pDataFile->m_FileSize - Start);
+			char *pSrc = m_pDataFile->m_pFileData + Start;
+
+			if(m_pDataFile->m_Header.m_Version == 4)
+			{
+				unsigned long UncompressedSize = m_pDataFile->m_Info.m_pDataSizes[Index];
+
+				dbg_msg("datafile", "loading data index=%d size=%d uncompressed=%lu", Index, DataSize, UncompressedSize);
+				AllocArena(m_pDataFile);
+				if(m_pDataFile->m_pArena)
+				{
+					m_pDataFile->m_ppDataPtrs[Index] = m_pDataFile->m_pArena + m_pDataFile->m_pArenaOffsets[Index];
+					m_pDataFile->m_pDataOwned[Index] = false;
+				}
+				else
+				{
+					m_pDataFile->m_ppDataPtrs[Index] = (char *)mem_alloc(UncompressedSize, 1);
+					m_pDataFile->m_pDataOwned[Index] = true;
+				}
+				m_pDataFile->m_pDataSizes[Index] = UncompressedSize;
+
+				// decompress straight from the file data
+				if(!UncompressData(m_pDataFile->m_ppDataPtrs[Index], UncompressedSize, pSrc, DataSize))
+					dbg_msg("datafile", "failed to decompress data index=%d", Index);
+#if defined(CONF_ARCH_ENDIAN_BIG)
+				SwapSize = UncompressedSize;
+#endif
+			}
+			else
+			{
+				dbg_msg("datafile", "loading data index=%d size=%d", Index, DataSize);
+#if defined(CONF_ARCH_ENDIAN_BIG)
+				// swapping in place would hit the same pages again after an unload
+				m_pDataFile->m_ppDataPtrs[Index] = (char *)mem_alloc(DataSize, 1);
+				m_pDataFile->m_pDataOwned[Index] = true;
+				mem_copy(m_pDataFile->m_ppDataPtrs[Index], pSrc, DataSize);
+				SwapSize = DataSize;
+#else
+				m_pDataFile->m_ppDataPtrs[Index] = pSrc;
+				m_pDataFile->m_pDataOwned[Index] = false;
+#endif
+				m_pDataFile->m_pDataSizes[Index] = DataSize;
+			}
+		}
+		else if(m_pDataFile->m_Header.m_Version == 4)
 		{
 			// v4 has compressed data
 			void *pTemp = (char *)mem_alloc(DataSize, 1);
 			unsigned long UncompressedSize = m_pDataFile->m_Info.m_pDataSizes[Index];
-			unsigned long s;
 
 			dbg_msg("datafile", "loading data index=%d size=%d uncompressed=%lu", Index, DataSize, UncompressedSize);
 			m_pDataFile->m_ppDataPtrs[Index] = (char *)mem_alloc(UncompressedSize, 1);
+			m_pDataFile->m_pDataOwned[Index] = true;
 			m_pDataFile->m_pDataSizes[Index] = UncompressedSize;
 
 			// read the compressed data
 			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset+m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
 			io_read(m_pDataFile->m_File, pTemp, DataSize);
 
-			// decompress the data, TODO: check for errors
-			s = UncompressedSize;
-			uncompress((Bytef*)m_pDataFile->m_ppDataPtrs[Index], &s, (Bytef*)pTemp, DataSize); // ignore_convention
+			// decompress the data
+			if(!UncompressData(m_pDataFile->m_ppDataPtrs[Index], UncompressedSize, (const char *)pTemp, DataSize))
+				dbg_msg("datafile", "failed to decompress data index=%d", Index);
 #if defined(CONF_ARCH_ENDIAN_BIG)
-			SwapSize = s;
+			SwapSize = UncompressedSize;
 #endif
 
 			// clean up the temporary buffers
@@ -322,6 +488,7 @@ void *CDataFileReader::GetDataImpl(int Index, int Swap)
 			// load the data
 			dbg_msg("datafile", "loading data index=%d size=%d", Index, DataSize);
 			m_pDataFile->m_ppDataPtrs[Index] = (char *)mem_alloc(DataSize, 1);
+			m_pDataFile->m_pDataOwned[Index] = true;
 			m_pDataFile->m_pDataSizes[Index] = DataSize;
 			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset+m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
 			io_read(m_pDataFile->m_File, m_pDataFile->m_ppDataPtrs[Index], DataSize);
@@ -357,6 +524,60 @@ void CDataFileReader::ReplaceData(int Index, char *pData, int Size)
 	UnloadData(Index);
 	m_pDataFile->m_ppDataPtrs[Index] = pData;
 	m_pDataFile->m_pDataSizes[Index] = Size;
+	m_pDataFile->m_pDataOwned[Index] = true;
+}
+
+int CDataFileReader::PrefetchJob(void *pUser)
+{
+	CDataPrefetch *pPrefetch = (CDataPrefetch *)pUser;
+	pPrefetch->m_pReader->GetDataImpl(pPrefetch->m_Index, 0);
+	return 0;
+}
+
+void CDataFileReader::PrefetchData(CJobPool *pPool, const int *pIndices, int NumIndices)
+{
+	// only compressed data of a file read at once is worth it: uncompressed data is a view anyway and
+	// reading needs the shared file handle. big endian hosts swap on first access, so don't guess there
+#if defined(CONF_ARCH_ENDIAN_BIG)
+	return;
+#endif
+	if(!m_pDataFile || !m_pDataFile->m_pFileData || m_pDataFile->m_Header.m_Version != 4 || !pPool || pPool->NumThreads() == 0)
+		return;
+
+	int NumData = m_pDataFile->m_Header.m_NumRawData;
+	if(!pIndices)
+		NumIndices = NumData;
+	if(NumIndices <= 0)
+		return;
+
+	// the jobs must not allocate the arena concurrently
+	AllocArena(m_pDataFile);
+
+	// one job per data that isn't loaded yet, each index only once
+	CDataPrefetch *pPrefetches = (CDataPrefetch *)mem_alloc(NumIndices*sizeof(CDataPrefetch), 1);
+	CJob **ppJobs = (CJob **)mem_alloc(NumIndices*sizeof(CJob *), 1);
+	bool *pQueued = (bool *)mem_alloc(NumData*sizeof(bool), 1);
+	mem_zero(pQueued, NumData*sizeof(bool));
+	int NumJobs = 0;
+	for(int i = 0; i < NumIndices; i++)
+	{
+		int Index = pIndices ? pIndices[i] : i;
+		if(Index < 0 || Index >= NumData || pQueued[Index] || m_pDataFile->m_ppDataPtrs[Index])
+			continue;
+		pQueued[Index] = true;
+
+		CDataPrefetch *pPrefetch = &pPrefetches[NumJobs];
+		pPrefetch->m_pReader = this;
+		pPrefetch->m_Index = Index;
+		ppJobs[NumJobs++] = &pPrefetch->m_Job;
+		pPool->Add(&pPrefetch->m_Job, PrefetchJob, pPrefetch);
+	}
+
+	pPool->WaitAll(ppJobs, NumJobs);
+
+	mem_free(pQueued);
+	mem_free(ppJobs);
+	mem_free(pPrefetches);
 }
 
 void CDataFileReader::UnloadData(int Index)
@@ -364,9 +585,11 @@ void CDataFileReader::UnloadData(int Index)
 	if(Index < 0 || Index >= m_pDataFile->m_Header.m_NumRawData)
 		return;
 
-	mem_free(m_pDataFile->m_ppDataPtrs[Index]);
+	if(m_pDataFile->m_pDataOwned[Index])
+		mem_free(m_pDataFile->m_ppDataPtrs[Index]);
 	m_pDataFile->m_ppDataPtrs[Index] = 0x0;
 	m_pDataFile->m_pDataSizes[Index] = 0;
+	m_pDataFile->m_pDataOwned[Index] = false;
 }
 
 int CDataFileReader::GetFileItemSize(int Index) const
@@ -457,11 +680,13 @@ bool CDataFileReader::Close()
 	int i;
 	for(i = 0; i < m_pDataFile->m_Header.m_NumRawData; i++)
 	{
-		mem_free(m_pDataFile->m_ppDataPtrs[i]);
+		if(m_pDataFile->m_pDataOwned[i])
+			mem_free(m_pDataFile->m_ppDataPtrs[i]);
 		m_pDataFile->m_pDataSizes[i] = 0;
 	}
 
-	io_close(m_pDataFile->m_File);
+	mem_free(m_pDataFile->m_pArena);
+	CloseSource(m_pDataFile->m_File, m_pDataFile->m_pFileData);
 	mem_free(m_pDataFile);
 	m_pDataFile = 0;
 	return true;
@@ -6,11 +6,14 @@
 #include <base/system.h>
 #include <base/hash.h>
 
+class CJobPool;
+
 // raw datafile access
 class CDataFileReader
 {
 	struct CDatafile *m_pDataFile;
 	void *GetDataImpl(int Index, int Swap);
+	static int PrefetchJob(void *pUser);
 	int GetFileDataSize(int Index) const;
 	int GetFileItemSize(int Index) const;
 
@@ -28,6 +31,8 @@ public:
 	int GetDataSize(int Index) const;
 	void ReplaceData(int Index, char *pData, int Size);
 	void UnloadData(int Index);
+	// decompresses the given data (all if pIndices is 0) on the job pool and waits for it
+	void PrefetchData(CJobPool *pPool, const int *pIndices = 0, int NumIndices = 0);
 	void *GetItem(int Index, int *pType, int *pID);
 	int GetItemSize(int Index) const;
 	void GetType(int Type, int *pStart, int *pNum);
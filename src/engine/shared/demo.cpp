@@ -1,7 +1,9 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/hash_ctxt.h>
 #include <base/math.h>
 #include <base/system.h>
+#include <base/tl/threading.h>
 
 #include <engine/console.h>
 #include <engine/storage.h>
@@ -17,12 +19,18 @@ static const unsigned char gs_aHeaderMarker[7] = {'T', 'W', 'D', 'E', 'M', 'O',
 static const unsigned char gs_ActVersion = 4;
 static const int gs_LengthOffset = 152;
 static const int gs_NumMarkersOffset = 176;
+static const unsigned char gs_aCheckpointMarker[8] = {'T', 'W', 'D', 'E', 'M', 'O', 'C', 'P'};
+static const unsigned char gs_CheckpointVersion = 2;
 
 CDemoRecorder::CDemoRecorder(class CSnapshotDelta *pSnapshotDelta)
 {
 	m_File = 0;
+	m_LastTick = -1;
+	m_FirstTick = -1;
 	m_LastTickMarker = -1;
 	m_pSnapshotDelta = pSnapshotDelta;
+	m_pQueue = 0;
+	m_pWriterThread = 0;
 	m_Huffman.Init();
 }
 
@@ -110,14 +118,26 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 
 	m_LastKeyFrame = -1;
 	m_LastTickMarker = -1;
+	m_LastTick = -1;
 	m_FirstTick = -1;
 	m_NumTimelineMarkers = 0;
+	m_NumWriteErrors = 0;
 
 	char aBuf[256];
 	str_format(aBuf, sizeof(aBuf), "Recording to '%s'", pFilename);
 	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", aBuf);
 	m_File = DemoFile;
 
+	// start the writer
+	m_pQueue = (unsigned char *)mem_alloc(QUEUE_SIZE, 16);
+	m_QueueRead = 0;
+	m_QueueWrite = 0;
+	m_WriterShutdown = false;
+#if !defined(CONF_PLATFORM_MACOSX)
+	semaphore_init(&m_WriterActivity);
+#endif
+	m_pWriterThread = thread_init(WriterThread, this);
+
 	return 0;
 }
 
@@ -135,6 +155,8 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 
 enum
 {
+	QUEUETYPE_PADDING = 0, // the rest of the queue is unused, continue at its start
+
 	CHUNKTYPEFLAG_TICKMARKER = 0x80,
 	CHUNKTICKFLAG_KEYFRAME = 0x40, // only when tickmarker is set
 
@@ -170,8 +192,6 @@ void CDemoRecorder::WriteTickMarker(int Tick, int Keyframe)
 	}
 
 	m_LastTickMarker = Tick;
-	if(m_FirstTick < 0)
-		m_FirstTick = Tick;
 }
 
 void CDemoRecorder::Write(int Type, const void *pData, int Size)
@@ -190,13 +210,14 @@ void CDemoRecorder::Write(int Type, const void *pData, int Size)
 	Size = CVariableInt::Compress(aBuffer2, Size, aBuffer, sizeof(aBuffer)); // buffer2 -> buffer
 	if(Size < 0)
 	{
-		m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_recorder", "error during intpack compression");
+		// reported on stop, the console belongs to the game thread
+		m_NumWriteErrors++;
 		return;
 	}
 	Size = m_Huffman.Compress(aBuffer, Size, aBuffer2, sizeof(aBuffer2)); // buffer -> buffer2
 	if(Size < 0)
 	{
-		m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_recorder", "error during network compression");
+		m_NumWriteErrors++;
 		return;
 	}
 
@@ -227,8 +248,86 @@ void CDemoRecorder::Write(int Type, const void *pData, int Size)
 	io_write(m_File, aBuffer2, Size);
 }
 
-void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
+void CDemoRecorder::Enqueue(int Type, int Tick, const void *pData, int Size)
+{
+	const unsigned ItemSize = (sizeof(CQueueItem)+Size+15)&~15;
+	unsigned Offset = m_QueueWrite%QUEUE_SIZE;
+	const unsigned Padding = Offset+ItemSize > QUEUE_SIZE ? QUEUE_SIZE-Offset : 0;
+
+	// the queue is bounded, wait for the writer when it falls behind
+	while(m_QueueWrite+Padding+ItemSize-m_QueueRead > QUEUE_SIZE)
+		thread_sleep(1);
+
+	// items are never split, skip the end of the queue instead
+	if(Padding)
+	{
+		((CQueueItem *)(m_pQueue+Offset))->m_Type = QUEUETYPE_PADDING;
+		Offset = 0;
+	}
+
+	CQueueItem *pItem = (CQueueItem *)(m_pQueue+Offset);
+	pItem->m_Type = Type;
+	pItem->m_Tick = Tick;
+	pItem->m_Size = Size;
+	mem_copy(pItem+1, pData, Size);
+
+	sync_barrier();
+	m_QueueWrite += Padding+ItemSize;
+#if !defined(CONF_PLATFORM_MACOSX)
+	semaphore_signal(&m_WriterActivity);
+#endif
+}
+
+void CDemoRecorder::WriterThread(void *pUser)
 {
+	CDemoRecorder *pSelf = (CDemoRecorder *)pUser;
+
+	while(1)
+	{
+#if !defined(CONF_PLATFORM_MACOSX)
+		semaphore_wait(&pSelf->m_WriterActivity);
+#else
+		if(pSelf->m_QueueRead == pSelf->m_QueueWrite && !pSelf->m_WriterShutdown)
+			thread_sleep(1);
+#endif
+		// read the shutdown flag first so nothing queued before it is missed
+		const bool Shutdown = pSelf->m_WriterShutdown;
+		sync_barrier();
+
+		while(pSelf->m_QueueRead != pSelf->m_QueueWrite)
+		{
+			sync_barrier();
+			const unsigned Offset = pSelf->m_QueueRead%QUEUE_SIZE;
+			const CQueueItem *pItem = (const CQueueItem *)(pSelf->m_pQueue+Offset);
+			unsigned ItemSize;
+			if(pItem->m_Type == QUEUETYPE_PADDING)
+				ItemSize = QUEUE_SIZE-Offset;
+			else
+			{
+				pSelf->WriteItem(pItem);
+				ItemSize = (sizeof(CQueueItem)+pItem->m_Size+15)&~15;
+			}
+			sync_barrier();
+			pSelf->m_QueueRead += ItemSize;
+		}
+
+		if(Shutdown)
+			break;
+	}
+}
+
+void CDemoRecorder::WriteItem(const CQueueItem *pItem)
+{
+	const void *pData = pItem+1;
+	const int Tick = pItem->m_Tick;
+	const int Size = pItem->m_Size;
+
+	if(pItem->m_Type == CHUNKTYPE_MESSAGE)
+	{
+		Write(CHUNKTYPE_MESSAGE, pData, Size);
+		return;
+	}
+
 	char aTmpData[CSnapshot::MAX_SIZE];
 
 	if(m_LastKeyFrame == -1 || (Tick-m_LastKeyFrame) > SERVER_TICK_SPEED*5)
@@ -259,9 +358,24 @@ void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
 	}
 }
 
+void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
+{
+	if(!m_File)
+		return;
+
+	Enqueue(CHUNKTYPE_SNAPSHOT, Tick, pData, Size);
+
+	m_LastTick = Tick;
+	if(m_FirstTick < 0)
+		m_FirstTick = Tick;
+}
+
 void CDemoRecorder::RecordMessage(const void *pData, int Size)
 {
-	Write(CHUNKTYPE_MESSAGE, pData, Size);
+	if(!m_File)
+		return;
+
+	Enqueue(CHUNKTYPE_MESSAGE, m_LastTick, pData, Size);
 }
 
 int CDemoRecorder::Stop()
@@ -269,6 +383,27 @@ int CDemoRecorder::Stop()
 	if(!m_File)
 		return -1;
 
+	// let the writer flush the queue
+	m_WriterShutdown = true;
+#if !defined(CONF_PLATFORM_MACOSX)
+	semaphore_signal(&m_WriterActivity);
+#endif
+	thread_wait(m_pWriterThread);
+	thread_destroy(m_pWriterThread);
+	m_pWriterThread = 0;
+#if !defined(CONF_PLATFORM_MACOSX)
+	semaphore_destroy(&m_WriterActivity);
+#endif
+	mem_free(m_pQueue);
+	m_pQueue = 0;
+
+	if(m_NumWriteErrors)
+	{
+		char aBuf[128];
+		str_format(aBuf, sizeof(aBuf), "%d chunks could not be compressed and were dropped", m_NumWriteErrors);
+		m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_recorder", aBuf);
+	}
+
 	// add the demo length to the header
 	io_seek(m_File, gs_LengthOffset, IOSEEK_START);
 	unsigned char aLength[4];
@@ -296,18 +431,18 @@ int CDemoRecorder::Stop()
 
 void CDemoRecorder::AddDemoMarker()
 {
-	if(m_LastTickMarker < 0 || m_NumTimelineMarkers >= MAX_TIMELINE_MARKERS)
+	if(m_LastTick < 0 || m_NumTimelineMarkers >= MAX_TIMELINE_MARKERS)
 		return;
 
 	// not more than 1 marker in a second
 	if(m_NumTimelineMarkers > 0)
 	{
-		int Diff = m_LastTickMarker - m_aTimelineMarkers[m_NumTimelineMarkers-1];
+		int Diff = m_LastTick - m_aTimelineMarkers[m_NumTimelineMarkers-1];
 		if(Diff < SERVER_TICK_SPEED*1.0f)
 			return;
 	}
 
-	m_aTimelineMarkers[m_NumTimelineMarkers++] = m_LastTickMarker;
+	m_aTimelineMarkers[m_NumTimelineMarkers++] = m_LastTick;
 
 	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", "Added timeline marker");
 }
@@ -320,6 +455,13 @@ CDemoPlayer::CDemoPlayer(class CSnapshotDelta *pSnapshotDelta)
 	m_File = 0;
 	m_aErrorMsg[0] = 0;
 	m_pKeyFrames = 0;
+	m_pCheckpoints = 0;
+	m_NumCheckpoints = 0;
+	m_CheckpointInterval = 0;
+	m_CacheCheckpoints = false;
+	m_CheckpointsPrepared = false;
+	m_DataStartPos = 0;
+	m_FixedStep = 0;
 
 	m_pSnapshotDelta = pSnapshotDelta;
 	m_LastSnapshotDataSize = -1;
@@ -330,6 +472,17 @@ void CDemoPlayer::SetListener(IListener *pListener)
 	m_pListener = pListener;
 }
 
+void CDemoPlayer::SetCheckpoints(int Interval, bool Cache)
+{
+	m_CheckpointInterval = Interval;
+	m_CacheCheckpoints = Cache;
+}
+
+void CDemoPlayer::SetFixedStep(int64 Step)
+{
+	m_FixedStep = Step;
+}
+
 
 int CDemoPlayer::ReadChunkHeader(int *pType, int *pSize, int *pTick)
 {
@@ -438,6 +591,216 @@ void CDemoPlayer::ScanFile()
 	io_seek(m_File, StartPos, IOSEEK_START);
 }
 
+void CDemoPlayer::BuildCheckpoints()
+{
+	static char aCompressedData[CSnapshot::MAX_SIZE];
+	static char aDecompressed[CSnapshot::MAX_SIZE];
+	static char aData[CSnapshot::MAX_SIZE];
+	static char aSnap[CSnapshot::MAX_SIZE];
+	static char aNewSnap[CSnapshot::MAX_SIZE];
+	int SnapSize = -1;
+	int ChunkTick = 0;
+	int LastCheckpointTick = 0;
+
+	// checkpoints are at least one interval apart
+	int MaxCheckpoints = (m_Info.m_Info.m_LastTick-m_Info.m_Info.m_FirstTick)/m_CheckpointInterval + 2;
+	m_pCheckpoints = (CCheckpoint *)mem_alloc(MaxCheckpoints*sizeof(CCheckpoint), 1);
+	m_NumCheckpoints = 0;
+
+	// decode with a copy of the delta so the playback data rate stats stay untouched
+	CSnapshotDelta *pDelta = new CSnapshotDelta(*m_pSnapshotDelta);
+
+	long StartPos = io_tell(m_File);
+	io_seek(m_File, m_DataStartPos, IOSEEK_START);
+	while(1)
+	{
+		int ChunkSize, ChunkType;
+		if(ReadChunkHeader(&ChunkType, &ChunkSize, &ChunkTick))
+			break;
+
+		if(ChunkType&CHUNKTYPEFLAG_TICKMARKER)
+		{
+			// store the snapshot the player will have when it reaches this tick
+			if(SnapSize != -1 && (m_NumCheckpoints == 0 || ChunkTick-LastCheckpointTick >= m_CheckpointInterval) && m_NumCheckpoints < MaxCheckpoints)
+			{
+				CCheckpoint *pCheckpoint = &m_pCheckpoints[m_NumCheckpoints++];
+				pCheckpoint->m_Filepos = io_tell(m_File);
+				pCheckpoint->m_Tick = ChunkTick;
+				pCheckpoint->m_DataSize = SnapSize;
+				pCheckpoint->m_pData = (unsigned char *)mem_alloc(SnapSize, 1);
+				mem_copy(pCheckpoint->m_pData, aSnap, SnapSize);
+				LastCheckpointTick = ChunkTick;
+			}
+			continue;
+		}
+
+		if(!ChunkSize)
+			continue;
+
+		// errors are reported once playback reaches them
+		if(io_read(m_File, aCompressedData, ChunkSize) != (unsigned)ChunkSize)
+			break;
+		int DataSize = m_Huffman.Decompress(aCompressedData, ChunkSize, aDecompressed, sizeof(aDecompressed));
+		if(DataSize < 0)
+			break;
+		DataSize = CVariableInt::Decompress(aDecompressed, DataSize, aData, sizeof(aData));
+		if(DataSize < 0)
+			break;
+
+		if(ChunkType == CHUNKTYPE_DELTA && SnapSize != -1)
+			DataSize = pDelta->UnpackDelta((CSnapshot*)aSnap, (CSnapshot*)aNewSnap, aData, DataSize);
+		else if(ChunkType == CHUNKTYPE_SNAPSHOT)
+		{
+			CSnapshotBuilder Builder;
+			DataSize = Builder.UnserializeSnap(aData, DataSize) ? Builder.Finish(aNewSnap) : -1;
+		}
+		else
+			continue;
+
+		if(DataSize >= 0)
+		{
+			SnapSize = DataSize;
+			mem_copy(aSnap, aNewSnap, DataSize);
+		}
+	}
+
+	delete pDelta;
+	io_seek(m_File, StartPos, IOSEEK_START);
+}
+
+bool CDemoPlayer::LoadCheckpoints(const SHA256_DIGEST &Sha256)
+{
+	char aCheckpointFilename[IO_MAX_PATH_LENGTH];
+	str_format(aCheckpointFilename, sizeof(aCheckpointFilename), "%s.cpt", m_aFilename);
+	IOHANDLE File = m_pStorage->OpenFile(aCheckpointFilename, IOFLAG_READ, m_StorageType);
+	if(!File)
+		return false;
+
+	// the cache is only valid for the exact demo and interval it was built for
+	unsigned char aMarker[sizeof(gs_aCheckpointMarker)];
+	unsigned char aHeader[3*4];
+	SHA256_DIGEST CacheSha256;
+	bool Valid = io_read(File, aMarker, sizeof(aMarker)) == sizeof(aMarker) && mem_comp(aMarker, gs_aCheckpointMarker, sizeof(aMarker)) == 0 &&
+		io_read(File, aHeader, sizeof(aHeader)) == sizeof(aHeader) &&
+		io_read(File, &CacheSha256, sizeof(CacheSha256)) == sizeof(CacheSha256) &&
+		bytes_be_to_uint(aHeader) == gs_CheckpointVersion && (int)bytes_be_to_uint(aHeader+4) == m_CheckpointInterval &&
+		sha256_comp(CacheSha256, Sha256) == 0;
+	int NumCheckpoints = Valid ? (int)bytes_be_to_uint(aHeader+8) : 0;
+	if(NumCheckpoints < 0 || NumCheckpoints > (m_Info.m_Info.m_LastTick-m_Info.m_Info.m_FirstTick)/m_CheckpointInterval + 2)
+		Valid = false;
+
+	if(Valid)
+	{
+		m_pCheckpoints = (CCheckpoint *)mem_alloc(max(NumCheckpoints, 1)*sizeof(CCheckpoint), 1);
+		for(m_NumCheckpoints = 0; m_NumCheckpoints < NumCheckpoints; m_NumCheckpoints++)
+		{
+			unsigned char aEntry[3*4];
+			if(io_read(File, aEntry, sizeof(aEntry)) != sizeof(aEntry))
+				break;
+			CCheckpoint *pCheckpoint = &m_pCheckpoints[m_NumCheckpoints];
+			pCheckpoint->m_Filepos = bytes_be_to_uint(aEntry);
+			pCheckpoint->m_Tick = bytes_be_to_uint(aEntry+4);
+			pCheckpoint->m_DataSize = bytes_be_to_uint(aEntry+8);
+			if(pCheckpoint->m_DataSize < 0 || pCheckpoint->m_DataSize > CSnapshot::MAX_SIZE)
+				break;
+			pCheckpoint->m_pData = (unsigned char *)mem_alloc(max(pCheckpoint->m_DataSize, 1), 1);
+			if(io_read(File, pCheckpoint->m_pData, pCheckpoint->m_DataSize) != (unsigned)pCheckpoint->m_DataSize ||
+				!((CSnapshot *)pCheckpoint->m_pData)->IsValid(pCheckpoint->m_DataSize))
+			{
+				mem_free(pCheckpoint->m_pData);
+				break;
+			}
+		}
+		Valid = m_NumCheckpoints == NumCheckpoints;
+	}
+	io_close(File);
+
+	if(!Valid)
+		FreeCheckpoints();
+	return Valid;
+}
+
+void CDemoPlayer::SaveCheckpoints(const SHA256_DIGEST &Sha256)
+{
+	char aCheckpointFilename[IO_MAX_PATH_LENGTH];
+	str_format(aCheckpointFilename, sizeof(aCheckpointFilename), "%s.cpt", m_aFilename);
+	IOHANDLE File = m_pStorage->OpenFile(aCheckpointFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(!File)
+		return;
+
+	// snapshot data is stored as is, the cache is meant for the machine that wrote it
+	unsigned char aHeader[3*4];
+	uint_to_bytes_be(aHeader, gs_CheckpointVersion);
+	uint_to_bytes_be(aHeader+4, m_CheckpointInterval);
+	uint_to_bytes_be(aHeader+8, m_NumCheckpoints);
+	io_write(File, gs_aCheckpointMarker, sizeof(gs_aCheckpointMarker));
+	io_write(File, aHeader, sizeof(aHeader));
+	io_write(File, &Sha256, sizeof(Sha256));
+	for(int i = 0; i < m_NumCheckpoints; i++)
+	{
+		unsigned char aEntry[3*4];
+		uint_to_bytes_be(aEntry, m_pCheckpoints[i].m_Filepos);
+		uint_to_bytes_be(aEntry+4, m_pCheckpoints[i].m_Tick);
+		uint_to_bytes_be(aEntry+8, m_pCheckpoints[i].m_DataSize);
+		io_write(File, aEntry, sizeof(aEntry));
+		io_write(File, m_pCheckpoints[i].m_pData, m_pCheckpoints[i].m_DataSize);
+	}
+	io_close(File);
+}
+
+SHA256_DIGEST CDemoPlayer::HashFile()
+{
+	static unsigned char s_aBuffer[64*1024];
+	SHA256_CTX Sha256Ctxt;
+	sha256_init(&Sha256Ctxt);
+
+	long StartPos = io_tell(m_File);
+	io_seek(m_File, 0, IOSEEK_START);
+	while(1)
+	{
+		unsigned Bytes = io_read(m_File, s_aBuffer, sizeof(s_aBuffer));
+		if(Bytes == 0)
+			break;
+		sha256_update(&Sha256Ctxt, s_aBuffer, Bytes);
+	}
+	io_seek(m_File, StartPos, IOSEEK_START);
+	return sha256_finish(&Sha256Ctxt);
+}
+
+void CDemoPlayer::PrepareCheckpoints()
+{
+	// done on the first seek, plain playback never needs them
+	m_CheckpointsPrepared = true;
+	if(m_CheckpointInterval <= 0 || m_Info.m_SeekablePoints <= 0)
+		return;
+
+	SHA256_DIGEST Sha256 = SHA256_ZEROED;
+	if(m_CacheCheckpoints)
+		Sha256 = HashFile();
+	if(!m_CacheCheckpoints || !LoadCheckpoints(Sha256))
+	{
+		BuildCheckpoints();
+		if(m_CacheCheckpoints)
+			SaveCheckpoints(Sha256);
+	}
+
+	int Size = 0;
+	for(int i = 0; i < m_NumCheckpoints; i++)
+		Size += m_pCheckpoints[i].m_DataSize;
+	char aBuf[128];
+	str_format(aBuf, sizeof(aBuf), "%d checkpoints, %dk", m_NumCheckpoints, Size/1024);
+	m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_player", aBuf);
+}
+
+void CDemoPlayer::FreeCheckpoints()
+{
+	for(int i = 0; i < m_NumCheckpoints; i++)
+		mem_free(m_pCheckpoints[i].m_pData);
+	mem_free(m_pCheckpoints);
+	m_pCheckpoints = 0;
+	m_NumCheckpoints = 0;
+}
+
 void CDemoPlayer::DoTick()
 {
 	static char aCompressedData[CSnapshot::MAX_SIZE];
@@ -584,6 +947,8 @@ void CDemoPlayer::Unpause()
 const char *CDemoPlayer::Load(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, int StorageType, const char *pNetversion)
 {
 	m_pConsole = pConsole;
+	m_pStorage = pStorage;
+	m_StorageType = StorageType;
 	m_aErrorMsg[0] = 0;
 	m_File = pStorage->OpenFile(pFilename, IOFLAG_READ, StorageType);
 	if(!m_File)
@@ -684,6 +1049,11 @@ const char *CDemoPlayer::Load(class IStorage *pStorage, class IConsole *pConsole
 	// scan the file for interesting points
 	ScanFile();
 
+	// snapshots are decoded in regular intervals once the demo is seeked the first time
+	FreeCheckpoints();
+	m_CheckpointsPrepared = false;
+	m_DataStartPos = io_tell(m_File);
+
 	// ready for playback
 	return 0;
 }
@@ -724,10 +1094,37 @@ int CDemoPlayer::SetPos(float Percent)
 	while(Keyframe && m_pKeyFrames[Keyframe].m_Tick > WantedTick)
 		Keyframe--;
 
-	// seek to the correct keyframe
-	io_seek(m_File, m_pKeyFrames[Keyframe].m_Filepos, IOSEEK_START);
+	if(!m_CheckpointsPrepared)
+		PrepareCheckpoints();
+
+	// find the last checkpoint before our tick
+	int Low = 0;
+	int High = m_NumCheckpoints;
+	while(Low < High)
+	{
+		int Mid = (Low+High)/2;
+		if(m_pCheckpoints[Mid].m_Tick <= WantedTick)
+			Low = Mid+1;
+		else
+			High = Mid;
+	}
+	const CCheckpoint *pCheckpoint = Low > 0 ? &m_pCheckpoints[Low-1] : 0;
+
+	if(pCheckpoint && pCheckpoint->m_Tick >= m_pKeyFrames[Keyframe].m_Tick)
+	{
+		// continue from the decoded snapshot
+		io_seek(m_File, pCheckpoint->m_Filepos, IOSEEK_START);
+		mem_copy(m_aLastSnapshotData, pCheckpoint->m_pData, pCheckpoint->m_DataSize);
+		m_LastSnapshotDataSize = pCheckpoint->m_DataSize;
+		m_Info.m_NextTick = pCheckpoint->m_Tick;
+	}
+	else
+	{
+		// seek to the correct keyframe
+		io_seek(m_File, m_pKeyFrames[Keyframe].m_Filepos, IOSEEK_START);
+		m_Info.m_NextTick = -1;
+	}
 
-	m_Info.m_NextTick = -1;
 	m_Info.m_Info.m_CurrentTick = -1;
 	m_Info.m_PreviousTick = -1;
 
@@ -748,7 +1145,7 @@ void CDemoPlayer::SetSpeed(float Speed)
 int CDemoPlayer::Update()
 {
 	int64 Now = time_get();
-	int64 Deltatime = Now-m_Info.m_LastUpdate;
+	int64 Deltatime = m_FixedStep ? m_FixedStep : Now-m_Info.m_LastUpdate;
 	m_Info.m_LastUpdate = Now;
 
 	if(!IsPlaying() || m_Info.m_Info.m_Paused)
@@ -802,6 +1199,7 @@ int CDemoPlayer::Stop()
 	m_File = 0;
 	mem_free(m_pKeyFrames);
 	m_pKeyFrames = 0;
+	FreeCheckpoints();
 	m_aFilename[0] = '\0';
 	return 0;
 }
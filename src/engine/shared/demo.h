@@ -11,17 +11,49 @@
 
 class CDemoRecorder : public IDemoRecorder
 {
+	enum
+	{
+		QUEUE_SIZE=1024*1024, // power of two, the offsets wrap around
+	};
+
+	// header of a queued snapshot or message, the data follows it
+	struct CQueueItem
+	{
+		int m_Type;
+		int m_Tick;
+		int m_Size;
+		int m_Reserved; // keeps the data 16 byte aligned
+	};
+
 	class IConsole *m_pConsole;
-	CHuffman m_Huffman;
 	IOHANDLE m_File;
-	int m_LastTickMarker;
-	int m_LastKeyFrame;
+	int m_LastTick;
 	int m_FirstTick;
-	unsigned char m_aLastSnapshotData[CSnapshot::MAX_SIZE];
 	class CSnapshotDelta *m_pSnapshotDelta;
 	int m_NumTimelineMarkers;
 	int m_aTimelineMarkers[MAX_TIMELINE_MARKERS];
 
+	// the game thread only copies the data into the queue, the writer
+	// thread does the delta, the compression and the file io
+	unsigned char *m_pQueue;
+	volatile unsigned m_QueueRead;
+	volatile unsigned m_QueueWrite;
+	void *m_pWriterThread;
+	volatile bool m_WriterShutdown;
+#if !defined(CONF_PLATFORM_MACOSX)
+	SEMAPHORE m_WriterActivity;
+#endif
+
+	// owned by the writer thread while recording
+	CHuffman m_Huffman;
+	int m_LastTickMarker;
+	int m_LastKeyFrame;
+	int m_NumWriteErrors;
+	unsigned char m_aLastSnapshotData[CSnapshot::MAX_SIZE];
+
+	void Enqueue(int Type, int Tick, const void *pData, int Size);
+	static void WriterThread(void *pUser);
+	void WriteItem(const CQueueItem *pItem);
 	void WriteTickMarker(int Tick, int Keyframe);
 	void Write(int Type, const void *pData, int Size);
 public:
@@ -36,7 +68,7 @@ public:
 
 	bool IsRecording() const { return m_File != 0; }
 
-	int Length() const { return (m_LastTickMarker - m_FirstTick)/SERVER_TICK_SPEED; }
+	int Length() const { return (m_LastTick - m_FirstTick)/SERVER_TICK_SPEED; }
 };
 
 class CDemoPlayer : public IDemoPlayer
@@ -85,12 +117,30 @@ private:
 		CKeyFrameSearch *m_pNext;
 	};
 
+	// decoded snapshot as it is before the data of m_Tick is read
+	struct CCheckpoint
+	{
+		long m_Filepos; // right after the tick marker of m_Tick
+		int m_Tick;
+		int m_DataSize;
+		unsigned char *m_pData;
+	};
+
 	class IConsole *m_pConsole;
+	class IStorage *m_pStorage;
+	int m_StorageType;
 	CHuffman m_Huffman;
 	IOHANDLE m_File;
 	char m_aFilename[256];
 	char m_aErrorMsg[256];
 	CKeyFrame *m_pKeyFrames;
+	CCheckpoint *m_pCheckpoints;
+	int m_NumCheckpoints;
+	int m_CheckpointInterval;
+	bool m_CacheCheckpoints;
+	bool m_CheckpointsPrepared;
+	long m_DataStartPos;
+	int64 m_FixedStep;
 
 	CPlaybackInfo m_Info;
 	int m_DemoType;
@@ -101,6 +151,12 @@ private:
 	int ReadChunkHeader(int *pType, int *pSize, int *pTick);
 	void DoTick();
 	void ScanFile();
+	SHA256_DIGEST HashFile();
+	void PrepareCheckpoints();
+	void BuildCheckpoints();
+	bool LoadCheckpoints(const SHA256_DIGEST &Sha256);
+	void SaveCheckpoints(const SHA256_DIGEST &Sha256);
+	void FreeCheckpoints();
 	int NextFrame();
 
 public:
@@ -108,6 +164,8 @@ public:
 	CDemoPlayer(class CSnapshotDelta *m_pSnapshotDelta);
 
 	void SetListener(IListener *pListner);
+	void SetCheckpoints(int Interval, bool Cache);
+	void SetFixedStep(int64 Step); // advance by Step per update instead of the elapsed time, 0 to disable
 
 	const char *Load(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, int StorageType, const char *pNetversion);
 	int Play();
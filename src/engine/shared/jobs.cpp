@@ -9,6 +9,9 @@ CJobPool::CJobPool()
 	m_NumThreads = 0;
 	m_Shutdown = false;
 	m_Lock = lock_create();
+#if !defined(CONF_PLATFORM_MACOSX)
+	semaphore_init(&m_Semaphore);
+#endif
 	m_pFirstJob = 0;
 	m_pLastJob = 0;
 }
@@ -16,44 +19,81 @@ CJobPool::CJobPool()
 CJobPool::~CJobPool()
 {
 	m_Shutdown = true;
+#if !defined(CONF_PLATFORM_MACOSX)
+	for(int i = 0; i < m_NumThreads; i++)
+		semaphore_signal(&m_Semaphore);
+#endif
 	for(int i = 0; i < m_NumThreads; i++)
 	{
 		thread_wait(m_apThreads[i]);
 		thread_destroy(m_apThreads[i]);
 	}
+#if !defined(CONF_PLATFORM_MACOSX)
+	semaphore_destroy(&m_Semaphore);
+#endif
 	lock_destroy(m_Lock);
 }
 
+CJob *CJobPool::PopJob()
+{
+	CJob *pJob = 0;
+
+	// fetch job from queue
+	lock_wait(m_Lock);
+	if(m_pFirstJob)
+	{
+		pJob = m_pFirstJob;
+		m_pFirstJob = m_pFirstJob->m_pNext;
+		if(m_pFirstJob)
+			m_pFirstJob->m_pPrev = 0;
+		else
+			m_pLastJob = 0;
+		pJob->m_Status = CJob::STATE_RUNNING;
+	}
+	lock_unlock(m_Lock);
+	return pJob;
+}
+
+void CJobPool::RunJob(CJob *pJob)
+{
+	pJob->m_Result = pJob->m_pfnFunc(pJob->m_pFuncData);
+
+	// finish under the lock so WaitAll doesn't miss the signal
+	lock_wait(m_Lock);
+	pJob->m_Status = CJob::STATE_DONE;
+#if !defined(CONF_PLATFORM_MACOSX)
+	SEMAPHORE *pDoneSignal = pJob->m_pDoneSignal;
+	pJob->m_pDoneSignal = 0;
+#endif
+	lock_unlock(m_Lock);
+
+#if !defined(CONF_PLATFORM_MACOSX)
+	if(pDoneSignal)
+		semaphore_signal(pDoneSignal);
+#endif
+}
+
 void CJobPool::WorkerThread(void *pUser)
 {
 	CJobPool *pPool = (CJobPool *)pUser;
 
 	while(!pPool->m_Shutdown)
 	{
-		CJob *pJob = 0;
-
-		// fetch job from queue
-		lock_wait(pPool->m_Lock);
-		if(pPool->m_pFirstJob)
-		{
-			pJob = pPool->m_pFirstJob;
-			pPool->m_pFirstJob = pPool->m_pFirstJob->m_pNext;
-			if(pPool->m_pFirstJob)
-				pPool->m_pFirstJob->m_pPrev = 0;
-			else
-				pPool->m_pLastJob = 0;
-		}
-		lock_unlock(pPool->m_Lock);
+#if !defined(CONF_PLATFORM_MACOSX)
+		// sleep until a job is queued
+		semaphore_wait(&pPool->m_Semaphore);
+		if(pPool->m_Shutdown)
+			break;
+#endif
 
-		// do the job if we have one
+		// do the job if we have one, it might have been taken by RunPending already
+		CJob *pJob = pPool->PopJob();
 		if(pJob)
-		{
-			pJob->m_Status = CJob::STATE_RUNNING;
-			pJob->m_Result = pJob->m_pfnFunc(pJob->m_pFuncData);
-			pJob->m_Status = CJob::STATE_DONE;
-		}
+			pPool->RunJob(pJob);
+#if defined(CONF_PLATFORM_MACOSX)
 		else
 			thread_sleep(10);
+#endif
 	}
 
 }
@@ -84,6 +124,51 @@ int CJobPool::Add(CJob *pJob, JOBFUNC pfnFunc, void *pData)
 		m_pFirstJob = pJob;
 
 	lock_unlock(m_Lock);
+
+#if !defined(CONF_PLATFORM_MACOSX)
+	semaphore_signal(&m_Semaphore);
+#endif
 	return 0;
 }
 
+bool CJobPool::RunPending()
+{
+	CJob *pJob = PopJob();
+	if(!pJob)
+		return false;
+	RunJob(pJob);
+	return true;
+}
+
+void CJobPool::WaitAll(CJob **ppJobs, int NumJobs)
+{
+	while(RunPending());
+
+#if !defined(CONF_PLATFORM_MACOSX)
+	// sleep until the workers are done with the jobs that are still running
+	SEMAPHORE DoneSignal;
+	semaphore_init(&DoneSignal);
+	int NumRunning = 0;
+	lock_wait(m_Lock);
+	for(int i = 0; i < NumJobs; i++)
+	{
+		if(ppJobs[i]->m_Status != CJob::STATE_DONE)
+		{
+			ppJobs[i]->m_pDoneSignal = &DoneSignal;
+			NumRunning++;
+		}
+	}
+	lock_unlock(m_Lock);
+
+	while(NumRunning--)
+		semaphore_wait(&DoneSignal);
+	semaphore_destroy(&DoneSignal);
+#else
+	for(int i = 0; i < NumJobs; i++)
+	{
+		while(ppJobs[i]->Status() != CJob::STATE_DONE)
+			thread_sleep(1);
+	}
+#endif
+}
+
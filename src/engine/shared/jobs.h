@@ -2,6 +2,9 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #ifndef ENGINE_SHARED_JOBS_H
 #define ENGINE_SHARED_JOBS_H
+
+#include <base/system.h>
+
 typedef int (*JOBFUNC)(void *pData);
 
 class CJobPool;
@@ -18,6 +21,9 @@ class CJob
 
 	JOBFUNC m_pfnFunc;
 	void *m_pFuncData;
+#if !defined(CONF_PLATFORM_MACOSX)
+	SEMAPHORE *m_pDoneSignal; // set by WaitAll, signaled once the job is done
+#endif
 public:
 	CJob()
 	{
@@ -47,9 +53,14 @@ class CJobPool
 	volatile bool m_Shutdown;
 
 	LOCK m_Lock;
+#if !defined(CONF_PLATFORM_MACOSX)
+	SEMAPHORE m_Semaphore;
+#endif
 	CJob *m_pFirstJob;
 	CJob *m_pLastJob;
 
+	CJob *PopJob();
+	void RunJob(CJob *pJob);
 	static void WorkerThread(void *pUser);
 
 public:
@@ -57,6 +68,12 @@ public:
 	~CJobPool();
 
 	int Init(int NumThreads);
+	int NumThreads() const { return m_NumThreads; }
 	int Add(CJob *pJob, JOBFUNC pfnFunc, void *pData);
+
+	// runs one pending job on the calling thread, returns false if the queue is empty
+	bool RunPending();
+	// blocks until the given jobs are done, helping out with pending ones meanwhile
+	void WaitAll(CJob **ppJobs, int NumJobs);
 };
 #endif
@@ -1,21 +1,73 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
 #include <base/system.h>
 #include <engine/map.h>
 #include <engine/storage.h>
 #include <game/mapitems.h>
+#include "config.h"
 #include "datafile.h"
+#include "jobs.h"
 
 class CMap : public IEngineMap
 {
 	CDataFileReader m_DataFile;
+	CJobPool m_JobPool;
+	bool m_JobPoolStarted;
+
+	// decompresses the data of all layers at once, the game and render components need them right away
+	void PrefetchLayers()
+	{
+		if(!m_JobPoolStarted)
+		{
+			IConfigManager *pConfigManager = Kernel()->RequestInterface<IConfigManager>();
+			m_JobPool.Init(pConfigManager ? pConfigManager->Values()->m_MapLoadThreads : 0);
+			m_JobPoolStarted = true;
+		}
+		if(m_JobPool.NumThreads() == 0)
+			return;
+
+		int LayersStart, LayersNum;
+		m_DataFile.GetType(MAPITEMTYPE_LAYER, &LayersStart, &LayersNum);
+		int *pIndices = (int *)mem_alloc(max(LayersNum*6, 1)*sizeof(int), 1);
+		int NumIndices = 0;
+		for(int l = 0; l < LayersNum; l++)
+		{
+			CMapItemLayer *pLayer = static_cast<CMapItemLayer *>(m_DataFile.GetItem(LayersStart + l, 0, 0));
+			if(pLayer->m_Type == LAYERTYPE_TILES)
+			{
+				CMapItemLayerTilemap *pTilemap = reinterpret_cast<CMapItemLayerTilemap *>(pLayer);
+				pIndices[NumIndices++] = pTilemap->m_Data;
+				// older versions keep the extra layers elsewhere, CLayers sorts that out
+				if(pTilemap->m_Version > 2)
+				{
+					if(pTilemap->m_Flags&TILESLAYERFLAG_TELE)
+						pIndices[NumIndices++] = pTilemap->m_Tele;
+					if(pTilemap->m_Flags&TILESLAYERFLAG_SPEEDUP)
+						pIndices[NumIndices++] = pTilemap->m_Speedup;
+					if(pTilemap->m_Flags&TILESLAYERFLAG_FRONT)
+						pIndices[NumIndices++] = pTilemap->m_Front;
+					if(pTilemap->m_Flags&TILESLAYERFLAG_SWITCH)
+						pIndices[NumIndices++] = pTilemap->m_Switch;
+					if(pTilemap->m_Flags&TILESLAYERFLAG_TUNE)
+						pIndices[NumIndices++] = pTilemap->m_Tune;
+				}
+			}
+			else if(pLayer->m_Type == LAYERTYPE_QUADS)
+				pIndices[NumIndices++] = reinterpret_cast<CMapItemLayerQuads *>(pLayer)->m_Data;
+		}
+		m_DataFile.PrefetchData(&m_JobPool, pIndices, NumIndices);
+		mem_free(pIndices);
+	}
+
 public:
-	CMap() {}
+	CMap() : m_JobPoolStarted(false) {}
 
 	virtual void *GetData(int Index) { return m_DataFile.GetData(Index); }
 	virtual int GetDataSize(int Index) { return m_DataFile.GetDataSize(Index); }
 	virtual void *GetDataSwapped(int Index) { return m_DataFile.GetDataSwapped(Index); }
 	virtual void UnloadData(int Index) { m_DataFile.UnloadData(Index); }
+	virtual void PrefetchData(const int *pIndices, int NumIndices) { m_DataFile.PrefetchData(&m_JobPool, pIndices, NumIndices); }
 	virtual void *GetItem(int Index, int *pType, int *pID) { return m_DataFile.GetItem(Index, pType, pID); }
 	virtual void GetType(int Type, int *pStart, int *pNum) { m_DataFile.GetType(Type, pStart, pNum); }
 	virtual void *FindItem(int Type, int ID) { return m_DataFile.FindItem(Type, ID); }
@@ -39,6 +91,8 @@ public:
 		if(!pItem || pItem->m_Version != CMapItemVersion::CURRENT_VERSION)
 			return false;
 
+		PrefetchLayers();
+
 		// replace compressed tile layers with uncompressed ones
 		int GroupsStart, GroupsNum, LayersStart, LayersNum;
 		m_DataFile.GetType(MAPITEMTYPE_GROUP, &GroupsStart, &GroupsNum);
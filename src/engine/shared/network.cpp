@@ -112,6 +112,10 @@ CNetBase::CNetBase()
 	m_pEngine = 0;
 	m_DataLogSent = 0;
 	m_DataLogRecv = 0;
+	m_NumRecvPackets = 0;
+	m_RecvPacketIndex = 0;
+	m_NumSendPackets = 0;
+	m_SendBatch = false;
 }
 
 CNetBase::~CNetBase()
@@ -127,12 +131,24 @@ void CNetBase::Init(NETSOCKET Socket, CConfig *pConfig, IConsole *pConsole, IEng
 	m_pEngine = pEngine;
 	m_Huffman.Init();
 	mem_zero(m_aRequestTokenBuf, sizeof(m_aRequestTokenBuf));
+	for(int i = 0; i < RECV_BATCH_SIZE; i++)
+		m_aRecvPackets[i].data = m_aaRecvBuffers[i];
+	for(int i = 0; i < SEND_BATCH_SIZE; i++)
+		m_aSendPackets[i].data = m_aaSendBuffers[i];
+	m_NumRecvPackets = 0;
+	m_RecvPacketIndex = 0;
+	m_NumSendPackets = 0;
+	m_SendBatch = false;
 	if(pEngine)
 		pConsole->Chain("dbg_lognetwork", ConchainDbgLognetwork, this);
 }
 
 void CNetBase::Shutdown()
 {
+	FlushDatagrams();
+	m_SendBatch = false;
+	m_NumRecvPackets = 0;
+	m_RecvPacketIndex = 0;
 	net_udp_close(m_Socket);
 	net_invalidate_socket(&m_Socket);
 }
@@ -142,6 +158,42 @@ void CNetBase::Wait(int Time)
 	net_socket_read_wait(m_Socket, Time);
 }
 
+void CNetBase::SendDatagram(const NETADDR *pAddr, const void *pData, int Size)
+{
+	if(!m_SendBatch)
+	{
+		net_udp_send(m_Socket, pAddr, pData, Size);
+		return;
+	}
+
+	if(m_NumSendPackets == SEND_BATCH_SIZE)
+		FlushDatagrams();
+
+	NETPACKET *pPacket = &m_aSendPackets[m_NumSendPackets++];
+	pPacket->addr = *pAddr;
+	pPacket->size = Size;
+	mem_copy(pPacket->data, pData, Size);
+}
+
+void CNetBase::FlushDatagrams()
+{
+	if(m_NumSendPackets)
+		net_udp_send_batch(m_Socket, m_aSendPackets, m_NumSendPackets);
+	m_NumSendPackets = 0;
+}
+
+// holds back all packets until EndSendBatch and sends them together
+void CNetBase::BeginSendBatch()
+{
+	m_SendBatch = true;
+}
+
+void CNetBase::EndSendBatch()
+{
+	FlushDatagrams();
+	m_SendBatch = false;
+}
+
 // packs the data tight and sends it
 void CNetBase::SendPacketConnless(const NETADDR *pAddr, TOKEN Token, TOKEN ResponseToken, const void *pData, int DataSize)
 {
@@ -165,7 +217,7 @@ void CNetBase::SendPacketConnless(const NETADDR *pAddr, TOKEN Token, TOKEN Respo
 	dbg_assert(i == NET_PACKETHEADERSIZE_CONNLESS, "inconsistency");
 
 	mem_copy(&aBuffer[i], pData, DataSize);
-	net_udp_send(m_Socket, pAddr, aBuffer, i+DataSize);
+	SendDatagram(pAddr, aBuffer, i+DataSize);
 }
 
 void CNetBase::SendPacket(const NETADDR *pAddr, CNetPacketConstruct *pPacket)
@@ -220,7 +272,7 @@ void CNetBase::SendPacket(const NETADDR *pAddr, CNetPacketConstruct *pPacket)
 
 		dbg_assert(i == NET_PACKETHEADERSIZE, "inconsistency");
 
-		net_udp_send(m_Socket, pAddr, aBuffer, FinalSize);
+		SendDatagram(pAddr, aBuffer, FinalSize);
 
 		// log raw socket data
 		if(m_DataLogSent)
@@ -237,10 +289,23 @@ void CNetBase::SendPacket(const NETADDR *pAddr, CNetPacketConstruct *pPacket)
 // TODO: rename this function
 int CNetBase::UnpackPacket(NETADDR *pAddr, unsigned char *pBuffer, CNetPacketConstruct *pPacket)
 {
-	int Size = net_udp_recv(m_Socket, pAddr, pBuffer, NET_MAX_PACKETSIZE);
-	// no more packets for now
-	if(Size <= 0)
-		return 1;
+	// fetch a batch of datagrams once all received ones are processed
+	if(m_RecvPacketIndex == m_NumRecvPackets)
+	{
+		m_RecvPacketIndex = 0;
+		m_NumRecvPackets = net_udp_recv_batch(m_Socket, m_aRecvPackets, RECV_BATCH_SIZE, NET_MAX_PACKETSIZE);
+		// no more packets for now
+		if(m_NumRecvPackets <= 0)
+		{
+			m_NumRecvPackets = 0;
+			return 1;
+		}
+	}
+
+	const NETPACKET *pDatagram = &m_aRecvPackets[m_RecvPacketIndex++];
+	*pAddr = pDatagram->addr;
+	int Size = pDatagram->size;
+	mem_copy(pBuffer, pDatagram->data, Size);
 
 	// log the data
 	if(m_DataLogRecv)
@@ -199,6 +199,13 @@ class CNetBase
 	};
 	static CNetInitializer m_NetInitializer;
 
+	enum
+	{
+		// datagrams per batched socket call
+		RECV_BATCH_SIZE = 32,
+		SEND_BATCH_SIZE = 64,
+	};
+
 	class CConfig *m_pConfig;
 	class IEngine *m_pEngine;
 	NETSOCKET m_Socket;
@@ -207,12 +214,28 @@ class CNetBase
 	CHuffman m_Huffman;
 	unsigned char m_aRequestTokenBuf[NET_TOKENREQUEST_DATASIZE];
 
+	// received datagrams that haven't been unpacked yet
+	NETPACKET m_aRecvPackets[RECV_BATCH_SIZE];
+	unsigned char m_aaRecvBuffers[RECV_BATCH_SIZE][NET_MAX_PACKETSIZE];
+	int m_NumRecvPackets;
+	int m_RecvPacketIndex;
+
+	// datagrams held back while a send batch is open
+	NETPACKET m_aSendPackets[SEND_BATCH_SIZE];
+	unsigned char m_aaSendBuffers[SEND_BATCH_SIZE][NET_MAX_PACKETSIZE];
+	int m_NumSendPackets;
+	bool m_SendBatch;
+
+	void SendDatagram(const NETADDR *pAddr, const void *pData, int Size);
+	void FlushDatagrams();
+
 public:
 	CNetBase();
 	~CNetBase();
 	CConfig *Config() { return m_pConfig; }
 	class IEngine *Engine() { return m_pEngine; }
 	int NetType() { return m_Socket.type; }
+	NETSOCKET Socket() const { return m_Socket; }
 	
 	void Init(NETSOCKET Socket, class CConfig *pConfig, class IConsole *pConsole, class IEngine *pEngine);
 	void Shutdown();
@@ -223,6 +246,8 @@ public:
 	void SendControlMsgWithToken(const NETADDR *pAddr, TOKEN Token, int Ack, int ControlMsg, TOKEN MyToken, bool Extended);
 	void SendPacketConnless(const NETADDR *pAddr, TOKEN Token, TOKEN ResponseToken, const void *pData, int DataSize);
 	void SendPacket(const NETADDR *pAddr, CNetPacketConstruct *pPacket);
+	void BeginSendBatch();
+	void EndSendBatch();
 	int UnpackPacket(NETADDR *pAddr, unsigned char *pBuffer, CNetPacketConstruct *pPacket);
 };
 
@@ -445,14 +470,24 @@ public:
 // server side
 class CNetServer : public CNetBase
 {
+	enum
+	{
+		SLOT_HASH_SIZE = 256,
+	};
+
 	struct CSlot
 	{
 	public:
 		CNetConnection m_Connection;
+		int m_Hash; // chain the slot is linked into, -1 if the slot is free
+		int m_NextHash;
 	};
 
 	class CNetBan *m_pNetBan;
 	CSlot m_aSlots[NET_MAX_CLIENTS];
+
+	// connected slots chained by the hash of their ip
+	int m_aSlotHash[SLOT_HASH_SIZE];
 	int m_NumClients;
 	int m_MaxClients;
 	int m_MaxClientsPerIP;
@@ -466,6 +501,12 @@ class CNetServer : public CNetBase
 	CNetTokenManager m_TokenManager;
 	CNetTokenCache m_TokenCache;
 
+	static int SlotHash(const NETADDR *pAddr);
+	void AddSlotHash(int ClientID);
+	void RemoveSlotHash(int ClientID);
+	int FindSlot(const NETADDR *pAddr) const;
+	int NumClientsWithIP(const NETADDR *pAddr) const;
+
 public:
 	//
 	bool Open(NETADDR BindAddr, class CConfig *pConfig, class IConsole *pConsole, class IEngine *pEngine, class CNetBan *pNetBan,
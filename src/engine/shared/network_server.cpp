@@ -32,7 +32,13 @@ bool CNetServer::Open(NETADDR BindAddr, CConfig *pConfig, IConsole *pConsole, IE
 	SetMaxClientsPerIP(MaxClientsPerIP);
 
 	for(int i = 0; i < NET_MAX_CLIENTS; i++)
+	{
 		m_aSlots[i].m_Connection.Init(this, true);
+		m_aSlots[i].m_Hash = -1;
+		m_aSlots[i].m_NextHash = -1;
+	}
+	for(int i = 0; i < SLOT_HASH_SIZE; i++)
+		m_aSlotHash[i] = -1;
 
 	m_pfnNewClient = pfnNewClient;
 	m_pfnDelClient = pfnDelClient;
@@ -51,23 +57,84 @@ void CNetServer::Close()
 
 void CNetServer::Drop(int ClientID, const char *pReason)
 {
-	if(ClientID < 0 || ClientID >= NET_MAX_CLIENTS || m_aSlots[ClientID].m_Connection.State() == NET_CONNSTATE_OFFLINE)
+	// the connection may already be offline, e.g. after running out of buffer
+	if(ClientID < 0 || ClientID >= NET_MAX_CLIENTS || m_aSlots[ClientID].m_Hash == -1)
 		return;
 
 	if(m_pfnDelClient)
 		m_pfnDelClient(ClientID, pReason, m_UserPtr);
 
+	RemoveSlotHash(ClientID);
 	m_aSlots[ClientID].m_Connection.Disconnect(pReason);
 	m_NumClients--;
 }
 
+// only the ip is hashed, so all clients with the same ip share a chain
+int CNetServer::SlotHash(const NETADDR *pAddr)
+{
+	int Size = pAddr->type == NETTYPE_IPV4 ? NETADDR_SIZE_IPV4 : NETADDR_SIZE_IPV6;
+	unsigned Hash = pAddr->type;
+	for(int i = 0; i < Size; i++)
+		Hash = Hash*31 + pAddr->ip[i];
+	return (Hash^(Hash>>8)^(Hash>>16)) & (SLOT_HASH_SIZE-1);
+}
+
+void CNetServer::AddSlotHash(int ClientID)
+{
+	RemoveSlotHash(ClientID);
+	int Hash = SlotHash(m_aSlots[ClientID].m_Connection.PeerAddress());
+	m_aSlots[ClientID].m_Hash = Hash;
+	m_aSlots[ClientID].m_NextHash = m_aSlotHash[Hash];
+	m_aSlotHash[Hash] = ClientID;
+}
+
+// uses the remembered chain, the peer address is gone once the connection went offline
+void CNetServer::RemoveSlotHash(int ClientID)
+{
+	if(m_aSlots[ClientID].m_Hash == -1)
+		return;
+
+	int *pLink = &m_aSlotHash[m_aSlots[ClientID].m_Hash];
+	while(*pLink != -1 && *pLink != ClientID)
+		pLink = &m_aSlots[*pLink].m_NextHash;
+	if(*pLink == ClientID)
+		*pLink = m_aSlots[ClientID].m_NextHash;
+	m_aSlots[ClientID].m_Hash = -1;
+	m_aSlots[ClientID].m_NextHash = -1;
+}
+
+int CNetServer::FindSlot(const NETADDR *pAddr) const
+{
+	for(int i = m_aSlotHash[SlotHash(pAddr)]; i != -1; i = m_aSlots[i].m_NextHash)
+	{
+		if(m_aSlots[i].m_Connection.State() != NET_CONNSTATE_OFFLINE && net_addr_comp(m_aSlots[i].m_Connection.PeerAddress(), pAddr, true) == 0)
+			return i;
+	}
+	return -1;
+}
+
+int CNetServer::NumClientsWithIP(const NETADDR *pAddr) const
+{
+	int Num = 0;
+	for(int i = m_aSlotHash[SlotHash(pAddr)]; i != -1; i = m_aSlots[i].m_NextHash)
+	{
+		if(m_aSlots[i].m_Connection.State() != NET_CONNSTATE_OFFLINE && net_addr_comp(m_aSlots[i].m_Connection.PeerAddress(), pAddr, false) == 0)
+			Num++;
+	}
+	return Num;
+}
+
 int CNetServer::Update()
 {
 	int64 Now = time_get();
 	for(int i = 0; i < NET_MAX_CLIENTS; i++)
 	{
 		if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE)
+		{
+			// went offline without being dropped, free the slot
+			Drop(i, m_aSlots[i].m_Connection.ErrorString());
 			continue;
+		}
 
 		m_aSlots[i].m_Connection.Update();
 		if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_ERROR)
@@ -122,40 +189,31 @@ int CNetServer::Recv(CNetChunk *pChunk, TOKEN *pResponseToken)
 				continue;
 			}
 
-			bool Found = false;
 			// try to find matching slot
-			for(int i = 0; i < NET_MAX_CLIENTS; i++)
+			int Slot = FindSlot(&Addr);
+			if(Slot != -1)
 			{
-				if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE)
-					continue;
-
-				if(net_addr_comp(m_aSlots[i].m_Connection.PeerAddress(), &Addr, true) == 0)
+				if(m_aSlots[Slot].m_Connection.Feed(&m_RecvUnpacker.m_Data, &Addr))
 				{
-					if(m_aSlots[i].m_Connection.Feed(&m_RecvUnpacker.m_Data, &Addr))
+					if(m_RecvUnpacker.m_Data.m_DataSize)
 					{
-						if(m_RecvUnpacker.m_Data.m_DataSize)
+						if(!(m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_CONNLESS))
+							m_RecvUnpacker.Start(&Addr, &m_aSlots[Slot].m_Connection, Slot);
+						else
 						{
-							if(!(m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_CONNLESS))
-								m_RecvUnpacker.Start(&Addr, &m_aSlots[i].m_Connection, i);
-							else
-							{
-								pChunk->m_Flags = NETSENDFLAG_CONNLESS;
-								pChunk->m_Address = *m_aSlots[i].m_Connection.PeerAddress();
-								pChunk->m_ClientID = i;
-								pChunk->m_DataSize = m_RecvUnpacker.m_Data.m_DataSize;
-								pChunk->m_pData = m_RecvUnpacker.m_Data.m_aChunkData;
-								if(pResponseToken)
-									*pResponseToken = NET_TOKEN_NONE;
-								return 1;
-							}
+							pChunk->m_Flags = NETSENDFLAG_CONNLESS;
+							pChunk->m_Address = *m_aSlots[Slot].m_Connection.PeerAddress();
+							pChunk->m_ClientID = Slot;
+							pChunk->m_DataSize = m_RecvUnpacker.m_Data.m_DataSize;
+							pChunk->m_pData = m_RecvUnpacker.m_Data.m_aChunkData;
+							if(pResponseToken)
+								*pResponseToken = NET_TOKEN_NONE;
+							return 1;
 						}
 					}
-					Found = true;
 				}
-			}
-
-			if(Found)
 				continue;
+			}
 
 			int Accept = m_TokenManager.ProcessMessage(&Addr, &m_RecvUnpacker.m_Data);
 			if(Accept <= 0)
@@ -174,39 +232,27 @@ int CNetServer::Recv(CNetChunk *pChunk, TOKEN *pResponseToken)
 					}
 
 					// only allow a specific number of players with the same ip
-					int FoundAddr = 1;
-					
-					bool Continue = false;
-					for(int i = 0; i < NET_MAX_CLIENTS; i++)
+					if(NumClientsWithIP(&Addr) >= m_MaxClientsPerIP)
 					{
-						if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE)
-							continue;
-
-						if(!net_addr_comp(&Addr, m_aSlots[i].m_Connection.PeerAddress(), false))
-						{
-							if(FoundAddr++ >= m_MaxClientsPerIP)
-							{
-								char aBuf[128];
-								str_format(aBuf, sizeof(aBuf), "Only %d players with the same IP are allowed", m_MaxClientsPerIP);
-								SendControlMsg(&Addr, m_RecvUnpacker.m_Data.m_ResponseToken, 0, NET_CTRLMSG_CLOSE, aBuf, str_length(aBuf) + 1);
-								Continue = true;
-								break;
-							}
-						}
-					}
-
-					if(Continue)
+						char aBuf[128];
+						str_format(aBuf, sizeof(aBuf), "Only %d players with the same IP are allowed", m_MaxClientsPerIP);
+						SendControlMsg(&Addr, m_RecvUnpacker.m_Data.m_ResponseToken, 0, NET_CTRLMSG_CLOSE, aBuf, str_length(aBuf) + 1);
 						continue;
+					}
 
 					for(int i = 0; i < NET_MAX_CLIENTS; i++)
 					{
-						if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE)
+						if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE && m_aSlots[i].m_Hash == -1)
 						{
-							m_NumClients++;
 							m_aSlots[i].m_Connection.SetToken(m_RecvUnpacker.m_Data.m_Token);
 							m_aSlots[i].m_Connection.Feed(&m_RecvUnpacker.m_Data, &Addr);
-							if(m_pfnNewClient)
-								m_pfnNewClient(i, m_UserPtr);
+							if(m_aSlots[i].m_Connection.State() != NET_CONNSTATE_OFFLINE)
+							{
+								m_NumClients++;
+								AddSlotHash(i);
+								if(m_pfnNewClient)
+									m_pfnNewClient(i, m_UserPtr);
+							}
 							break;
 						}
 					}
@@ -240,21 +286,9 @@ int CNetServer::Send(CNetChunk *pChunk, TOKEN Token)
 			return -1;
 		}
 
+		// upgrade the packet, if we know its recipent
 		if(pChunk->m_ClientID == -1)
-		{
-			for(int i = 0; i < NET_MAX_CLIENTS; i++)
-			{
-				if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE)
-					continue;
-
-				if(net_addr_comp(&pChunk->m_Address, m_aSlots[i].m_Connection.PeerAddress(), true) == 0)
-				{
-					// upgrade the packet, now that we know its recipent
-					pChunk->m_ClientID = i;
-					break;
-				}
-			}
-		}
+			pChunk->m_ClientID = FindSlot(&pChunk->m_Address);
 
 		if(Token != NET_TOKEN_NONE)
 		{
@@ -6,6 +6,11 @@
 #include "compression.h"
 #include "uuid_manager.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define SNAPSHOT_DELTA_SSE2 1
+	#include <emmintrin.h>
+#endif
+
 // CSnapshot
 
 const CSnapshotItem *CSnapshot::GetItem(int Index) const
@@ -103,6 +108,26 @@ void CSnapshot::InvalidateItem(int Index)
 	}
 }
 
+bool CSnapshot::IsValid(int ActualSize) const
+{
+	if(ActualSize < (int)sizeof(CSnapshot) || m_NumItems < 0 || m_DataSize < 0 ||
+		m_NumItems > (ActualSize-(int)sizeof(CSnapshot))/(int)(2*sizeof(int)))
+		return false;
+	if((int)sizeof(CSnapshot) + m_NumItems*(int)(2*sizeof(int)) + m_DataSize != ActualSize)
+		return false;
+
+	// items are stored back to back, so increasing offsets keep every size in range
+	int Prev = -(int)sizeof(CSnapshotItem);
+	for(int i = 0; i < m_NumItems; i++)
+	{
+		int Offset = Offsets()[i];
+		if(Offset%sizeof(int) != 0 || Offset < Prev+(int)sizeof(CSnapshotItem) || Offset > m_DataSize-(int)sizeof(CSnapshotItem))
+			return false;
+		Prev = Offset;
+	}
+	return true;
+}
+
 int CSnapshot::Serialize(char *pDstData)
 {
 	int *pData = (int*)pDstData;
@@ -146,59 +171,67 @@ void CSnapshot::DebugDump() const
 
 // CSnapshotDelta
 
-struct CItemList
-{
-	int m_Num;
-	int m_aKeys[64];
-	int m_aIndex[64];
-};
-
 enum
 {
-	HASHLIST_SIZE = 256,
+	MAX_DELTA_ITEMS = 1024,
 };
 
-static void GenerateHash(CItemList *pHashlist, const CSnapshot *pSnapshot)
+/*
+	Item matching for the deltas. Snapshots keep their items sorted by key,
+	so the items of two snapshots are matched by walking both key lists at
+	once. Only snapshots with invalidated items need to be sorted first.
+*/
+static void GatherKeys(const CSnapshot *pSnapshot, int *pKeys, int *pIndices)
 {
-	for(int i = 0; i < HASHLIST_SIZE; i++)
-		pHashlist[i].m_Num = 0;
-
 	for(int i = 0; i < pSnapshot->NumItems(); i++)
 	{
 		int Key = pSnapshot->GetItem(i)->Key();
-		int HashID = ((Key>>12)&0xf0) | (Key&0xf);
-		if(pHashlist[HashID].m_Num != 64)
+
+		// stable insertion sort, a single pass for sorted snapshots
+		int j = i;
+		for(; j > 0 && pKeys[j-1] > Key; j--)
 		{
-			pHashlist[HashID].m_aIndex[pHashlist[HashID].m_Num] = i;
-			pHashlist[HashID].m_aKeys[pHashlist[HashID].m_Num] = Key;
-			pHashlist[HashID].m_Num++;
+			pKeys[j] = pKeys[j-1];
+			pIndices[j] = pIndices[j-1];
 		}
+		pKeys[j] = Key;
+		pIndices[j] = i;
 	}
 }
 
-static int GetItemIndexHashed(int Key, const CItemList *pHashlist)
+// finds the index of every item in the other snapshot, or -1
+static void MatchKeys(const int *pKeys, const int *pIndices, int Num, const int *pOtherKeys, const int *pOtherIndices, int NumOther, int *pMatches)
 {
-		int HashID = ((Key>>12)&0xf0) | (Key&0xf);
-		for(int i = 0; i < pHashlist[HashID].m_Num; i++)
-		{
-			if(pHashlist[HashID].m_aKeys[i] == Key)
-				return pHashlist[HashID].m_aIndex[i];
+	int Other = 0;
+	for(int i = 0; i < Num; i++)
+	{
+		while(Other < NumOther && pOtherKeys[Other] < pKeys[i])
+			Other++;
+		if(Other < NumOther && pOtherKeys[Other] == pKeys[i])
+			pMatches[pIndices[i]] = pOtherIndices[Other];
+		else
+			pMatches[pIndices[i]] = -1;
 	}
-
-	return -1;
 }
 
 static int DiffItem(const int *pPast, const int *pCurrent, int *pOut, int Size)
 {
 	int Needed = 0;
-	while(Size)
+	int i = 0;
+#if defined(SNAPSHOT_DELTA_SSE2)
+	__m128i NeededVec = _mm_setzero_si128();
+	for(; i+4 <= Size; i += 4)
 	{
-		*pOut = *pCurrent-*pPast;
-		Needed |= *pOut;
-		pOut++;
-		pPast++;
-		pCurrent++;
-		Size--;
+		__m128i Diff = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(pCurrent+i)), _mm_loadu_si128((const __m128i *)(pPast+i)));
+		_mm_storeu_si128((__m128i *)(pOut+i), Diff);
+		NeededVec = _mm_or_si128(NeededVec, Diff);
+	}
+	Needed = _mm_movemask_epi8(_mm_cmpeq_epi32(NeededVec, _mm_setzero_si128())) != 0xffff;
+#endif
+	for(; i < Size; i++)
+	{
+		pOut[i] = pCurrent[i]-pPast[i];
+		Needed |= pOut[i];
 	}
 
 	return Needed;
@@ -206,24 +239,24 @@ static int DiffItem(const int *pPast, const int *pCurrent, int *pOut, int Size)
 
 void CSnapshotDelta::UndiffItem(const int *pPast, const int *pDiff, int *pOut, int Size)
 {
-	while(Size)
-	{
-		*pOut = *pPast+*pDiff;
+	int i = 0;
+#if defined(SNAPSHOT_DELTA_SSE2)
+	for(; i+4 <= Size; i += 4)
+		_mm_storeu_si128((__m128i *)(pOut+i), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(pPast+i)), _mm_loadu_si128((const __m128i *)(pDiff+i))));
+#endif
+	for(; i < Size; i++)
+		pOut[i] = pPast[i]+pDiff[i];
 
-		if(*pDiff == 0)
-			m_aSnapshotDataRate[m_SnapshotCurrent] += 1;
+	// data rate statistics, the size the diff takes in the packed delta
+	int Rate = 0;
+	for(i = 0; i < Size; i++)
+	{
+		if(pDiff[i] == 0)
+			Rate += 1;
 		else
-		{
-			unsigned char aBuf[16];
-			unsigned char *pEnd = CVariableInt::Pack(aBuf, *pDiff);
-			m_aSnapshotDataRate[m_SnapshotCurrent] += (int)(pEnd - (unsigned char*)aBuf) * 8;
-		}
-
-		pOut++;
-		pPast++;
-		pDiff++;
-		Size--;
+			Rate += CVariableInt::PackedSize(pDiff[i]) * 8;
 	}
+	m_aSnapshotDataRate[m_SnapshotCurrent] += Rate;
 }
 
 CSnapshotDelta::CSnapshotDelta()
@@ -247,13 +280,11 @@ CSnapshotDelta::CData *CSnapshotDelta::EmptyDelta()
 	return &m_Empty;
 }
 
-// TODO: OPT: this should be made much faster
 int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, CSnapshot *pTo, void *pDstData)
 {
 	CData *pDelta = (CData *)pDstData;
 	int *pData = (int *)pDelta->m_pData;
 	int i, ItemSize, PastIndex;
-	const CSnapshotItem *pFromItem;
 	const CSnapshotItem *pCurItem;
 	const CSnapshotItem *pPastItem;
 	int SizeCount = 0;
@@ -262,34 +293,31 @@ int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, CSnapshot *pTo, void *pD
 	pDelta->m_NumUpdateItems = 0;
 	pDelta->m_NumTempItems = 0;
 
-	CItemList Hashlist[HASHLIST_SIZE];
-	GenerateHash(Hashlist, pTo);
+	int aFromKeys[MAX_DELTA_ITEMS];
+	int aFromIndices[MAX_DELTA_ITEMS];
+	int aToKeys[MAX_DELTA_ITEMS];
+	int aToIndices[MAX_DELTA_ITEMS];
+	int aFutureIndices[MAX_DELTA_ITEMS];
+	int aPastIndecies[MAX_DELTA_ITEMS];
+	const int NumItems = pTo->NumItems();
+
+	GatherKeys(pFrom, aFromKeys, aFromIndices);
+	GatherKeys(pTo, aToKeys, aToIndices);
+	MatchKeys(aFromKeys, aFromIndices, pFrom->NumItems(), aToKeys, aToIndices, NumItems, aFutureIndices);
+	MatchKeys(aToKeys, aToIndices, NumItems, aFromKeys, aFromIndices, pFrom->NumItems(), aPastIndecies);
 
 	// pack deleted stuff
 	for(i = 0; i < pFrom->NumItems(); i++)
 	{
-		pFromItem = pFrom->GetItem(i);
-		if(GetItemIndexHashed(pFromItem->Key(), Hashlist) == -1)
+		if(aFutureIndices[i] == -1)
 		{
 			// deleted
 			pDelta->m_NumDeletedItems++;
-			*pData = pFromItem->Key();
+			*pData = pFrom->GetItem(i)->Key();
 			pData++;
 		}
 	}
 
-	GenerateHash(Hashlist, pFrom);
-	int aPastIndecies[1024];
-
-	// fetch previous indices
-	// we do this as a separate pass because it helps the cache
-	const int NumItems = pTo->NumItems();
-	for(i = 0; i < NumItems; i++)
-	{
-		pCurItem = pTo->GetItem(i); // O(1) .. O(n)
-		aPastIndecies[i] = GetItemIndexHashed(pCurItem->Key(), Hashlist); // O(n) .. O(n^n)
-	}
-
 	for(i = 0; i < NumItems; i++)
 	{
 		// do delta
@@ -475,6 +503,43 @@ void CSnapshotStorage::Init()
 {
 	m_pFirst = 0;
 	m_pLast = 0;
+	m_pCurrentChunk = 0;
+	m_pFreeChunks = 0;
+	m_AllocatedSize = 0;
+	m_UsedSize = 0;
+}
+
+void CSnapshotStorage::FreeChunk(CChunk *pChunk)
+{
+	m_AllocatedSize -= CHUNK_SIZE;
+	mem_free(pChunk);
+}
+
+void CSnapshotStorage::FreeHolder(CHolder *pHolder)
+{
+	m_UsedSize -= pHolder->m_AllocSize;
+
+	CChunk *pChunk = pHolder->m_pChunk;
+	if(!pChunk)
+	{
+		m_AllocatedSize -= pHolder->m_AllocSize;
+		mem_free(pHolder);
+		return;
+	}
+
+	if(--pChunk->m_NumHolders > 0)
+		return;
+
+	if(pChunk == m_pCurrentChunk)
+	{
+		// empty again, start over at its beginning
+		pChunk->m_Used = 0;
+	}
+	else
+	{
+		pChunk->m_pNext = m_pFreeChunks;
+		m_pFreeChunks = pChunk;
+	}
 }
 
 void CSnapshotStorage::PurgeAll()
@@ -485,10 +550,21 @@ void CSnapshotStorage::PurgeAll()
 	while(pHolder)
 	{
 		pNext = pHolder->m_pNext;
-		mem_free(pHolder);
+		FreeHolder(pHolder);
 		pHolder = pNext;
 	}
 
+	// give the chunks back, the storage might stay unused for a while
+	if(m_pCurrentChunk)
+		FreeChunk(m_pCurrentChunk);
+	while(m_pFreeChunks)
+	{
+		CChunk *pChunk = m_pFreeChunks;
+		m_pFreeChunks = pChunk->m_pNext;
+		FreeChunk(pChunk);
+	}
+	m_pCurrentChunk = 0;
+
 	// no more snapshots in storage
 	m_pFirst = 0;
 	m_pLast = 0;
@@ -504,7 +580,7 @@ void CSnapshotStorage::PurgeUntil(int Tick)
 		pNext = pHolder->m_pNext;
 		if(pHolder->m_Tick >= Tick)
 			return; // no more to remove
-		mem_free(pHolder);
+		FreeHolder(pHolder);
 
 		// did we come to the end of the list?
 		if (!pNext)
@@ -528,8 +604,43 @@ void CSnapshotStorage::Add(int Tick, int64 Tagtime, int DataSize, void *pData, i
 
 	if(CreateAlt)
 		TotalSize += DataSize;
+	TotalSize = (TotalSize+7)&~7;
 
-	CHolder *pHolder = (CHolder *)mem_alloc(TotalSize, 1);
+	CHolder *pHolder;
+	if(TotalSize > CHUNK_SIZE-ChunkDataOffset())
+	{
+		// too large for a chunk, only happens for huge snapshots
+		pHolder = (CHolder *)mem_alloc(TotalSize, 1);
+		pHolder->m_pChunk = 0;
+		m_AllocatedSize += TotalSize;
+	}
+	else
+	{
+		if(!m_pCurrentChunk || ChunkDataOffset()+m_pCurrentChunk->m_Used+TotalSize > CHUNK_SIZE)
+		{
+			// the current chunk is full, it is recycled once its holders are purged
+			if(m_pFreeChunks)
+			{
+				m_pCurrentChunk = m_pFreeChunks;
+				m_pFreeChunks = m_pFreeChunks->m_pNext;
+			}
+			else
+			{
+				m_pCurrentChunk = (CChunk *)mem_alloc(CHUNK_SIZE, 1);
+				m_AllocatedSize += CHUNK_SIZE;
+			}
+			m_pCurrentChunk->m_pNext = 0;
+			m_pCurrentChunk->m_Used = 0;
+			m_pCurrentChunk->m_NumHolders = 0;
+		}
+
+		pHolder = (CHolder *)((char *)m_pCurrentChunk + ChunkDataOffset() + m_pCurrentChunk->m_Used);
+		pHolder->m_pChunk = m_pCurrentChunk;
+		m_pCurrentChunk->m_Used += TotalSize;
+		m_pCurrentChunk->m_NumHolders++;
+	}
+	pHolder->m_AllocSize = TotalSize;
+	m_UsedSize += TotalSize;
 
 	// set data
 	pHolder->m_Tick = Tick;
@@ -586,6 +697,11 @@ CSnapshotBuilder::CSnapshotBuilder()
 	m_NumExtendedItemTypes = 0;
 }
 
+static int GetTypeFromIndex(int Index)
+{
+	return CSnapshot::MAX_TYPE - Index;
+}
+
 void CSnapshotBuilder::Init()
 {
 	m_DataSize = 0;
@@ -614,6 +730,13 @@ void CSnapshotBuilder::Init(const CSnapshot *pSnapshot)
 	m_NumItems = pSnapshot->m_NumItems;
 	mem_copy(m_aOffsets, pSnapshot->Offsets(), sizeof(int)*m_NumItems);
 	mem_copy(m_aData, pSnapshot->DataStart(), m_DataSize);
+
+	// items of extended types registered after pSnapshot was built need their type item too
+	for(int i = 0; i < m_NumExtendedItemTypes; i++)
+	{
+		if(pSnapshot->GetItemIndex(0, GetTypeFromIndex(i)) < 0)
+			AddExtendedItemType(i);
+	}
 }
 
 bool CSnapshotBuilder::UnserializeSnap(const char *pSrcData, int SrcSize)
@@ -726,11 +849,6 @@ int CSnapshotBuilder::Finish(void *pSnapdata)
 	return sizeof(CSnapshot) + KeySize + OffsetSize + m_DataSize;
 }
 
-static int GetTypeFromIndex(int Index)
-{
-	return CSnapshot::MAX_TYPE - Index;
-}
-
 void CSnapshotBuilder::AddExtendedItemType(int Index)
 {
 	dbg_assert(0 <= Index && Index < m_NumExtendedItemTypes, "index out of range");
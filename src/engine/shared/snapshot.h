@@ -51,6 +51,7 @@ public:
 	int GetItemType(int Index) const;
 
 	void InvalidateItem(int Index);
+	bool IsValid(int ActualSize) const; // header, offsets and item sizes fit ActualSize bytes
 
 	int Serialize(char *pDstData);
 
@@ -101,6 +102,36 @@ public:
 
 class CSnapshotStorage
 {
+public:
+	class CHolder;
+
+private:
+	// Holders are allocated in order of their ticks and purged from the
+	// oldest one, so they are bump allocated from chunks. A chunk goes back
+	// to the free list when its last holder was purged, which means no heap
+	// allocations once enough chunks for the stored ticks exist.
+	enum
+	{
+		CHUNK_SIZE = 64*1024,
+	};
+
+	class CChunk
+	{
+	public:
+		CChunk *m_pNext;
+		int m_Used;
+		int m_NumHolders;
+	};
+
+	CChunk *m_pCurrentChunk;
+	CChunk *m_pFreeChunks;
+	int m_AllocatedSize;
+	int m_UsedSize;
+
+	static int ChunkDataOffset() { return (sizeof(CChunk)+7)&~7; }
+	void FreeHolder(CHolder *pHolder);
+	void FreeChunk(CChunk *pChunk);
+
 public:
 	class CHolder
 	{
@@ -114,6 +145,9 @@ public:
 		int m_SnapSize;
 		CSnapshot *m_pSnap;
 		CSnapshot *m_pAltSnap;
+
+		CChunk *m_pChunk; // 0 if the holder didn't fit into a chunk
+		int m_AllocSize;
 	};
 
 
@@ -125,6 +159,10 @@ public:
 	void PurgeUntil(int Tick);
 	void Add(int Tick, int64 Tagtime, int DataSize, void *pData, int CreateAlt);
 	int Get(int Tick, int64 *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData);
+
+	// memory held by the storage and the part of it used by stored snapshots
+	int AllocatedSize() const { return m_AllocatedSize; }
+	int UsedSize() const { return m_UsedSize; }
 };
 
 class CSnapshotBuilder
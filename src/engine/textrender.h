@@ -63,6 +63,14 @@ public:
 	vec4 m_SecondaryColor;
 };
 
+// glyph quad relative to the cursor anchor, kept between frames
+struct CGlyphQuad
+{
+	IGraphics::CTileQuadItem m_Item;
+	float m_LineOffsetX;
+	int m_AtlasIndex;
+};
+
 struct CTextBoundingBox
 {
 	float x, y, w, h;
@@ -91,6 +99,11 @@ class CTextCursor
 	array<CScaledGlyph> m_Glyphs;
 	int64 m_StringVersion;
 
+	// quads are rebuilt when the layout, the alignment or the glyph atlas changed
+	array<CGlyphQuad> m_Quads;
+	int m_QuadsPageCount;
+	int m_QuadsAlign;
+
 	CTextBoundingBox AlignedBoundingBox() const
 	{
 		CTextBoundingBox Box;
@@ -147,6 +160,7 @@ public:
 			m_Truncated = false;
 			m_StartOfLine = true;
 			m_Glyphs.set_size(0);
+			m_QuadsPageCount = -1;
 			m_StringVersion = StringVersion;
 			m_SkipTextRender = false;
 		}
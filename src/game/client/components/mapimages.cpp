@@ -33,6 +33,17 @@ void CMapImages::LoadMapImages(IMap *pMap, class CLayers *pLayers, int MapType)
 	pMap->GetType(MAPITEMTYPE_IMAGE, &Start, &m_Info[MapType].m_Count);
 	m_Info[MapType].m_Count = clamp(m_Info[MapType].m_Count, 0, int(MAX_TEXTURES));
 
+	// decompress the embedded images up front, uploading them is serial anyway
+	int aImageData[MAX_TEXTURES];
+	int NumImageData = 0;
+	for(int i = 0; i < m_Info[MapType].m_Count; i++)
+	{
+		CMapItemImage *pImg = (CMapItemImage *)pMap->GetItem(Start+i, 0, 0);
+		if(!pImg->m_External)
+			aImageData[NumImageData++] = pImg->m_ImageData;
+	}
+	pMap->PrefetchData(aImageData, NumImageData);
+
 	// load new textures
 	for(int i = 0; i < m_Info[MapType].m_Count; i++)
 	{
@@ -26,6 +26,8 @@ CMapLayers::CMapLayers(int Type)
 	m_pMenuMap = 0;
 	m_pMenuLayers = 0;
 	m_OnlineStartTime = 0;
+	m_pTilemapCaches = 0;
+	m_pTilemapCacheLayers = 0;
 }
 
 void CMapLayers::OnStateChange(int NewState, int OldState)
@@ -62,6 +64,7 @@ void CMapLayers::LoadBackgroundMap()
 	char aBuf[128];
 	// check for the appropriate day/night map
 	str_format(aBuf, sizeof(aBuf), "ui/themes/%s_%s.map", pMenuMap, IsDaytime ? "day" : "night");
+	ClearTilemapCaches();
 	if(!m_pMenuMap->Load(aBuf, m_pClient->Storage()))
 	{
 		// fall back on generic map
@@ -113,6 +116,7 @@ void CMapLayers::OnInit()
 
 void CMapLayers::OnMapLoad()
 {
+	ClearTilemapCaches();
 	if(Layers())
 	{
 		LoadEnvPoints(Layers(), m_lEnvPoints);
@@ -125,6 +129,7 @@ void CMapLayers::OnMapLoad()
 
 void CMapLayers::OnShutdown()
 {
+	ClearTilemapCaches();
 	if(m_pEggTiles)
 	{
 		mem_free(m_pEggTiles);
@@ -132,6 +137,31 @@ void CMapLayers::OnShutdown()
 	}
 }
 
+CTilemapCache *CMapLayers::GetTilemapCache(const CLayers *pLayers, int LayerIndex, const CTile *pTiles, int Width, int Height)
+{
+	if(pLayers != m_pTilemapCacheLayers)
+	{
+		ClearTilemapCaches();
+		m_pTilemapCaches = new CTilemapCache[pLayers->NumLayers()];
+		m_pTilemapCacheLayers = pLayers;
+	}
+
+	CTilemapCache *pCache = &m_pTilemapCaches[LayerIndex];
+	if(!pCache->IsBuilt())
+	{
+		pCache->Init(pTiles, Width, Height, 32.0f);
+		pCache->Upload(Graphics());
+	}
+	return pCache;
+}
+
+void CMapLayers::ClearTilemapCaches()
+{
+	delete [] m_pTilemapCaches;
+	m_pTilemapCaches = 0;
+	m_pTilemapCacheLayers = 0;
+}
+
 void CMapLayers::LoadEnvPoints(const CLayers *pLayers, array<CEnvPoint>& lEnvPoints)
 {
 	lEnvPoints.clear();
@@ -400,8 +430,9 @@ void CMapLayers::OnRender()
 								Color = vec4(pTMap->m_Color.r/255.0f, pTMap->m_Color.g/255.0f, pTMap->m_Color.b/255.0f, pTMap->m_Color.a/255.0f*(100-Config()->m_ClOverlayEntities)/100.0f);
 						}
 
+						CTilemapCache *pCache = GetTilemapCache(pLayers, pGroup->m_StartLayer+l, pTiles, pTMap->m_Width, pTMap->m_Height);
 						Graphics()->BlendNone();
-						RenderTools()->RenderTilemap(pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_OPAQUE,
+						RenderTools()->RenderTilemapCached(pCache, pTiles, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_OPAQUE,
 														EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
 
 						Graphics()->BlendNormal();
@@ -419,7 +450,7 @@ void CMapLayers::OnRender()
 																EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
 						}
 
-						RenderTools()->RenderTilemap(pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_TRANSPARENT,
+						RenderTools()->RenderTilemapCached(pCache, pTiles, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_TRANSPARENT,
 														EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
 					}
 				}
@@ -461,11 +492,12 @@ void CMapLayers::OnRender()
 				if((Size >= pTMap->m_Width*pTMap->m_Height*sizeof(CTile)) || pTMap->m_Version >= 4)
 				{
 					vec4 Color = vec4(pTMap->m_Color.r/255.0f, pTMap->m_Color.g/255.0f, pTMap->m_Color.b/255.0f, pTMap->m_Color.a/255.0f*Config()->m_ClOverlayEntities/100.0f);
+					CTilemapCache *pCache = GetTilemapCache(pLayers, pGroup->m_StartLayer+l, pFrontTiles, pTMap->m_Width, pTMap->m_Height);
 					Graphics()->BlendNone();
-					RenderTools()->RenderTilemap(pFrontTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_OPAQUE,
+					RenderTools()->RenderTilemapCached(pCache, pFrontTiles, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_OPAQUE,
 							EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
 					Graphics()->BlendNormal();
-					RenderTools()->RenderTilemap(pFrontTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_TRANSPARENT,
+					RenderTools()->RenderTilemapCached(pCache, pFrontTiles, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_TRANSPARENT,
 							EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
 				}
 			}
@@ -22,6 +22,13 @@ class CMapLayers : public CComponent
 	int m_EggLayerWidth;
 	int m_EggLayerHeight;
 
+	// tile quads of the layers rendered by this component, indexed by layer and built on first use
+	class CTilemapCache *m_pTilemapCaches;
+	const CLayers *m_pTilemapCacheLayers;
+
+	class CTilemapCache *GetTilemapCache(const CLayers *pLayers, int LayerIndex, const CTile *pTiles, int Width, int Height);
+	void ClearTilemapCaches();
+
 	static void EnvelopeEval(float TimeOffset, int Env, float *pChannels, void *pUser);
 
 	void LoadEnvPoints(const CLayers *pLayers, array<CEnvPoint>& lEnvPoints);
@@ -21,45 +21,56 @@ CParticles::CParticles()
 void CParticles::OnReset()
 {
 	// reset particles
-	for(int i = 0; i < MAX_PARTICLES; i++)
-	{
-		m_aParticles[i].m_PrevPart = i-1;
-		m_aParticles[i].m_NextPart = i+1;
-	}
-
-	m_aParticles[0].m_PrevPart = 0;
-	m_aParticles[MAX_PARTICLES-1].m_NextPart = -1;
-	m_FirstFree = 0;
-
-	for(int i = 0; i < NUM_GROUPS; i++)
-		m_aFirstPart[i] = -1;
+	m_NumParticles = 0;
+	m_GroupsDirty = true;
 }
 
 void CParticles::Add(int Group, CParticle *pPart)
 {
 	if(m_pClient->IsWorldPaused() || m_pClient->IsDemoPlaybackPaused())
 		return;
-	if (m_FirstFree == -1)
+	if(m_NumParticles == MAX_PARTICLES)
 		return;
 
-	// remove from the free list
-	int Id = m_FirstFree;
-	m_FirstFree = m_aParticles[Id].m_NextPart;
-	if(m_FirstFree != -1)
-		m_aParticles[m_FirstFree].m_PrevPart = -1;
-
 	// copy data
-	m_aParticles[Id] = *pPart;
-
-	// insert to the group list
-	m_aParticles[Id].m_PrevPart = -1;
-	m_aParticles[Id].m_NextPart = m_aFirstPart[Group];
-	if(m_aFirstPart[Group] != -1)
-		m_aParticles[m_aFirstPart[Group]].m_PrevPart = Id;
-	m_aFirstPart[Group] = Id;
+	int Id = m_NumParticles++;
+	m_aPosX[Id] = pPart->m_Pos.x;
+	m_aPosY[Id] = pPart->m_Pos.y;
+	m_aVelX[Id] = pPart->m_Vel.x;
+	m_aVelY[Id] = pPart->m_Vel.y;
+	m_aLifeSpan[Id] = pPart->m_LifeSpan;
+	m_aRot[Id] = pPart->m_Rot;
+	m_aRotspeed[Id] = pPart->m_Rotspeed;
+	m_aGravity[Id] = pPart->m_Gravity;
+	m_aFriction[Id] = pPart->m_Friction;
+	m_aStartSize[Id] = pPart->m_StartSize;
+	m_aEndSize[Id] = pPart->m_EndSize;
+	m_aSpr[Id] = pPart->m_Spr;
+	m_aColor[Id] = pPart->m_Color;
+	m_aGroup[Id] = Group;
 
 	// set some parameters
-	m_aParticles[Id].m_Life = 0;
+	m_aLife[Id] = 0;
+	m_GroupsDirty = true;
+}
+
+void CParticles::MoveParticle(int From, int To)
+{
+	m_aPosX[To] = m_aPosX[From];
+	m_aPosY[To] = m_aPosY[From];
+	m_aVelX[To] = m_aVelX[From];
+	m_aVelY[To] = m_aVelY[From];
+	m_aLife[To] = m_aLife[From];
+	m_aLifeSpan[To] = m_aLifeSpan[From];
+	m_aRot[To] = m_aRot[From];
+	m_aRotspeed[To] = m_aRotspeed[From];
+	m_aGravity[To] = m_aGravity[From];
+	m_aFriction[To] = m_aFriction[From];
+	m_aStartSize[To] = m_aStartSize[From];
+	m_aEndSize[To] = m_aEndSize[From];
+	m_aSpr[To] = m_aSpr[From];
+	m_aColor[To] = m_aColor[From];
+	m_aGroup[To] = m_aGroup[From];
 }
 
 void CParticles::Update(float TimePassed)
@@ -80,49 +91,70 @@ void CParticles::Update(float TimePassed)
 		s_FrictionFraction -= 0.05f;
 	}
 
-	for(int g = 0; g < NUM_GROUPS; g++)
+	// the loops below have no dependencies between particles, so the compiler can vectorise them
+	const int Num = m_NumParticles;
+	for(int i = 0; i < Num; i++)
+		m_aVelY[i] += m_aGravity[i]*TimePassed;
+
+	for(int f = 0; f < FrictionCount; f++) // apply friction
 	{
-		int i = m_aFirstPart[g];
-		while(i != -1)
+		for(int i = 0; i < Num; i++)
 		{
-			int Next = m_aParticles[i].m_NextPart;
-			//m_aParticles[i].vel += flow_get(m_aParticles[i].pos)*time_passed * m_aParticles[i].flow_affected;
-			m_aParticles[i].m_Vel.y += m_aParticles[i].m_Gravity*TimePassed;
-
-			for(int f = 0; f < FrictionCount; f++) // apply friction
-				m_aParticles[i].m_Vel *= m_aParticles[i].m_Friction;
-
-			// move the point
-			vec2 Vel = m_aParticles[i].m_Vel*TimePassed;
-			Collision()->MovePoint(&m_aParticles[i].m_Pos, &Vel, 0.1f+0.9f*frandom(), NULL);
-			m_aParticles[i].m_Vel = Vel* (1.0f/TimePassed);
-
-			m_aParticles[i].m_Life += TimePassed;
-			m_aParticles[i].m_Rot += TimePassed * m_aParticles[i].m_Rotspeed;
-
-			// check particle death
-			if(m_aParticles[i].m_Life > m_aParticles[i].m_LifeSpan)
-			{
-				// remove it from the group list
-				if(m_aParticles[i].m_PrevPart != -1)
-					m_aParticles[m_aParticles[i].m_PrevPart].m_NextPart = m_aParticles[i].m_NextPart;
-				else
-					m_aFirstPart[g] = m_aParticles[i].m_NextPart;
-
-				if(m_aParticles[i].m_NextPart != -1)
-					m_aParticles[m_aParticles[i].m_NextPart].m_PrevPart = m_aParticles[i].m_PrevPart;
-
-				// insert to the free list
-				if(m_FirstFree != -1)
-					m_aParticles[m_FirstFree].m_PrevPart = i;
-				m_aParticles[i].m_PrevPart = -1;
-				m_aParticles[i].m_NextPart = m_FirstFree;
-				m_FirstFree = i;
-			}
-
-			i = Next;
+			m_aVelX[i] *= m_aFriction[i];
+			m_aVelY[i] *= m_aFriction[i];
 		}
 	}
+
+	// move the points
+	for(int i = 0; i < Num; i++)
+	{
+		m_aVelX[i] *= TimePassed;
+		m_aVelY[i] *= TimePassed;
+		m_aElasticity[i] = 0.1f+0.9f*frandom();
+	}
+	Collision()->MovePoints(m_aPosX, m_aPosY, m_aVelX, m_aVelY, m_aElasticity, Num);
+
+	const float InvTimePassed = 1.0f/TimePassed;
+	for(int i = 0; i < Num; i++)
+	{
+		m_aVelX[i] *= InvTimePassed;
+		m_aVelY[i] *= InvTimePassed;
+		m_aLife[i] += TimePassed;
+		m_aRot[i] += TimePassed * m_aRotspeed[i];
+	}
+
+	// remove dead particles, keeping the order of the rest
+	int NumAlive = 0;
+	for(int i = 0; i < Num; i++)
+	{
+		if(m_aLife[i] > m_aLifeSpan[i])
+			continue;
+		if(NumAlive != i)
+			MoveParticle(i, NumAlive);
+		NumAlive++;
+	}
+	if(NumAlive != Num)
+		m_GroupsDirty = true;
+	m_NumParticles = NumAlive;
+}
+
+void CParticles::SortGroups()
+{
+	// counting sort, keeps the creation order inside each group
+	int aNext[NUM_GROUPS] = {0};
+	for(int i = 0; i < m_NumParticles; i++)
+		aNext[m_aGroup[i]]++;
+
+	m_aGroupStart[0] = 0;
+	for(int g = 0; g < NUM_GROUPS; g++)
+	{
+		m_aGroupStart[g+1] = m_aGroupStart[g] + aNext[g];
+		aNext[g] = m_aGroupStart[g];
+	}
+
+	for(int i = 0; i < m_NumParticles; i++)
+		m_aGroupOrder[aNext[m_aGroup[i]]++] = i;
+	m_GroupsDirty = false;
 }
 
 void CParticles::OnRender()
@@ -143,26 +175,28 @@ void CParticles::RenderGroup(int Group)
 	Graphics()->TextureSet(g_pData->m_aImages[IMAGE_PARTICLES].m_Id);
 	Graphics()->QuadsBegin();
 
-	int i = m_aFirstPart[Group];
-	while(i != -1)
+	if(m_GroupsDirty)
+		SortGroups();
+
+	// newest first
+	for(int k = m_aGroupStart[Group+1]-1; k >= m_aGroupStart[Group]; k--)
 	{
-		RenderTools()->SelectSprite(m_aParticles[i].m_Spr);
-		float a = m_aParticles[i].m_Life / m_aParticles[i].m_LifeSpan;
-		vec2 p = m_aParticles[i].m_Pos;
-		float Size = mix(m_aParticles[i].m_StartSize, m_aParticles[i].m_EndSize, a);
+		int i = m_aGroupOrder[k];
+		RenderTools()->SelectSprite(m_aSpr[i]);
+		float a = m_aLife[i] / m_aLifeSpan[i];
+		vec2 p(m_aPosX[i], m_aPosY[i]);
+		float Size = mix(m_aStartSize[i], m_aEndSize[i], a);
 
-		Graphics()->QuadsSetRotation(m_aParticles[i].m_Rot);
+		Graphics()->QuadsSetRotation(m_aRot[i]);
 
 		Graphics()->SetColor(
-			m_aParticles[i].m_Color.r,
-			m_aParticles[i].m_Color.g,
-			m_aParticles[i].m_Color.b,
-			m_aParticles[i].m_Color.a); // pow(a, 0.75f) *
+			m_aColor[i].r,
+			m_aColor[i].g,
+			m_aColor[i].b,
+			m_aColor[i].a); // pow(a, 0.75f) *
 
 		IGraphics::CQuadItem QuadItem(p.x, p.y, Size, Size);
 		Graphics()->QuadsDraw(&QuadItem, 1);
-
-		i = m_aParticles[i].m_NextPart;
 	}
 	Graphics()->QuadsEnd();
 	Graphics()->BlendNormal();
@@ -41,11 +41,6 @@ struct CParticle
 	float m_Friction;
 
 	vec4 m_Color;
-
-	// set by the particle system
-	float m_Life;
-	int m_PrevPart;
-	int m_NextPart;
 };
 
 class CParticles : public CComponent
@@ -74,9 +69,36 @@ private:
 		MAX_PARTICLES=1024*8,
 	};
 
-	CParticle m_aParticles[MAX_PARTICLES];
-	int m_FirstFree;
-	int m_aFirstPart[NUM_GROUPS];
+	// the particles of all groups in the order they were added, kept as separate
+	// arrays so the update loops only stream through the data they need
+	int m_NumParticles;
+	float m_aPosX[MAX_PARTICLES];
+	float m_aPosY[MAX_PARTICLES];
+	float m_aVelX[MAX_PARTICLES];
+	float m_aVelY[MAX_PARTICLES];
+	float m_aLife[MAX_PARTICLES];
+	float m_aLifeSpan[MAX_PARTICLES];
+	float m_aRot[MAX_PARTICLES];
+	float m_aRotspeed[MAX_PARTICLES];
+	float m_aGravity[MAX_PARTICLES];
+	float m_aFriction[MAX_PARTICLES];
+	float m_aElasticity[MAX_PARTICLES]; // filled for the collision query of each update
+
+	// only used for rendering
+	float m_aStartSize[MAX_PARTICLES];
+	float m_aEndSize[MAX_PARTICLES];
+	int m_aSpr[MAX_PARTICLES];
+	vec4 m_aColor[MAX_PARTICLES];
+	unsigned char m_aGroup[MAX_PARTICLES];
+
+	// particle indices ordered by group, so each group renders only its own range.
+	// rebuilt on the first render after particles were added or removed
+	int m_aGroupStart[NUM_GROUPS+1];
+	int m_aGroupOrder[MAX_PARTICLES];
+	bool m_GroupsDirty;
+
+	void MoveParticle(int From, int To);
+	void SortGroups();
 
 	void RenderGroup(int Group);
 	void Update(float TimePassed);
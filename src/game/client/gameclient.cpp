@@ -126,7 +126,7 @@ static CMapLayers gs_MapLayersForeGround(CMapLayers::TYPE_FOREGROUND);
 static CBackground gs_BackGround;
 
 CGameClient::CStack::CStack() { m_Num = 0; }
-void CGameClient::CStack::Add(class CComponent *pComponent) { m_paComponents[m_Num++] = pComponent; }
+void CGameClient::CStack::Add(class CComponent *pComponent, const char *pName) { m_apNames[m_Num] = pName; m_paComponents[m_Num++] = pComponent; }
 
 const char *CGameClient::Version() const { return GAME_VERSION; }
 const char *CGameClient::NetVersion() const { return GAME_NETVERSION; }
@@ -219,6 +219,7 @@ static CGameMsg gs_GameMsgList[NUM_GAMEMSGS] = {
 void CGameClient::OnConsoleInit()
 {
 	m_InitComplete = false;
+	m_RenderProfiling = false;
 	m_pEngine = Kernel()->RequestInterface<IEngine>();
 	m_pClient = Kernel()->RequestInterface<IClient>();
 	m_pTextRender = Kernel()->RequestInterface<ITextRender>();
@@ -260,42 +261,42 @@ void CGameClient::OnConsoleInit()
 	m_pStats = &::gs_Stats;
 
 	// make a list of all the systems, make sure to add them in the corrent render order
-	m_All.Add(m_pSkins);
-	m_All.Add(m_pCountryFlags);
-	m_All.Add(m_pMapimages);
-	m_All.Add(m_pEffects); // doesn't render anything, just updates effects
-	m_All.Add(m_pParticles); // doesn't render anything, just updates all the particles
-	m_All.Add(m_pBinds);
-	m_All.Add(&m_pBinds->m_SpecialBinds);
-	m_All.Add(m_pControls);
-	m_All.Add(m_pCamera);
-	m_All.Add(m_pSounds);
-	m_All.Add(m_pVoting);
-
-	m_All.Add(&gs_BackGround);	//render instead of gs_MapLayersBackGround when g_Config.m_ClOverlayEntities == 100
-	m_All.Add(&gs_MapLayersBackGround); // first to render
-	m_All.Add(&m_pParticles->m_RenderTrail);
-	m_All.Add(m_pItems);
-	m_All.Add(&gs_Players);
-	m_All.Add(&gs_MapLayersForeGround);
-	m_All.Add(&m_pParticles->m_RenderExplosions);
-	m_All.Add(&gs_NamePlates);
-	m_All.Add(&m_pParticles->m_RenderGeneral);
-	m_All.Add(m_pDamageind);
-	m_All.Add(&gs_Hud);
-	m_All.Add(&gs_Spectator);
-	m_All.Add(&gs_Emoticon);
-	m_All.Add(&gs_InfoMessages);
-	m_All.Add(m_pChat);
-	m_All.Add(&gs_Broadcast);
-	m_All.Add(&gs_DebugHud);
-	m_All.Add(&gs_Notifications);
-	m_All.Add(&gs_Scoreboard);
-	m_All.Add(m_pStats);
-	m_All.Add(m_pMotd);
-	m_All.Add(m_pMenus);
-	m_All.Add(&m_pMenus->m_Binder);
-	m_All.Add(m_pGameConsole);
+	m_All.Add(m_pSkins, "skins");
+	m_All.Add(m_pCountryFlags, "countryflags");
+	m_All.Add(m_pMapimages, "mapimages");
+	m_All.Add(m_pEffects, "effects"); // doesn't render anything, just updates effects
+	m_All.Add(m_pParticles, "particles"); // doesn't render anything, just updates all the particles
+	m_All.Add(m_pBinds, "binds");
+	m_All.Add(&m_pBinds->m_SpecialBinds, "specialbinds");
+	m_All.Add(m_pControls, "controls");
+	m_All.Add(m_pCamera, "camera");
+	m_All.Add(m_pSounds, "sounds");
+	m_All.Add(m_pVoting, "voting");
+
+	m_All.Add(&gs_BackGround, "background");	//render instead of gs_MapLayersBackGround when g_Config.m_ClOverlayEntities == 100
+	m_All.Add(&gs_MapLayersBackGround, "maplayers_bg"); // first to render
+	m_All.Add(&m_pParticles->m_RenderTrail, "particles_trail");
+	m_All.Add(m_pItems, "items");
+	m_All.Add(&gs_Players, "players");
+	m_All.Add(&gs_MapLayersForeGround, "maplayers_fg");
+	m_All.Add(&m_pParticles->m_RenderExplosions, "particles_explosions");
+	m_All.Add(&gs_NamePlates, "nameplates");
+	m_All.Add(&m_pParticles->m_RenderGeneral, "particles_general");
+	m_All.Add(m_pDamageind, "damageind");
+	m_All.Add(&gs_Hud, "hud");
+	m_All.Add(&gs_Spectator, "spectator");
+	m_All.Add(&gs_Emoticon, "emoticon");
+	m_All.Add(&gs_InfoMessages, "infomessages");
+	m_All.Add(m_pChat, "chat");
+	m_All.Add(&gs_Broadcast, "broadcast");
+	m_All.Add(&gs_DebugHud, "debughud");
+	m_All.Add(&gs_Notifications, "notifications");
+	m_All.Add(&gs_Scoreboard, "scoreboard");
+	m_All.Add(m_pStats, "stats");
+	m_All.Add(m_pMotd, "motd");
+	m_All.Add(m_pMenus, "menus");
+	m_All.Add(&m_pMenus->m_Binder, "binder");
+	m_All.Add(m_pGameConsole, "console");
 
 	// build the input stack
 	m_Input.Add(&m_pMenus->m_Binder); // this will take over all input when we want to bind a key
@@ -385,6 +386,9 @@ void CGameClient::OnInit()
 	m_UI.Init(Config(), Graphics(), Input(), TextRender());
 	m_RenderTools.Init(Config(), Graphics(), TextRender());
 
+	m_PredictedTick = 0;
+	m_PredictionValid = false;
+
 	int64 Start = time_get();
 
 	str_format(m_aDDNetVersionStr, sizeof(m_aDDNetVersionStr), "%s %s", GAME_NAME, GAME_VERSION);
@@ -579,7 +583,7 @@ int CGameClient::OnSnapInput(int *pData, bool Dummy, bool Force)
 void CGameClient::OnConnected()
 {
 	m_Layers.Init(Kernel());
-	m_Collision.Init(Layers());
+	m_Collision.Init(Layers(), Config());
 
 	for(int i = 0; i < m_All.m_Num; i++)
 	{
@@ -599,6 +603,7 @@ void CGameClient::OnReset()
 	{
 		// clear out the invalid pointers
 		m_LastNewPredictedTick = -1;
+		m_PredictionValid = false;
 		mem_zero(&m_Snap, sizeof(m_Snap));
 
 		for(int ClientID = 0; ClientID < MAX_CLIENTS; ClientID++)
@@ -743,8 +748,20 @@ void CGameClient::OnRender()
 	StartRendering();
 
 	// render all systems
-	for(int i = 0; i < m_All.m_Num; i++)
-		m_All.m_paComponents[i]->OnRender();
+	if(m_RenderProfiling)
+	{
+		for(int i = 0; i < m_All.m_Num; i++)
+		{
+			int64 Start = time_get();
+			m_All.m_paComponents[i]->OnRender();
+			m_aRenderTimes[i] = time_get()-Start;
+		}
+	}
+	else
+	{
+		for(int i = 0; i < m_All.m_Num; i++)
+			m_All.m_paComponents[i]->OnRender();
+	}
 
 	// clear all events/input for this frame
 	Input()->Clear();
@@ -756,6 +773,23 @@ void CGameClient::OnRender()
 	CLineInput::RenderCandidates();
 }
 
+void CGameClient::SetRenderProfiling(bool Enable)
+{
+	m_RenderProfiling = Enable;
+	mem_zero(m_aRenderTimes, sizeof(m_aRenderTimes));
+}
+
+int CGameClient::GetRenderProfile(const char **ppNames, int64 *pTimes, int MaxComponents) const
+{
+	int Num = min(m_All.m_Num, MaxComponents);
+	for(int i = 0; i < Num; i++)
+	{
+		ppNames[i] = m_All.m_apNames[i];
+		pTimes[i] = m_aRenderTimes[i];
+	}
+	return Num;
+}
+
 void CGameClient::OnRelease()
 {
 	// release all systems
@@ -1473,6 +1507,9 @@ static CGameInfoEx GetGameInfoEx(const CNetObj_GameInfoEx *pInfoEx, int InfoExSi
 
 void CGameClient::OnNewSnapshot()
 {
+	// predictions have to start over from the new snapshot
+	m_PredictionValid = false;
+
 	// clear out the invalid pointers
 	mem_zero(&m_Snap, sizeof(m_Snap));
 
@@ -1973,6 +2010,8 @@ void CGameClient::OnPredict()
 	// don't predict anything if we are paused or round/game is over
 	if(IsWorldPaused())
 	{
+		m_PredictionValid = false;
+
 		for(int i = 0; i < MAX_CLIENTS; i++)
 		{
 			if(!m_Snap.m_aCharacters[i].m_Active)
@@ -1987,23 +2026,43 @@ void CGameClient::OnPredict()
 		return;
 	}
 
-	// repredict character
-	CWorldCore World;
-	World.m_Tuning[Config()->m_ClDummy] = m_Tuning[Config()->m_ClDummy];
+	// The ticks up to `m_PredictedTick` only depend on the current snapshot,
+	// the tuning and the inputs of those ticks, which were sent before and
+	// don't change anymore. As long as none of these changed, continue from
+	// the last prediction instead of simulating all ticks again.
+	const int Dummy = Config()->m_ClDummy;
+	CWorldCore &World = m_PredictionWorld;
+	int StartTick = m_PredictedTick + 1;
+	if(!m_PredictionValid ||
+		m_PredictionDummy != Dummy ||
+		m_PredictionLocalClientID != m_LocalClientID[Dummy] ||
+		m_PredictedTick < Client()->GameTick() ||
+		m_PredictedTick > Client()->PredGameTick() ||
+		mem_comp(&World.m_Tuning[Dummy], &m_Tuning[Dummy], sizeof(CTuningParams)) != 0)
+	{
+		// repredict character
+		World = CWorldCore();
+		World.m_Tuning[Dummy] = m_Tuning[Dummy];
+
+		// search for players
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			if(!m_Snap.m_aCharacters[i].m_Active)
+				continue;
 
-	// search for players
-	for(int i = 0; i < MAX_CLIENTS; i++)
-	{
-		if(!m_Snap.m_aCharacters[i].m_Active)
-			continue;
+			m_aClients[i].m_Predicted.Init(&World, Collision(), Config());
+			World.m_apCharacters[i] = &m_aClients[i].m_Predicted;
+			m_aClients[i].m_Predicted.Read(&m_Snap.m_aCharacters[i].m_Cur);
+		}
 
-		m_aClients[i].m_Predicted.Init(&World, Collision(), Config());
-		World.m_apCharacters[i] = &m_aClients[i].m_Predicted;
-		m_aClients[i].m_Predicted.Read(&m_Snap.m_aCharacters[i].m_Cur);
+		m_PredictionValid = true;
+		m_PredictionDummy = Dummy;
+		m_PredictionLocalClientID = m_LocalClientID[Dummy];
+		StartTick = Client()->GameTick() + 1;
 	}
 
 	// predict
-	for(int Tick = Client()->GameTick() + 1;
+	for(int Tick = StartTick;
 		Tick <= Client()->PredGameTick();
 		Tick++)
 	{
@@ -61,14 +61,19 @@ class CGameClient : public IGameClient
 		};
 
 		CStack();
-		void Add(class CComponent *pComponent);
+		void Add(class CComponent *pComponent, const char *pName = "");
 
 		class CComponent *m_paComponents[MAX_COMPONENTS];
+		const char *m_apNames[MAX_COMPONENTS];
 		int m_Num;
 	};
 
 	CStack m_All;
 	CStack m_Input;
+
+	// cpu time each component spent in the last OnRender, only measured while profiling
+	bool m_RenderProfiling;
+	int64 m_aRenderTimes[CStack::MAX_COMPONENTS];
 	CNetObjHandler m_NetObjHandler;
 
 	class IEngine *m_pEngine;
@@ -98,6 +103,13 @@ class CGameClient : public IGameClient
 	int m_PredictedTick;
 	int m_LastNewPredictedTick;
 
+	// the predicted world at m_PredictedTick, continued by OnPredict until
+	// a new snapshot, dummy switch or tuning change invalidates it
+	CWorldCore m_PredictionWorld;
+	bool m_PredictionValid;
+	int m_PredictionDummy;
+	int m_PredictionLocalClientID;
+
 	int m_LastGameStartTick;
 	int m_LastFlagCarrierRed;
 	int m_LastFlagCarrierBlue;
@@ -347,6 +359,9 @@ public:
 	virtual void OnDummySwap();
 	virtual void OnDummyDisconnect();
 
+	virtual void SetRenderProfiling(bool Enable);
+	virtual int GetRenderProfile(const char **ppNames, int64 *pTimes, int MaxComponents) const;
+
 	virtual const char *GetItemName(int Type) const;
 	virtual const char *Version() const;
 	virtual const char *NetVersion() const;
@@ -19,6 +19,7 @@ enum
 	LAYERRENDERFLAG_TRANSPARENT = 2,
 
 	TILERENDERFLAG_EXTEND = 4,
+	TILERENDERFLAG_OUTSIDE = 8, // only the extended tiles outside of the layer
 };
 
 class CTeeRenderInfo
@@ -42,6 +43,43 @@ public:
 	int m_GotAirJump;
 };
 
+// the tile quads of a layer, built once and grouped into chunks of CHUNK_SIZE*CHUNK_SIZE
+// tiles so rendering only has to submit the chunks that are on screen
+class CTilemapCache
+{
+public:
+	enum
+	{
+		CHUNK_SIZE = 32,
+	};
+
+	struct CChunk
+	{
+		int m_Start;
+		int m_NumOpaque; // tiles flagged opaque come first
+		int m_NumTransparent;
+	};
+
+	int m_Width;
+	int m_Height;
+	int m_NumChunksX;
+	int m_NumChunksY;
+	float m_Scale;
+	CChunk *m_pChunks;
+	int m_NumQuads;
+	IGraphics::CTileQuadItem *m_pQuads; // freed once they are uploaded
+	IGraphics *m_pGraphics;
+	IGraphics::CBufferHandle m_Buffer;
+
+	CTilemapCache();
+	~CTilemapCache();
+
+	void Init(const CTile *pTiles, int w, int h, float Scale);
+	void Upload(IGraphics *pGraphics);
+	void Clear();
+	bool IsBuilt() const { return m_pChunks != 0; }
+};
+
 typedef void (*ENVELOPE_EVAL)(float TimeOffset, int Env, float *pChannels, void *pUser);
 class CTextCursor;
 
@@ -50,6 +88,8 @@ class CRenderTools
 	class CConfig *m_pConfig;
 	class IGraphics *m_pGraphics;
 	class ITextRender *m_pTextRender;
+
+	void DrawTilemapCacheRange(const CTilemapCache *pCache, int Start, int Num);
 public:
 
 	class IGraphics *Graphics() const { return m_pGraphics; }
@@ -74,6 +114,7 @@ public:
 	void RenderQuads(CQuad *pQuads, int NumQuads, int Flags, ENVELOPE_EVAL pfnEval, void *pUser);
 	void ForceRenderQuads(CQuad *pQuads, int NumQuads, int Flags, ENVELOPE_EVAL pfnEval, void *pUser, float Alpha = 1.0f);
 	void RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4 Color, int RenderFlags, ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset);
+	void RenderTilemapCached(const CTilemapCache *pCache, CTile *pTiles, vec4 Color, int RenderFlags, ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset);
 
 	void RenderTileRectangle(int RectX, int RectY, int RectW, int RectH, unsigned char IndexIn, unsigned char IndexOut, float Scale, vec4 Color, int RenderFlags, ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset);
 
@@ -419,6 +419,53 @@ void CRenderTools::RenderTileRectangle(int RectX, int RectY, int RectW, int Rect
 	Graphics()->MapScreen(ScreenX0, ScreenY0, ScreenX1, ScreenY1);
 }
 
+static void TileTexCoords(int Flags, float *pU, float *pV)
+{
+	float x0 = 0;
+	float y0 = 0;
+	float x1 = 1;
+	float y1 = 0;
+	float x2 = 1;
+	float y2 = 1;
+	float x3 = 0;
+	float y3 = 1;
+
+	if(Flags&TILEFLAG_VFLIP)
+	{
+		x0 = x2;
+		x1 = x3;
+		x2 = x3;
+		x3 = x0;
+	}
+
+	if(Flags&TILEFLAG_HFLIP)
+	{
+		y0 = y3;
+		y2 = y1;
+		y3 = y1;
+		y1 = y0;
+	}
+
+	if(Flags&TILEFLAG_ROTATE)
+	{
+		float Tmp = x0;
+		x0 = x3;
+		x3 = x2;
+		x2 = x1;
+		x1 = Tmp;
+		Tmp = y0;
+		y0 = y3;
+		y3 = y2;
+		y2 = y1;
+		y1 = Tmp;
+	}
+
+	pU[0] = x0; pV[0] = y0;
+	pU[1] = x1; pV[1] = y1;
+	pU[2] = x2; pV[2] = y2;
+	pU[3] = x3; pV[3] = y3;
+}
+
 void CRenderTools::RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4 Color, int RenderFlags,
 									ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset)
 {
@@ -448,6 +495,12 @@ void CRenderTools::RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4
 	for(int y = StartY; y < EndY; y++)
 		for(int x = StartX; x < EndX; x++)
 		{
+			if(RenderFlags&TILERENDERFLAG_OUTSIDE && x >= 0 && x < w && y >= 0 && y < h)
+			{
+				x = w-1; // skip the tiles inside the layer
+				continue;
+			}
+
 			int mx = x;
 			int my = y;
 
@@ -495,54 +548,199 @@ void CRenderTools::RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4
 
 				if(Render)
 				{
-					float x0 = 0;
-					float y0 = 0;
-					float x1 = 1;
-					float y1 = 0;
-					float x2 = 1;
-					float y2 = 1;
-					float x3 = 0;
-					float y3 = 1;
+					float aU[4], aV[4];
+					TileTexCoords(Flags, aU, aV);
+					Graphics()->QuadsSetSubsetFree(aU[0], aV[0], aU[1], aV[1], aU[2], aV[2], aU[3], aV[3], Index);
+					IGraphics::CQuadItem QuadItem(x*Scale, y*Scale, Scale, Scale);
+					Graphics()->QuadsDrawTL(&QuadItem, 1);
+				}
+			}
+			x += pTiles[c].m_Skip;
+		}
 
-					if(Flags&TILEFLAG_VFLIP)
-					{
-						x0 = x2;
-						x1 = x3;
-						x2 = x3;
-						x3 = x0;
-					}
+	Graphics()->QuadsEnd();
+	Graphics()->MapScreen(ScreenX0, ScreenY0, ScreenX1, ScreenY1);
+}
 
-					if(Flags&TILEFLAG_HFLIP)
-					{
-						y0 = y3;
-						y2 = y1;
-						y3 = y1;
-						y1 = y0;
-					}
+CTilemapCache::CTilemapCache()
+{
+	m_Width = 0;
+	m_Height = 0;
+	m_NumChunksX = 0;
+	m_NumChunksY = 0;
+	m_Scale = 0;
+	m_pChunks = 0;
+	m_NumQuads = 0;
+	m_pQuads = 0;
+	m_pGraphics = 0;
+}
 
-					if(Flags&TILEFLAG_ROTATE)
+CTilemapCache::~CTilemapCache()
+{
+	Clear();
+}
+
+void CTilemapCache::Clear()
+{
+	if(m_Buffer.IsValid())
+		m_pGraphics->DestroyQuadBuffer(&m_Buffer);
+	delete [] m_pChunks;
+	delete [] m_pQuads;
+	m_pChunks = 0;
+	m_pQuads = 0;
+	m_NumQuads = 0;
+	m_NumChunksX = 0;
+	m_NumChunksY = 0;
+}
+
+void CTilemapCache::Init(const CTile *pTiles, int w, int h, float Scale)
+{
+	Clear();
+
+	m_Width = w;
+	m_Height = h;
+	m_Scale = Scale;
+	m_NumChunksX = (w+CHUNK_SIZE-1)/CHUNK_SIZE;
+	m_NumChunksY = (h+CHUNK_SIZE-1)/CHUNK_SIZE;
+	m_pChunks = new CChunk[m_NumChunksX*m_NumChunksY+1];
+
+	for(int i = 0; i < w*h; i++)
+	{
+		if(pTiles[i].m_Index)
+			m_NumQuads++;
+	}
+	m_pQuads = new IGraphics::CTileQuadItem[m_NumQuads+1];
+
+	int Num = 0;
+	for(int cy = 0; cy < m_NumChunksY; cy++)
+		for(int cx = 0; cx < m_NumChunksX; cx++)
+		{
+			CChunk *pChunk = &m_pChunks[cy*m_NumChunksX+cx];
+			pChunk->m_Start = Num;
+			const int x0 = cx*CHUNK_SIZE;
+			const int y0 = cy*CHUNK_SIZE;
+			const int x1 = min(x0+CHUNK_SIZE, w);
+			const int y1 = min(y0+CHUNK_SIZE, h);
+
+			// opaque tiles first, so every pass draws one range of the chunk
+			for(int Pass = 0; Pass < 2; Pass++)
+			{
+				for(int y = y0; y < y1; y++)
+					for(int x = x0; x < x1; x++)
 					{
-						float Tmp = x0;
-						x0 = x3;
-						x3 = x2;
-						x2 = x1;
-						x1 = Tmp;
-						Tmp = y0;
-						y0 = y3;
-						y3 = y2;
-						y2 = y1;
-						y1 = Tmp;
+						const CTile *pTile = &pTiles[y*w+x];
+						if(!pTile->m_Index || (Pass == 0) != ((pTile->m_Flags&TILEFLAG_OPAQUE) != 0))
+							continue;
+
+						IGraphics::CTileQuadItem *pQuad = &m_pQuads[Num++];
+						pQuad->m_Quad = IGraphics::CQuadItem(x*Scale, y*Scale, Scale, Scale);
+						TileTexCoords(pTile->m_Flags, pQuad->m_aU, pQuad->m_aV);
+						pQuad->m_TextureIndex = pTile->m_Index;
 					}
 
-					Graphics()->QuadsSetSubsetFree(x0, y0, x1, y1, x2, y2, x3, y3, Index);
-					IGraphics::CQuadItem QuadItem(x*Scale, y*Scale, Scale, Scale);
-					Graphics()->QuadsDrawTL(&QuadItem, 1);
-				}
+				if(Pass == 0)
+					pChunk->m_NumOpaque = Num-pChunk->m_Start;
+				else
+					pChunk->m_NumTransparent = Num-pChunk->m_Start-pChunk->m_NumOpaque;
 			}
-			x += pTiles[c].m_Skip;
 		}
+}
+
+void CTilemapCache::Upload(IGraphics *pGraphics)
+{
+	m_pGraphics = pGraphics;
+	m_Buffer = pGraphics->CreateQuadBuffer(m_pQuads, m_NumQuads);
+	if(m_Buffer.IsValid())
+	{
+		delete [] m_pQuads;
+		m_pQuads = 0;
+	}
+}
+
+void CRenderTools::DrawTilemapCacheRange(const CTilemapCache *pCache, int Start, int Num)
+{
+	if(Num <= 0)
+		return;
+	if(pCache->m_Buffer.IsValid())
+		Graphics()->QuadsDrawBuffer(pCache->m_Buffer, Start, Num);
+	else
+		Graphics()->QuadsDrawTiles(pCache->m_pQuads+Start, Num);
+}
+
+void CRenderTools::RenderTilemapCached(const CTilemapCache *pCache, CTile *pTiles, vec4 Color, int RenderFlags,
+									ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset)
+{
+	float ScreenX0, ScreenY0, ScreenX1, ScreenY1;
+	Graphics()->GetScreen(&ScreenX0, &ScreenY0, &ScreenX1, &ScreenY1);
+
+	if(ColorEnv >= 0)
+	{
+		float aChannels[4];
+		pfnEval(ColorEnvOffset/1000.0f, ColorEnv, aChannels, pUser);
+		Color = Color*vec4(aChannels[0], aChannels[1], aChannels[2], aChannels[3]);
+	}
+
+	const float Scale = pCache->m_Scale;
+	const int w = pCache->m_Width;
+	const int h = pCache->m_Height;
+	int StartY = (int)(ScreenY0/Scale)-1;
+	int StartX = (int)(ScreenX0/Scale)-1;
+	int EndY = (int)(ScreenY1/Scale)+1;
+	int EndX = (int)(ScreenX1/Scale)+1;
+
+	// the color only tints the cached quads, the opacity decides which of them go into which pass
+	const bool Opaque = Color.a > 254.0f/255.0f;
+	const int ChunkX0 = max(StartX, 0)/CTilemapCache::CHUNK_SIZE;
+	const int ChunkY0 = max(StartY, 0)/CTilemapCache::CHUNK_SIZE;
+	const int ChunkX1 = min((EndX-1)/CTilemapCache::CHUNK_SIZE, pCache->m_NumChunksX-1);
+	const int ChunkY1 = min((EndY-1)/CTilemapCache::CHUNK_SIZE, pCache->m_NumChunksY-1);
+
+	Graphics()->QuadsBegin();
+	Graphics()->SetColor(Color.r*Color.a, Color.g*Color.a, Color.b*Color.a, Color.a);
+
+	if(EndX > 0 && EndY > 0)
+	{
+		// ranges of neighbouring chunks that follow each other are drawn together
+		int DrawStart = 0;
+		int DrawNum = 0;
+		for(int cy = ChunkY0; cy <= ChunkY1; cy++)
+			for(int cx = ChunkX0; cx <= ChunkX1; cx++)
+			{
+				const CTilemapCache::CChunk *pChunk = &pCache->m_pChunks[cy*pCache->m_NumChunksX+cx];
+				int Start = pChunk->m_Start;
+				int Num = 0;
+				if(Opaque)
+				{
+					if(RenderFlags&LAYERRENDERFLAG_OPAQUE)
+						Num += pChunk->m_NumOpaque;
+					else
+						Start += pChunk->m_NumOpaque;
+					if(RenderFlags&LAYERRENDERFLAG_TRANSPARENT)
+						Num += pChunk->m_NumTransparent;
+				}
+				else if(RenderFlags&LAYERRENDERFLAG_TRANSPARENT)
+					Num = pChunk->m_NumOpaque+pChunk->m_NumTransparent;
+
+				if(Num == 0)
+					continue;
+				if(DrawStart+DrawNum == Start)
+				{
+					DrawNum += Num;
+					continue;
+				}
+				DrawTilemapCacheRange(pCache, DrawStart, DrawNum);
+				DrawStart = Start;
+				DrawNum = Num;
+			}
+		DrawTilemapCacheRange(pCache, DrawStart, DrawNum);
+	}
 
 	Graphics()->QuadsEnd();
+
+	// the extended border is not cached
+	if(RenderFlags&TILERENDERFLAG_EXTEND && (StartX < 0 || StartY < 0 || EndX > w || EndY > h))
+		RenderTilemap(pTiles, w, h, Scale, Color, RenderFlags|TILERENDERFLAG_OUTSIDE, pfnEval, pUser, -1, 0);
+
 	Graphics()->MapScreen(ScreenX0, ScreenY0, ScreenX1, ScreenY1);
 }
 
@@ -41,6 +41,8 @@ CCollision::CCollision()
 	m_Width = 0;
 	m_Height = 0;
 	m_pLayers = 0;
+	m_pConfig = 0;
+	m_pTileFlags = 0;
 
 	m_pTele = 0;
 	m_pSpeedup = 0;
@@ -56,11 +58,12 @@ CCollision::~CCollision()
 	Dest();
 }
 
-void CCollision::Init(class CLayers *pLayers)
+void CCollision::Init(class CLayers *pLayers, class CConfig *pConfig)
 {
 	Dest();
 	m_NumSwitchers = 0;
 	m_pLayers = pLayers;
+	m_pConfig = pConfig;
 	m_Width = m_pLayers->GameLayer()->m_Width;
 	m_Height = m_pLayers->GameLayer()->m_Height;
 	m_pTiles = static_cast<CTile *>(m_pLayers->Map()->GetData(m_pLayers->GameLayer()->m_Data));
@@ -150,6 +153,8 @@ void CCollision::Init(class CLayers *pLayers)
 			}
 		}
 	}
+
+	InitTileFlags();
 }
 
 enum
@@ -229,6 +234,96 @@ static int GetMoveRestrictions(int Direction, int Tile, int Flags)
 	return Result&GetMoveRestrictionsMask(Direction);
 }
 
+enum
+{
+	THROUGHDIR_NONE=0,
+	THROUGHDIR_0,
+	THROUGHDIR_90,
+	THROUGHDIR_180,
+	THROUGHDIR_270,
+};
+
+static int GetThroughDir(const CTile &Tile)
+{
+	if(Tile.m_Index != TILE_THROUGH_DIR)
+		return THROUGHDIR_NONE;
+	switch(Tile.m_Flags)
+	{
+	case ROTATION_0: return THROUGHDIR_0;
+	case ROTATION_90: return THROUGHDIR_90;
+	case ROTATION_180: return THROUGHDIR_180;
+	case ROTATION_270: return THROUGHDIR_270;
+	}
+	return THROUGHDIR_NONE;
+}
+
+// whether a through dir tile stops a hook going from Pos0 to Pos1
+static bool ThroughDirBlocks(int ThroughDir, vec2 Pos0, vec2 Pos1)
+{
+	switch(ThroughDir)
+	{
+	case THROUGHDIR_0: return Pos0.y < Pos1.y;
+	case THROUGHDIR_90: return Pos0.x > Pos1.x;
+	case THROUGHDIR_180: return Pos0.y > Pos1.y;
+	case THROUGHDIR_270: return Pos0.x < Pos1.x;
+	}
+	return false;
+}
+
+static unsigned GetStopFlags(const CTile &Tile, int Shift, int HereShift)
+{
+	unsigned Restrictions = GetMoveRestrictionsRaw(MR_DIR_HERE, Tile.m_Index, Tile.m_Flags);
+	unsigned Flags = Restrictions<<Shift;
+	if(Tile.m_Index == TILE_STOP)
+		Flags |= Restrictions<<HereShift;
+	return Flags;
+}
+
+void CCollision::InitTileFlags()
+{
+	if(!m_pTiles)
+		return;
+
+	m_pTileFlags = new unsigned[m_Width*m_Height];
+	for(int i = 0; i < m_Width*m_Height; i++)
+		UpdateTileFlags(i);
+}
+
+void CCollision::UpdateTileFlags(int Index)
+{
+	const CTile &Tile = m_pTiles[Index];
+	unsigned Flags = 0;
+
+	if(Tile.m_Index >= TILE_SOLID && Tile.m_Index <= TILE_NOLASER)
+		Flags |= Tile.m_Index;
+	if(Tile.m_Index == TILE_SOLID || Tile.m_Index == TILE_NOHOOK)
+		Flags |= COLFLAG_SOLID;
+	if(Tile.m_Index == TILE_THROUGH)
+		Flags |= COLFLAG_THROUGH;
+	if(Tile.m_Index == TILE_THROUGH_ALL)
+		Flags |= COLFLAG_HOOK_BLOCKER;
+	Flags |= GetThroughDir(Tile)<<COLFLAG_THROUGH_DIR_SHIFT;
+	Flags |= GetStopFlags(Tile, COLFLAG_STOP_SHIFT, COLFLAG_STOP_HERE_SHIFT);
+
+	if(m_pFront)
+	{
+		const CTile &Front = m_pFront[Index];
+		if(Front.m_Index == TILE_THROUGH)
+			Flags |= COLFLAG_THROUGH;
+		if(Front.m_Index == TILE_THROUGH_ALL || Front.m_Index == TILE_THROUGH_CUT)
+			Flags |= COLFLAG_FRONT_THROUGH_ALL;
+		if(Front.m_Index == TILE_THROUGH_ALL)
+			Flags |= COLFLAG_HOOK_BLOCKER;
+		Flags |= GetThroughDir(Front)<<COLFLAG_FRONT_THROUGH_DIR_SHIFT;
+		Flags |= GetStopFlags(Front, COLFLAG_STOP_SHIFT, COLFLAG_STOP_HERE_SHIFT);
+	}
+
+	if(m_pSpeedup && m_pSpeedup[Index].m_Force > 0)
+		Flags |= COLFLAG_SPEEDUP;
+
+	m_pTileFlags[Index] = Flags;
+}
+
 int CCollision::GetMoveRestrictions(CALLBACK_SWITCHACTIVE pfnSwitchActive, void *pUser, vec2 Pos, float Distance, int OverrideCenterTileIndex)
 {
 	static const vec2 DIRECTIONS[NUM_MR_DIRS] =
@@ -249,21 +344,13 @@ int CCollision::GetMoveRestrictions(CALLBACK_SWITCHACTIVE pfnSwitchActive, void
 		{
 			ModMapIndex = OverrideCenterTileIndex;
 		}
-		for(int Front = 0; Front < 2; Front++)
+		if(ModMapIndex >= 0)
 		{
-			int Tile;
-			int Flags;
-			if(!Front)
-			{
-				Tile = GetTileIndex(ModMapIndex);
-				Flags = GetTileFlags(ModMapIndex);
-			}
+			// stoppers of the game and front layer, see ::GetMoveRestrictions
+			if(d == MR_DIR_HERE)
+				Restrictions |= (m_pTileFlags[ModMapIndex]>>COLFLAG_STOP_HERE_SHIFT)&COLFLAG_STOP_MASK;
 			else
-			{
-				Tile = GetFTileIndex(ModMapIndex);
-				Flags = GetFTileFlags(ModMapIndex);
-			}
-			Restrictions |= ::GetMoveRestrictions(d, Tile, Flags);
+				Restrictions |= (m_pTileFlags[ModMapIndex]>>COLFLAG_STOP_SHIFT)&GetMoveRestrictionsMask(d);
 		}
 		if(pfnSwitchActive)
 		{
@@ -281,28 +368,169 @@ int CCollision::GetMoveRestrictions(CALLBACK_SWITCHACTIVE pfnSwitchActive, void
 
 int CCollision::GetTile(int x, int y)
 {
-	if(!m_pTiles)
+	if(!m_pTileFlags)
 		return 0;
 
 	int Nx = clamp(x/32, 0, m_Width-1);
 	int Ny = clamp(y/32, 0, m_Height-1);
-	int pos = Ny * m_Width + Nx;
+	return m_pTileFlags[Ny*m_Width+Nx]&COLFLAG_INDEX_MASK;
+}
 
-	if(m_pTiles[pos].m_Index >= TILE_SOLID && m_pTiles[pos].m_Index <= TILE_NOLASER)
-		return m_pTiles[pos].m_Index;
-	return 0;
+int CCollision::TraversalMode() const
+{
+	return m_pConfig ? m_pConfig->m_DbgTileTraversal : 1;
 }
 
+/*
+	The line traces test one sample per unit of distance. All tests only
+	depend on the tile a rounded sample falls into, and the samples are
+	monotonic in both axes, so the samples inside one tile form a single run.
+	CLineTrace hands out the first sample of every run, which visits each
+	tile once and reports exactly the same hits as testing every sample.
+*/
+class CLineTrace
+{
+	vec2 m_Pos0;
+	vec2 m_Pos1;
+	float m_Scale;
+	bool m_Divide;
+	int m_Num;
+	int m_OffsetX;
+	int m_OffsetY;
+	int m_Mode;
+
+	void Key(int Index, int *pKey) const
+	{
+		vec2 Pos = Get(Index);
+		int x = round_to_int(Pos.x);
+		int y = round_to_int(Pos.y);
+		pKey[0] = x/32;
+		pKey[1] = y/32;
+		pKey[2] = (x+m_OffsetX)/32;
+		pKey[3] = (y+m_OffsetY)/32;
+	}
+
+	bool SameKey(int Index, const int *pKey) const
+	{
+		int aKey[4];
+		Key(Index, aKey);
+		return aKey[0] == pKey[0] && aKey[1] == pKey[1] && aKey[2] == pKey[2] && aKey[3] == pKey[3];
+	}
+
+	int EstimateRun(vec2 Pos) const
+	{
+		// samples until the next tile border on either axis
+		vec2 Step = (m_Pos1-m_Pos0) * (m_Divide ? 1.0f/m_Scale : m_Scale);
+		float Samples = (float)m_Num;
+		for(int Axis = 0; Axis < 2; Axis++)
+		{
+			float Coord = Axis ? Pos.y : Pos.x;
+			float Delta = Axis ? Step.y : Step.x;
+			if(Delta == 0.0f)
+				continue;
+			float Tile = floorf(round_to_int(Coord)/32.0f);
+			float Border = (Delta > 0.0f ? (Tile+1)*32.0f : Tile*32.0f) - 0.5f;
+			Samples = min(Samples, (Border-Coord)/Delta);
+		}
+		return Samples < 1.0f ? 1 : Samples >= m_Num ? m_Num : (int)ceilf(Samples);
+	}
+
+public:
+	// samples at mix(Pos0, Pos1, i*InverseEnd) for i in [0, End]
+	CLineTrace(vec2 Pos0, vec2 Pos1, int End, float InverseEnd, int Mode)
+	{
+		m_Pos0 = Pos0;
+		m_Pos1 = Pos1;
+		m_Scale = InverseEnd;
+		m_Divide = false;
+		m_Num = End+1;
+		m_OffsetX = 0;
+		m_OffsetY = 0;
+		m_Mode = Mode;
+	}
+
+	// samples at mix(Pos0, Pos1, f/d) for f in [0, d)
+	CLineTrace(vec2 Pos0, vec2 Pos1, float d, int Mode)
+	{
+		m_Pos0 = Pos0;
+		m_Pos1 = Pos1;
+		m_Scale = d;
+		m_Divide = true;
+		m_Num = d > 0 ? (int)ceilf(d) : 0;
+		m_OffsetX = 0;
+		m_OffsetY = 0;
+		m_Mode = Mode;
+	}
+
+	// tests that also look at a neighbouring tile
+	void SetOffset(int OffsetX, int OffsetY)
+	{
+		m_OffsetX = OffsetX;
+		m_OffsetY = OffsetY;
+	}
+
+	int Num() const { return m_Num; }
+
+	vec2 Get(int Index) const
+	{
+		if(m_Divide)
+			return mix(m_Pos0, m_Pos1, (float)Index/m_Scale);
+		return mix(m_Pos0, m_Pos1, Index*m_Scale);
+	}
+
+	vec2 Before(int Index) const { return Index > 0 ? Get(Index-1) : m_Pos0; }
+
+	int Next(int Index) const
+	{
+		if(!m_Mode)
+			return Index+1;
+
+		int aKey[4];
+		Key(Index, aKey);
+
+		// [Lo, Hi) brackets the end of the run, Lo is known to be in it
+		int Lo = Index;
+		int Hi = min(Index+EstimateRun(Get(Index)), m_Num);
+		if(Hi-1 > Lo)
+		{
+			if(SameKey(Hi-1, aKey))
+				Lo = Hi-1;
+			else
+				Hi = Hi-1;
+		}
+		for(int Step = 2; Hi < m_Num && SameKey(Hi, aKey); Step *= 2)
+		{
+			Lo = Hi;
+			Hi = min(Hi+Step, m_Num);
+		}
+		while(Hi-Lo > 1)
+		{
+			int Mid = (Lo+Hi)/2;
+			if(SameKey(Mid, aKey))
+				Lo = Mid;
+			else
+				Hi = Mid;
+		}
+
+		if(m_Mode == 2)
+		{
+			for(int i = Index+1; i <= Hi && i < m_Num; i++)
+				dbg_assert(SameKey(i, aKey) == (i < Hi), "tile traversal skipped a tile");
+		}
+		return Hi;
+	}
+};
+
 // TODO: rewrite this smarter!
 int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
 {
 	const int End = distance(Pos0, Pos1)+1;
 	const float InverseEnd = 1.0f/End;
-	vec2 Last = Pos0;
+	CLineTrace Trace(Pos0, Pos1, End, InverseEnd, TraversalMode());
 	int ix = 0, iy = 0; // Temporary position for checking collision
-	for(int i = 0; i <= End; i++)
+	for(int i = 0; i < Trace.Num(); i = Trace.Next(i))
 	{
-		vec2 Pos = mix(Pos0, Pos1, i*InverseEnd);
+		vec2 Pos = Trace.Get(i);
 		ix = round_to_int(Pos.x);
 		iy = round_to_int(Pos.y);
 
@@ -311,11 +539,9 @@ int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *p
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Trace.Before(i);
 			return GetCollisionAt(ix, iy);
 		}
-
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -328,13 +554,14 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 {
 	const int End = distance(Pos0, Pos1)+1;
 	const float InverseEnd = 1.0f/End;
-	vec2 Last = Pos0;
+	CLineTrace Trace(Pos0, Pos1, End, InverseEnd, TraversalMode());
 	int ix = 0, iy = 0; // Temporary position for checking collision
 	int dx = 0, dy = 0; // Offset for checking the "through" tile
 	ThroughOffset(Pos0, Pos1, &dx, &dy);
-	for(int i = 0; i <= End; i++)
+	Trace.SetOffset(dx, dy);
+	for(int i = 0; i < Trace.Num(); i = Trace.Next(i))
 	{
-		vec2 Pos = mix(Pos0, Pos1, i*InverseEnd);
+		vec2 Pos = Trace.Get(i);
 		ix = round_to_int(Pos.x);
 		iy = round_to_int(Pos.y);
 
@@ -345,7 +572,7 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Trace.Before(i);
 			return TILE_TELEINHOOK;
 		}
 
@@ -364,11 +591,9 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Trace.Before(i);
 			return hit;
 		}
-
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -381,11 +606,11 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 {
 	const int End = distance(Pos0, Pos1)+1;
 	const float InverseEnd = 1.0f/End;
-	vec2 Last = Pos0;
+	CLineTrace Trace(Pos0, Pos1, End, InverseEnd, TraversalMode());
 	int ix = 0, iy = 0; // Temporary position for checking collision
-	for(int i = 0; i <= End; i++)
+	for(int i = 0; i < Trace.Num(); i = Trace.Next(i))
 	{
-		vec2 Pos = mix(Pos0, Pos1, i*InverseEnd);
+		vec2 Pos = Trace.Get(i);
 		ix = round_to_int(Pos.x);
 		iy = round_to_int(Pos.y);
 
@@ -396,7 +621,7 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Trace.Before(i);
 			return TILE_TELEINWEAPON;
 		}
 
@@ -405,11 +630,9 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Trace.Before(i);
 			return GetCollisionAt(ix, iy);
 		}
-
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -457,6 +680,39 @@ void CCollision::MovePoint(vec2 *pInoutPos, vec2 *pInoutVel, float Elasticity, i
 	}
 }
 
+void CCollision::MovePoints(float *pPosX, float *pPosY, float *pVelX, float *pVelY, const float *pElasticity, int Num)
+{
+	for(int i = 0; i < Num; i++)
+	{
+		float NewX = pPosX[i] + pVelX[i];
+		float NewY = pPosY[i] + pVelY[i];
+		if(!IsSolid(round_to_int(NewX), round_to_int(NewY)))
+		{
+			pPosX[i] = NewX;
+			pPosY[i] = NewY;
+			continue;
+		}
+
+		// bounce off the axes that are blocked, same as MovePoint
+		int Affected = 0;
+		if(IsSolid(round_to_int(NewX), round_to_int(pPosY[i])))
+		{
+			pVelX[i] *= -pElasticity[i];
+			Affected++;
+		}
+		if(IsSolid(round_to_int(pPosX[i]), round_to_int(NewY)))
+		{
+			pVelY[i] *= -pElasticity[i];
+			Affected++;
+		}
+		if(Affected == 0)
+		{
+			pVelX[i] *= -pElasticity[i];
+			pVelY[i] *= -pElasticity[i];
+		}
+	}
+}
+
 bool CCollision::TestBox(vec2 Pos, vec2 Size)
 {
 	Size *= 0.5f;
@@ -471,7 +727,135 @@ bool CCollision::TestBox(vec2 Pos, vec2 Size)
 	return false;
 }
 
+CCollision::CBoxSpan CCollision::BoxSpan(float Center, float HalfSize)
+{
+	// same rounding as TestBox
+	CBoxSpan Span;
+	Span.m_Lo = round_to_int(Center-HalfSize)/32;
+	Span.m_Hi = round_to_int(Center+HalfSize)/32;
+	return Span;
+}
+
+bool CCollision::IsSolidTile(int TileX, int TileY)
+{
+	if(!m_pTileFlags)
+		return false;
+
+	return m_pTileFlags[clamp(TileY, 0, m_Height-1)*m_Width + clamp(TileX, 0, m_Width-1)]&COLFLAG_SOLID;
+}
+
+bool CCollision::TestBoxSpan(const CBoxSpan &SpanX, const CBoxSpan &SpanY)
+{
+	return IsSolidTile(SpanX.m_Lo, SpanY.m_Lo) || IsSolidTile(SpanX.m_Hi, SpanY.m_Lo) ||
+		IsSolidTile(SpanX.m_Lo, SpanY.m_Hi) || IsSolidTile(SpanX.m_Hi, SpanY.m_Hi);
+}
+
+/*
+	MoveBox keeps the unit sized steps of the original solver, so positions
+	and bounces are accumulated exactly as before. The box is only tested
+	against the map again once one of its edges enters another tile row or
+	column; while it stays inside the tiles of the last free box, a step
+	costs two additions and the span rounding.
+*/
 void CCollision::MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elasticity)
+{
+	const int Mode = TraversalMode();
+	if(Mode == 0)
+	{
+		MoveBoxSampled(pInoutPos, pInoutVel, Size, Elasticity);
+		return;
+	}
+
+	vec2 Pos = *pInoutPos;
+	vec2 Vel = *pInoutVel;
+
+	const float Distance = length(Vel);
+	const int Max = (int)Distance;
+
+	if(Distance > 0.00001f)
+	{
+		const vec2 HalfSize = Size*0.5f;
+		const float Fraction = 1.0f/(Max+1);
+		CBoxSpan PosX = BoxSpan(Pos.x, HalfSize.x);
+		CBoxSpan PosY = BoxSpan(Pos.y, HalfSize.y);
+		CBoxSpan FreeX = PosX;
+		CBoxSpan FreeY = PosY;
+		bool HasFree = false;
+
+		for(int i = 0; i <= Max; i++)
+		{
+			if(Vel == vec2(0, 0))
+				break;
+
+			vec2 NewPos = Pos + Vel*Fraction;
+			CBoxSpan NewX = BoxSpan(NewPos.x, HalfSize.x);
+			CBoxSpan NewY = BoxSpan(NewPos.y, HalfSize.y);
+
+			if(HasFree && NewX == FreeX && NewY == FreeY)
+			{
+				Pos = NewPos;
+				PosX = NewX;
+				PosY = NewY;
+				continue;
+			}
+
+			if(TestBoxSpan(NewX, NewY))
+			{
+				int Hits = 0;
+
+				if(TestBoxSpan(PosX, NewY))
+				{
+					NewPos.y = Pos.y;
+					NewY = PosY;
+					Vel.y *= -Elasticity;
+					Hits++;
+				}
+
+				if(TestBoxSpan(NewX, PosY))
+				{
+					NewPos.x = Pos.x;
+					NewX = PosX;
+					Vel.x *= -Elasticity;
+					Hits++;
+				}
+
+				// corner case, see MoveBoxSampled
+				if(Hits == 0)
+				{
+					NewPos.y = Pos.y;
+					NewY = PosY;
+					Vel.y *= -Elasticity;
+					NewPos.x = Pos.x;
+					NewX = PosX;
+					Vel.x *= -Elasticity;
+				}
+			}
+			else
+			{
+				HasFree = true;
+				FreeX = NewX;
+				FreeY = NewY;
+			}
+
+			Pos = NewPos;
+			PosX = NewX;
+			PosY = NewY;
+		}
+	}
+
+	if(Mode == 2)
+	{
+		vec2 CheckPos = *pInoutPos;
+		vec2 CheckVel = *pInoutVel;
+		MoveBoxSampled(&CheckPos, &CheckVel, Size, Elasticity);
+		dbg_assert(mem_comp(&CheckPos, &Pos, sizeof(Pos)) == 0 && mem_comp(&CheckVel, &Vel, sizeof(Vel)) == 0, "tile traversal diverged from sampled box move");
+	}
+
+	*pInoutPos = Pos;
+	*pInoutVel = Vel;
+}
+
+void CCollision::MoveBoxSampled(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elasticity)
 {
 	// do the move
 	vec2 Pos = *pInoutPos;
@@ -540,6 +924,9 @@ void CCollision::Dest()
 		delete[] m_pDoor;
 	if(m_pSwitchers)
 		delete[] m_pSwitchers;
+	if(m_pTileFlags)
+		delete[] m_pTileFlags;
+	m_pTileFlags = 0;
 	m_pTiles = 0;
 	m_Width = 0;
 	m_Height = 0;
@@ -555,45 +942,33 @@ void CCollision::Dest()
 
 int CCollision::IsSolid(int x, int y)
 {
-	int index = GetTile(x,y);
-	return index == TILE_SOLID || index == TILE_NOHOOK;
+	if(!m_pTileFlags)
+		return 0;
+
+	int Nx = clamp(x/32, 0, m_Width-1);
+	int Ny = clamp(y/32, 0, m_Height-1);
+	return (m_pTileFlags[Ny*m_Width+Nx]&COLFLAG_SOLID) != 0;
 }
 
 bool CCollision::IsThrough(int x, int y, int xoff, int yoff, vec2 pos0, vec2 pos1)
 {
-	int pos = GetPureMapIndex(x, y);
-	if(m_pFront && (m_pFront[pos].m_Index == TILE_THROUGH_ALL || m_pFront[pos].m_Index == TILE_THROUGH_CUT))
-		return true;
-	if(m_pFront && m_pFront[pos].m_Index == TILE_THROUGH_DIR && (
-		(m_pFront[pos].m_Flags == ROTATION_0   && pos0.y > pos1.y) ||
-		(m_pFront[pos].m_Flags == ROTATION_90  && pos0.x < pos1.x) ||
-		(m_pFront[pos].m_Flags == ROTATION_180 && pos0.y < pos1.y) ||
-		(m_pFront[pos].m_Flags == ROTATION_270 && pos0.x > pos1.x) ))
+	unsigned Flags = m_pTileFlags[GetPureMapIndex(x, y)];
+	if(Flags&COLFLAG_FRONT_THROUGH_ALL)
 		return true;
-	int offpos = GetPureMapIndex(x+xoff, y+yoff);
-	if(m_pTiles[offpos].m_Index == TILE_THROUGH || (m_pFront && m_pFront[offpos].m_Index == TILE_THROUGH))
+	// the front through dir lets lines pass that its hook blocker would stop
+	if(ThroughDirBlocks((Flags>>COLFLAG_FRONT_THROUGH_DIR_SHIFT)&COLFLAG_THROUGH_DIR_MASK, pos1, pos0))
 		return true;
-	return false;
+	return (m_pTileFlags[GetPureMapIndex(x+xoff, y+yoff)]&COLFLAG_THROUGH) != 0;
 }
 
 bool CCollision::IsHookBlocker(int x, int y, vec2 pos0, vec2 pos1)
 {
-	int pos = GetPureMapIndex(x, y);
-	if(m_pTiles[pos].m_Index == TILE_THROUGH_ALL || (m_pFront && m_pFront[pos].m_Index == TILE_THROUGH_ALL))
+	unsigned Flags = m_pTileFlags[GetPureMapIndex(x, y)];
+	if(Flags&COLFLAG_HOOK_BLOCKER)
 		return true;
-	if(m_pTiles[pos].m_Index == TILE_THROUGH_DIR && (
-		(m_pTiles[pos].m_Flags == ROTATION_0   && pos0.y < pos1.y) ||
-		(m_pTiles[pos].m_Flags == ROTATION_90  && pos0.x > pos1.x) ||
-		(m_pTiles[pos].m_Flags == ROTATION_180 && pos0.y > pos1.y) ||
-		(m_pTiles[pos].m_Flags == ROTATION_270 && pos0.x < pos1.x) ))
+	if(ThroughDirBlocks((Flags>>COLFLAG_THROUGH_DIR_SHIFT)&COLFLAG_THROUGH_DIR_MASK, pos0, pos1))
 		return true;
-	if(m_pFront && m_pFront[pos].m_Index == TILE_THROUGH_DIR && (
-		(m_pFront[pos].m_Flags == ROTATION_0   && pos0.y < pos1.y) ||
-		(m_pFront[pos].m_Flags == ROTATION_90  && pos0.x > pos1.x) ||
-		(m_pFront[pos].m_Flags == ROTATION_180 && pos0.y > pos1.y) ||
-		(m_pFront[pos].m_Flags == ROTATION_270 && pos0.x < pos1.x) ))
-		return true;
-	return false;
+	return ThroughDirBlocks((Flags>>COLFLAG_FRONT_THROUGH_DIR_SHIFT)&COLFLAG_THROUGH_DIR_MASK, pos0, pos1);
 }
 
 int CCollision::IsWallJump(int Index)
@@ -706,7 +1081,7 @@ int CCollision::IsSpeedup(int Index)
 	if(Index < 0 || !m_pSpeedup)
 		return 0;
 
-	if(m_pSpeedup[Index].m_Force > 0)
+	if(m_pTileFlags[Index]&COLFLAG_SPEEDUP)
 		return Index;
 
 	return 0;
@@ -995,8 +1370,7 @@ int CCollision::GetIndex(vec2 PrevPos, vec2 Pos)
 		int Nx = clamp((int)Pos.x/32, 0, m_Width-1);
 		int Ny = clamp((int)Pos.y/32, 0, m_Height-1);
 
-		if ((m_pTele) ||
-			(m_pSpeedup && m_pSpeedup[Ny*m_Width+Nx].m_Force > 0))
+		if(m_pTele || (m_pTileFlags[Ny*m_Width+Nx]&COLFLAG_SPEEDUP))
 		{
 			return Ny*m_Width+Nx;
 		}
@@ -1013,8 +1387,7 @@ int CCollision::GetIndex(vec2 PrevPos, vec2 Pos)
 		Tmp = mix(PrevPos, Pos, a);
 		Nx = clamp((int)Tmp.x/32, 0, m_Width-1);
 		Ny = clamp((int)Tmp.y/32, 0, m_Height-1);
-		if ((m_pTele) ||
-			(m_pSpeedup && m_pSpeedup[Ny*m_Width+Nx].m_Force > 0))
+		if(m_pTele || (m_pTileFlags[Ny*m_Width+Nx]&COLFLAG_SPEEDUP))
 		{
 			return Ny*m_Width+Nx;
 		}
@@ -1099,6 +1472,7 @@ void CCollision::SetCollisionAt(float x, float y, int id)
 	int Ny = clamp(round_to_int(y)/32, 0, m_Height-1);
 
 	m_pTiles[Ny * m_Width + Nx].m_Index = id;
+	UpdateTileFlags(Ny * m_Width + Nx);
 }
 
 void CCollision::SetDCollisionAt(float x, float y, int Type, int Flags, int Number)
@@ -1170,12 +1544,11 @@ void ThroughOffset(vec2 Pos0, vec2 Pos1, int *Ox, int *Oy)
 int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
 {
 	float d = distance(Pos0, Pos1);
-	vec2 Last = Pos0;
+	CLineTrace Trace(Pos0, Pos1, d, TraversalMode());
 
-	for(float f = 0; f < d; f++)
+	for(int i = 0; i < Trace.Num(); i = Trace.Next(i))
 	{
-		float a = f/d;
-		vec2 Pos = mix(Pos0, Pos1, a);
+		vec2 Pos = Trace.Get(i);
 		int Nx = clamp(round_to_int(Pos.x)/32, 0, m_Width-1);
 		int Ny = clamp(round_to_int(Pos.y)/32, 0, m_Height-1);
 		if(GetIndex(Nx, Ny) == TILE_SOLID
@@ -1186,12 +1559,11 @@ int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Trace.Before(i);
 			if (GetFIndex(Nx, Ny) == TILE_NOLASER)	return GetFCollisionAt(Pos.x, Pos.y);
 			else return GetCollisionAt(Pos.x, Pos.y);
 
 		}
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -1203,22 +1575,20 @@ int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2
 int CCollision::IntersectNoLaserNW(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
 {
 	float d = distance(Pos0, Pos1);
-	vec2 Last = Pos0;
+	CLineTrace Trace(Pos0, Pos1, d, TraversalMode());
 
-	for(float f = 0; f < d; f++)
+	for(int i = 0; i < Trace.Num(); i = Trace.Next(i))
 	{
-		float a = f/d;
-		vec2 Pos = mix(Pos0, Pos1, a);
+		vec2 Pos = Trace.Get(i);
 		if(IsNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)) || IsFNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)))
 		{
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Trace.Before(i);
 			if(IsNoLaser(round_to_int(Pos.x), round_to_int(Pos.y))) return GetCollisionAt(Pos.x, Pos.y);
 			else return  GetFCollisionAt(Pos.x, Pos.y);
 		}
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -1230,25 +1600,23 @@ int CCollision::IntersectNoLaserNW(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, ve
 int CCollision::IntersectAir(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
 {
 	float d = distance(Pos0, Pos1);
-	vec2 Last = Pos0;
+	CLineTrace Trace(Pos0, Pos1, d, TraversalMode());
 
-	for(float f = 0; f < d; f++)
+	for(int i = 0; i < Trace.Num(); i = Trace.Next(i))
 	{
-		float a = f/d;
-		vec2 Pos = mix(Pos0, Pos1, a);
+		vec2 Pos = Trace.Get(i);
 		if(IsSolid(round_to_int(Pos.x), round_to_int(Pos.y)) || (!GetTile(round_to_int(Pos.x), round_to_int(Pos.y)) && !GetFTile(round_to_int(Pos.x), round_to_int(Pos.y))))
 		{
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Trace.Before(i);
 			if(!GetTile(round_to_int(Pos.x), round_to_int(Pos.y)) && !GetFTile(round_to_int(Pos.x), round_to_int(Pos.y)))
 				return -1;
 			else
 				if (!GetTile(round_to_int(Pos.x), round_to_int(Pos.y))) return GetTile(round_to_int(Pos.x), round_to_int(Pos.y));
 				else return GetFTile(round_to_int(Pos.x), round_to_int(Pos.y));
 		}
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
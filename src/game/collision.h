@@ -22,15 +22,54 @@ typedef bool (*CALLBACK_SWITCHACTIVE)(int Number, void* pUser);
 
 class CCollision
 {
+	friend class CCollisionTestMap;
+
 	class CTile* m_pTiles;
 	int m_Width;
 	int m_Height;
 	class CLayers* m_pLayers;
+	class CConfig* m_pConfig;
+
+	// packed per tile summary of the game, front and speedup layer, so the
+	// physics queries only need to look at one array
+	enum
+	{
+		COLFLAG_INDEX_MASK = 7, // collision index of the game layer, as returned by GetTile
+		COLFLAG_SOLID = 1<<3,
+		COLFLAG_THROUGH = 1<<4, // game or front through tile
+		COLFLAG_FRONT_THROUGH_ALL = 1<<5, // front through all or through cut tile
+		COLFLAG_HOOK_BLOCKER = 1<<6, // game or front through all tile
+		COLFLAG_SPEEDUP = 1<<7,
+		COLFLAG_THROUGH_DIR_SHIFT = 8, // rotation of a through dir tile in the game layer
+		COLFLAG_FRONT_THROUGH_DIR_SHIFT = 11, // rotation of a through dir tile in the front layer
+		COLFLAG_THROUGH_DIR_MASK = 7,
+		COLFLAG_STOP_SHIFT = 14, // CANTMOVE_* of the game and front stoppers
+		COLFLAG_STOP_HERE_SHIFT = 18, // CANTMOVE_* of one-way stoppers, which also apply on top of them
+		COLFLAG_STOP_MASK = 15,
+	};
+	unsigned* m_pTileFlags;
+
+	void InitTileFlags();
+	void UpdateTileFlags(int Index);
+
+	int TraversalMode() const;
+
+	// range of tile columns or rows covered by the corners of a box
+	struct CBoxSpan
+	{
+		int m_Lo;
+		int m_Hi;
+		bool operator==(const CBoxSpan &Other) const { return m_Lo == Other.m_Lo && m_Hi == Other.m_Hi; }
+	};
+	static CBoxSpan BoxSpan(float Center, float HalfSize);
+	bool IsSolidTile(int TileX, int TileY);
+	bool TestBoxSpan(const CBoxSpan &SpanX, const CBoxSpan &SpanY);
+	void MoveBoxSampled(vec2* pInoutPos, vec2* pInoutVel, vec2 Size, float Elasticity);
 
 public:
 	CCollision();
 	~CCollision();
-	void Init(class CLayers* pLayers);
+	void Init(class CLayers* pLayers, class CConfig* pConfig = 0);
 	bool CheckPoint(float x, float y) { return IsSolid(round_to_int(x), round_to_int(y)); }
 	bool CheckPoint(vec2 Pos) { return CheckPoint(Pos.x, Pos.y); }
 	int GetCollisionAt(float x, float y) { return GetTile(round_to_int(x), round_to_int(y)); }
@@ -40,6 +79,8 @@ public:
 	int IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2* pOutCollision, vec2* pOutBeforeCollision, int* pTeleNr);
 	int IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2* pOutCollision, vec2* pOutBeforeCollision, int* pTeleNr);
 	void MovePoint(vec2* pInoutPos, vec2* pInoutVel, float Elasticity, int* pBounces);
+	// MovePoint for many points stored as separate arrays, as used by the particles
+	void MovePoints(float *pPosX, float *pPosY, float *pVelX, float *pVelY, const float *pElasticity, int Num);
 	void MoveBox(vec2* pInoutPos, vec2* pInoutVel, vec2 Size, float Elasticity);
 	bool TestBox(vec2 Pos, vec2 Size);
 
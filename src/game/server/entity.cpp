@@ -12,6 +12,13 @@ CEntity::CEntity(CGameWorld *pGameWorld, int ObjType, vec2 Pos, int ProximityRad
 	m_pPrevTypeEntity = 0;
 	m_pNextTypeEntity = 0;
 
+	m_pPrevGridEntity = 0;
+	m_pNextGridEntity = 0;
+	m_GridX = 0;
+	m_GridY = 0;
+	m_GridBucket = -1;
+	m_Serial = 0;
+
 	m_ID = Server()->SnapNewID();
 	m_ObjType = ObjType;
 
@@ -27,6 +34,13 @@ CEntity::~CEntity()
 	Server()->SnapFreeID(m_ID);
 }
 
+void CEntity::SetPos(vec2 Pos)
+{
+	m_Pos = Pos;
+	if(m_GridBucket != -1)
+		GameWorld()->UpdateEntityGrid(this);
+}
+
 int CEntity::NetworkClipped(int SnappingClient)
 {
 	return NetworkClipped(SnappingClient, m_Pos);
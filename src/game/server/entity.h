@@ -26,6 +26,14 @@ private:
 	CEntity *m_pPrevTypeEntity;
 	CEntity *m_pNextTypeEntity;
 
+	/* Spatial index */
+	CEntity *m_pPrevGridEntity;
+	CEntity *m_pNextGridEntity;
+	int m_GridX;
+	int m_GridY;
+	int m_GridBucket;
+	int m_Serial;
+
 	int m_ID;
 	int m_ObjType;
 
@@ -50,6 +58,15 @@ protected:
 	/* Getters */
 	int GetID() const					{ return m_ID; }
 
+	/* Setters */
+
+	/*
+		Function: SetPos
+			Moves the entity and keeps the world's spatial index up to date.
+			Always use this instead of assigning m_Pos directly.
+	*/
+	void SetPos(vec2 Pos);
+
 public:
 	/* Constructor */
 	CEntity(CGameWorld *pGameWorld, int Objtype, vec2 Pos, int ProximityRadius=0);
@@ -1565,7 +1565,7 @@ void CGameContext::OnInit()
 		Server()->SnapSetStaticsize(i, m_NetObjHandler.GetObjSize(i));
 
 	m_Layers.Init(Kernel());
-	m_Collision.Init(&m_Layers);
+	m_Collision.Init(&m_Layers, Config());
 
 	// select gametype
 	if(str_comp_nocase(Config()->m_SvGametype, "mod") == 0)
@@ -1660,6 +1660,10 @@ void CGameContext::OnSnap(int ClientID)
 	}
 }
 void CGameContext::OnPreSnap() {}
+void CGameContext::OnSnapShared()
+{
+	m_pController->SnapShared();
+}
 void CGameContext::OnPostSnap()
 {
 	m_World.PostSnap();
@@ -171,6 +171,7 @@ public:
 
 	virtual void OnTick();
 	virtual void OnPreSnap();
+	virtual void OnSnapShared();
 	virtual void OnSnap(int ClientID);
 	virtual void OnPostSnap();
 
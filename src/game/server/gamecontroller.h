@@ -196,6 +196,7 @@ public:
 	void SwapTeamscore();
 
 	// general
+	virtual void SnapShared(); // the same for every client, see IGameServer::OnSnapShared
 	virtual void Snap(int SnappingClient);
 	virtual void Tick();
 
@@ -24,7 +24,7 @@ public:
 	virtual bool OnEntity(int Index, vec2 Pos);
 
 	// general
-	virtual void Snap(int SnappingClient);
+	virtual void SnapShared();
 	virtual void Tick();
 };
 
@@ -20,7 +20,13 @@ CGameWorld::CGameWorld()
 	m_Paused = false;
 	m_ResetRequested = false;
 	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
 		m_apFirstEntityTypes[i] = 0;
+		m_aNumEntities[i] = 0;
+		m_aMaxProximityRadius[i] = 0.0f;
+	}
+	mem_zero(m_aapGridBuckets, sizeof(m_aapGridBuckets));
+	m_NextEntitySerial = 0;
 }
 
 CGameWorld::~CGameWorld()
@@ -43,11 +49,134 @@ CEntity *CGameWorld::FindFirst(int Type)
 	return Type < 0 || Type >= NUM_ENTTYPES ? 0 : m_apFirstEntityTypes[Type];
 }
 
+int CGameWorld::GridCoord(float Pos)
+{
+	// keep far away entities from overflowing the cell coordinates
+	return (int)floorf(clamp(Pos, -1000000.0f, 1000000.0f)) >> GRID_CELL_SHIFT;
+}
+
+int CGameWorld::GridBucket(int GridX, int GridY)
+{
+	return (int)(((unsigned)GridX*73856093u) ^ ((unsigned)GridY*19349663u)) & (GRID_NUM_BUCKETS-1);
+}
+
+void CGameWorld::InsertEntityGrid(CEntity *pEnt)
+{
+	pEnt->m_GridX = GridCoord(pEnt->m_Pos.x);
+	pEnt->m_GridY = GridCoord(pEnt->m_Pos.y);
+	pEnt->m_GridBucket = GridBucket(pEnt->m_GridX, pEnt->m_GridY);
+
+	CEntity **ppBucket = &m_aapGridBuckets[pEnt->m_ObjType][pEnt->m_GridBucket];
+	if(*ppBucket)
+		(*ppBucket)->m_pPrevGridEntity = pEnt;
+	pEnt->m_pNextGridEntity = *ppBucket;
+	pEnt->m_pPrevGridEntity = 0;
+	*ppBucket = pEnt;
+}
+
+void CGameWorld::RemoveEntityGrid(CEntity *pEnt)
+{
+	if(pEnt->m_pPrevGridEntity)
+		pEnt->m_pPrevGridEntity->m_pNextGridEntity = pEnt->m_pNextGridEntity;
+	else
+		m_aapGridBuckets[pEnt->m_ObjType][pEnt->m_GridBucket] = pEnt->m_pNextGridEntity;
+	if(pEnt->m_pNextGridEntity)
+		pEnt->m_pNextGridEntity->m_pPrevGridEntity = pEnt->m_pPrevGridEntity;
+
+	pEnt->m_pNextGridEntity = 0;
+	pEnt->m_pPrevGridEntity = 0;
+	pEnt->m_GridBucket = -1;
+}
+
+void CGameWorld::UpdateEntityGrid(CEntity *pEnt)
+{
+	if(pEnt->m_GridBucket == -1)
+		return;
+
+	if(GridCoord(pEnt->m_Pos.x) != pEnt->m_GridX || GridCoord(pEnt->m_Pos.y) != pEnt->m_GridY)
+	{
+		RemoveEntityGrid(pEnt);
+		InsertEntityGrid(pEnt);
+	}
+}
+
+bool CGameWorld::GetGridRange(int Type, vec2 Min, vec2 Max, float Radius, int *pX0, int *pY0, int *pX1, int *pY1)
+{
+	// every entity that can pass the distance check lies in the box grown by its proximity radius
+	float Grow = Radius + m_aMaxProximityRadius[Type];
+	*pX0 = GridCoord(Min.x - Grow);
+	*pY0 = GridCoord(Min.y - Grow);
+	*pX1 = GridCoord(Max.x + Grow);
+	*pY1 = GridCoord(Max.y + Grow);
+
+	// walking the list is cheaper than visiting more cells than there are entities
+	int64 NumCells = (int64)(*pX1 - *pX0 + 1) * (*pY1 - *pY0 + 1);
+	return NumCells <= m_aNumEntities[Type];
+}
+
+// the type lists are ordered newest first, so sorting by serial keeps the order of a linear scan
+static void InsertBySerial(CEntity **ppEnts, int *pSerials, int *pNum, int Max, CEntity *pEnt, int Serial)
+{
+	int i = *pNum;
+	if(i == Max)
+	{
+		if(pSerials[Max-1] >= Serial)
+			return;
+		i--;
+	}
+	else
+		(*pNum)++;
+
+	for(; i > 0 && pSerials[i-1] < Serial; i--)
+	{
+		ppEnts[i] = ppEnts[i-1];
+		pSerials[i] = pSerials[i-1];
+	}
+	ppEnts[i] = pEnt;
+	pSerials[i] = Serial;
+}
+
 int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type)
 {
 	if(Type < 0 || Type >= NUM_ENTTYPES)
 		return 0;
 
+	if(!Config()->m_SvWorldGrid || !ppEnts || Max <= 0 || Max > MAX_FIND_ENTITIES)
+		return FindEntitiesLinear(Pos, Radius, ppEnts, Max, Type);
+
+	int Num = FindEntitiesGrid(Pos, Radius, ppEnts, Max, Type);
+	if(Config()->m_SvWorldGrid == 2)
+	{
+		CEntity *apCheck[MAX_FIND_ENTITIES];
+		int CheckNum = FindEntitiesLinear(Pos, Radius, apCheck, Max, Type);
+		dbg_assert(CheckNum == Num && mem_comp(apCheck, ppEnts, Num*sizeof(CEntity *)) == 0, "grid FindEntities mismatch");
+	}
+	return Num;
+}
+
+int CGameWorld::FindEntitiesGrid(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type)
+{
+	int X0, Y0, X1, Y1;
+	if(!GetGridRange(Type, Pos, Pos, Radius, &X0, &Y0, &X1, &Y1))
+		return FindEntitiesLinear(Pos, Radius, ppEnts, Max, Type);
+
+	int aSerials[MAX_FIND_ENTITIES];
+	int Num = 0;
+	for(int y = Y0; y <= Y1; y++)
+		for(int x = X0; x <= X1; x++)
+			for(CEntity *pEnt = m_aapGridBuckets[Type][GridBucket(x, y)]; pEnt; pEnt = pEnt->m_pNextGridEntity)
+			{
+				if(pEnt->m_GridX != x || pEnt->m_GridY != y)
+					continue;
+				if(distance(pEnt->m_Pos, Pos) < Radius+pEnt->m_ProximityRadius)
+					InsertBySerial(ppEnts, aSerials, &Num, Max, pEnt, pEnt->m_Serial);
+			}
+
+	return Num;
+}
+
+int CGameWorld::FindEntitiesLinear(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type)
+{
 	int Num = 0;
 	for(CEntity *pEnt = m_apFirstEntityTypes[Type];	pEnt; pEnt = pEnt->m_pNextTypeEntity)
 	{
@@ -77,6 +206,12 @@ void CGameWorld::InsertEntity(CEntity *pEnt)
 	pEnt->m_pNextTypeEntity = m_apFirstEntityTypes[pEnt->m_ObjType];
 	pEnt->m_pPrevTypeEntity = 0x0;
 	m_apFirstEntityTypes[pEnt->m_ObjType] = pEnt;
+
+	// index it
+	pEnt->m_Serial = m_NextEntitySerial++;
+	m_aNumEntities[pEnt->m_ObjType]++;
+	m_aMaxProximityRadius[pEnt->m_ObjType] = max(m_aMaxProximityRadius[pEnt->m_ObjType], pEnt->m_ProximityRadius);
+	InsertEntityGrid(pEnt);
 }
 
 void CGameWorld::DestroyEntity(CEntity *pEnt)
@@ -104,6 +239,9 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 
 	pEnt->m_pNextTypeEntity = 0;
 	pEnt->m_pPrevTypeEntity = 0;
+
+	m_aNumEntities[pEnt->m_ObjType]--;
+	RemoveEntityGrid(pEnt);
 }
 
 //
@@ -205,6 +343,60 @@ void CGameWorld::Tick()
 
 // TODO: should be more general
 CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, vec2& NewPos, CEntity *pNotThis)
+{
+	if(!Config()->m_SvWorldGrid)
+		return IntersectCharacterLinear(Pos0, Pos1, Radius, NewPos, pNotThis);
+
+	vec2 GridPos = NewPos;
+	CCharacter *pClosest = IntersectCharacterGrid(Pos0, Pos1, Radius, GridPos, pNotThis);
+	if(Config()->m_SvWorldGrid == 2)
+	{
+		vec2 CheckPos = NewPos;
+		CCharacter *pCheck = IntersectCharacterLinear(Pos0, Pos1, Radius, CheckPos, pNotThis);
+		dbg_assert(pCheck == pClosest && CheckPos == GridPos, "grid IntersectCharacter mismatch");
+	}
+	NewPos = GridPos;
+	return pClosest;
+}
+
+CCharacter *CGameWorld::IntersectCharacterGrid(vec2 Pos0, vec2 Pos1, float Radius, vec2& NewPos, CEntity *pNotThis)
+{
+	int X0, Y0, X1, Y1;
+	vec2 Min(min(Pos0.x, Pos1.x), min(Pos0.y, Pos1.y));
+	vec2 Max(max(Pos0.x, Pos1.x), max(Pos0.y, Pos1.y));
+	if(!GetGridRange(ENTTYPE_CHARACTER, Min, Max, Radius, &X0, &Y0, &X1, &Y1))
+		return IntersectCharacterLinear(Pos0, Pos1, Radius, NewPos, pNotThis);
+
+	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
+	CCharacter *pClosest = 0;
+
+	for(int y = Y0; y <= Y1; y++)
+		for(int x = X0; x <= X1; x++)
+			for(CEntity *pEnt = m_aapGridBuckets[ENTTYPE_CHARACTER][GridBucket(x, y)]; pEnt; pEnt = pEnt->m_pNextGridEntity)
+			{
+				if(pEnt->m_GridX != x || pEnt->m_GridY != y || pEnt == pNotThis)
+					continue;
+
+				CCharacter *p = (CCharacter *)pEnt;
+				vec2 IntersectPos = closest_point_on_line(Pos0, Pos1, p->m_Pos);
+				float Len = distance(p->m_Pos, IntersectPos);
+				if(Len < p->m_ProximityRadius+Radius)
+				{
+					// on equal distance the linear scan keeps the one earlier in the list
+					Len = distance(Pos0, IntersectPos);
+					if(Len < ClosestLen || (Len == ClosestLen && pClosest && p->m_Serial > pClosest->m_Serial))
+					{
+						NewPos = IntersectPos;
+						ClosestLen = Len;
+						pClosest = p;
+					}
+				}
+			}
+
+	return pClosest;
+}
+
+CCharacter *CGameWorld::IntersectCharacterLinear(vec2 Pos0, vec2 Pos1, float Radius, vec2& NewPos, CEntity *pNotThis)
 {
 	// Find other players
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
@@ -235,6 +427,50 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 
 
 CEntity *CGameWorld::ClosestEntity(vec2 Pos, float Radius, int Type, CEntity *pNotThis)
+{
+	if(Type < 0 || Type >= NUM_ENTTYPES)
+		return 0;
+
+	if(!Config()->m_SvWorldGrid)
+		return ClosestEntityLinear(Pos, Radius, Type, pNotThis);
+
+	CEntity *pClosest = ClosestEntityGrid(Pos, Radius, Type, pNotThis);
+	if(Config()->m_SvWorldGrid == 2)
+		dbg_assert(ClosestEntityLinear(Pos, Radius, Type, pNotThis) == pClosest, "grid ClosestEntity mismatch");
+	return pClosest;
+}
+
+CEntity *CGameWorld::ClosestEntityGrid(vec2 Pos, float Radius, int Type, CEntity *pNotThis)
+{
+	int X0, Y0, X1, Y1;
+	if(!GetGridRange(Type, Pos, Pos, Radius, &X0, &Y0, &X1, &Y1))
+		return ClosestEntityLinear(Pos, Radius, Type, pNotThis);
+
+	float ClosestRange = Radius*2;
+	CEntity *pClosest = 0;
+
+	for(int y = Y0; y <= Y1; y++)
+		for(int x = X0; x <= X1; x++)
+			for(CEntity *p = m_aapGridBuckets[Type][GridBucket(x, y)]; p; p = p->m_pNextGridEntity)
+			{
+				if(p->m_GridX != x || p->m_GridY != y || p == pNotThis)
+					continue;
+
+				float Len = distance(Pos, p->m_Pos);
+				if(Len < p->m_ProximityRadius+Radius)
+				{
+					if(Len < ClosestRange || (Len == ClosestRange && pClosest && p->m_Serial > pClosest->m_Serial))
+					{
+						ClosestRange = Len;
+						pClosest = p;
+					}
+				}
+			}
+
+	return pClosest;
+}
+
+CEntity *CGameWorld::ClosestEntityLinear(vec2 Pos, float Radius, int Type, CEntity *pNotThis)
 {
 	// Find other players
 	float ClosestRange = Radius*2;
@@ -27,12 +27,38 @@ public:
 	};
 
 private:
+	enum
+	{
+		GRID_CELL_SHIFT = 8, // 8x8 tiles per cell
+		GRID_NUM_BUCKETS = 1024,
+		MAX_FIND_ENTITIES = 256,
+	};
+
 	void Reset();
 	void RemoveEntities();
 
 	CEntity *m_pNextTraverseEntity;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
 
+	// uniform grid of entities per type, hashed into a fixed number of buckets
+	CEntity *m_aapGridBuckets[NUM_ENTTYPES][GRID_NUM_BUCKETS];
+	int m_aNumEntities[NUM_ENTTYPES];
+	float m_aMaxProximityRadius[NUM_ENTTYPES];
+	int m_NextEntitySerial;
+
+	static int GridCoord(float Pos);
+	static int GridBucket(int GridX, int GridY);
+	void InsertEntityGrid(CEntity *pEnt);
+	void RemoveEntityGrid(CEntity *pEnt);
+	bool GetGridRange(int Type, vec2 Min, vec2 Max, float Radius, int *pX0, int *pY0, int *pX1, int *pY1);
+
+	int FindEntitiesLinear(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type);
+	int FindEntitiesGrid(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type);
+	CEntity *ClosestEntityLinear(vec2 Pos, float Radius, int Type, CEntity *pNotThis);
+	CEntity *ClosestEntityGrid(vec2 Pos, float Radius, int Type, CEntity *pNotThis);
+	class CCharacter *IntersectCharacterLinear(vec2 Pos0, vec2 Pos1, float Radius, vec2 &NewPos, class CEntity *pNotThis);
+	class CCharacter *IntersectCharacterGrid(vec2 Pos0, vec2 Pos1, float Radius, vec2 &NewPos, class CEntity *pNotThis);
+
 	class CGameContext *m_pGameServer;
 	class CConfig *m_pConfig;
 	class IServer *m_pServer;
@@ -128,6 +154,15 @@ public:
 	*/
 	void DestroyEntity(CEntity *pEntity);
 
+	/*
+		Function: update_entity_grid
+			Moves an entity to the grid cell of its current position.
+
+		Arguments:
+			entity - Entity that moved
+	*/
+	void UpdateEntityGrid(CEntity *pEntity);
+
 	/*
 		Function: snap
 			Calls snap on all the entities in the world to create
@@ -0,0 +1,285 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/config.h>
+#include <game/collision.h>
+#include <game/mapitems.h>
+
+// sets up collision maps from plain tile arrays instead of a map file
+class CCollisionTestMap
+{
+public:
+	static void Init(CCollision *pCollision, CTile *pTiles, CTile *pFront, int Width, int Height, CConfig *pConfig = 0)
+	{
+		pCollision->Dest();
+		pCollision->m_NumSwitchers = 0;
+		pCollision->m_pConfig = pConfig;
+		pCollision->m_Width = Width;
+		pCollision->m_Height = Height;
+		pCollision->m_pTiles = pTiles;
+		pCollision->m_pFront = pFront;
+		pCollision->InitTileFlags();
+	}
+};
+
+class CollisionTest : public ::testing::Test
+{
+protected:
+	enum
+	{
+		WIDTH = 64,
+		HEIGHT = 48,
+		NUM_TRACES = 2000,
+	};
+
+	CTile m_aTiles[WIDTH*HEIGHT];
+	CTile m_aFront[WIDTH*HEIGHT];
+	CConfig m_SampledConfig;
+	CConfig m_TraversalConfig;
+	CCollision m_Sampled;
+	CCollision m_Traversal;
+	unsigned m_Seed;
+
+	unsigned Random()
+	{
+		m_Seed = m_Seed*1103515245u + 12345u;
+		return (m_Seed>>16)&0x7fff;
+	}
+
+	float RandomCoord(int Tiles)
+	{
+		// reach a bit outside of the map as well
+		return (int)(Random()%((Tiles+4)*32*8))/8.0f - 64.0f;
+	}
+
+	void SetUp()
+	{
+		static const int s_aTileTypes[] = {TILE_SOLID, TILE_NOHOOK, TILE_NOLASER, TILE_THROUGH, TILE_THROUGH_ALL, TILE_THROUGH_DIR, TILE_DEATH};
+		m_Seed = 1337;
+		mem_zero(m_aTiles, sizeof(m_aTiles));
+		for(int i = 0; i < WIDTH*HEIGHT; i++)
+		{
+			if(Random()%5 == 0)
+			{
+				m_aTiles[i].m_Index = s_aTileTypes[Random()%(sizeof(s_aTileTypes)/sizeof(s_aTileTypes[0]))];
+				m_aTiles[i].m_Flags = Random()%4;
+			}
+		}
+
+		mem_zero(&m_SampledConfig, sizeof(m_SampledConfig));
+		mem_zero(&m_TraversalConfig, sizeof(m_TraversalConfig));
+		m_SampledConfig.m_DbgTileTraversal = 0;
+		m_TraversalConfig.m_DbgTileTraversal = 2;
+		CCollisionTestMap::Init(&m_Sampled, m_aTiles, 0, WIDTH, HEIGHT, &m_SampledConfig);
+		CCollisionTestMap::Init(&m_Traversal, m_aTiles, 0, WIDTH, HEIGHT, &m_TraversalConfig);
+	}
+
+	void AddFrontLayer()
+	{
+		static const int s_aFrontTypes[] = {TILE_THROUGH, TILE_THROUGH_ALL, TILE_THROUGH_CUT, TILE_THROUGH_DIR, TILE_DEATH};
+		mem_zero(m_aFront, sizeof(m_aFront));
+		for(int i = 0; i < WIDTH*HEIGHT; i++)
+		{
+			if(Random()%4 == 0)
+			{
+				m_aFront[i].m_Index = s_aFrontTypes[Random()%(sizeof(s_aFrontTypes)/sizeof(s_aFrontTypes[0]))];
+				m_aFront[i].m_Flags = Random()%4;
+			}
+		}
+		CCollisionTestMap::Init(&m_Sampled, m_aTiles, m_aFront, WIDTH, HEIGHT, &m_SampledConfig);
+		CCollisionTestMap::Init(&m_Traversal, m_aTiles, m_aFront, WIDTH, HEIGHT, &m_TraversalConfig);
+	}
+
+	void RandomSegment(vec2 *pPos0, vec2 *pPos1)
+	{
+		*pPos0 = vec2(RandomCoord(WIDTH), RandomCoord(HEIGHT));
+		if(Random()%2)
+			*pPos1 = vec2(RandomCoord(WIDTH), RandomCoord(HEIGHT));
+		else // short traces like hooks and projectiles
+			*pPos1 = *pPos0 + vec2((int)(Random()%800)-400, (int)(Random()%800)-400);
+	}
+
+	void CompareTraces();
+};
+
+#define EXPECT_SAME_VEC(a, b) \
+	EXPECT_EQ(mem_comp(&(a), &(b), sizeof(vec2)), 0) << (a).x << "," << (a).y << " vs " << (b).x << "," << (b).y
+
+TEST_F(CollisionTest, IntersectLineTraversal)
+{
+	CompareTraces();
+}
+
+TEST_F(CollisionTest, IntersectLineTraversalFront)
+{
+	AddFrontLayer();
+	CompareTraces();
+}
+
+void CollisionTest::CompareTraces()
+{
+	for(int i = 0; i < NUM_TRACES; i++)
+	{
+		vec2 Pos0, Pos1;
+		RandomSegment(&Pos0, &Pos1);
+
+		vec2 aCol[2], aBefore[2];
+		int aTeleNr[2];
+
+		EXPECT_EQ(m_Sampled.IntersectLine(Pos0, Pos1, &aCol[0], &aBefore[0]), m_Traversal.IntersectLine(Pos0, Pos1, &aCol[1], &aBefore[1]));
+		EXPECT_SAME_VEC(aCol[0], aCol[1]);
+		EXPECT_SAME_VEC(aBefore[0], aBefore[1]);
+
+		EXPECT_EQ(m_Sampled.IntersectLineTeleHook(Pos0, Pos1, &aCol[0], &aBefore[0], &aTeleNr[0]), m_Traversal.IntersectLineTeleHook(Pos0, Pos1, &aCol[1], &aBefore[1], &aTeleNr[1]));
+		EXPECT_SAME_VEC(aCol[0], aCol[1]);
+		EXPECT_SAME_VEC(aBefore[0], aBefore[1]);
+		EXPECT_EQ(aTeleNr[0], aTeleNr[1]);
+
+		EXPECT_EQ(m_Sampled.IntersectLineTeleWeapon(Pos0, Pos1, &aCol[0], &aBefore[0], &aTeleNr[0]), m_Traversal.IntersectLineTeleWeapon(Pos0, Pos1, &aCol[1], &aBefore[1], &aTeleNr[1]));
+		EXPECT_SAME_VEC(aCol[0], aCol[1]);
+		EXPECT_SAME_VEC(aBefore[0], aBefore[1]);
+
+		EXPECT_EQ(m_Sampled.IntersectNoLaser(Pos0, Pos1, &aCol[0], &aBefore[0]), m_Traversal.IntersectNoLaser(Pos0, Pos1, &aCol[1], &aBefore[1]));
+		EXPECT_SAME_VEC(aCol[0], aCol[1]);
+		EXPECT_SAME_VEC(aBefore[0], aBefore[1]);
+
+		EXPECT_EQ(m_Sampled.IntersectNoLaserNW(Pos0, Pos1, &aCol[0], &aBefore[0]), m_Traversal.IntersectNoLaserNW(Pos0, Pos1, &aCol[1], &aBefore[1]));
+		EXPECT_SAME_VEC(aCol[0], aCol[1]);
+		EXPECT_SAME_VEC(aBefore[0], aBefore[1]);
+
+		EXPECT_EQ(m_Sampled.IntersectAir(Pos0, Pos1, &aCol[0], &aBefore[0]), m_Traversal.IntersectAir(Pos0, Pos1, &aCol[1], &aBefore[1]));
+		EXPECT_SAME_VEC(aCol[0], aCol[1]);
+		EXPECT_SAME_VEC(aBefore[0], aBefore[1]);
+	}
+}
+
+TEST_F(CollisionTest, MoveBoxTraversal)
+{
+	static const float s_aElasticity[] = {0.0f, 0.5f};
+	const vec2 Size(28.0f, 28.0f);
+
+	for(unsigned e = 0; e < sizeof(s_aElasticity)/sizeof(s_aElasticity[0]); e++)
+	{
+		vec2 Pos(RandomCoord(WIDTH), RandomCoord(HEIGHT));
+		vec2 Vel(0.0f, 0.0f);
+		for(int Tick = 0; Tick < NUM_TRACES; Tick++)
+		{
+			// gravity with the occasional jump, hook pull or speedup boost
+			Vel.y += 0.5f;
+			switch(Random()%16)
+			{
+			case 0: Vel.y = -13.2f; break;
+			case 1: Vel += vec2((int)(Random()%80)-40, (int)(Random()%80)-40); break;
+			case 2: Vel = vec2((int)(Random()%12000)-6000, (int)(Random()%12000)-6000)/10.0f; break;
+			case 3: Pos = vec2(RandomCoord(WIDTH), RandomCoord(HEIGHT)); break;
+			}
+
+			vec2 aPos[2] = {Pos, Pos};
+			vec2 aVel[2] = {Vel, Vel};
+			m_Sampled.MoveBox(&aPos[0], &aVel[0], Size, s_aElasticity[e]);
+			m_Traversal.MoveBox(&aPos[1], &aVel[1], Size, s_aElasticity[e]);
+			EXPECT_SAME_VEC(aPos[0], aPos[1]);
+			EXPECT_SAME_VEC(aVel[0], aVel[1]);
+
+			Pos = aPos[0];
+			Vel = aVel[0];
+		}
+	}
+}
+
+TEST_F(CollisionTest, MovePointsBatch)
+{
+	enum { NUM_POINTS = 256 };
+	float aPosX[NUM_POINTS], aPosY[NUM_POINTS], aVelX[NUM_POINTS], aVelY[NUM_POINTS], aElasticity[NUM_POINTS];
+	vec2 aPos[NUM_POINTS], aVel[NUM_POINTS];
+	for(int i = 0; i < NUM_POINTS; i++)
+	{
+		aPos[i] = vec2(RandomCoord(WIDTH), RandomCoord(HEIGHT));
+		aVel[i] = vec2((int)(Random()%400)-200, (int)(Random()%400)-200)/10.0f;
+		aPosX[i] = aPos[i].x;
+		aPosY[i] = aPos[i].y;
+		aVelX[i] = aVel[i].x;
+		aVelY[i] = aVel[i].y;
+		aElasticity[i] = (Random()%10)/10.0f;
+	}
+
+	for(int Tick = 0; Tick < 50; Tick++)
+	{
+		for(int i = 0; i < NUM_POINTS; i++)
+			m_Sampled.MovePoint(&aPos[i], &aVel[i], aElasticity[i], 0);
+		m_Sampled.MovePoints(aPosX, aPosY, aVelX, aVelY, aElasticity, NUM_POINTS);
+		for(int i = 0; i < NUM_POINTS; i++)
+		{
+			vec2 Pos(aPosX[i], aPosY[i]);
+			vec2 Vel(aVelX[i], aVelY[i]);
+			EXPECT_SAME_VEC(aPos[i], Pos);
+			EXPECT_SAME_VEC(aVel[i], Vel);
+		}
+	}
+}
+
+TEST_F(CollisionTest, MoveRestrictions)
+{
+	CTile aTiles[3*3];
+	mem_zero(aTiles, sizeof(aTiles));
+	CCollision Collision;
+	CCollisionTestMap::Init(&Collision, aTiles, 0, 3, 3);
+	const vec2 Center(48.0f, 48.0f);
+	EXPECT_EQ(Collision.GetMoveRestrictions(0, 0, Center), 0);
+
+	// one-way stopper below, blocks moving down only
+	aTiles[2*3+1].m_Index = TILE_STOP;
+	aTiles[2*3+1].m_Flags = ROTATION_0;
+	CCollisionTestMap::Init(&Collision, aTiles, 0, 3, 3);
+	EXPECT_EQ(Collision.GetMoveRestrictions(0, 0, Center), CANTMOVE_DOWN);
+	EXPECT_EQ(Collision.GetMoveRestrictions(0, 0, vec2(48.0f, 80.0f), 18.0f), CANTMOVE_DOWN);
+	EXPECT_EQ(Collision.GetMoveRestrictions(0, 0, vec2(48.0f, 16.0f), 18.0f), 0);
+
+	// bidirectional stopper to the right
+	aTiles[1*3+2].m_Index = TILE_STOPS;
+	aTiles[1*3+2].m_Flags = ROTATION_90;
+	CCollisionTestMap::Init(&Collision, aTiles, 0, 3, 3);
+	EXPECT_EQ(Collision.GetMoveRestrictions(0, 0, Center), CANTMOVE_DOWN|CANTMOVE_RIGHT);
+
+	// all directions stopper in the center only applies when moving onto it
+	aTiles[1*3+1].m_Index = TILE_STOPA;
+	CCollisionTestMap::Init(&Collision, aTiles, 0, 3, 3);
+	EXPECT_EQ(Collision.GetMoveRestrictions(0, 0, Center), CANTMOVE_DOWN|CANTMOVE_RIGHT);
+	EXPECT_EQ(Collision.GetMoveRestrictions(0, 0, vec2(16.0f, 48.0f)), CANTMOVE_RIGHT);
+}
+
+TEST_F(CollisionTest, HookFrontLayer)
+{
+	enum { W = 5, H = 3 };
+	CTile aTiles[W*H];
+	CTile aFront[W*H];
+	mem_zero(aTiles, sizeof(aTiles));
+	mem_zero(aFront, sizeof(aFront));
+	aTiles[1*W+3].m_Index = TILE_SOLID;
+
+	CCollision Collision;
+	const vec2 From(16.0f, 48.0f), To(150.0f, 48.0f);
+	vec2 Col, Before;
+	int TeleNr;
+
+	// the solid tile stops the hook
+	CCollisionTestMap::Init(&Collision, aTiles, aFront, W, H);
+	EXPECT_EQ(Collision.IntersectLineTeleHook(From, To, &Col, &Before, &TeleNr), TILE_SOLID);
+	EXPECT_EQ(round_to_int(Col.x)/32, 3);
+
+	// a front through all tile on top of it lets the hook pass
+	aFront[1*W+3].m_Index = TILE_THROUGH_ALL;
+	CCollisionTestMap::Init(&Collision, aTiles, aFront, W, H);
+	EXPECT_EQ(Collision.IntersectLineTeleHook(From, To, &Col, &Before, &TeleNr), 0);
+
+	// on an empty tile it blocks the hook
+	aFront[1*W+1].m_Index = TILE_THROUGH_ALL;
+	CCollisionTestMap::Init(&Collision, aTiles, aFront, W, H);
+	EXPECT_EQ(Collision.IntersectLineTeleHook(From, To, &Col, &Before, &TeleNr), TILE_NOHOOK);
+	EXPECT_EQ(round_to_int(Col.x)/32, 1);
+
+	// a front through cut tile doesn't
+	aFront[1*W+1].m_Index = TILE_THROUGH_CUT;
+	CCollisionTestMap::Init(&Collision, aTiles, aFront, W, H);
+	EXPECT_EQ(Collision.IntersectLineTeleHook(From, To, &Col, &Before, &TeleNr), 0);
+}
@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/console.h>
+#include <engine/shared/config.h>
+
+class Console : public ::testing::Test
+{
+protected:
+	IConsole *m_pConsole;
+	int m_Sum;
+	int m_NumCalls;
+	char m_aLastString[64];
+
+	void SetUp()
+	{
+		m_pConsole = CreateConsole(CFGFLAG_SERVER);
+		m_Sum = 0;
+		m_NumCalls = 0;
+		m_aLastString[0] = 0;
+		m_pConsole->Register("Add", "i[value]", CFGFLAG_SERVER, ConAdd, this, "");
+		m_pConsole->Register("say_it", "r[text]", CFGFLAG_SERVER, ConSay, this, "");
+		m_pConsole->Register("+hold", "", CFGFLAG_SERVER, ConHold, this, "");
+		m_pConsole->Register("register", "", CFGFLAG_SERVER, ConRegister, this, "");
+		m_pConsole->Register("flood", "", CFGFLAG_SERVER, ConFlood, this, "");
+	}
+
+	void TearDown()
+	{
+		delete m_pConsole;
+	}
+
+	static void ConAdd(IConsole::IResult *pResult, void *pUserData)
+	{
+		Console *pSelf = (Console *)pUserData;
+		pSelf->m_Sum += pResult->GetInteger(0);
+		pSelf->m_NumCalls++;
+	}
+
+	static void ConSay(IConsole::IResult *pResult, void *pUserData)
+	{
+		Console *pSelf = (Console *)pUserData;
+		str_copy(pSelf->m_aLastString, pResult->GetString(0), sizeof(pSelf->m_aLastString));
+		pSelf->m_NumCalls++;
+	}
+
+	static void ConHold(IConsole::IResult *pResult, void *pUserData)
+	{
+		Console *pSelf = (Console *)pUserData;
+		pSelf->m_Sum += pResult->GetInteger(0) ? 10 : -1;
+		pSelf->m_NumCalls++;
+	}
+
+	static void ConRegister(IConsole::IResult *pResult, void *pUserData)
+	{
+		Console *pSelf = (Console *)pUserData;
+		pSelf->m_pConsole->Register("say_it", "r[text]", CFGFLAG_SERVER, ConSay, pSelf, "");
+		pSelf->m_NumCalls++;
+	}
+
+	static void ConFlood(IConsole::IResult *pResult, void *pUserData)
+	{
+		// enough different single command lines to reuse every line cache slot
+		Console *pSelf = (Console *)pUserData;
+		for(int i = 0; i < 512; i++)
+		{
+			char aLine[32];
+			str_format(aLine, sizeof(aLine), "add 0 # %d", i);
+			pSelf->m_pConsole->ExecuteLine(aLine);
+		}
+	}
+};
+
+TEST_F(Console, FindCommandsIgnoringCase)
+{
+	m_pConsole->ExecuteLine("add 3");
+	m_pConsole->ExecuteLine("ADD 4");
+	EXPECT_EQ(m_Sum, 7);
+	EXPECT_TRUE(m_pConsole->GetCommandInfo("sAy_iT", CFGFLAG_SERVER, false));
+	EXPECT_FALSE(m_pConsole->GetCommandInfo("say_it", CFGFLAG_CLIENT, false));
+	EXPECT_FALSE(m_pConsole->GetCommandInfo("say", CFGFLAG_SERVER, false));
+}
+
+TEST_F(Console, RepeatedLines)
+{
+	for(int i = 0; i < 10; i++)
+	{
+		m_pConsole->ExecuteLine("add 1; add 2 # add 100");
+		m_pConsole->ExecuteLine("say_it \"a;b\"; add -3");
+		m_pConsole->ExecuteLine("add");
+		m_pConsole->ExecuteLine("unknown 1; add 1");
+	}
+	EXPECT_EQ(m_Sum, 10);
+	EXPECT_EQ(m_NumCalls, 50);
+	EXPECT_STREQ(m_aLastString, "a;b");
+}
+
+TEST_F(Console, StrokeLines)
+{
+	for(int i = 0; i < 10; i++)
+	{
+		m_pConsole->ExecuteLineStroked(1, "+hold; add 1");
+		m_pConsole->ExecuteLineStroked(0, "+hold; add 1");
+	}
+	EXPECT_EQ(m_Sum, 100);
+	EXPECT_EQ(m_NumCalls, 30);
+}
+
+TEST_F(Console, LinesFollowRegistration)
+{
+	m_pConsole->ExecuteLine("say_it first");
+	EXPECT_STREQ(m_aLastString, "first");
+
+	// the same name now takes a number
+	m_pConsole->Register("say_it", "i[value]", CFGFLAG_SERVER, ConAdd, this, "");
+	m_pConsole->ExecuteLine("say_it 5");
+	EXPECT_EQ(m_Sum, 5);
+
+	// the rest of the line still runs when a command in it registers commands
+	for(int i = 0; i < 3; i++)
+		m_pConsole->ExecuteLine("register; say_it second; add 1");
+	EXPECT_STREQ(m_aLastString, "second");
+	EXPECT_EQ(m_Sum, 8);
+
+	m_pConsole->RegisterTemp("temp_cmd", "", CFGFLAG_SERVER, "");
+	EXPECT_TRUE(m_pConsole->GetCommandInfo("temp_cmd", CFGFLAG_SERVER, true));
+	m_pConsole->DeregisterTemp("temp_cmd");
+	EXPECT_FALSE(m_pConsole->GetCommandInfo("temp_cmd", CFGFLAG_SERVER, true));
+	m_pConsole->RegisterTemp("temp_a", "", CFGFLAG_SERVER, "");
+	m_pConsole->RegisterTemp("temp_b", "", CFGFLAG_SERVER, "");
+	m_pConsole->DeregisterTempAll();
+	EXPECT_FALSE(m_pConsole->GetCommandInfo("temp_a", CFGFLAG_SERVER, true));
+	EXPECT_FALSE(m_pConsole->GetCommandInfo("temp_b", CFGFLAG_SERVER, true));
+	m_pConsole->ExecuteLine("add 1");
+	EXPECT_EQ(m_Sum, 9);
+}
+
+TEST_F(Console, NestedLinesReuseCache)
+{
+	// the rest of the line still runs when a nested line took over its cache slot
+	for(int i = 0; i < 3; i++)
+		m_pConsole->ExecuteLine("flood; add 1; add 2");
+	EXPECT_EQ(m_Sum, 9);
+	EXPECT_EQ(m_NumCalls, 3*(512+2));
+}
@@ -3,6 +3,7 @@
 #include <gtest/gtest.h>
 
 #include <engine/shared/datafile.h>
+#include <engine/shared/jobs.h>
 #include <engine/storage.h>
 
 TEST(Datafile, RoundtripItemDataAndSize)
@@ -63,3 +64,184 @@ TEST(Datafile, RoundtripItemDataAndSize)
 
 	EXPECT_TRUE(pStorage->RemoveFile(aFilename, IStorage::TYPE_SAVE));
 }
+
+TEST(Datafile, UnloadAndReloadData)
+{
+	CTestInfo Info;
+	char aFilename[64];
+	Info.Filename(aFilename, sizeof(aFilename), ".datafile");
+	IStorage *pStorage = CreateTestStorage();
+	CDataFileWriter Writer;
+	ASSERT_TRUE(Writer.Open(pStorage, aFilename));
+
+	int aaData[8][256];
+	int aIndices[8];
+	for(int i = 0; i < 8; i++)
+	{
+		for(int k = 0; k < 256; k++)
+			aaData[i][k] = i*1000+k;
+		aIndices[i] = Writer.AddData((i+1)*32*sizeof(int), aaData[i]);
+	}
+	EXPECT_TRUE(Writer.Finish());
+
+	CDataFileReader Reader;
+	ASSERT_TRUE(Reader.Open(pStorage, aFilename, IStorage::TYPE_ALL));
+	for(int Pass = 0; Pass < 2; Pass++)
+	{
+		for(int i = 7; i >= 0; i--)
+		{
+			ASSERT_EQ(Reader.GetDataSize(aIndices[i]), (i+1)*32*(int)sizeof(int));
+			EXPECT_TRUE(mem_comp(Reader.GetData(aIndices[i]), aaData[i], (i+1)*32*sizeof(int)) == 0);
+		}
+		for(int i = 0; i < 8; i += 2)
+			Reader.UnloadData(aIndices[i]);
+	}
+
+	char *pReplace = (char *)mem_alloc(4, 1);
+	mem_copy(pReplace, "abc", 4);
+	Reader.ReplaceData(aIndices[3], pReplace, 4);
+	EXPECT_TRUE(mem_comp(Reader.GetData(aIndices[3]), "abc", 4) == 0);
+	EXPECT_TRUE(mem_comp(Reader.GetData(aIndices[4]), aaData[4], 5*32*sizeof(int)) == 0);
+	EXPECT_TRUE(Reader.Close());
+
+	EXPECT_TRUE(pStorage->RemoveFile(aFilename, IStorage::TYPE_SAVE));
+	delete pStorage;
+}
+
+TEST(Datafile, ReadUncompressedVersion3)
+{
+	CTestInfo Info;
+	char aFilename[64];
+	Info.Filename(aFilename, sizeof(aFilename), ".datafile");
+	IStorage *pStorage = CreateTestStorage();
+
+	// the writer only produces v4, so put a v3 file with two data blocks together by hand
+	static const char TEST_DATA[] = "Hello World!";
+	int aFile[] = {
+		0, 3, 0, 0, // id, version, size, swaplen
+		0, 0, 2, 0, 2*sizeof(TEST_DATA), // item types, items, raw data, item size, data size
+		0, sizeof(TEST_DATA), // data offsets
+	};
+	mem_copy(&aFile[0], "DATA", 4);
+	IOHANDLE File = pStorage->OpenFile(aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	ASSERT_TRUE(File);
+	io_write(File, aFile, sizeof(aFile));
+	io_write(File, TEST_DATA, sizeof(TEST_DATA));
+	io_write(File, TEST_DATA, sizeof(TEST_DATA));
+	io_close(File);
+
+	CDataFileReader Reader;
+	ASSERT_TRUE(Reader.Open(pStorage, aFilename, IStorage::TYPE_ALL));
+	ASSERT_EQ(Reader.NumData(), 2);
+	for(int i = 0; i < 2; i++)
+	{
+		ASSERT_EQ(Reader.GetDataSize(i), sizeof(TEST_DATA));
+		EXPECT_TRUE(mem_comp(Reader.GetData(i), TEST_DATA, sizeof(TEST_DATA)) == 0);
+	}
+	Reader.UnloadData(0);
+	EXPECT_TRUE(mem_comp(Reader.GetData(0), TEST_DATA, sizeof(TEST_DATA)) == 0);
+	EXPECT_TRUE(Reader.Close());
+
+	EXPECT_TRUE(pStorage->RemoveFile(aFilename, IStorage::TYPE_SAVE));
+	delete pStorage;
+}
+
+TEST(Datafile, PrefetchData)
+{
+	CTestInfo Info;
+	char aFilename[64];
+	Info.Filename(aFilename, sizeof(aFilename), ".datafile");
+	IStorage *pStorage = CreateTestStorage();
+	CDataFileWriter Writer;
+	ASSERT_TRUE(Writer.Open(pStorage, aFilename));
+
+	static int s_aaData[64][1024];
+	for(int i = 0; i < 64; i++)
+	{
+		for(int k = 0; k < 1024; k++)
+			s_aaData[i][k] = (i*7919+k*31)%(i+5);
+		Writer.AddData(sizeof(s_aaData[i]), s_aaData[i]);
+	}
+	EXPECT_TRUE(Writer.Finish());
+
+	CJobPool Pool;
+	Pool.Init(3);
+	CDataFileReader Reader;
+	ASSERT_TRUE(Reader.Open(pStorage, aFilename, IStorage::TYPE_ALL));
+
+	// a subset with duplicates and invalid indices first, then the rest
+	int aIndices[] = {5, 9, 5, -1, 63, 64, 9, 0};
+	Reader.PrefetchData(&Pool, aIndices, sizeof(aIndices)/sizeof(aIndices[0]));
+	Reader.UnloadData(63);
+	Reader.PrefetchData(&Pool);
+	for(int i = 0; i < 64; i++)
+	{
+		ASSERT_EQ(Reader.GetDataSize(i), (int)sizeof(s_aaData[i]));
+		EXPECT_TRUE(mem_comp(Reader.GetData(i), s_aaData[i], sizeof(s_aaData[i])) == 0);
+	}
+	EXPECT_TRUE(Reader.Close());
+
+	EXPECT_TRUE(pStorage->RemoveFile(aFilename, IStorage::TYPE_SAVE));
+	delete pStorage;
+}
+
+TEST(Datafile, CorruptCompressedData)
+{
+	CTestInfo Info;
+	char aFilename[64];
+	Info.Filename(aFilename, sizeof(aFilename), ".datafile");
+	IStorage *pStorage = CreateTestStorage();
+
+	// one v4 data block that doesn't inflate to the size the header claims
+	static const char GARBAGE[16] = "not zlib data";
+	int aFile[] = {
+		0, 4, 0, 0, // id, version, size, swaplen
+		0, 0, 1, 0, sizeof(GARBAGE), // item types, items, raw data, item size, data size
+		0, // data offsets
+		64, // uncompressed data sizes
+	};
+	mem_copy(&aFile[0], "DATA", 4);
+	IOHANDLE File = pStorage->OpenFile(aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	ASSERT_TRUE(File);
+	io_write(File, aFile, sizeof(aFile));
+	io_write(File, GARBAGE, sizeof(GARBAGE));
+	io_close(File);
+
+	static const char ZEROES[64] = {0};
+	CDataFileReader Reader;
+	ASSERT_TRUE(Reader.Open(pStorage, aFilename, IStorage::TYPE_ALL));
+	ASSERT_EQ(Reader.GetDataSize(0), 64);
+	EXPECT_TRUE(mem_comp(Reader.GetData(0), ZEROES, sizeof(ZEROES)) == 0);
+	EXPECT_TRUE(Reader.Close());
+
+	EXPECT_TRUE(pStorage->RemoveFile(aFilename, IStorage::TYPE_SAVE));
+	delete pStorage;
+}
+
+TEST(Datafile, TruncatedWhileOpen)
+{
+	CTestInfo Info;
+	char aFilename[64];
+	Info.Filename(aFilename, sizeof(aFilename), ".datafile");
+	IStorage *pStorage = CreateTestStorage();
+	CDataFileWriter Writer;
+	ASSERT_TRUE(Writer.Open(pStorage, aFilename));
+
+	static int s_aData[16*1024];
+	for(int i = 0; i < 16*1024; i++)
+		s_aData[i] = i*2654435761u;
+	int Index = Writer.AddData(sizeof(s_aData), s_aData);
+	EXPECT_TRUE(Writer.Finish());
+
+	CDataFileReader Reader;
+	ASSERT_TRUE(Reader.Open(pStorage, aFilename, IStorage::TYPE_ALL));
+
+	// the data is requested only after the file was cut off on disk
+	io_close(pStorage->OpenFile(aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE));
+	ASSERT_EQ(Reader.GetDataSize(Index), (int)sizeof(s_aData));
+	EXPECT_TRUE(mem_comp(Reader.GetData(Index), s_aData, sizeof(s_aData)) == 0);
+	EXPECT_TRUE(Reader.Close());
+
+	EXPECT_TRUE(pStorage->RemoveFile(aFilename, IStorage::TYPE_SAVE));
+	delete pStorage;
+}
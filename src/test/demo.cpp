@@ -0,0 +1,239 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/hash.h>
+#include <base/system.h>
+#include <engine/console.h>
+#include <engine/shared/config.h>
+#include <engine/shared/demo.h>
+#include <engine/storage.h>
+
+class CSnapshotCollector : public CDemoPlayer::IListener
+{
+public:
+	char m_aData[CSnapshot::MAX_SIZE];
+	int m_Size;
+	int m_NumMessages;
+	int m_LastMessage;
+
+	CSnapshotCollector() { m_Size = 0; m_NumMessages = 0; m_LastMessage = 0; }
+	void OnDemoPlayerSnapshot(void *pData, int Size) { mem_copy(m_aData, pData, Size); m_Size = Size; }
+	void OnDemoPlayerMessage(void *pData, int Size) { m_LastMessage = *(int *)pData; m_NumMessages++; }
+};
+
+class Demo : public ::testing::Test
+{
+protected:
+	CTestInfo m_Info;
+	IStorage *m_pStorage;
+	IConsole *m_pConsole;
+	CSnapshotDelta m_Delta;
+	char m_aMap[64];
+	char m_aMapFilename[128];
+	char m_aDemoFilename[64];
+	char m_aCheckpointFilename[64];
+
+	void SetUp()
+	{
+		m_pStorage = CreateTestStorage();
+		m_pConsole = CreateConsole(CFGFLAG_CLIENT);
+
+		// the recorder needs a map to embed, an empty one will do
+		str_copy(m_aMap, m_Info.m_aFilenamePrefix, sizeof(m_aMap));
+		str_format(m_aMapFilename, sizeof(m_aMapFilename), "maps/%s.map", m_aMap);
+		m_pStorage->CreateFolder("maps", IStorage::TYPE_SAVE);
+		io_close(m_pStorage->OpenFile(m_aMapFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE));
+
+		m_Info.Filename(m_aDemoFilename, sizeof(m_aDemoFilename), ".demo");
+		str_format(m_aCheckpointFilename, sizeof(m_aCheckpointFilename), "%s.cpt", m_aDemoFilename);
+	}
+
+	void TearDown()
+	{
+		m_pStorage->RemoveFile(m_aMapFilename, IStorage::TYPE_SAVE);
+		m_pStorage->RemoveFile(m_aDemoFilename, IStorage::TYPE_SAVE);
+		m_pStorage->RemoveFile(m_aCheckpointFilename, IStorage::TYPE_SAVE);
+		fs_remove("maps");
+		delete m_pConsole;
+		delete m_pStorage;
+	}
+
+	void Record(int NumTicks, int Seed = 0)
+	{
+		static char s_aSnap[CSnapshot::MAX_SIZE];
+		CDemoRecorder Recorder(&m_Delta);
+		ASSERT_EQ(Recorder.Start(m_pStorage, m_pConsole, m_aDemoFilename, "test", m_aMap, sha256(0, 0), 0, "client"), 0);
+		for(int Tick = 1; Tick <= NumTicks; Tick++)
+		{
+			CSnapshotBuilder Builder;
+			Builder.Init();
+			// one item that tells the tick and a few that change now and then
+			*(int *)Builder.NewItem(1, 0, 4) = Tick;
+			for(int i = 0; i < 8; i++)
+				*(int *)Builder.NewItem(2, i, 4) = Tick/(i+3) + Seed;
+			int Size = Builder.Finish(s_aSnap);
+			Recorder.RecordSnapshot(Tick, s_aSnap, Size);
+		}
+		Recorder.Stop();
+	}
+
+	// returns the tick the player ended up at and the snapshot it delivered last
+	int Seek(int CheckpointInterval, bool Cache, float Percent, CSnapshotCollector *pCollector)
+	{
+		CDemoPlayer Player(&m_Delta);
+		Player.SetListener(pCollector);
+		Player.SetCheckpoints(CheckpointInterval, Cache);
+		if(Player.Load(m_pStorage, m_pConsole, m_aDemoFilename, IStorage::TYPE_ALL, "test"))
+			return -1;
+		Player.Play();
+		Player.SetPos(Percent);
+		int Tick = Player.Info()->m_Info.m_CurrentTick;
+		Player.Stop();
+		return Tick;
+	}
+};
+
+TEST_F(Demo, SeekCheckpoints)
+{
+	Record(2000);
+
+	for(int Cache = 0; Cache < 2; Cache++)
+		for(int i = 0; i <= 20; i++)
+		{
+			float Percent = i/20.0f;
+			CSnapshotCollector Keyframes;
+			CSnapshotCollector Checkpoints;
+			int Tick = Seek(0, false, Percent, &Keyframes);
+			ASSERT_GT(Tick, 0);
+			EXPECT_EQ(Seek(25, Cache, Percent, &Checkpoints), Tick);
+			ASSERT_EQ(Checkpoints.m_Size, Keyframes.m_Size);
+			EXPECT_EQ(mem_comp(Checkpoints.m_aData, Keyframes.m_aData, Keyframes.m_Size), 0);
+			EXPECT_EQ(((CSnapshot *)Checkpoints.m_aData)->GetItem(0)->Data()[0], Tick);
+		}
+}
+
+TEST_F(Demo, CheckpointCacheFollowsDemo)
+{
+	Record(2000);
+	CSnapshotCollector Collector;
+	ASSERT_GT(Seek(25, true, 0.5f, &Collector), 0);
+
+	// a different demo under the same name must not use the old cache
+	Record(2000, 7);
+	CSnapshotCollector Keyframes;
+	CSnapshotCollector Checkpoints;
+	int Tick = Seek(0, false, 0.5f, &Keyframes);
+	ASSERT_GT(Tick, 0);
+	EXPECT_EQ(Seek(25, true, 0.5f, &Checkpoints), Tick);
+	ASSERT_EQ(Checkpoints.m_Size, Keyframes.m_Size);
+	EXPECT_EQ(mem_comp(Checkpoints.m_aData, Keyframes.m_aData, Keyframes.m_Size), 0);
+}
+
+TEST_F(Demo, CorruptCheckpointCache)
+{
+	static unsigned char s_aCache[1024*1024];
+	Record(2000);
+	CSnapshotCollector Collector;
+	ASSERT_GT(Seek(25, true, 0.5f, &Collector), 0);
+
+	IOHANDLE File = m_pStorage->OpenFile(m_aCheckpointFilename, IOFLAG_READ, IStorage::TYPE_SAVE);
+	ASSERT_TRUE(File);
+	int Size = io_read(File, s_aCache, sizeof(s_aCache));
+	io_close(File);
+
+	// point the last item of every checkpoint past the end of its snapshot,
+	// entries follow the marker, header and sha256
+	int NumCheckpoints = bytes_be_to_uint(s_aCache + 8 + 2*4);
+	ASSERT_GT(NumCheckpoints, 0);
+	int Pos = 8 + 3*4 + 32;
+	for(int i = 0; i < NumCheckpoints; i++)
+	{
+		int DataSize = bytes_be_to_uint(s_aCache + Pos + 2*4);
+		ASSERT_LE(Pos + 3*4 + DataSize, Size);
+		CSnapshot *pSnap = (CSnapshot *)(s_aCache + Pos + 3*4);
+		ASSERT_GT(pSnap->NumItems(), 0);
+		int *pLastOffset = (int *)(pSnap+1) + 2*pSnap->NumItems() - 1;
+		*pLastOffset += 0x1000;
+		Pos += 3*4 + DataSize;
+	}
+	File = m_pStorage->OpenFile(m_aCheckpointFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	ASSERT_TRUE(File);
+	io_write(File, s_aCache, Size);
+	io_close(File);
+
+	for(int i = 1; i <= 4; i++)
+	{
+		float Percent = i/4.0f;
+		CSnapshotCollector Keyframes;
+		CSnapshotCollector Checkpoints;
+		int Tick = Seek(0, false, Percent, &Keyframes);
+		ASSERT_GT(Tick, 0);
+		EXPECT_EQ(Seek(25, true, Percent, &Checkpoints), Tick);
+		ASSERT_EQ(Checkpoints.m_Size, Keyframes.m_Size);
+		EXPECT_EQ(mem_comp(Checkpoints.m_aData, Keyframes.m_aData, Keyframes.m_Size), 0);
+	}
+}
+
+TEST_F(Demo, FixedStep)
+{
+	Record(500);
+
+	CSnapshotCollector Collector;
+	CDemoPlayer Player(&m_Delta);
+	Player.SetListener(&Collector);
+	ASSERT_FALSE(Player.Load(m_pStorage, m_pConsole, m_aDemoFilename, IStorage::TYPE_ALL, "test"));
+	Player.Play();
+	Player.SetFixedStep(time_freq()/SERVER_TICK_SPEED);
+
+	// one tick per update, however long the updates take
+	int StartTick = Player.Info()->m_Info.m_CurrentTick;
+	for(int i = 1; i <= 100; i++)
+	{
+		Player.Update();
+		EXPECT_EQ(Player.Info()->m_Info.m_CurrentTick, StartTick+i);
+	}
+	thread_sleep(50);
+	Player.Update();
+	EXPECT_EQ(Player.Info()->m_Info.m_CurrentTick, StartTick+101);
+	Player.Stop();
+}
+
+TEST_F(Demo, RecorderQueueWraps)
+{
+	// snapshots big enough to wrap the writer queue a few times
+	static char s_aSnap[CSnapshot::MAX_SIZE];
+	const int NumTicks = 400;
+	CDemoRecorder Recorder(&m_Delta);
+	ASSERT_EQ(Recorder.Start(m_pStorage, m_pConsole, m_aDemoFilename, "test", m_aMap, sha256(0, 0), 0, "client"), 0);
+	for(int Tick = 1; Tick <= NumTicks; Tick++)
+	{
+		CSnapshotBuilder Builder;
+		Builder.Init();
+		*(int *)Builder.NewItem(1, 0, 4) = Tick;
+		for(int i = 0; i < 32; i++)
+		{
+			int *pItem = (int *)Builder.NewItem(2, i, 64*4);
+			for(int k = 0; k < 64; k++)
+				pItem[k] = Tick*(k+1)+i;
+		}
+		int Size = Builder.Finish(s_aSnap);
+		Recorder.RecordSnapshot(Tick, s_aSnap, Size);
+		Recorder.RecordMessage(&Tick, sizeof(Tick));
+	}
+	EXPECT_EQ(Recorder.Length(), (NumTicks-1)/SERVER_TICK_SPEED);
+	Recorder.Stop();
+
+	CSnapshotCollector Collector;
+	CDemoPlayer Player(&m_Delta);
+	Player.SetListener(&Collector);
+	ASSERT_FALSE(Player.Load(m_pStorage, m_pConsole, m_aDemoFilename, IStorage::TYPE_ALL, "test"));
+	Player.Play();
+	Player.SetFixedStep(time_freq()/SERVER_TICK_SPEED);
+	for(int i = 0; i < NumTicks*2 && Player.IsPlaying(); i++)
+		Player.Update();
+
+	ASSERT_GT(Collector.m_Size, 0);
+	EXPECT_EQ(((CSnapshot *)Collector.m_aData)->GetItem(0)->Data()[0], NumTicks);
+	EXPECT_EQ(Collector.m_NumMessages, NumTicks);
+	EXPECT_EQ(Collector.m_LastMessage, NumTicks);
+}
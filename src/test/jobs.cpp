@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/jobs.h>
+
+static int Square(void *pUser)
+{
+	int *pValue = (int *)pUser;
+	*pValue = *pValue * *pValue;
+	return *pValue;
+}
+
+static void RunJobs(int NumThreads)
+{
+	CJobPool Pool;
+	Pool.Init(NumThreads);
+
+	enum { NUM_JOBS = 64 };
+	CJob aJobs[NUM_JOBS];
+	CJob *apJobs[NUM_JOBS];
+	int aValues[NUM_JOBS];
+	for(int i = 0; i < NUM_JOBS; i++)
+	{
+		aValues[i] = i;
+		apJobs[i] = &aJobs[i];
+		Pool.Add(&aJobs[i], Square, &aValues[i]);
+	}
+	Pool.WaitAll(apJobs, NUM_JOBS);
+
+	for(int i = 0; i < NUM_JOBS; i++)
+	{
+		EXPECT_EQ(aJobs[i].Status(), CJob::STATE_DONE);
+		EXPECT_EQ(aJobs[i].Result(), i*i);
+		EXPECT_EQ(aValues[i], i*i);
+	}
+}
+
+TEST(Jobs, WaitAllWithoutThreads)
+{
+	RunJobs(0);
+}
+
+TEST(Jobs, WaitAllWithThreads)
+{
+	RunJobs(4);
+}
+
+TEST(Jobs, RunPendingEmpty)
+{
+	CJobPool Pool;
+	EXPECT_FALSE(Pool.RunPending());
+}
+
+static int SlowSquare(void *pUser)
+{
+	thread_sleep(20);
+	return Square(pUser);
+}
+
+TEST(Jobs, WaitAllForRunningJobs)
+{
+	CJobPool Pool;
+	Pool.Init(4);
+
+	// the workers pick these up right away, so WaitAll has to wait for them
+	enum { NUM_JOBS = 4 };
+	CJob aJobs[NUM_JOBS];
+	CJob *apJobs[NUM_JOBS];
+	int aValues[NUM_JOBS];
+	for(int i = 0; i < NUM_JOBS; i++)
+	{
+		aValues[i] = i+2;
+		apJobs[i] = &aJobs[i];
+		Pool.Add(&aJobs[i], SlowSquare, &aValues[i]);
+	}
+	thread_sleep(5);
+	Pool.WaitAll(apJobs, NUM_JOBS);
+
+	for(int i = 0; i < NUM_JOBS; i++)
+	{
+		EXPECT_EQ(aJobs[i].Status(), CJob::STATE_DONE);
+		EXPECT_EQ(aValues[i], (i+2)*(i+2));
+	}
+}
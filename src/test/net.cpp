@@ -0,0 +1,259 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/config.h>
+#include <engine/shared/network.h>
+
+static NETSOCKET CreateSocketInRange(NETADDR *pBindAddr)
+{
+	NETSOCKET Socket;
+	for(pBindAddr->port = 28300; pBindAddr->port < 28400; pBindAddr->port++)
+	{
+		Socket = net_udp_create(*pBindAddr, 0);
+		if(Socket.type != NETTYPE_INVALID)
+			break;
+	}
+	return Socket;
+}
+
+TEST(Net, UdpBatch)
+{
+	NETADDR BindAddr;
+	mem_zero(&BindAddr, sizeof(BindAddr));
+	BindAddr.type = NETTYPE_IPV4;
+	NETSOCKET Sender = net_udp_create(BindAddr, 1);
+	ASSERT_NE(Sender.type, NETTYPE_INVALID);
+
+	// the receiver needs a known port
+	NETSOCKET Receiver = CreateSocketInRange(&BindAddr);
+	ASSERT_NE(Receiver.type, NETTYPE_INVALID);
+
+	NETADDR Addr;
+	ASSERT_EQ(net_addr_from_str(&Addr, "127.0.0.1"), 0);
+	Addr.port = BindAddr.port;
+
+	const int NumPackets = 100;
+	static char s_aaData[NumPackets][16];
+	NETPACKET aPackets[NumPackets];
+	for(int i = 0; i < NumPackets; i++)
+	{
+		str_format(s_aaData[i], sizeof(s_aaData[i]), "packet %d", i);
+		aPackets[i].addr = Addr;
+		aPackets[i].data = s_aaData[i];
+		aPackets[i].size = str_length(s_aaData[i])+1;
+	}
+	EXPECT_EQ(net_udp_send_batch(Sender, aPackets, NumPackets), NumPackets);
+
+	static char s_aaRecvData[NumPackets][64];
+	NETPACKET aRecvPackets[NumPackets];
+	for(int i = 0; i < NumPackets; i++)
+		aRecvPackets[i].data = s_aaRecvData[i];
+
+	int NumReceived = 0;
+	for(int Tries = 0; NumReceived < NumPackets && Tries < 100; Tries++)
+	{
+		net_socket_read_wait(Receiver, 10);
+		NumReceived += net_udp_recv_batch(Receiver, aRecvPackets+NumReceived, NumPackets-NumReceived, sizeof(s_aaRecvData[0]));
+	}
+	ASSERT_EQ(NumReceived, NumPackets);
+	for(int i = 0; i < NumPackets; i++)
+	{
+		EXPECT_EQ(aRecvPackets[i].size, aPackets[i].size);
+		EXPECT_STREQ((char *)aRecvPackets[i].data, s_aaData[i]);
+	}
+	EXPECT_EQ(net_udp_recv_batch(Receiver, aRecvPackets, NumPackets, sizeof(s_aaRecvData[0])), 0);
+
+	net_udp_close(Sender);
+	net_udp_close(Receiver);
+}
+
+class NetServer : public ::testing::Test
+{
+protected:
+	enum
+	{
+		NUM_CLIENTS = 4,
+	};
+
+	CConfigManager m_ConfigManager;
+	CNetServer m_Server;
+	CNetClient m_aClients[NUM_CLIENTS];
+	int m_aClientIDs[NUM_CLIENTS];
+	int m_NumConnected;
+	NETADDR m_ServerAddr;
+
+	static int NewClient(int ClientID, void *pUser)
+	{
+		((NetServer *)pUser)->m_NumConnected++;
+		return 0;
+	}
+
+	static int DelClient(int ClientID, const char *pReason, void *pUser)
+	{
+		((NetServer *)pUser)->m_NumConnected--;
+		return 0;
+	}
+
+	void Pump()
+	{
+		for(int Tries = 0; Tries < 20; Tries++)
+		{
+			CNetChunk Chunk;
+			for(int i = 0; i < NUM_CLIENTS; i++)
+			{
+				m_aClients[i].Update();
+				while(m_aClients[i].Recv(&Chunk))
+					;
+			}
+			m_Server.Update();
+			while(m_Server.Recv(&Chunk))
+			{
+				// the payload tells which client sent it
+				int Client = *(int *)Chunk.m_pData;
+				m_aClientIDs[Client] = Chunk.m_ClientID;
+			}
+			thread_sleep(1);
+		}
+	}
+
+	void SendFromClient(int Client)
+	{
+		CNetChunk Chunk;
+		Chunk.m_ClientID = 0;
+		Chunk.m_Flags = NETSENDFLAG_VITAL|NETSENDFLAG_FLUSH;
+		Chunk.m_pData = &Client;
+		Chunk.m_DataSize = sizeof(Client);
+		m_aClients[Client].Send(&Chunk);
+	}
+
+	void SetUp()
+	{
+		ASSERT_EQ(secure_random_init(), 0);
+		m_ConfigManager.Reset();
+		m_NumConnected = 0;
+
+		NETADDR BindAddr;
+		mem_zero(&BindAddr, sizeof(BindAddr));
+		BindAddr.type = NETTYPE_IPV4;
+		NETSOCKET Socket = CreateSocketInRange(&BindAddr);
+		ASSERT_NE(Socket.type, NETTYPE_INVALID);
+		net_udp_close(Socket);
+		ASSERT_TRUE(m_Server.Open(BindAddr, m_ConfigManager.Values(), 0, 0, 0, 8, 2, NewClient, DelClient, this));
+
+		ASSERT_EQ(net_addr_from_str(&m_ServerAddr, "127.0.0.1"), 0);
+		m_ServerAddr.port = BindAddr.port;
+		BindAddr.port = 0;
+		for(int i = 0; i < NUM_CLIENTS; i++)
+		{
+			ASSERT_TRUE(m_aClients[i].Open(BindAddr, m_ConfigManager.Values(), 0, 0, NETCREATE_FLAG_RANDOMPORT));
+			m_aClients[i].Connect(&m_ServerAddr);
+			m_aClientIDs[i] = -1;
+		}
+	}
+
+	void TearDown()
+	{
+		for(int i = 0; i < NUM_CLIENTS; i++)
+			m_aClients[i].Close();
+		m_Server.Close();
+	}
+};
+
+TEST_F(NetServer, ClientsPerIP)
+{
+	Pump();
+	EXPECT_EQ(m_NumConnected, 2);
+
+	// packets get dispatched to the slot of their sender
+	for(int i = 0; i < NUM_CLIENTS; i++)
+		SendFromClient(i);
+	Pump();
+	int NumOnline = 0;
+	for(int i = 0; i < NUM_CLIENTS; i++)
+	{
+		if(m_aClients[i].State() != NETSTATE_ONLINE)
+			continue;
+		NumOnline++;
+		ASSERT_GE(m_aClientIDs[i], 0);
+		for(int j = 0; j < i; j++)
+			EXPECT_NE(m_aClientIDs[i], m_aClientIDs[j]);
+	}
+	EXPECT_EQ(NumOnline, 2);
+
+	// dropping a client frees its place for the same ip
+	int Rejected = -1;
+	for(int i = 0; i < NUM_CLIENTS; i++)
+	{
+		if(m_aClientIDs[i] < 0)
+			Rejected = i;
+	}
+	for(int i = 0; i < NUM_CLIENTS; i++)
+	{
+		if(m_aClientIDs[i] >= 0)
+		{
+			m_Server.Drop(m_aClientIDs[i], "test");
+			break;
+		}
+	}
+	EXPECT_EQ(m_NumConnected, 1);
+
+	ASSERT_GE(Rejected, 0);
+	m_aClients[Rejected].Connect(&m_ServerAddr);
+	Pump();
+	EXPECT_EQ(m_NumConnected, 2);
+	SendFromClient(Rejected);
+	Pump();
+	EXPECT_GE(m_aClientIDs[Rejected], 0);
+}
+
+TEST_F(NetServer, ReconnectAfterOutOfBuffer)
+{
+	Pump();
+	int Client = -1;
+	for(int i = 0; i < NUM_CLIENTS; i++)
+	{
+		SendFromClient(i);
+		if(m_aClients[i].State() == NETSTATE_ONLINE && Client == -1)
+			Client = i;
+	}
+	Pump();
+	ASSERT_GE(Client, 0);
+	ASSERT_GE(m_aClientIDs[Client], 0);
+	EXPECT_EQ(m_NumConnected, 2);
+
+	// flood vital chunks without letting the client ack them
+	static char s_aData[1024];
+	mem_zero(s_aData, sizeof(s_aData));
+	for(int i = 0; i < 100 && m_NumConnected == 2; i++)
+	{
+		CNetChunk Chunk;
+		Chunk.m_ClientID = m_aClientIDs[Client];
+		Chunk.m_Flags = NETSENDFLAG_VITAL;
+		Chunk.m_pData = s_aData;
+		Chunk.m_DataSize = sizeof(s_aData);
+		m_Server.Send(&Chunk);
+	}
+	EXPECT_EQ(m_NumConnected, 1);
+
+	// the same address gets a slot again
+	m_aClients[Client].Disconnect(0);
+	m_aClients[Client].Connect(&m_ServerAddr);
+	m_aClientIDs[Client] = -1;
+	Pump();
+	EXPECT_EQ(m_NumConnected, 2);
+	SendFromClient(Client);
+	Pump();
+	EXPECT_GE(m_aClientIDs[Client], 0);
+
+	// and is counted once against its ip
+	for(int i = 0; i < NUM_CLIENTS; i++)
+	{
+		if(m_aClients[i].State() != NETSTATE_ONLINE)
+		{
+			m_aClients[i].Disconnect(0);
+			m_aClients[i].Connect(&m_ServerAddr);
+		}
+	}
+	Pump();
+	EXPECT_EQ(m_NumConnected, 2);
+}
@@ -0,0 +1,383 @@
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/shared/snapshot.h>
+#include <engine/shared/uuid_manager.h>
+
+static int SnapSize(int Tick)
+{
+	// vary the size, with the occasional snapshot that doesn't fit into a chunk
+	return Tick%100 == 0 ? 100*1024 : 64 + (Tick*37)%100*160;
+}
+
+static void FillSnap(char *pData, int Size, int Tick)
+{
+	for(int i = 0; i < Size; i++)
+		pData[i] = (char)(Tick+i);
+}
+
+TEST(SnapshotStorage, AddGetPurge)
+{
+	static char s_aData[128*1024];
+	static char s_aExpected[128*1024];
+	CSnapshotStorage Storage;
+	Storage.Init();
+
+	int SteadyAllocated = 0;
+	for(int Tick = 1; Tick <= 2000; Tick++)
+	{
+		Storage.PurgeUntil(Tick-150);
+		int Size = SnapSize(Tick);
+		FillSnap(s_aData, Size, Tick);
+		Storage.Add(Tick, Tick, Size, s_aData, Tick%2);
+
+		// the oldest and the newest snapshot have to be intact
+		int aTicks[] = {max(Tick-150, 1), Tick};
+		for(unsigned i = 0; i < sizeof(aTicks)/sizeof(aTicks[0]); i++)
+		{
+			CSnapshot *pSnap;
+			CSnapshot *pAltSnap;
+			int64 Tagtime;
+			ASSERT_EQ(Storage.Get(aTicks[i], &Tagtime, &pSnap, &pAltSnap), SnapSize(aTicks[i]));
+			EXPECT_EQ(Tagtime, aTicks[i]);
+			FillSnap(s_aExpected, SnapSize(aTicks[i]), aTicks[i]);
+			EXPECT_EQ(mem_comp(pSnap, s_aExpected, SnapSize(aTicks[i])), 0);
+			if(aTicks[i]%2)
+				EXPECT_EQ(mem_comp(pAltSnap, s_aExpected, SnapSize(aTicks[i])), 0);
+			else
+				EXPECT_EQ(pAltSnap, (CSnapshot *)0);
+		}
+		EXPECT_EQ(Storage.Get(Tick-151, 0, 0, 0), -1);
+		EXPECT_LE(Storage.UsedSize(), Storage.AllocatedSize());
+
+		// chunks get reused once enough of them exist
+		if(Tick > 1000)
+			EXPECT_LE(Storage.AllocatedSize(), SteadyAllocated);
+		else
+			SteadyAllocated = max(SteadyAllocated, Storage.AllocatedSize());
+	}
+
+	Storage.PurgeAll();
+	EXPECT_EQ(Storage.UsedSize(), 0);
+	EXPECT_EQ(Storage.AllocatedSize(), 0);
+}
+
+TEST(SnapshotBuilder, InitKeepsExtendedTypes)
+{
+	static int s_aShared[CSnapshot::MAX_SIZE/4];
+	static int s_aSnap[CSnapshot::MAX_SIZE/4];
+	CSnapshot *pShared = (CSnapshot *)s_aShared;
+	CSnapshot *pSnap = (CSnapshot *)s_aSnap;
+	CSnapshotBuilder Builder;
+
+	Builder.Init();
+	*(int *)Builder.NewItem(1, 0, 4) = 1;
+	Builder.Finish(pShared);
+
+	// an extended type first used on top of the shared items
+	Builder.Init(pShared);
+	*(int *)Builder.NewItem(OFFSET_UUID, 0, 4) = 2;
+	Builder.Finish(pSnap);
+	EXPECT_GE(pSnap->GetItemIndex(OFFSET_UUID, 0), 0);
+
+	// the next snapshot built on them needs the type item as well
+	Builder.Init(pShared);
+	*(int *)Builder.NewItem(OFFSET_UUID, 0, 4) = 3;
+	Builder.Finish(pSnap);
+	EXPECT_EQ(pSnap->NumItems(), 3);
+	int Index = pSnap->GetItemIndex(OFFSET_UUID, 0);
+	ASSERT_GE(Index, 0);
+	EXPECT_EQ(*(int *)pSnap->GetItem(Index)->Data(), 3);
+}
+
+// the hashed matcher CreateDelta used before, kept to check the output
+// bytes against. buckets hold up to 64 keys, keep test snapshots below that
+class CReferenceDelta
+{
+	enum
+	{
+		HASHLIST_SIZE=256,
+		MAX_BUCKET=64,
+	};
+
+	struct CItemList
+	{
+		int m_Num;
+		int m_aKeys[MAX_BUCKET];
+		int m_aIndex[MAX_BUCKET];
+	};
+
+	CItemList m_aHashlist[HASHLIST_SIZE];
+
+	void GenerateHash(const CSnapshot *pSnapshot)
+	{
+		for(int i = 0; i < HASHLIST_SIZE; i++)
+			m_aHashlist[i].m_Num = 0;
+
+		for(int i = 0; i < pSnapshot->NumItems(); i++)
+		{
+			int Key = pSnapshot->GetItem(i)->Key();
+			int HashID = ((Key>>12)&0xf0) | (Key&0xf);
+			if(m_aHashlist[HashID].m_Num != MAX_BUCKET)
+			{
+				m_aHashlist[HashID].m_aIndex[m_aHashlist[HashID].m_Num] = i;
+				m_aHashlist[HashID].m_aKeys[m_aHashlist[HashID].m_Num] = Key;
+				m_aHashlist[HashID].m_Num++;
+			}
+		}
+	}
+
+	int GetItemIndexHashed(int Key) const
+	{
+		int HashID = ((Key>>12)&0xf0) | (Key&0xf);
+		for(int i = 0; i < m_aHashlist[HashID].m_Num; i++)
+		{
+			if(m_aHashlist[HashID].m_aKeys[i] == Key)
+				return m_aHashlist[HashID].m_aIndex[i];
+		}
+		return -1;
+	}
+
+public:
+	int CreateDelta(const short *pItemSizes, int NumItemSizes, const CSnapshot *pFrom, const CSnapshot *pTo, void *pDstData)
+	{
+		CSnapshotDelta::CData *pDelta = (CSnapshotDelta::CData *)pDstData;
+		int *pData = (int *)pDelta->m_pData;
+
+		pDelta->m_NumDeletedItems = 0;
+		pDelta->m_NumUpdateItems = 0;
+		pDelta->m_NumTempItems = 0;
+
+		// pack deleted stuff
+		GenerateHash(pTo);
+		for(int i = 0; i < pFrom->NumItems(); i++)
+		{
+			if(GetItemIndexHashed(pFrom->GetItem(i)->Key()) == -1)
+			{
+				pDelta->m_NumDeletedItems++;
+				*pData++ = pFrom->GetItem(i)->Key();
+			}
+		}
+
+		GenerateHash(pFrom);
+		for(int i = 0; i < pTo->NumItems(); i++)
+		{
+			int ItemSize = pTo->GetItemSize(i);
+			const CSnapshotItem *pCurItem = pTo->GetItem(i);
+			int PastIndex = GetItemIndexHashed(pCurItem->Key());
+			bool IncludeSize = pCurItem->Type() >= NumItemSizes || !pItemSizes[pCurItem->Type()];
+			int *pItemData = pData + (IncludeSize ? 3 : 2);
+
+			if(PastIndex != -1)
+			{
+				const int *pPast = pFrom->GetItem(PastIndex)->Data();
+				const int *pCurrent = pCurItem->Data();
+				int Needed = 0;
+				for(int d = 0; d < ItemSize/4; d++)
+				{
+					pItemData[d] = pCurrent[d]-pPast[d];
+					Needed |= pItemData[d];
+				}
+				if(!Needed)
+					continue;
+			}
+			else
+				mem_copy(pItemData, pCurItem->Data(), ItemSize);
+
+			*pData++ = pCurItem->Type();
+			*pData++ = pCurItem->ID();
+			if(IncludeSize)
+				*pData++ = ItemSize/4;
+			pData += ItemSize/4;
+			pDelta->m_NumUpdateItems++;
+		}
+
+		if(!pDelta->m_NumDeletedItems && !pDelta->m_NumUpdateItems && !pDelta->m_NumTempItems)
+			return 0;
+
+		return (int)((char *)pData-(char *)pDstData);
+	}
+};
+
+class SnapshotDelta : public ::testing::Test
+{
+protected:
+	CSnapshotDelta m_Delta;
+	CReferenceDelta m_Reference;
+	short m_aItemSizes[8];
+	CSnapshotBuilder m_Builder;
+	int m_aFrom[CSnapshot::MAX_SIZE/4];
+	int m_aTo[CSnapshot::MAX_SIZE/4];
+	int m_aResult[CSnapshot::MAX_SIZE/4];
+	int m_aDeltaData[CSnapshot::MAX_SIZE/4*2];
+	int m_aReferenceData[CSnapshot::MAX_SIZE/4*2];
+	unsigned m_Seed;
+
+	CSnapshot *From() { return (CSnapshot *)m_aFrom; }
+	CSnapshot *To() { return (CSnapshot *)m_aTo; }
+	CSnapshot *Result() { return (CSnapshot *)m_aResult; }
+
+	unsigned Random()
+	{
+		m_Seed = m_Seed*1103515245u + 12345u;
+		return (m_Seed>>16)&0x7fff;
+	}
+
+	void SetUp()
+	{
+		m_Seed = 1337;
+		mem_zero(m_aItemSizes, sizeof(m_aItemSizes));
+		m_aItemSizes[1] = 4*4;
+		m_aItemSizes[2] = 7*4;
+		for(int i = 0; i < 8; i++)
+			m_Delta.SetStaticsize(i, m_aItemSizes[i]);
+	}
+
+	// items with small changes between snapshots, like players moving around
+	int BuildSnap(CSnapshot *pSnap, int Seed, int NumItems, int IDStep)
+	{
+		m_Builder.Init();
+		for(int i = 0; i < NumItems; i++)
+		{
+			int Type = 1 + i%5;
+			int Size = Type == 1 ? 4 : Type == 2 ? 7 : 1 + i%13;
+			int *pData = (int *)m_Builder.NewItem(Type, i*IDStep, Size*4);
+			for(int d = 0; d < Size; d++)
+				pData[d] = (i*31+d*7) + (Random()%4 == 0 ? (int)(Random()%200) - 100 + Seed : 0);
+		}
+		return m_Builder.Finish(pSnap);
+	}
+
+	void ExpectSameAsReference()
+	{
+		int DeltaSize = m_Delta.CreateDelta(From(), To(), m_aDeltaData);
+		int ReferenceSize = m_Reference.CreateDelta(m_aItemSizes, 8, From(), To(), m_aReferenceData);
+		ASSERT_EQ(DeltaSize, ReferenceSize);
+		EXPECT_EQ(mem_comp(m_aDeltaData, m_aReferenceData, DeltaSize), 0);
+	}
+
+	void ExpectRoundtrip()
+	{
+		int DeltaSize = m_Delta.CreateDelta(From(), To(), m_aDeltaData);
+		ASSERT_GE(DeltaSize, 0);
+		if(DeltaSize == 0)
+		{
+			// nothing changed
+			ASSERT_EQ(From()->Crc(), To()->Crc());
+			return;
+		}
+		int ResultSize = m_Delta.UnpackDelta(From(), Result(), m_aDeltaData, DeltaSize);
+		ASSERT_GE(ResultSize, 0);
+		ASSERT_EQ(Result()->NumItems(), To()->NumItems());
+		for(int i = 0; i < To()->NumItems(); i++)
+		{
+			int Index = Result()->GetItemIndex(To()->GetItem(i)->Type(), To()->GetItem(i)->ID());
+			ASSERT_GE(Index, 0);
+			ASSERT_EQ(Result()->GetItemSize(Index), To()->GetItemSize(i));
+			EXPECT_EQ(mem_comp(Result()->GetItem(Index)->Data(), To()->GetItem(i)->Data(), To()->GetItemSize(i)), 0);
+		}
+	}
+};
+
+TEST_F(SnapshotDelta, Roundtrip)
+{
+	for(int i = 0; i < 50; i++)
+	{
+		BuildSnap(From(), i, Random()%300, 1);
+		BuildSnap(To(), i+1, Random()%300, 1+i%3);
+		ExpectRoundtrip();
+	}
+}
+
+TEST_F(SnapshotDelta, MatchesReference)
+{
+	for(int i = 0; i < 50; i++)
+	{
+		BuildSnap(From(), i, Random()%300, 1);
+		BuildSnap(To(), i+1, Random()%300, 1+i%3);
+		ExpectSameAsReference();
+	}
+
+	// same type, IDs sharing the low bits, but few enough for the old buckets
+	m_Builder.Init();
+	for(int i = 0; i < 60; i++)
+		*(int *)m_Builder.NewItem(3, i*16, 4) = i;
+	m_Builder.Finish(From());
+	m_Builder.Init();
+	for(int i = 5; i < 64; i++)
+		*(int *)m_Builder.NewItem(3, i*16, 4) = i*2;
+	m_Builder.Finish(To());
+	ExpectSameAsReference();
+
+	// unsorted keys after invalidating items
+	BuildSnap(From(), 0, 200, 1);
+	BuildSnap(To(), 1, 200, 1);
+	for(int i = 0; i < 200; i += 7)
+		From()->InvalidateItem(i);
+	ExpectSameAsReference();
+}
+
+TEST_F(SnapshotDelta, Unchanged)
+{
+	BuildSnap(From(), 0, 100, 1);
+	mem_copy(m_aTo, m_aFrom, sizeof(m_aTo));
+	EXPECT_EQ(m_Delta.CreateDelta(From(), To(), m_aDeltaData), 0);
+}
+
+TEST_F(SnapshotDelta, ManySimilarKeys)
+{
+	// many items of the same type whose IDs share the low bits
+	m_Builder.Init();
+	for(int i = 0; i < 70; i++)
+		*(int *)m_Builder.NewItem(3, i*16, 4) = i;
+	m_Builder.Finish(From());
+	mem_copy(m_aTo, m_aFrom, sizeof(m_aTo));
+	EXPECT_EQ(m_Delta.CreateDelta(From(), To(), m_aDeltaData), 0);
+
+	((int *)To()->GetItem(69)->Data())[0]++;
+	ExpectRoundtrip();
+}
+
+TEST_F(SnapshotDelta, InvalidatedItems)
+{
+	// the client invalidates broken items, which leaves the keys unsorted
+	BuildSnap(From(), 0, 200, 1);
+	BuildSnap(To(), 1, 200, 1);
+	for(int i = 0; i < 200; i += 7)
+		From()->InvalidateItem(i);
+	ExpectRoundtrip();
+}
+
+TEST_F(SnapshotDelta, DISABLED_Benchmark)
+{
+	// run with --gtest_also_run_disabled_tests, a stream of snapshots
+	// similar to a full server where a few values change every tick
+	const int NumSnaps = 200;
+	const int Rounds = 50;
+	int64 CreateTime = 0;
+	int64 UnpackTime = 0;
+	int TotalSize = 0;
+	for(int i = 0; i < NumSnaps; i++)
+	{
+		BuildSnap(From(), i, 256, 1);
+		BuildSnap(To(), i+1, 256, 1);
+
+		int64 Start = time_get();
+		int DeltaSize = 0;
+		for(int r = 0; r < Rounds; r++)
+			DeltaSize = m_Delta.CreateDelta(From(), To(), m_aDeltaData);
+		CreateTime += time_get()-Start;
+		ASSERT_GT(DeltaSize, 0);
+		ASSERT_EQ(DeltaSize, m_Reference.CreateDelta(m_aItemSizes, 8, From(), To(), m_aReferenceData));
+		ASSERT_EQ(mem_comp(m_aDeltaData, m_aReferenceData, DeltaSize), 0);
+		TotalSize += DeltaSize;
+
+		Start = time_get();
+		for(int r = 0; r < Rounds; r++)
+			ASSERT_GE(m_Delta.UnpackDelta(From(), Result(), m_aDeltaData, DeltaSize), 0);
+		UnpackTime += time_get()-Start;
+	}
+	printf("create=%.2fus unpack=%.2fus avgsize=%d\n",
+		CreateTime*1000000.0/time_freq()/(NumSnaps*Rounds), UnpackTime*1000000.0/time_freq()/(NumSnaps*Rounds), TotalSize/NumSnaps);
+}